@@ -0,0 +1,477 @@
+#include "async_reader.h"
+#include "file_utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#include <linux/io_uring.h>
+#define LIDAR_HAVE_IO_URING
+#endif
+#endif
+
+// Logical block size O_DIRECT transfers are aligned to
+static const size_t IO_ALIGNMENT = 4096;
+
+AlignedBuffer::AlignedBuffer(size_t size, size_t alignment)
+    : data(NULL), size(size) {
+  size_t bytes = std::max<size_t>(size, 1);
+#ifdef _WIN32
+  data = (char *)_aligned_malloc(bytes, alignment);
+#else
+  void *p = NULL;
+  if (posix_memalign(&p, alignment, bytes) == 0)
+    data = (char *)p;
+#endif
+  if (!data)
+    this->size = 0;
+}
+
+AlignedBuffer::~AlignedBuffer() {
+#ifdef _WIN32
+  _aligned_free(data);
+#else
+  free(data);
+#endif
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other)
+    : data(other.data), size(other.size) {
+  other.data = NULL;
+  other.size = 0;
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) {
+  std::swap(data, other.data);
+  std::swap(size, other.size);
+  return *this;
+}
+
+AsyncFileReader::AsyncFileReader()
+    : backend(BACKEND_THREAD_POOL), queueDepth(0), directIO(false),
+      ringFd(-1), sqRing(NULL), cqRing(NULL), sqes(NULL), sqRingSize(0),
+      cqRingSize(0), sqesSize(0), sqHead(NULL), sqTail(NULL), sqMask(NULL),
+      sqArray(NULL), cqHead(NULL), cqTail(NULL), cqMask(NULL), cqes(NULL),
+      running(0), stopping(false) {}
+
+AsyncFileReader::~AsyncFileReader() { shutdown(); }
+
+bool AsyncFileReader::init(unsigned depth, bool direct, bool forceThreads,
+                           unsigned threads) {
+  shutdown();
+  queueDepth = std::max(depth, 1u);
+  directIO = direct;
+
+  if (!forceThreads && initRing(queueDepth)) {
+    backend = BACKEND_IO_URING;
+    return true;
+  }
+
+  backend = BACKEND_THREAD_POOL;
+  stopping = false;
+  for (unsigned i = 0; i < std::max(threads, 1u); ++i)
+    workers.push_back(std::thread(&AsyncFileReader::workerLoop, this));
+  return true;
+}
+
+void AsyncFileReader::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workReady.notify_all();
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+  workers.clear();
+  work.clear();
+  done.clear();
+  running = 0;
+
+  // Closing the ring doesn't cancel reads the kernel already took, which
+  // would still land in their buffers; wait for every one to complete
+  // before the buffers go away
+  std::vector<ReadCompletion> discarded;
+  while (ringFd >= 0 && freeSlots.size() < slots.size()) {
+    reapRing(discarded, true);
+    discarded.clear();
+  }
+  destroyRing();
+  slots.clear();
+  freeSlots.clear();
+  queued.clear();
+
+  for (size_t i = 0; i < files.size(); ++i)
+    closeFile((int)i);
+  files.clear();
+}
+
+const char *AsyncFileReader::getBackendName() const {
+  return backend == BACKEND_IO_URING ? "io_uring" : "thread pool";
+}
+
+int AsyncFileReader::openFile(const std::string &path) {
+  File file;
+  file.fd = -1;
+  file.direct = false;
+  file.path = path;
+#ifdef _WIN32
+  if (!fileExists(path))
+    return -1;
+#else
+#ifdef O_DIRECT
+  // tmpfs and some network file systems reject O_DIRECT
+  if (directIO) {
+    file.fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+    file.direct = file.fd >= 0;
+  }
+#endif
+  if (file.fd < 0)
+    file.fd = open(path.c_str(), O_RDONLY);
+  if (file.fd < 0)
+    return -1;
+#endif
+  // Pool workers look files up while new ones are opened
+  std::lock_guard<std::mutex> lock(mutex);
+  files.push_back(file);
+  return (int)files.size() - 1;
+}
+
+void AsyncFileReader::closeFile(int handle) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (handle < 0 || handle >= (int)files.size())
+    return;
+#ifndef _WIN32
+  if (files[handle].fd >= 0)
+    close(files[handle].fd);
+#endif
+  files[handle].fd = -1;
+}
+
+bool AsyncFileReader::isDirect(int handle) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return handle >= 0 && handle < (int)files.size() && files[handle].direct;
+}
+
+AsyncFileReader::Request AsyncFileReader::makeRequest(int handle,
+                                                      uint64_t offset,
+                                                      size_t size,
+                                                      uint64_t tag) {
+  Request request;
+  request.handle = handle;
+  request.offset = offset;
+  request.size = size;
+  request.tag = tag;
+  request.alignedOffset = offset;
+  request.alignedSize = size;
+  if (isDirect(handle)) {
+    // Widen the transfer to whole blocks
+    const uint64_t mask = ~(uint64_t)(IO_ALIGNMENT - 1);
+    uint64_t end = (offset + size + IO_ALIGNMENT - 1) & mask;
+    request.alignedOffset = offset & mask;
+    request.alignedSize = (size_t)(end - request.alignedOffset);
+  }
+  request.buffer = AlignedBuffer(request.alignedSize, IO_ALIGNMENT);
+  return request;
+}
+
+void AsyncFileReader::finish(Request &request, long result,
+                             ReadCompletion &out) {
+  out.tag = request.tag;
+  out.dataOffset = (size_t)(request.offset - request.alignedOffset);
+  out.size = 0;
+  out.error = 0;
+  if (result < 0) {
+    out.error = (int)-result;
+  } else if ((size_t)result > out.dataOffset) {
+    out.size = std::min(request.size, (size_t)result - out.dataOffset);
+  }
+  // Reads past the end of the file come back short
+  if (out.error == 0 && out.size < request.size)
+    out.error = EIO;
+  out.buffer = std::move(request.buffer);
+}
+
+void AsyncFileReader::read(int handle, uint64_t offset, size_t size,
+                           uint64_t tag) {
+  queued.push_back(makeRequest(handle, offset, size, tag));
+}
+
+void AsyncFileReader::submit() {
+  if (backend == BACKEND_IO_URING) {
+    submitRing();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!queued.empty()) {
+      work.push_back(std::move(queued.front()));
+      queued.pop_front();
+    }
+  }
+  workReady.notify_all();
+}
+
+size_t AsyncFileReader::getOutstanding() const {
+  if (backend == BACKEND_IO_URING)
+    return queued.size() + slots.size() - freeSlots.size() + done.size();
+  std::lock_guard<std::mutex> lock(mutex);
+  return queued.size() + work.size() + running + done.size();
+}
+
+size_t AsyncFileReader::poll(std::vector<ReadCompletion> &out, bool wait) {
+  if (backend == BACKEND_IO_URING) {
+    submitRing();
+    size_t count = reapRing(out, wait);
+    submitRing(); // Refill the slots that just freed up
+    return count;
+  }
+
+  submit();
+  std::unique_lock<std::mutex> lock(mutex);
+  if (wait) {
+    doneReady.wait(lock, [this]() {
+      return !done.empty() || (work.empty() && running == 0);
+    });
+  }
+  size_t count = done.size();
+  for (size_t i = 0; i < done.size(); ++i)
+    out.push_back(std::move(done[i]));
+  done.clear();
+  return count;
+}
+
+void AsyncFileReader::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    workReady.wait(lock, [this]() { return stopping || !work.empty(); });
+    if (stopping)
+      return;
+
+    Request request = std::move(work.front());
+    work.pop_front();
+    ++running;
+    const File file = files[request.handle];
+    lock.unlock();
+
+    long result = 0;
+#ifdef _WIN32
+    result = readFileRange(file.path, request.alignedOffset,
+                           request.alignedSize, request.buffer.get())
+                 ? (long)request.alignedSize
+                 : -EIO;
+#else
+    size_t total = 0;
+    while (total < request.alignedSize) {
+      ssize_t n = pread(file.fd, request.buffer.get() + total,
+                        request.alignedSize - total,
+                        (off_t)(request.alignedOffset + total));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0) {
+        result = -errno;
+        break;
+      }
+      if (n == 0)
+        break;
+      total += (size_t)n;
+    }
+    if (result == 0)
+      result = (long)total;
+#endif
+
+    ReadCompletion completion;
+    finish(request, result, completion);
+
+    lock.lock();
+    --running;
+    done.push_back(std::move(completion));
+    doneReady.notify_all();
+  }
+}
+
+#ifdef LIDAR_HAVE_IO_URING
+
+bool AsyncFileReader::initRing(unsigned entries) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0)
+    return false; // Old kernel, or disabled by seccomp or sysctl
+
+  // Rings exist since 5.1 but plain reads only since 5.6; older kernels
+  // also lack the probe and fail it
+  std::vector<char> probeBytes(sizeof(io_uring_probe) +
+                               256 * sizeof(io_uring_probe_op));
+  io_uring_probe *probe = (io_uring_probe *)probeBytes.data();
+  if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+              256) < 0 ||
+      probe->last_op < IORING_OP_READ ||
+      !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+    close(fd);
+    return false;
+  }
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap)
+    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  cqRing = singleMap ? sqRing
+                     : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  ringFd = fd;
+  if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+    if (sqRing == MAP_FAILED)
+      sqRing = NULL;
+    if (cqRing == MAP_FAILED)
+      cqRing = NULL;
+    if (sqes == MAP_FAILED)
+      sqes = NULL;
+    destroyRing();
+    return false;
+  }
+
+  char *sq = (char *)sqRing, *cq = (char *)cqRing;
+  sqHead = (unsigned *)(sq + params.sq_off.head);
+  sqTail = (unsigned *)(sq + params.sq_off.tail);
+  sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+  sqArray = (unsigned *)(sq + params.sq_off.array);
+  cqHead = (unsigned *)(cq + params.cq_off.head);
+  cqTail = (unsigned *)(cq + params.cq_off.tail);
+  cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+
+  // The completion ring is at least as large, so it can't overflow
+  slots.resize(params.sq_entries);
+  freeSlots.clear();
+  for (unsigned i = 0; i < params.sq_entries; ++i)
+    freeSlots.push_back(params.sq_entries - 1 - i);
+  return true;
+}
+
+void AsyncFileReader::destroyRing() {
+  if (sqes)
+    munmap(sqes, sqesSize);
+  if (cqRing && cqRing != sqRing)
+    munmap(cqRing, cqRingSize);
+  if (sqRing)
+    munmap(sqRing, sqRingSize);
+  if (ringFd >= 0)
+    close(ringFd);
+  sqes = sqRing = cqRing = NULL;
+  ringFd = -1;
+}
+
+void AsyncFileReader::submitRing() {
+  unsigned tail = *sqTail;
+  unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  unsigned count = 0;
+  while (!queued.empty() && !freeSlots.empty() &&
+         tail - head < (unsigned)slots.size()) {
+    unsigned slot = freeSlots.back();
+    freeSlots.pop_back();
+    Request &request = slots[slot];
+    request = std::move(queued.front());
+    queued.pop_front();
+
+    unsigned index = tail & *sqMask;
+    io_uring_sqe *sqe = (io_uring_sqe *)sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = files[request.handle].fd;
+    sqe->off = request.alignedOffset;
+    sqe->addr = (uint64_t)(uintptr_t)request.buffer.get();
+    sqe->len = (uint32_t)request.alignedSize;
+    sqe->user_data = slot;
+    sqArray[index] = index;
+    ++tail;
+    ++count;
+  }
+  if (count == 0)
+    return;
+
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+  int error = 0;
+  while (count > 0) {
+    int submitted = (int)syscall(__NR_io_uring_enter, ringFd, count, 0, 0,
+                                 NULL, 0);
+    if (submitted < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (submitted <= 0) {
+      error = submitted < 0 ? errno : EIO;
+      break;
+    }
+    count -= (unsigned)submitted;
+  }
+  if (count == 0)
+    return;
+
+  // The kernel refused the rest. It only takes entries inside enter, so
+  // they can be taken back off the ring and failed; reapRing hands them
+  // out with the next completions.
+  head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  for (unsigned i = head; i != tail; ++i) {
+    const io_uring_sqe *sqe = (io_uring_sqe *)sqes + sqArray[i & *sqMask];
+    unsigned slot = (unsigned)sqe->user_data;
+    done.push_back(ReadCompletion());
+    finish(slots[slot], -error, done.back());
+    freeSlots.push_back(slot);
+  }
+  __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+}
+
+size_t AsyncFileReader::reapRing(std::vector<ReadCompletion> &out,
+                                 bool wait) {
+  // Reads submitRing failed
+  size_t count = done.size();
+  for (size_t i = 0; i < done.size(); ++i)
+    out.push_back(std::move(done[i]));
+  done.clear();
+  for (;;) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = ((io_uring_cqe *)cqes)[head & *cqMask];
+      unsigned slot = (unsigned)cqe.user_data;
+      out.push_back(ReadCompletion());
+      finish(slots[slot], cqe.res, out.back());
+      freeSlots.push_back(slot);
+      ++count;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    bool inFlight = freeSlots.size() < slots.size();
+    if (count > 0 || !wait || !inFlight)
+      return count;
+    syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL,
+            0);
+  }
+}
+
+#else
+
+bool AsyncFileReader::initRing(unsigned) { return false; }
+void AsyncFileReader::destroyRing() {}
+void AsyncFileReader::submitRing() {}
+size_t AsyncFileReader::reapRing(std::vector<ReadCompletion> &, bool) {
+  return 0;
+}
+
+#endif
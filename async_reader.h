@@ -0,0 +1,128 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Heap memory aligned for O_DIRECT transfers
+class AlignedBuffer {
+public:
+  AlignedBuffer() : data(NULL), size(0) {}
+  explicit AlignedBuffer(size_t size, size_t alignment = 4096);
+  ~AlignedBuffer();
+  AlignedBuffer(AlignedBuffer &&other);
+  AlignedBuffer &operator=(AlignedBuffer &&other);
+  AlignedBuffer(const AlignedBuffer &) = delete;
+  AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+  char *get() const { return data; }
+  size_t getSize() const { return size; }
+
+private:
+  char *data;
+  size_t size;
+};
+
+// A finished read. With O_DIRECT the transfer is widened to block
+// boundaries, so the requested bytes start dataOffset into the buffer.
+struct ReadCompletion {
+  uint64_t tag;
+  int error; // 0 or an errno value
+  AlignedBuffer buffer;
+  size_t dataOffset;
+  size_t size; // Requested bytes actually read
+  const char *data() const { return buffer.get() + dataOffset; }
+};
+
+// Batched asynchronous file reads. On Linux the reads go through io_uring
+// (raw syscalls, no liburing); elsewhere, or when the kernel refuses it,
+// a thread pool issues blocking preads instead.
+class AsyncFileReader {
+public:
+  enum Backend { BACKEND_IO_URING, BACKEND_THREAD_POOL };
+
+  AsyncFileReader();
+  ~AsyncFileReader();
+
+  // queueDepth bounds the reads in flight; directIO opens files with
+  // O_DIRECT where the file system supports it
+  bool init(unsigned queueDepth = 64, bool directIO = false,
+            bool forceThreads = false, unsigned threads = 4);
+  void shutdown();
+
+  Backend getBackend() const { return backend; }
+  const char *getBackendName() const;
+
+  // Returns a handle, or -1 if the file can't be opened
+  int openFile(const std::string &path);
+  void closeFile(int handle);
+  bool isDirect(int handle) const;
+
+  // Queue a read; nothing is issued until submit() or poll()
+  void read(int handle, uint64_t offset, size_t size, uint64_t tag);
+  void submit();
+
+  // Reads queued or in flight
+  size_t getOutstanding() const;
+
+  // Append finished reads to out. With wait, blocks until at least one
+  // read finishes (unless nothing is outstanding).
+  size_t poll(std::vector<ReadCompletion> &out, bool wait);
+
+private:
+  struct File {
+    int fd;
+    bool direct;
+    std::string path;
+  };
+
+  struct Request {
+    int handle;
+    uint64_t offset;
+    size_t size;
+    uint64_t tag;
+    uint64_t alignedOffset;
+    size_t alignedSize;
+    AlignedBuffer buffer;
+  };
+
+  Request makeRequest(int handle, uint64_t offset, size_t size, uint64_t tag);
+  void finish(Request &request, long result, ReadCompletion &out);
+  void workerLoop();
+
+  bool initRing(unsigned entries);
+  void destroyRing();
+  void submitRing();
+  size_t reapRing(std::vector<ReadCompletion> &out, bool wait);
+
+  Backend backend;
+  unsigned queueDepth;
+  bool directIO;
+  std::vector<File> files;
+
+  std::deque<Request> queued; // Not yet handed to the ring or pool
+
+  // io_uring state
+  int ringFd;
+  void *sqRing, *cqRing, *sqes;
+  size_t sqRingSize, cqRingSize, sqesSize;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  void *cqes;
+  std::vector<Request> slots;    // In-flight reads by slot (user_data)
+  std::vector<unsigned> freeSlots;
+
+  // Thread pool state
+  std::vector<std::thread> workers;
+  mutable std::mutex mutex;
+  std::condition_variable workReady, doneReady;
+  std::deque<Request> work;
+  std::vector<ReadCompletion> done; // Also reads the ring refused
+  size_t running;
+  bool stopping;
+};
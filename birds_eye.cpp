@@ -0,0 +1,260 @@
+#include "birds_eye.h"
+#include "elevation_grid.h"
+#include "gl_ext.h"
+#include "gl_stats.h"
+#include "memory_stats.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+const size_t SLAB = 4 << 20; // Points sorted at once
+
+uint32_t packColor(const Point3D &p) {
+  uint32_t r = (uint32_t)(std::min(std::max(p.r, 0.0f), 1.0f) * 255.0f + 0.5f);
+  uint32_t g = (uint32_t)(std::min(std::max(p.g, 0.0f), 1.0f) * 255.0f + 0.5f);
+  uint32_t b = (uint32_t)(std::min(std::max(p.b, 0.0f), 1.0f) * 255.0f + 0.5f);
+  return r | g << 8 | b << 16;
+}
+
+// The renderer's height gradient: blue (low) -> green -> red (high)
+void gradient(float t, float rgb[3]) {
+  t = std::min(std::max(t, 0.0f), 1.0f);
+  rgb[0] = t;
+  rgb[1] = 1.0f - std::fabs(t - 0.5f) * 2.0f;
+  rgb[2] = 1.0f - t;
+}
+
+} // namespace
+
+BirdsEyeRaster::BirdsEyeRaster()
+    : minX(0.0f), minZ(0.0f), cellSize(1.0f), width(0), height(0),
+      pointCount(0) {}
+
+bool BirdsEyeRaster::create(float originX, float originZ, int columns,
+                            int rows, float size) {
+  clear();
+  if (columns <= 0 || rows <= 0 || !(size > 0.0f) ||
+      (uint64_t)columns * (uint64_t)rows >= GridBins::OUTSIDE)
+    return false;
+  minX = originX;
+  minZ = originZ;
+  width = columns;
+  height = rows;
+  cellSize = size;
+  size_t cells = (size_t)width * height;
+  top.assign(cells, -std::numeric_limits<float>::infinity());
+  colors.assign(cells, 0);
+  intensity.assign(cells, 0.0f);
+  counts.assign(cells, 0);
+  return true;
+}
+
+void BirdsEyeRaster::clear() {
+  width = height = 0;
+  pointCount = 0;
+  std::vector<float>().swap(top);
+  std::vector<uint32_t>().swap(colors);
+  std::vector<float>().swap(intensity);
+  std::vector<uint32_t>().swap(counts);
+}
+
+void BirdsEyeRaster::addPoints(const Point3D *points, size_t count,
+                               unsigned threads) {
+  if (top.empty())
+    return;
+
+  GridBins bins;
+  for (size_t slab = 0; slab < count; slab += SLAB) {
+    const Point3D *slabPoints = points + slab;
+    bins.bin(slabPoints, std::min(SLAB, count - slab), minX, minZ, width,
+             height, cellSize, threads);
+    pointCount += bins.order.size();
+
+    parallelFor(
+        bins.getBandCount(),
+        [&](size_t b) {
+          for (size_t k = bins.starts[b]; k < bins.starts[b + 1]; ++k) {
+            const Point3D &p = slabPoints[bins.order[k]];
+            uint32_t cell = bins.cells[bins.order[k]];
+            uint32_t &c = counts[cell];
+            if (c < GridBins::OUTSIDE)
+              ++c;
+            if (p.y > top[cell]) {
+              top[cell] = p.y;
+              colors[cell] = packColor(p);
+            }
+            intensity[cell] += (p.intensity - intensity[cell]) / (float)c;
+          }
+        },
+        threads);
+  }
+}
+
+void BirdsEyeRaster::toImage(BirdsEyeChannel channel,
+                             const PointCloudRenderer &renderer,
+                             std::vector<unsigned char> &rgba,
+                             unsigned threads) const {
+  rgba.assign((size_t)width * height * 4, 0);
+  float min[3], max[3];
+  renderer.getBounds(min, max);
+  float range = max[1] > min[1] ? max[1] - min[1] : 1.0f;
+  uint32_t most = 1;
+  if (channel == BEV_DENSITY) {
+    for (size_t i = 0; i < counts.size(); ++i)
+      most = std::max(most, counts[i]);
+  }
+  float densityScale = 1.0f / std::log(1.0f + (float)most);
+
+  parallelFor(
+      (size_t)height,
+      [&](size_t row) {
+        for (size_t i = row * width; i < (row + 1) * width; ++i) {
+          if (counts[i] == 0)
+            continue; // Stays transparent
+          float rgb[3];
+          switch (channel) {
+          case BEV_POINTS: {
+            uint32_t c = colors[i];
+            Point3D p(0.0f, top[i], 0.0f, (c & 0xff) / 255.0f,
+                      (c >> 8 & 0xff) / 255.0f, (c >> 16 & 0xff) / 255.0f,
+                      intensity[i]);
+            renderer.getPointColor(p, rgb);
+            break;
+          }
+          case BEV_HEIGHT:
+            gradient((top[i] - min[1]) / range, rgb);
+            break;
+          case BEV_INTENSITY:
+            rgb[0] = rgb[1] = rgb[2] =
+                std::min(std::max(intensity[i], 0.0f), 1.0f);
+            break;
+          default:
+            gradient(std::log(1.0f + (float)counts[i]) * densityScale, rgb);
+            break;
+          }
+          // Occupied cells are opaque, so premultiplying changes nothing
+          for (int c = 0; c < 3; ++c)
+            rgba[i * 4 + c] = (unsigned char)(rgb[c] * 255.0f + 0.5f);
+          rgba[i * 4 + 3] = 255;
+        }
+      },
+      threads);
+}
+
+size_t BirdsEyeRaster::getOccupiedCount() const {
+  size_t occupied = 0;
+  for (size_t i = 0; i < counts.size(); ++i)
+    occupied += counts[i] != 0;
+  return occupied;
+}
+
+float BirdsEyeRaster::getMeanTop() const {
+  double sum = 0.0;
+  size_t occupied = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] != 0) {
+      sum += top[i];
+      ++occupied;
+    }
+  }
+  return occupied > 0 ? (float)(sum / occupied) : 0.0f;
+}
+
+BirdsEyeLayer::BirdsEyeLayer()
+    : texture(0), textureBytes(0), minX(0.0f), minZ(0.0f), maxX(0.0f),
+      maxZ(0.0f), y(0.0f), cellSize(1.0f) {}
+
+void BirdsEyeLayer::upload(const BirdsEyeRaster &raster,
+                           BirdsEyeChannel channel,
+                           const PointCloudRenderer &renderer) {
+  release();
+  int width = raster.getWidth(), height = raster.getHeight();
+  if (raster.getPointCount() == 0)
+    return;
+  std::vector<unsigned char> rgba;
+  raster.toImage(channel, renderer, rgba);
+
+  cellSize = raster.getCellSize();
+  minX = raster.getMinX();
+  minZ = raster.getMinZ();
+  maxX = minX + width * cellSize;
+  maxZ = minZ + height * cellSize;
+  y = raster.getMeanTop();
+
+  // Mipmaps keep the raster from shimmering when it is smaller than the
+  // screen it covers; averaging premultiplied texels keeps empty cells from
+  // darkening their neighbors
+  glGenTextures(1, &texture);
+  gliBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, rgba.data());
+  gliBindTexture(GL_TEXTURE_2D, 0);
+  textureBytes = rgba.size() * 4 / 3; // With the mipmap chain
+  MemoryStats::add(MEM_TEXTURES, textureBytes);
+  GLStats::countUpload(rgba.size());
+}
+
+void BirdsEyeLayer::draw(float opacity) const {
+  if (texture == 0 || !(opacity > 0.0f))
+    return;
+
+  gliDisable(GL_DEPTH_TEST);
+  gliEnable(GL_BLEND);
+  gliBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gliEnable(GL_TEXTURE_2D);
+  gliBindTexture(GL_TEXTURE_2D, texture);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  opacity = std::min(opacity, 1.0f);
+  glColor4f(opacity, opacity, opacity, opacity); // Premultiplied
+
+  gliBegin(GL_QUADS);
+  glTexCoord2f(0.0f, 0.0f);
+  gliVertex3f(minX, y, minZ);
+  glTexCoord2f(0.0f, 1.0f);
+  gliVertex3f(minX, y, maxZ);
+  glTexCoord2f(1.0f, 1.0f);
+  gliVertex3f(maxX, y, maxZ);
+  glTexCoord2f(1.0f, 0.0f);
+  gliVertex3f(maxX, y, minZ);
+  gliEnd();
+
+  gliBindTexture(GL_TEXTURE_2D, 0);
+  gliDisable(GL_TEXTURE_2D);
+  gliBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  gliDisable(GL_BLEND);
+  gliEnable(GL_DEPTH_TEST);
+}
+
+void BirdsEyeLayer::release() {
+  if (texture != 0) {
+    glDeleteTextures(1, &texture);
+    MemoryStats::remove(MEM_TEXTURES, textureBytes);
+    texture = 0;
+  }
+  textureBytes = 0;
+}
+
+float BirdsEyeLayer::getOpacity(const Camera &camera,
+                                int viewportHeight) const {
+  if (texture == 0 || viewportHeight <= 0)
+    return 0.0f;
+  // Pixels per unit at the target's distance
+  float scale = 0.5f * viewportHeight /
+                (camera.distance * std::tan(camera.fov * (float)M_PI / 360.0f));
+  float pixels = cellSize * scale;
+  float full = camera.pitch >= 85.0f ? 2.0f : 1.0f;
+  return std::min(std::max((2.0f * full - pixels) / full, 0.0f), 1.0f);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What a bird's-eye cell shows
+enum BirdsEyeChannel {
+  BEV_POINTS,    // The highest point in the renderer's color mode
+  BEV_HEIGHT,    // Highest point on the height gradient
+  BEV_INTENSITY, // Mean intensity
+  BEV_DENSITY    // Points per cell, log scaled
+};
+
+// A top-down raster of a cloud over the viewer's X/Z plane, laid out as
+// ElevationGrid (row 0 at minZ). Each cell keeps the highest point's height
+// and color, the mean intensity and the point count, which is all any
+// channel needs, so switching channels or color modes only re-colors.
+// Points are binned in parallel through GridBins and never kept.
+class BirdsEyeRaster {
+public:
+  BirdsEyeRaster();
+
+  // Empty the raster and size it; false if width * height overflows
+  bool create(float minX, float minZ, int width, int height, float cellSize);
+  void clear();
+
+  // Add points (viewer coordinates); those outside are ignored
+  void addPoints(const Point3D *points, size_t count, unsigned threads = 0);
+
+  // width * height premultiplied RGBA texels, transparent where empty. The
+  // renderer supplies the color mode and height range.
+  void toImage(BirdsEyeChannel channel, const PointCloudRenderer &renderer,
+               std::vector<unsigned char> &rgba, unsigned threads = 0) const;
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  float getCellSize() const { return cellSize; }
+  float getMinX() const { return minX; }
+  float getMinZ() const { return minZ; }
+  uint64_t getPointCount() const { return pointCount; }
+  size_t getOccupiedCount() const;
+  // Mean height of the occupied cells' highest points (0 if none)
+  float getMeanTop() const;
+
+private:
+  float minX, minZ, cellSize;
+  int width, height;
+  uint64_t pointCount;
+
+  std::vector<float> top;       // Highest y, -inf when empty
+  std::vector<uint32_t> colors; // Highest point's RGB, packed 8 bits each
+  std::vector<float> intensity; // Running mean
+  std::vector<uint32_t> counts;
+};
+
+// A BirdsEyeRaster drawn as one mipmapped texture on a flat quad at the
+// raster's mean top height, blended over whatever is behind it with depth
+// testing off. Needs a current GL context; call release() before the
+// context goes away.
+class BirdsEyeLayer {
+public:
+  BirdsEyeLayer();
+
+  void upload(const BirdsEyeRaster &raster, BirdsEyeChannel channel,
+              const PointCloudRenderer &renderer);
+  // Draw with the current matrices, faded by opacity (0..1)
+  void draw(float opacity) const;
+  void release();
+
+  bool isEmpty() const { return texture == 0; }
+
+  // How opaque the layer should be under a camera: 1 while a cell covers
+  // at most a pixel, 0 once it covers two, faded between. Seen from above
+  // (pitch of 85 degrees or more) the raster matches the points closely,
+  // so the switch happens at two and four pixels instead.
+  float getOpacity(const Camera &camera, int viewportHeight) const;
+
+private:
+  unsigned texture;
+  size_t textureBytes;
+  float minX, minZ, maxX, maxZ, y;
+  float cellSize;
+};
@@ -0,0 +1,172 @@
+#include "camera_path.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+namespace {
+
+const int CHANNELS = 6; // yaw, pitch, log distance, target x, y, z
+
+void getChannels(const CameraKey &key, float values[CHANNELS]) {
+  values[0] = key.yaw;
+  values[1] = key.pitch;
+  values[2] = std::log(std::max(key.distance, 1e-6f));
+  values[3] = key.target[0];
+  values[4] = key.target[1];
+  values[5] = key.target[2];
+}
+
+bool earlier(const CameraKey &a, const CameraKey &b) {
+  return a.time < b.time;
+}
+
+} // namespace
+
+void CameraPath::addKey(const CameraKey &key) {
+  std::vector<CameraKey>::iterator it =
+      std::lower_bound(keys.begin(), keys.end(), key, earlier);
+  if (it != keys.end() && it->time == key.time)
+    *it = key;
+  else
+    keys.insert(it, key);
+}
+
+CameraKey CameraPath::makeKey(float time, const Camera &camera) {
+  CameraKey key;
+  key.time = time;
+  key.yaw = camera.yaw;
+  key.pitch = camera.pitch;
+  key.distance = camera.distance;
+  key.target[0] = camera.targetX;
+  key.target[1] = camera.targetY;
+  key.target[2] = camera.targetZ;
+  return key;
+}
+
+bool CameraPath::load(const std::string &path, std::string &error) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::vector<CameraKey> loaded;
+  char line[512];
+  int number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    ++number;
+    char *comment = strchr(line, '#');
+    if (comment)
+      *comment = '\0';
+    CameraKey key;
+    char extra;
+    int fields = sscanf(line, "%f %f %f %f %f %f %f %c", &key.time, &key.yaw,
+                        &key.pitch, &key.distance, &key.target[0],
+                        &key.target[1], &key.target[2], &extra);
+    if (fields == EOF)
+      continue; // Blank line
+    if (fields != 7 || !(key.distance > 0.0f) || !(key.time >= 0.0f)) {
+      char message[64];
+      snprintf(message, sizeof(message), "bad key on line %d", number);
+      error = message;
+      ok = false;
+    }
+    loaded.push_back(key);
+  }
+  fclose(file);
+  if (!ok)
+    return false;
+  if (loaded.empty()) {
+    error = "no keys in " + path;
+    return false;
+  }
+  keys.clear();
+  for (size_t i = 0; i < loaded.size(); ++i)
+    addKey(loaded[i]);
+  return true;
+}
+
+bool CameraPath::save(const std::string &path, std::string &error) const {
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file) {
+    error = "cannot create " + path;
+    return false;
+  }
+  fprintf(file, "# time yaw pitch distance targetX targetY targetZ\n");
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const CameraKey &k = keys[i];
+    fprintf(file, "%g %.9g %.9g %.9g %.9g %.9g %.9g\n", k.time, k.yaw,
+            k.pitch, k.distance, k.target[0], k.target[1], k.target[2]);
+  }
+  if (fclose(file) != 0) {
+    error = "cannot write " + path;
+    return false;
+  }
+  return true;
+}
+
+float CameraPath::getDuration() const {
+  return keys.empty() ? 0.0f : keys.back().time;
+}
+
+void CameraPath::evaluate(float time, Camera &camera) const {
+  if (keys.empty())
+    return;
+  float values[CHANNELS];
+  if (keys.size() == 1 || time <= keys.front().time) {
+    getChannels(keys.front(), values);
+  } else if (time >= keys.back().time) {
+    getChannels(keys.back(), values);
+  } else {
+    // Hermite segment from key i to i + 1; tangents are central
+    // differences over time (one-sided at the ends), so a path whose keys
+    // lie on a line is followed at constant speed
+    CameraKey probe;
+    probe.time = time;
+    size_t i = std::upper_bound(keys.begin(), keys.end(), probe, earlier) -
+               keys.begin() - 1;
+    size_t prev = i > 0 ? i - 1 : i;
+    size_t next = std::min(i + 2, keys.size() - 1);
+    float p0[CHANNELS], p1[CHANNELS], before[CHANNELS], after[CHANNELS];
+    getChannels(keys[i], p0);
+    getChannels(keys[i + 1], p1);
+    getChannels(keys[prev], before);
+    getChannels(keys[next], after);
+
+    float h = keys[i + 1].time - keys[i].time;
+    float t = (time - keys[i].time) / h;
+    float t2 = t * t, t3 = t2 * t;
+    float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+    float h10 = t3 - 2.0f * t2 + t;
+    float h01 = -2.0f * t3 + 3.0f * t2;
+    float h11 = t3 - t2;
+    float span0 = keys[i + 1].time - keys[prev].time;
+    float span1 = keys[next].time - keys[i].time;
+    for (int c = 0; c < CHANNELS; ++c) {
+      float m0 = (p1[c] - before[c]) / span0 * h;
+      float m1 = (after[c] - p0[c]) / span1 * h;
+      values[c] = h00 * p0[c] + h10 * m0 + h01 * p1[c] + h11 * m1;
+    }
+  }
+
+  camera.yaw = values[0];
+  camera.pitch = std::min(std::max(values[1], -89.0f), 89.0f);
+  camera.distance = std::exp(values[2]);
+  camera.targetX = values[3];
+  camera.targetY = values[4];
+  camera.targetZ = values[5];
+}
+
+CameraPath CameraPath::makeOrbit(const Camera &camera, float duration,
+                                 int turns) {
+  CameraPath path;
+  int quarters = std::max(turns, 1) * 4;
+  CameraKey key = makeKey(0.0f, camera);
+  for (int q = 0; q <= quarters; ++q) {
+    key.time = duration * q / quarters;
+    key.yaw = camera.yaw + 90.0f * q;
+    path.keys.push_back(key);
+  }
+  return path;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <string>
+#include <vector>
+
+// A camera pose at a time on a path, in seconds from the path's start
+struct CameraKey {
+  float time;
+  float yaw, pitch, distance;
+  float target[3];
+};
+
+// A keyframed camera path for fly-throughs. Yaw, pitch and target follow
+// Catmull-Rom splines through the keys, with tangents scaled to the time
+// between keys so uneven spacing doesn't jerk. Distance follows the same
+// spline in log space, so zooms move at a steady rate. Yaw is taken as
+// written: keys at 0 and 360 make a full turn.
+class CameraPath {
+public:
+  void clear() { keys.clear(); }
+  bool isEmpty() const { return keys.empty(); }
+
+  // Insert a key in time order, replacing one at the same time
+  void addKey(const CameraKey &key);
+  // A key holding the camera's current pose
+  static CameraKey makeKey(float time, const Camera &camera);
+
+  // One key per line, "time yaw pitch distance targetX targetY targetZ",
+  // in viewer coordinates; '#' starts a comment
+  bool load(const std::string &path, std::string &error);
+  bool save(const std::string &path, std::string &error) const;
+
+  const std::vector<CameraKey> &getKeys() const { return keys; }
+  // Time of the last key
+  float getDuration() const;
+
+  // Set the camera's pose at a time, clamped to the path (fov is kept)
+  void evaluate(float time, Camera &camera) const;
+
+  // turns orbits around the camera's target from its current pose over
+  // duration seconds, with a key every quarter turn
+  static CameraPath makeOrbit(const Camera &camera, float duration,
+                              int turns = 1);
+
+private:
+  std::vector<CameraKey> keys;
+};
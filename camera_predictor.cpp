@@ -0,0 +1,74 @@
+#include "camera_predictor.h"
+#include <algorithm>
+#include <cmath>
+
+CameraPredictor::CameraPredictor() { reset(); }
+
+void CameraPredictor::reset() {
+  hasLast = false;
+  lastTime = 0.0;
+  for (int i = 0; i < STATE_SIZE; ++i)
+    velocity[i] = 0.0f;
+}
+
+void CameraPredictor::getState(const Camera &camera, float state[STATE_SIZE]) {
+  state[TARGET_X] = camera.targetX;
+  state[TARGET_Y] = camera.targetY;
+  state[TARGET_Z] = camera.targetZ;
+  state[YAW] = camera.yaw;
+  state[PITCH] = camera.pitch;
+  // Zoom is multiplicative, so extrapolate it in log space
+  state[DISTANCE] = std::log(std::max(camera.distance, 1e-3f));
+}
+
+void CameraPredictor::observe(const Camera &camera, double time) {
+  double dt = time - lastTime;
+  if (!hasLast || dt > 0.5) {
+    // First frame or a long stall: old motion says nothing about the next
+    for (int i = 0; i < STATE_SIZE; ++i)
+      velocity[i] = 0.0f;
+  } else if (dt > 1e-4) {
+    float before[STATE_SIZE], now[STATE_SIZE];
+    getState(last, before);
+    getState(camera, now);
+
+    // Exponential smoothing with a time constant of about 100 ms
+    float blend = (float)std::min(dt / 0.1, 1.0);
+    for (int i = 0; i < STATE_SIZE; ++i) {
+      float rate = (float)((now[i] - before[i]) / dt);
+      velocity[i] += (rate - velocity[i]) * blend;
+    }
+  } else {
+    return; // Same frame observed twice
+  }
+
+  last = camera;
+  lastTime = time;
+  hasLast = true;
+}
+
+Camera CameraPredictor::predict(float seconds) const {
+  Camera camera = last;
+  camera.targetX += velocity[TARGET_X] * seconds;
+  camera.targetY += velocity[TARGET_Y] * seconds;
+  camera.targetZ += velocity[TARGET_Z] * seconds;
+  camera.yaw += velocity[YAW] * seconds;
+  camera.pitch = std::min(
+      std::max(camera.pitch + velocity[PITCH] * seconds, -89.0f), 89.0f);
+  camera.distance *= std::exp(velocity[DISTANCE] * seconds);
+  return camera;
+}
+
+bool CameraPredictor::isMoving() const {
+  if (!hasLast)
+    return false;
+
+  // Thresholds relative to the view: 2% of the distance, 1 degree or a 2%
+  // zoom per second
+  float pan = std::sqrt(velocity[TARGET_X] * velocity[TARGET_X] +
+                        velocity[TARGET_Y] * velocity[TARGET_Y] +
+                        velocity[TARGET_Z] * velocity[TARGET_Z]);
+  return pan > last.distance * 0.02f || std::fabs(velocity[YAW]) > 1.0f ||
+         std::fabs(velocity[PITCH]) > 1.0f ||
+         std::fabs(velocity[DISTANCE]) > 0.02f;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+
+// Tracks the camera's recent motion and extrapolates where it will be.
+// Velocities are smoothed so a single jerky frame doesn't send prefetches
+// off in the wrong direction.
+class CameraPredictor {
+public:
+  CameraPredictor();
+
+  // Record the camera at the given time in seconds
+  void observe(const Camera &camera, double time);
+  void reset();
+
+  // Camera extrapolated `seconds` past the last observation
+  Camera predict(float seconds) const;
+
+  // True when the smoothed motion is large enough to be worth prefetching
+  bool isMoving() const;
+
+private:
+  enum { TARGET_X, TARGET_Y, TARGET_Z, YAW, PITCH, DISTANCE, STATE_SIZE };
+
+  static void getState(const Camera &camera, float state[STATE_SIZE]);
+
+  Camera last;
+  double lastTime;
+  bool hasLast;
+  float velocity[STATE_SIZE]; // Per second; distance as a log rate
+};
@@ -0,0 +1,138 @@
+#include "chunk_cache.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const double LOAD_WINDOW = 0.5; // Seconds per decode load sample
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+ChunkCache::ChunkCache(size_t byteBudget)
+    : byteBudget(byteBudget), stats(), windowStart(Clock::now()),
+      windowDecodeSeconds(0.0) {}
+
+void ChunkCache::setByteBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  byteBudget = bytes;
+  trim();
+}
+
+void ChunkCache::setCodecOptions(const CodecOptions &options) {
+  std::lock_guard<std::mutex> lock(mutex);
+  codec = options;
+}
+
+void ChunkCache::put(int id, const std::vector<Point3D> &points) {
+  CodecOptions options;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (byteBudget == 0)
+      return;
+    options = codec;
+  }
+
+  Clock::time_point start = Clock::now();
+  std::vector<uint8_t> encoded;
+  encodePoints(points.data(), points.size(), options, encoded);
+  std::shared_ptr<Block> block =
+      std::make_shared<Block>(encoded.begin(), encoded.end());
+  double seconds = secondsSince(start);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<int, Entry>::iterator it = entries.find(id);
+  if (it != entries.end())
+    evict(it);
+  Entry &entry = entries[id];
+  entry.block = block;
+  entry.rawBytes = points.size() * sizeof(Point3D);
+  lru.push_front(id);
+  entry.lru = lru.begin();
+  ++stats.entries;
+  stats.compressedBytes += block->size();
+  stats.rawBytes += entry.rawBytes;
+  stats.encodeSeconds += seconds;
+  trim();
+}
+
+bool ChunkCache::get(int id, std::vector<Point3D> &out) {
+  std::shared_ptr<const Block> block;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<int, Entry>::iterator it = entries.find(id);
+    if (it == entries.end()) {
+      ++stats.misses;
+      return false;
+    }
+    ++stats.hits;
+    lru.splice(lru.begin(), lru, it->second.lru);
+    block = it->second.block;
+  }
+
+  // The block stays alive through our reference even if it is evicted
+  Clock::time_point start = Clock::now();
+  bool ok = decodePoints(block->data(), block->size(), out);
+  double seconds = secondsSince(start);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.decodeSeconds += seconds;
+  updateLoad(seconds);
+  return ok;
+}
+
+bool ChunkCache::contains(int id) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.count(id) != 0;
+}
+
+void ChunkCache::remove(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<int, Entry>::iterator it = entries.find(id);
+  if (it != entries.end())
+    evict(it);
+}
+
+void ChunkCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  lru.clear();
+  stats = ChunkCacheStats();
+  windowStart = Clock::now();
+  windowDecodeSeconds = 0.0;
+}
+
+ChunkCacheStats ChunkCache::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  updateLoad(0.0);
+  return stats;
+}
+
+void ChunkCache::evict(std::map<int, Entry>::iterator it) {
+  --stats.entries;
+  stats.compressedBytes -= it->second.block->size();
+  stats.rawBytes -= it->second.rawBytes;
+  lru.erase(it->second.lru);
+  entries.erase(it);
+}
+
+void ChunkCache::trim() {
+  while (!lru.empty() && stats.compressedBytes > byteBudget)
+    evict(entries.find(lru.back()));
+}
+
+void ChunkCache::updateLoad(double decodeSeconds) const {
+  windowDecodeSeconds += decodeSeconds;
+  double elapsed = secondsSince(windowStart);
+  if (elapsed < LOAD_WINDOW)
+    return;
+
+  // Blend in the finished window; idle windows decay the load
+  float sample = (float)(windowDecodeSeconds / elapsed);
+  stats.decodeLoad = 0.5f * stats.decodeLoad + 0.5f * sample;
+  windowStart = Clock::now();
+  windowDecodeSeconds = 0.0;
+}
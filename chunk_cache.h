@@ -0,0 +1,67 @@
+#pragma once
+
+#include "point_codec.h"
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Counters since the cache was created or cleared
+struct ChunkCacheStats {
+  size_t entries;
+  size_t hits, misses;
+  size_t compressedBytes; // Held now
+  size_t rawBytes;        // What the held chunks take decoded
+  double encodeSeconds, decodeSeconds;
+  float decodeLoad; // Recent decode time per second of wall time (cores)
+};
+
+// Chunks kept in RAM as point codec blocks, least recently used evicted
+// first once over the byte budget. Loader threads put every chunk they
+// read from disk and try the cache before reading; decoding a block is
+// much cheaper than reading and parsing the source file again.
+// Thread-safe; blocks are decoded outside the lock.
+class ChunkCache {
+public:
+  explicit ChunkCache(size_t byteBudget = 512u << 20);
+
+  void setByteBudget(size_t bytes);
+  size_t getByteBudget() const { return byteBudget; }
+  void setCodecOptions(const CodecOptions &options);
+
+  // Compress and store a chunk, replacing any older copy
+  void put(int id, const std::vector<Point3D> &points);
+
+  // Append a cached chunk's points to out; false on a miss
+  bool get(int id, std::vector<Point3D> &out);
+
+  bool contains(int id) const;
+  void remove(int id);
+  void clear();
+
+  ChunkCacheStats getStats() const;
+
+private:
+  typedef std::vector<uint8_t, TrackedAllocator<uint8_t, MEM_CACHES>> Block;
+  struct Entry {
+    std::shared_ptr<const Block> block;
+    size_t rawBytes;
+    std::list<int>::iterator lru;
+  };
+
+  void evict(std::map<int, Entry>::iterator it);
+  void trim();
+  void updateLoad(double decodeSeconds) const;
+
+  size_t byteBudget;
+  CodecOptions codec;
+  mutable std::mutex mutex;
+  std::map<int, Entry> entries;
+  std::list<int> lru; // Most recently used first
+  mutable ChunkCacheStats stats;
+
+  // Decode time in the current window, for the load estimate
+  mutable std::chrono::steady_clock::time_point windowStart;
+  mutable double windowDecodeSeconds;
+};
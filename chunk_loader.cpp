@@ -0,0 +1,91 @@
+#include "chunk_loader.h"
+#include <algorithm>
+
+ChunkLoader::ChunkLoader(LoadFunction load, unsigned threads)
+    : load(load), stopping(false) {
+  for (unsigned i = 0; i < std::max(threads, 1u); ++i)
+    workers.push_back(std::thread(&ChunkLoader::workerLoop, this));
+}
+
+ChunkLoader::~ChunkLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    queued.clear();
+  }
+  wake.notify_all();
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+}
+
+void ChunkLoader::request(int id, float priority) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelledRunning.erase(id);
+    if (running.count(id))
+      return;
+    queued[id] = priority;
+  }
+  wake.notify_one();
+}
+
+void ChunkLoader::cancel(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  queued.erase(id);
+  if (running.count(id))
+    cancelledRunning.insert(id);
+}
+
+void ChunkLoader::cancelAll() {
+  std::lock_guard<std::mutex> lock(mutex);
+  queued.clear();
+  cancelledRunning = running;
+}
+
+bool ChunkLoader::isPending(int id) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queued.count(id) != 0 || running.count(id) != 0;
+}
+
+size_t ChunkLoader::getPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queued.size() + running.size();
+}
+
+size_t ChunkLoader::takeFinished(std::vector<LoadedChunk> &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t count = finished.size();
+  for (size_t i = 0; i < finished.size(); ++i)
+    out.push_back(std::move(finished[i]));
+  finished.clear();
+  return count;
+}
+
+void ChunkLoader::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+    if (stopping)
+      return;
+
+    // Linear scan is fine for the few thousand requests a view produces
+    std::map<int, float>::iterator best = queued.begin();
+    for (std::map<int, float>::iterator it = queued.begin();
+         it != queued.end(); ++it) {
+      if (it->second > best->second)
+        best = it;
+    }
+    LoadedChunk chunk;
+    chunk.id = best->first;
+    queued.erase(best);
+    running.insert(chunk.id);
+
+    lock.unlock();
+    chunk.ok = load(chunk.id, chunk.points);
+    lock.lock();
+
+    running.erase(chunk.id);
+    if (cancelledRunning.erase(chunk.id) == 0 && !stopping)
+      finished.push_back(std::move(chunk));
+  }
+}
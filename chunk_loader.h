@@ -0,0 +1,55 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// A chunk whose points finished loading on a worker thread
+struct LoadedChunk {
+  int id;
+  bool ok;
+  std::vector<Point3D> points;
+};
+
+// Loads chunks on background threads, highest priority first. Requests
+// can be reprioritized or cancelled until a worker picks them up; results
+// of loads cancelled while running are dropped.
+class ChunkLoader {
+public:
+  typedef std::function<bool(int id, std::vector<Point3D> &points)>
+      LoadFunction;
+
+  explicit ChunkLoader(LoadFunction load, unsigned threads = 2);
+  ~ChunkLoader();
+
+  // Queue a load, or change the priority of a queued one
+  void request(int id, float priority);
+  void cancel(int id);
+  void cancelAll();
+
+  // Queued or running
+  bool isPending(int id) const;
+  size_t getPendingCount() const;
+
+  // Move finished loads into out; returns how many were added
+  size_t takeFinished(std::vector<LoadedChunk> &out);
+
+private:
+  void workerLoop();
+
+  LoadFunction load;
+  std::vector<std::thread> workers;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+
+  std::map<int, float> queued; // id -> priority
+  std::set<int> running;
+  std::set<int> cancelledRunning;
+  std::vector<LoadedChunk> finished;
+};
@@ -0,0 +1,107 @@
+#include "cloud_compare.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const size_t BLOCK = 4096; // Points per task
+
+// Moreland's cool-warm endpoints, which stay distinguishable for
+// color-blind viewers
+const float COOL[3] = {0.230f, 0.299f, 0.754f};
+const float NEUTRAL[3] = {0.865f, 0.865f, 0.865f};
+const float WARM[3] = {0.706f, 0.016f, 0.150f};
+
+float percentile(std::vector<float> &values, double fraction) {
+  size_t k = (size_t)(fraction * (values.size() - 1) + 0.5);
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+} // namespace
+
+void computeCloudDistances(const Point3D *reference, const KdTree &tree,
+                           const Point3D *points, size_t count,
+                           float maxDistance, float *distances,
+                           unsigned threads, const Pose &referencePose) {
+  // Query in the reference's frame; the pose is rigid, so distances hold
+  Pose toReference = referencePose.inverse();
+  parallelFor(
+      (count + BLOCK - 1) / BLOCK,
+      [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BLOCK);
+        for (size_t i = block * BLOCK; i < end; ++i) {
+          const float p[3] = {points[i].x, points[i].y, points[i].z};
+          float q[3];
+          toReference.apply(p, q);
+          KdNeighbor nearest;
+          if (!tree.findNearest(q, maxDistance, nearest)) {
+            distances[i] = std::numeric_limits<float>::quiet_NaN();
+            continue;
+          }
+          const Point3D &r = reference[nearest.index];
+          const float local[3] = {r.x, r.y, r.z};
+          float placed[3];
+          referencePose.apply(local, placed);
+          float d = std::sqrt(nearest.distance2);
+          distances[i] = p[1] < placed[1] ? -d : d;
+        }
+      },
+      threads);
+}
+
+DistanceSummary summarizeDistances(const std::vector<float> &distances) {
+  DistanceSummary summary = {0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  std::vector<float> absolute;
+  absolute.reserve(distances.size());
+  double sum = 0.0, sum2 = 0.0;
+  for (size_t i = 0; i < distances.size(); ++i) {
+    float d = distances[i];
+    if (d != d)
+      continue; // NaN, no neighbor
+    sum += d;
+    sum2 += (double)d * d;
+    absolute.push_back(std::fabs(d));
+  }
+  summary.matched = absolute.size();
+  if (absolute.empty())
+    return summary;
+  summary.mean = (float)(sum / absolute.size());
+  summary.rms = (float)std::sqrt(sum2 / absolute.size());
+  summary.p50 = percentile(absolute, 0.5);
+  summary.p95 = percentile(absolute, 0.95);
+  summary.p99 = percentile(absolute, 0.99);
+  return summary;
+}
+
+void getDivergingColor(float value, float range, float rgb[3]) {
+  if (value != value) {
+    rgb[0] = rgb[1] = rgb[2] = 0.3f;
+    return;
+  }
+  float t = range > 0.0f ? value / range : 0.0f;
+  t = std::min(std::max(t, -1.0f), 1.0f);
+  const float *end = t < 0.0f ? COOL : WARM;
+  t = std::fabs(t);
+  for (int c = 0; c < 3; ++c)
+    rgb[c] = NEUTRAL[c] + (end[c] - NEUTRAL[c]) * t;
+}
+
+void colorByDistance(const float *distances, size_t count, float range,
+                     Point3D *points, unsigned threads) {
+  parallelFor(
+      (count + BLOCK - 1) / BLOCK,
+      [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BLOCK);
+        for (size_t i = block * BLOCK; i < end; ++i) {
+          float rgb[3];
+          getDivergingColor(distances[i], range, rgb);
+          points[i].r = rgb[0];
+          points[i].g = rgb[1];
+          points[i].b = rgb[2];
+        }
+      },
+      threads);
+}
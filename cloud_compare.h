@@ -0,0 +1,38 @@
+#pragma once
+
+#include "kd_tree.h"
+#include "point_cloud_renderer.h"
+#include "pose.h"
+#include <cstddef>
+#include <vector>
+
+// Cloud-to-cloud (C2C) distances for change detection between surveys:
+// for every compared point, the distance to the nearest reference point
+// (reference and tree built from the same array). The distance is signed
+// by height, positive where the compared point lies above its neighbor
+// (deposition, growth) and negative below (erosion, removal). Points with
+// no neighbor within maxDistance get NaN. Blocks of points are queried on
+// worker threads. referencePose places the reference among the compared
+// points, e.g. after registration, without rebuilding the tree.
+void computeCloudDistances(const Point3D *reference, const KdTree &tree,
+                           const Point3D *points, size_t count,
+                           float maxDistance, float *distances,
+                           unsigned threads = 0,
+                           const Pose &referencePose = Pose());
+
+struct DistanceSummary {
+  size_t matched; // Points with a distance
+  float mean;     // Of the signed distances
+  float rms;
+  float p50, p95, p99; // Of the absolute distances
+};
+
+DistanceSummary summarizeDistances(const std::vector<float> &distances);
+
+// Diverging blue - light gray - red colormap over [-range, range]; NaN is
+// dark gray
+void getDivergingColor(float value, float range, float rgb[3]);
+
+// Set points' r, g, b from their distances
+void colorByDistance(const float *distances, size_t count, float range,
+                     Point3D *points, unsigned threads = 0);
@@ -0,0 +1,144 @@
+// Measures the point codec: compression ratio, encode and decode speed on
+// one core, parallel per-chunk decode speed, and the quantization error.
+#include "parallel.h"
+#include "point_codec.h"
+#include "point_io.h"
+#include "sample_scenes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Largest per-axis difference between each decoded point and the input
+// point it came from
+static float maxPositionError(const std::vector<Point3D> &points,
+                              const std::vector<Point3D> &decoded,
+                              const std::vector<uint32_t> &order) {
+  if (decoded.size() != order.size())
+    return INFINITY;
+  float worst = 0.0f;
+  for (size_t i = 0; i < decoded.size(); ++i) {
+    const Point3D &p = points[order[i]];
+    worst = std::max(worst, std::fabs(p.x - decoded[i].x));
+    worst = std::max(worst, std::fabs(p.y - decoded[i].y));
+    worst = std::max(worst, std::fabs(p.z - decoded[i].z));
+  }
+  return worst;
+}
+
+int main(int argc, char **argv) {
+  std::string scene = "terrain";
+  std::string file;
+  int numPoints = 2000000;
+  size_t chunkPoints = 20000;
+  CodecOptions options;
+  int repeats = 5;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--scene") && i + 1 < argc) {
+      scene = argv[++i];
+    } else if (!strcmp(argv[i], "--file") && i + 1 < argc) {
+      file = argv[++i];
+    } else if (!strcmp(argv[i], "--points") && i + 1 < argc) {
+      numPoints = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--chunk-points") && i + 1 < argc) {
+      chunkPoints = (size_t)std::max(atoi(argv[++i]), 1);
+    } else if (!strcmp(argv[i], "--precision") && i + 1 < argc) {
+      options.precision = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--repeats") && i + 1 < argc) {
+      repeats = std::max(atoi(argv[++i]), 1);
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--scene spiral|terrain|boxes | --file POINTS]\n"
+              "          [--points N] [--chunk-points N] [--precision P]\n"
+              "          [--repeats N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<Point3D> points;
+  if (!file.empty()) {
+    double origin[3];
+    std::string error;
+    if (!loadPointFile(file, points, origin, &error)) {
+      fprintf(stderr, "Cannot load %s: %s\n", file.c_str(), error.c_str());
+      return 1;
+    }
+  } else if (!makeScene(scene.c_str(), numPoints, points)) {
+    fprintf(stderr, "Unknown scene %s\n", scene.c_str());
+    return 1;
+  }
+
+  // Chunks as the octree would store them: spatially coherent runs
+  size_t chunkCount = (points.size() + chunkPoints - 1) / chunkPoints;
+  std::vector<std::vector<uint8_t>> blocks(chunkCount);
+  std::vector<std::vector<uint32_t>> orders(chunkCount);
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (size_t c = 0; c < chunkCount; ++c) {
+    size_t first = c * chunkPoints;
+    size_t count = std::min(chunkPoints, points.size() - first);
+    encodePoints(&points[first], count, options, blocks[c], &orders[c]);
+  }
+  double encodeSeconds = secondsSince(start);
+
+  size_t rawBytes = points.size() * sizeof(Point3D), encodedBytes = 0;
+  std::vector<const uint8_t *> data(chunkCount);
+  std::vector<size_t> sizes(chunkCount);
+  for (size_t c = 0; c < chunkCount; ++c) {
+    data[c] = blocks[c].data();
+    sizes[c] = blocks[c].size();
+    encodedBytes += blocks[c].size();
+  }
+
+  // Best of several runs, single-threaded and across all cores
+  std::vector<std::vector<Point3D>> decoded;
+  double singleSeconds = 1e30, parallelSeconds = 1e30;
+  bool ok = true;
+  for (int r = 0; r < repeats; ++r) {
+    start = std::chrono::steady_clock::now();
+    ok = decodeBlocks(data, sizes, decoded, 1) && ok;
+    singleSeconds = std::min(singleSeconds, secondsSince(start));
+
+    start = std::chrono::steady_clock::now();
+    ok = decodeBlocks(data, sizes, decoded) && ok;
+    parallelSeconds = std::min(parallelSeconds, secondsSince(start));
+  }
+
+  std::vector<Point3D> all;
+  std::vector<uint32_t> order;
+  all.reserve(points.size());
+  order.reserve(points.size());
+  for (size_t c = 0; c < decoded.size(); ++c) {
+    all.insert(all.end(), decoded[c].begin(), decoded[c].end());
+    for (size_t i = 0; i < orders[c].size(); ++i)
+      order.push_back((uint32_t)(c * chunkPoints) + orders[c][i]);
+  }
+  float error = maxPositionError(points, all, order);
+
+  const double MB = 1024.0 * 1024.0;
+  printf("%zu points in %zu chunks of %zu, precision %g\n", points.size(),
+         chunkCount, chunkPoints, options.precision);
+  printf("Raw %.1f MB, encoded %.1f MB: ratio %.2fx, %.2f bytes/point\n",
+         rawBytes / MB, encodedBytes / MB, (double)rawBytes / encodedBytes,
+         (double)encodedBytes / points.size());
+  printf("Encode:          %8.1f MB/s raw  %8.2f Mpoints/s\n",
+         rawBytes / MB / encodeSeconds, points.size() / encodeSeconds / 1e6);
+  printf("Decode 1 thread: %8.1f MB/s raw  %8.2f Mpoints/s\n",
+         rawBytes / MB / singleSeconds, points.size() / singleSeconds / 1e6);
+  printf("Decode %u threads:%8.1f MB/s raw  %8.2f Mpoints/s\n",
+         getWorkerCount(), rawBytes / MB / parallelSeconds,
+         points.size() / parallelSeconds / 1e6);
+  printf("Max position error: %g%s\n", error, ok ? "" : "  DECODE FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+#include "contours.h"
+#include "elevation_grid.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+const int TILE = 64; // Squares per tile edge
+const int LEVEL_BIAS = 1 << 23;
+const uint32_t NONE = 0xffffffffu;
+
+// Contour vertices are keyed by level and grid edge. Edge 2 * cell is the
+// horizontal edge from the cell's center to its right neighbor's, edge
+// 2 * cell + 1 the vertical one to the neighbor below.
+uint64_t vertexKey(int level, uint64_t edge) {
+  return ((uint64_t)(level + LEVEL_BIAS) << 40) | edge;
+}
+
+// A run of vertices between two contour vertices; head == tail for a
+// closed loop (whose last vertex is not repeated)
+struct Piece {
+  uint64_t head, tail;
+  size_t first, count;
+  int level;
+};
+
+// Square edges from corner v0 (row, column) clockwise: top, right, bottom,
+// left. Segments per corner case (bit i set when corner i is at or above
+// the level; corners v0 v1 v2 v3 go clockwise from the top left). Saddles
+// 5 and 10 are listed for a center below the level; a center at or above
+// it takes the other saddle's pair.
+const int8_t SEGMENTS[16][4] = {
+    {-1, -1, -1, -1}, {3, 0, -1, -1}, {0, 1, -1, -1}, {3, 1, -1, -1},
+    {1, 2, -1, -1},   {3, 0, 1, 2},   {0, 2, -1, -1}, {3, 2, -1, -1},
+    {2, 3, -1, -1},   {0, 2, -1, -1}, {0, 1, 2, 3},   {1, 2, -1, -1},
+    {1, 3, -1, -1},   {0, 1, -1, -1}, {3, 0, -1, -1}, {-1, -1, -1, -1}};
+
+// Join pieces that share end keys into longer pieces, reversing them as
+// needed. Every key is shared by at most two pieces.
+void chainPieces(const std::vector<Piece> &pieces,
+                 const std::vector<float> &pool, std::vector<Piece> &out,
+                 std::vector<float> &outPool) {
+  // Key -> up to two piece ends (piece * 2, +1 for the tail)
+  struct Ends {
+    uint32_t a, b;
+  };
+  std::unordered_map<uint64_t, Ends> ends;
+  ends.reserve(pieces.size() * 2);
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    if (pieces[i].head == pieces[i].tail)
+      continue;
+    for (int e = 0; e < 2; ++e) {
+      uint64_t key = e ? pieces[i].tail : pieces[i].head;
+      std::pair<std::unordered_map<uint64_t, Ends>::iterator, bool> slot =
+          ends.insert(std::make_pair(key, Ends()));
+      uint32_t end = (uint32_t)(i * 2 + e);
+      if (slot.second) {
+        slot.first->second.a = end;
+        slot.first->second.b = NONE;
+      } else {
+        slot.first->second.b = end;
+      }
+    }
+  }
+
+  std::vector<char> used(pieces.size(), 0);
+  // Trace a chain from piece i entering at its head (end 0) or tail
+  auto walk = [&](size_t i, int end) {
+    Piece chain;
+    chain.head = end ? pieces[i].tail : pieces[i].head;
+    chain.first = outPool.size() / 3;
+    chain.level = pieces[i].level;
+    bool first = true;
+    for (;;) {
+      const Piece &p = pieces[i];
+      used[i] = 1;
+      // Vertices in walking order; the entry vertex is the previous
+      // piece's exit vertex
+      for (size_t k = first ? 0 : 1; k < p.count; ++k) {
+        size_t v = p.first + (end ? p.count - 1 - k : k);
+        outPool.insert(outPool.end(), &pool[v * 3], &pool[v * 3 + 3]);
+      }
+      first = false;
+      uint64_t exit = end ? p.head : p.tail;
+      chain.tail = exit;
+
+      std::unordered_map<uint64_t, Ends>::const_iterator it = ends.find(exit);
+      uint32_t self = (uint32_t)(i * 2 + (1 - end));
+      uint32_t next = it->second.a == self ? it->second.b : it->second.a;
+      if (next == NONE)
+        break;
+      if (used[next / 2]) {
+        // Back at the start: a loop, whose exit repeats the first vertex
+        outPool.resize(outPool.size() - 3);
+        chain.tail = chain.head = exit;
+        break;
+      }
+      i = next / 2;
+      end = (int)(next & 1);
+    }
+    chain.count = outPool.size() / 3 - chain.first;
+    out.push_back(chain);
+  };
+
+  // Open chains from their free ends first, then what is left is loops
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    const Piece &p = pieces[i];
+    if (used[i])
+      continue;
+    if (p.head == p.tail) {
+      used[i] = 1;
+      Piece loop = p;
+      loop.first = outPool.size() / 3;
+      outPool.insert(outPool.end(), &pool[p.first * 3],
+                     &pool[(p.first + p.count) * 3]);
+      out.push_back(loop);
+    } else if (ends[p.head].b == NONE) {
+      walk(i, 0);
+    } else if (ends[p.tail].b == NONE) {
+      walk(i, 1);
+    }
+  }
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    if (!used[i])
+      walk(i, 0);
+  }
+}
+
+} // namespace
+
+ContourSet::ContourSet() : interval(1.0f), base(0.0f), segments(0) {}
+
+void ContourSet::clear() {
+  std::vector<float>().swap(vertices);
+  std::vector<ContourLine>().swap(lines);
+  segments = 0;
+}
+
+bool ContourSet::build(const ElevationGrid &grid, float step, float offset,
+                       unsigned threads, int maxLevels) {
+  clear();
+  interval = step;
+  base = offset;
+  float low, high;
+  if (!(step > 0.0f) || !grid.getRange(low, high))
+    return false;
+  if ((high - low) / step > (float)maxLevels)
+    return false;
+
+  int width = grid.getWidth(), height = grid.getHeight();
+  const float *h = grid.getElevations().data();
+  float cell = grid.getCellSize();
+  float minX = grid.getMinX() + 0.5f * cell; // Cell centers
+  float minZ = grid.getMinZ() + 0.5f * cell;
+
+  // Position of a level's crossing of an edge, from the edge alone
+  auto edgePoint = [&](uint64_t edge, float level, float *out) {
+    uint64_t cellIndex = edge >> 1;
+    int row = (int)(cellIndex / width), column = (int)(cellIndex % width);
+    size_t next = edge & 1 ? cellIndex + width : cellIndex + 1;
+    float a = h[cellIndex], b = h[next];
+    float t = (level - a) / (b - a);
+    out[0] = minX + (column + (edge & 1 ? 0.0f : t)) * cell;
+    out[1] = level;
+    out[2] = minZ + (row + (edge & 1 ? t : 0.0f)) * cell;
+  };
+
+  // Trace and chain each tile on its own
+  int squaresX = width - 1, squaresZ = height - 1;
+  int tilesX = (squaresX + TILE - 1) / TILE;
+  int tilesZ = (squaresZ + TILE - 1) / TILE;
+  size_t tileCount = squaresX > 0 && squaresZ > 0 ? (size_t)tilesX * tilesZ
+                                                  : 0;
+  std::vector<std::vector<Piece>> tilePieces(tileCount);
+  std::vector<std::vector<float>> tilePools(tileCount);
+  std::vector<size_t> tileSegments(tileCount, 0);
+  parallelFor(
+      tileCount,
+      [&](size_t tile) {
+        int row0 = (int)(tile / tilesX) * TILE;
+        int column0 = (int)(tile % tilesX) * TILE;
+        int row1 = std::min(row0 + TILE, squaresZ);
+        int column1 = std::min(column0 + TILE, squaresX);
+        std::vector<Piece> segmentPieces;
+        std::vector<float> segmentPool;
+
+        for (int row = row0; row < row1; ++row) {
+          for (int column = column0; column < column1; ++column) {
+            size_t c0 = (size_t)row * width + column;
+            float v[4] = {h[c0], h[c0 + 1], h[c0 + width + 1], h[c0 + width]};
+            if (!(v[0] == v[0] && v[1] == v[1] && v[2] == v[2] &&
+                  v[3] == v[3]))
+              continue; // A corner is empty
+            float lo = std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+            float hi = std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+            int kFirst = (int)std::floor((lo - base) / interval) + 1;
+            int kLast = (int)std::floor((hi - base) / interval);
+            uint64_t edges[4] = {2 * c0, 2 * (c0 + 1) + 1,
+                                 2 * (c0 + width), 2 * c0 + 1};
+
+            for (int k = kFirst; k <= kLast; ++k) {
+              float level = base + k * interval;
+              int index = (v[0] >= level) | (v[1] >= level) << 1 |
+                          (v[2] >= level) << 2 | (v[3] >= level) << 3;
+              if (index == 0 || index == 15)
+                continue;
+              const int8_t *pairs = SEGMENTS[index];
+              if ((index == 5 || index == 10) &&
+                  (v[0] + v[1] + v[2] + v[3]) * 0.25f >= level)
+                pairs = SEGMENTS[15 - index];
+              for (int s = 0; s < 4 && pairs[s] >= 0; s += 2) {
+                Piece piece;
+                piece.head = vertexKey(k, edges[pairs[s]]);
+                piece.tail = vertexKey(k, edges[pairs[s + 1]]);
+                piece.first = segmentPool.size() / 3;
+                piece.count = 2;
+                piece.level = k;
+                segmentPool.resize(segmentPool.size() + 6);
+                float *out = &segmentPool[piece.first * 3];
+                edgePoint(edges[pairs[s]], level, out);
+                edgePoint(edges[pairs[s + 1]], level, out + 3);
+                segmentPieces.push_back(piece);
+              }
+            }
+          }
+        }
+        tileSegments[tile] = segmentPieces.size();
+        chainPieces(segmentPieces, segmentPool, tilePieces[tile],
+                    tilePools[tile]);
+      },
+      threads);
+
+  // Stitch the tiles: lines crossing a seam end on the same key on both
+  // sides, everything else passes through unchanged
+  std::vector<Piece> pieces;
+  std::vector<float> pool;
+  for (size_t t = 0; t < tileCount; ++t) {
+    size_t offset = pool.size() / 3;
+    for (size_t i = 0; i < tilePieces[t].size(); ++i) {
+      pieces.push_back(tilePieces[t][i]);
+      pieces.back().first += offset;
+    }
+    pool.insert(pool.end(), tilePools[t].begin(), tilePools[t].end());
+    segments += tileSegments[t];
+    std::vector<Piece>().swap(tilePieces[t]);
+    std::vector<float>().swap(tilePools[t]);
+  }
+  std::vector<Piece> joined;
+  chainPieces(pieces, pool, joined, vertices);
+
+  lines.resize(joined.size());
+  for (size_t i = 0; i < joined.size(); ++i) {
+    lines[i].first = joined[i].first;
+    lines[i].count = joined[i].count;
+    lines[i].level = joined[i].level;
+    lines[i].closed = joined[i].head == joined[i].tail;
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ElevationGrid;
+
+// One iso-elevation polyline; its vertices are
+// getVertices()[first * 3, (first + count) * 3)
+struct ContourLine {
+  size_t first, count;
+  int level;     // Elevation is base + level * interval
+  bool closed;   // Last vertex connects back to the first
+};
+
+// Contour lines of an ElevationGrid by marching squares over the squares
+// between cell centers, at base + k * interval for every k in the grid's
+// range. Saddles are resolved by the square's center value; squares with
+// an empty corner produce nothing, so lines end at holes.
+//
+// The grid is cut into tiles of 64 x 64 squares. Each tile is traced on
+// its own thread and its segments chained into polylines; the pieces that
+// end on a tile seam are then joined into whole lines. A contour vertex is
+// identified by its level and the grid edge it lies on, and its position
+// is computed from that edge alone, so both sides of a seam agree exactly.
+class ContourSet {
+public:
+  ContourSet();
+
+  // Lines at most maxLevels apart are traced; false (and empty) if the
+  // interval would give more
+  bool build(const ElevationGrid &grid, float interval, float base = 0.0f,
+             unsigned threads = 0, int maxLevels = 10000);
+  void clear();
+
+  float getInterval() const { return interval; }
+  float getBase() const { return base; }
+  float getElevation(int level) const { return base + level * interval; }
+
+  const std::vector<float> &getVertices() const { return vertices; } // xyz
+  const std::vector<ContourLine> &getLines() const { return lines; }
+  size_t getSegmentCount() const { return segments; }
+
+private:
+  float interval, base;
+  std::vector<float> vertices;
+  std::vector<ContourLine> lines;
+  size_t segments;
+};
@@ -0,0 +1,485 @@
+#include "elevation_grid.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const size_t BATCH = 16384;  // Points binned per task
+const size_t SLAB = 4 << 20; // Points sorted at once
+
+const float NO_DATA = -9999.0f; // Empty cells in float rasters
+
+// "path/dem.flt" -> "path/dem.hdr"
+std::string headerPath(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return path + ".hdr";
+  return path.substr(0, dot) + ".hdr";
+}
+
+} // namespace
+
+ElevationGrid::ElevationGrid()
+    : minX(0.0f), minZ(0.0f), cellSize(1.0f), width(0), height(0),
+      statistic(GRID_MAX), idwPower(2.0f), finished(false), pointCount(0) {}
+
+bool ElevationGrid::create(float x, float z, int columns, int rows,
+                           float size, GridStatistic stat, float power) {
+  clear();
+  if (columns <= 0 || rows <= 0 || !(size > 0.0f) ||
+      (uint64_t)columns * (uint64_t)rows >= GridBins::OUTSIDE)
+    return false;
+  minX = x;
+  minZ = z;
+  width = columns;
+  height = rows;
+  cellSize = size;
+  statistic = stat;
+  idwPower = power;
+
+  float start = 0.0f;
+  if (stat == GRID_MIN)
+    start = std::numeric_limits<float>::infinity();
+  else if (stat == GRID_MAX)
+    start = -std::numeric_limits<float>::infinity();
+  size_t cells = (size_t)width * height;
+  heights.assign(cells, start);
+  counts.assign(cells, 0);
+  if (stat == GRID_IDW)
+    weights.assign(cells, 0.0f);
+  return true;
+}
+
+void ElevationGrid::clear() {
+  width = height = 0;
+  finished = false;
+  pointCount = 0;
+  std::vector<float>().swap(heights);
+  std::vector<float>().swap(weights);
+  std::vector<uint32_t>().swap(counts);
+}
+
+void GridBins::bin(const Point3D *points, size_t count, float minX,
+                   float minZ, int width, int height, float cellSize,
+                   unsigned threads) {
+  size_t bandCells = (size_t)width << BAND_BITS;
+  size_t bands = ((size_t)height + (1 << BAND_BITS) - 1) >> BAND_BITS;
+  float scale = 1.0f / cellSize;
+
+  // The cell of every point
+  cells.resize(count);
+  parallelFor(
+      (count + BATCH - 1) / BATCH,
+      [&](size_t batch) {
+        size_t end = std::min(count, (batch + 1) * BATCH);
+        for (size_t i = batch * BATCH; i < end; ++i) {
+          const Point3D &p = points[i];
+          float fx = (p.x - minX) * scale;
+          float fz = (p.z - minZ) * scale;
+          if (fx >= 0.0f && fx < (float)width && fz >= 0.0f &&
+              fz < (float)height && p.y == p.y)
+            cells[i] = std::min((uint32_t)fz, (uint32_t)height - 1) *
+                           (uint32_t)width +
+                       std::min((uint32_t)fx, (uint32_t)width - 1);
+          else
+            cells[i] = OUTSIDE; // Outside the grid, or NaN
+        }
+      },
+      threads);
+
+  // Counting sort by band, keeping input order within a band
+  starts.assign(bands + 1, 0);
+  for (size_t i = 0; i < count; ++i) {
+    if (cells[i] != OUTSIDE)
+      ++starts[cells[i] / bandCells + 1];
+  }
+  for (size_t b = 0; b < bands; ++b)
+    starts[b + 1] += starts[b];
+  order.resize(starts[bands]);
+  std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+  for (size_t i = 0; i < count; ++i) {
+    if (cells[i] != OUTSIDE)
+      order[fill[cells[i] / bandCells]++] = (uint32_t)i;
+  }
+}
+
+void ElevationGrid::addPoints(const Point3D *points, size_t count,
+                              unsigned threads) {
+  if (finished || heights.empty())
+    return;
+
+  GridBins bins;
+  for (size_t slab = 0; slab < count; slab += SLAB) {
+    const Point3D *slabPoints = points + slab;
+    bins.bin(slabPoints, std::min(SLAB, count - slab), minX, minZ, width,
+             height, cellSize, threads);
+    pointCount += bins.order.size();
+
+    // Each band's cells belong to one task, so no locking. Means are kept
+    // as running means, which stay accurate in float over any count.
+    parallelFor(
+        bins.getBandCount(),
+        [&](size_t b) {
+          for (size_t k = bins.starts[b]; k < bins.starts[b + 1]; ++k) {
+            const Point3D &p = slabPoints[bins.order[k]];
+            uint32_t cell = bins.cells[bins.order[k]];
+            float &h = heights[cell];
+            uint32_t &c = counts[cell];
+            if (c < GridBins::OUTSIDE)
+              ++c;
+            switch (statistic) {
+            case GRID_MIN:
+              h = std::min(h, p.y);
+              break;
+            case GRID_MAX:
+              h = std::max(h, p.y);
+              break;
+            case GRID_MEAN:
+              h += (p.y - h) / (float)c;
+              break;
+            case GRID_IDW: {
+              float dx = p.x - (minX + ((cell % width) + 0.5f) * cellSize);
+              float dz = p.z - (minZ + ((cell / width) + 0.5f) * cellSize);
+              // Floor the distance so a point on the center can't take
+              // all the weight
+              float d2 = std::max(dx * dx + dz * dz,
+                                  1e-4f * cellSize * cellSize);
+              float w = idwPower == 2.0f ? 1.0f / d2
+                                         : std::pow(d2, -0.5f * idwPower);
+              float &total = weights[cell];
+              total += w;
+              h += (p.y - h) * (w / total);
+              break;
+            }
+            }
+          }
+        },
+        threads);
+  }
+}
+
+void ElevationGrid::finish() {
+  if (finished)
+    return;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (size_t i = 0; i < heights.size(); ++i) {
+    if (counts[i] == 0)
+      heights[i] = nan;
+  }
+  std::vector<float>().swap(weights);
+  finished = true;
+}
+
+size_t ElevationGrid::fillHoles(int radius, float power, unsigned threads) {
+  if (!finished || radius <= 0)
+    return 0;
+
+  // Read from a copy so filled cells don't feed their neighbors
+  std::vector<float> source(heights);
+  std::vector<size_t> filled(height, 0);
+  int r2 = radius * radius;
+
+  // Filled cells summed over rows [0, y) and columns [0, x), so a hole with
+  // too few filled quadrants around it is skipped in constant time. Sparse
+  // surveys leave most of a grid empty.
+  size_t stride = (size_t)width + 1;
+  std::vector<uint32_t> sums(stride * (height + 1), 0);
+  parallelFor(
+      (size_t)height,
+      [&](size_t row) {
+        uint32_t *out = &sums[(row + 1) * stride + 1];
+        const float *in = &source[row * width];
+        uint32_t run = 0;
+        for (int x = 0; x < width; ++x) {
+          run += in[x] == in[x];
+          out[x] = run;
+        }
+      },
+      threads);
+  const size_t COLUMN_BLOCK = 1024;
+  parallelFor(
+      (stride + COLUMN_BLOCK - 1) / COLUMN_BLOCK,
+      [&](size_t block) {
+        size_t end = std::min(stride, (block + 1) * COLUMN_BLOCK);
+        for (int row = 1; row <= height; ++row) {
+          uint32_t *line = &sums[row * stride];
+          const uint32_t *above = line - stride;
+          for (size_t x = block * COLUMN_BLOCK; x < end; ++x)
+            line[x] += above[x];
+        }
+      },
+      threads);
+
+  // Filled cells in rows [r0, r1] and columns [c0, c1], clamped to the grid
+  auto countFilled = [&](int r0, int r1, int c0, int c1) -> uint32_t {
+    r0 = std::max(r0, 0);
+    c0 = std::max(c0, 0);
+    r1 = std::min(r1, height - 1);
+    c1 = std::min(c1, width - 1);
+    if (r0 > r1 || c0 > c1)
+      return 0;
+    const uint32_t *top = &sums[(size_t)r0 * stride];
+    const uint32_t *bottom = &sums[(size_t)(r1 + 1) * stride];
+    return bottom[c1 + 1] - bottom[c0] - top[c1 + 1] + top[c0];
+  };
+
+  parallelFor(
+      (size_t)height,
+      [&](size_t row) {
+        int y = (int)row;
+        for (int x = 0; x < width; ++x) {
+          size_t cell = row * width + x;
+          if (source[cell] == source[cell])
+            continue;
+          // Same quadrants as below, over their bounding squares
+          int around = (countFilled(y - radius, y - 1, x, x + radius) > 0) +
+                       (countFilled(y, y + radius, x + 1, x + radius) > 0) +
+                       (countFilled(y + 1, y + radius, x - radius, x) > 0) +
+                       (countFilled(y - radius, y, x - radius, x - 1) > 0);
+          if (around < 3)
+            continue;
+
+          double sum = 0.0, total = 0.0;
+          int quadrants = 0;
+          int r0 = std::max(y - radius, 0);
+          int r1 = std::min(y + radius, height - 1);
+          int c0 = std::max(x - radius, 0);
+          int c1 = std::min(x + radius, width - 1);
+          for (int ny = r0; ny <= r1; ++ny) {
+            int dy = ny - y;
+            const float *line = &source[(size_t)ny * width];
+            for (int nx = c0; nx <= c1; ++nx) {
+              int dx = nx - x;
+              int d2 = dx * dx + dy * dy;
+              float h = line[nx];
+              if (d2 > r2 || !(h == h))
+                continue;
+              float w = power == 2.0f ? 1.0f / d2
+                                      : std::pow((float)d2, -0.5f * power);
+              sum += (double)w * h;
+              total += w;
+              // Each offset belongs to exactly one quadrant
+              if (dy < 0 && dx >= 0)
+                quadrants |= 1;
+              else if (dy >= 0 && dx > 0)
+                quadrants |= 2;
+              else if (dy > 0 && dx <= 0)
+                quadrants |= 4;
+              else
+                quadrants |= 8;
+            }
+          }
+          int sides = (quadrants & 1) + ((quadrants >> 1) & 1) +
+                      ((quadrants >> 2) & 1) + ((quadrants >> 3) & 1);
+          if (sides >= 3 && total > 0.0) {
+            heights[cell] = (float)(sum / total);
+            ++filled[row];
+          }
+        }
+      },
+      threads);
+
+  size_t total = 0;
+  for (size_t i = 0; i < filled.size(); ++i)
+    total += filled[i];
+  return total;
+}
+
+size_t ElevationGrid::getFilledCount() const {
+  size_t filled = 0;
+  for (size_t i = 0; i < heights.size(); ++i)
+    filled += heights[i] == heights[i];
+  return filled;
+}
+
+bool ElevationGrid::getRange(float &low, float &high) const {
+  bool any = false;
+  for (size_t i = 0; finished && i < heights.size(); ++i) {
+    float h = heights[i];
+    if (!(h == h))
+      continue;
+    if (!any) {
+      low = high = h;
+      any = true;
+    } else {
+      low = std::min(low, h);
+      high = std::max(high, h);
+    }
+  }
+  return any;
+}
+
+bool getRasterFormat(const std::string &path, RasterFormat &format) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+  std::string ext = path.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); ++i)
+    ext[i] = (char)tolower((unsigned char)ext[i]);
+  if (ext == "flt")
+    format = RASTER_FLOAT;
+  else if (ext == "pgm")
+    format = RASTER_PGM;
+  else if (ext == "raw" || ext == "r16")
+    format = RASTER_RAW16;
+  else
+    return false;
+  return true;
+}
+
+RasterWriter::RasterWriter()
+    : file(NULL), format(RASTER_FLOAT), width(0), height(0), written(0),
+      low(0.0f), scale(0.0f) {}
+
+RasterWriter::~RasterWriter() {
+  if (file)
+    fclose(file);
+}
+
+bool RasterWriter::fail(const std::string &message) {
+  error = message;
+  if (file)
+    fclose(file);
+  file = NULL;
+  return false;
+}
+
+bool RasterWriter::open(const std::string &path, RasterFormat rasterFormat,
+                        int columns, int rows, double cellSize, double xll,
+                        double yll, float lowest, float highest) {
+  if (file)
+    fclose(file);
+  format = rasterFormat;
+  width = columns;
+  height = rows;
+  written = 0;
+  low = lowest;
+  scale = highest > lowest ? 65534.0f / (highest - lowest) : 0.0f;
+  error.clear();
+
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+    return fail("cannot create " + path);
+
+  if (format == RASTER_PGM) {
+    fprintf(file,
+            "P5\n# elevation = %.6f + (value - 1) * %.9g, 0 = no data\n"
+            "%d %d\n65535\n",
+            low, scale > 0.0f ? 1.0f / scale : 0.0f, width, height);
+  } else {
+    std::string hdr = headerPath(path);
+    FILE *header = fopen(hdr.c_str(), "w");
+    if (!header)
+      return fail("cannot create " + hdr);
+    fprintf(header,
+            "ncols %d\nnrows %d\nxllcorner %.6f\nyllcorner %.6f\n"
+            "cellsize %.9g\n",
+            width, height, xll, yll, cellSize);
+    if (format == RASTER_FLOAT) {
+      fprintf(header, "NODATA_value %g\nbyteorder LSBFIRST\n", NO_DATA);
+    } else {
+      // BIL keys for readers that take the raw file as a 16-bit band
+      fprintf(header,
+              "nbands 1\nnbits 16\npixeltype unsignedint\nbyteorder I\n"
+              "layout bil\nnodata 0\n"
+              "elevation_offset %.6f\nelevation_step %.9g\n",
+              low, scale > 0.0f ? 1.0f / scale : 0.0f);
+    }
+    if (fclose(header) != 0)
+      return fail("cannot write " + hdr);
+  }
+  row.resize((size_t)width * (format == RASTER_FLOAT ? 4 : 2));
+  return true;
+}
+
+bool RasterWriter::writeRows(const float *elevations, int rows) {
+  if (!file)
+    return false;
+  if (written + rows > height)
+    return fail("more rows than the raster has");
+
+  unsigned char *out = row.data();
+  for (int r = 0; r < rows; ++r, elevations += width) {
+    for (int x = 0; x < width; ++x) {
+      float h = elevations[x];
+      if (format == RASTER_FLOAT) {
+        if (!(h == h))
+          h = NO_DATA;
+        uint32_t bits;
+        memcpy(&bits, &h, 4);
+        out[x * 4] = (unsigned char)bits;
+        out[x * 4 + 1] = (unsigned char)(bits >> 8);
+        out[x * 4 + 2] = (unsigned char)(bits >> 16);
+        out[x * 4 + 3] = (unsigned char)(bits >> 24);
+        continue;
+      }
+      uint16_t v = 0;
+      if (h == h) {
+        float f = 1.0f + (h - low) * scale + 0.5f;
+        v = (uint16_t)std::min(std::max(f, 1.0f), 65535.0f);
+      }
+      // PGM samples are big-endian
+      int hi = format == RASTER_PGM ? 0 : 1;
+      out[x * 2 + hi] = (unsigned char)(v >> 8);
+      out[x * 2 + 1 - hi] = (unsigned char)v;
+    }
+    if (fwrite(out, 1, row.size(), file) != row.size())
+      return fail("write failed (disk full?)");
+  }
+  written += rows;
+  return true;
+}
+
+bool RasterWriter::close() {
+  if (!file)
+    return error.empty();
+  if (written != height)
+    return fail("raster closed after " + std::to_string(written) + " of " +
+                std::to_string(height) + " rows");
+  bool ok = fclose(file) == 0;
+  file = NULL;
+  return ok ? true : fail("write failed (disk full?)");
+}
+
+bool writeElevationGrid(const ElevationGrid &grid, const std::string &path,
+                        const double origin[3], std::string &error) {
+  RasterFormat format;
+  float low, high;
+  if (!getRasterFormat(path, format)) {
+    error = "unknown raster extension (flt, pgm, raw)";
+    return false;
+  }
+  if (!grid.isFinished() || !grid.getRange(low, high)) {
+    error = "the grid is empty";
+    return false;
+  }
+
+  int width = grid.getWidth(), height = grid.getHeight();
+  float cell = grid.getCellSize();
+  double xll = origin[0] + grid.getMinX();
+  double yll = origin[1] - (grid.getMinZ() + height * (double)cell);
+  float offset = (float)origin[2];
+  RasterWriter writer;
+  if (!writer.open(path, format, width, height, cell, xll, yll,
+                   low + offset, high + offset)) {
+    error = writer.getError();
+    return false;
+  }
+  std::vector<float> row(width);
+  for (int r = 0; r < height && writer.getError().empty(); ++r) {
+    const float *in = &grid.getElevations()[(size_t)r * width];
+    for (int x = 0; x < width; ++x)
+      row[x] = in[x] + offset;
+    writer.writeRows(row.data(), 1);
+  }
+  if (!writer.close()) {
+    error = writer.getError();
+    return false;
+  }
+  return true;
+}
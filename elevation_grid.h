@@ -0,0 +1,150 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// How the points that fall into a cell make its elevation
+enum GridStatistic {
+  GRID_MIN,  // Lowest return (terrain under vegetation, roughly)
+  GRID_MAX,  // Highest return (surface model)
+  GRID_MEAN,
+  GRID_IDW   // Weighted by inverse distance to the cell center
+};
+
+// A batch of points binned by grid cell and counting-sorted into bands of
+// rows, so each band's cells can be updated by one thread without locking.
+// Shared by the rasters built from points.
+struct GridBins {
+  static const int BAND_BITS = 3; // 8 rows per band
+  static const uint32_t OUTSIDE = 0xffffffffu;
+
+  std::vector<uint32_t> cells; // Cell of each point, OUTSIDE if none
+  std::vector<uint32_t> order; // Points grouped by band, in input order
+  std::vector<size_t> starts;  // Band b is order[starts[b], starts[b + 1])
+
+  // Points outside the grid or with a NaN height are left out. count must
+  // fit in 32 bits.
+  void bin(const Point3D *points, size_t count, float minX, float minZ,
+           int width, int height, float cellSize, unsigned threads = 0);
+  size_t getBandCount() const {
+    return starts.empty() ? 0 : starts.size() - 1;
+  }
+};
+
+// A regular grid of elevations over the viewer's X/Z plane. Cell (row,
+// column) covers x in [minX + column * cellSize, + cellSize) and z likewise
+// from minZ, so row 0 is the north edge once points come from a Z-up file
+// through fileToViewer. Elevations are viewer Y; cells without points are
+// NaN.
+//
+// Points are accumulated batch by batch and never kept: each batch is
+// binned by cell in parallel, counting-sorted into bands of rows, and each
+// band accumulated on its own thread. Any number of points can be fed
+// through a grid that fits in memory; larger grids are made band by band
+// (see lidar_dem).
+class ElevationGrid {
+public:
+  ElevationGrid();
+
+  // Empty the grid and size it; false if width * height overflows
+  bool create(float minX, float minZ, int width, int height, float cellSize,
+              GridStatistic statistic, float idwPower = 2.0f);
+  void clear();
+
+  // Add points (viewer coordinates); those outside the grid are ignored
+  void addPoints(const Point3D *points, size_t count, unsigned threads = 0);
+
+  // Turn the accumulated sums into elevations. Points can't be added after.
+  void finish();
+
+  // Fill empty cells from the filled cells within radius (in cells),
+  // weighted by inverse distance. Only cells with filled neighbors in at
+  // least three quadrants are filled, so holes close but the outline of
+  // the data is not smeared outward. Returns the number filled.
+  size_t fillHoles(int radius, float power = 2.0f, unsigned threads = 0);
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  float getCellSize() const { return cellSize; }
+  float getMinX() const { return minX; }
+  float getMinZ() const { return minZ; }
+  GridStatistic getStatistic() const { return statistic; }
+  bool isFinished() const { return finished; }
+
+  float getElevation(int row, int column) const {
+    return heights[(size_t)row * width + column];
+  }
+  const std::vector<float> &getElevations() const { return heights; }
+  // Points that fell into a cell (0 for filled holes)
+  uint32_t getCount(int row, int column) const {
+    return counts[(size_t)row * width + column];
+  }
+
+  uint64_t getPointCount() const { return pointCount; }
+  size_t getFilledCount() const; // Cells with an elevation
+  // Lowest and highest elevation; false when every cell is empty
+  bool getRange(float &low, float &high) const;
+
+private:
+  float minX, minZ, cellSize;
+  int width, height;
+  GridStatistic statistic;
+  float idwPower;
+  bool finished;
+  uint64_t pointCount;
+
+  // Min, max or running (weighted) mean while accumulating
+  std::vector<float> heights;
+  std::vector<float> weights; // IDW weight sums
+  std::vector<uint32_t> counts;
+};
+
+// Raster files without GeoTIFF: raw floats with an ESRI .hdr (read by GDAL
+// and most GIS), 16-bit PGM, and raw 16-bit heightmaps for terrain tools
+enum RasterFormat {
+  RASTER_FLOAT, // .flt + .hdr, -9999 for empty cells
+  RASTER_PGM,   // P5 with 16-bit samples, 0 for empty cells
+  RASTER_RAW16  // Little-endian uint16 + .hdr, 0 for empty cells
+};
+
+// Format from the extension (flt, pgm, raw/r16); false if none matches
+bool getRasterFormat(const std::string &path, RasterFormat &format);
+
+// Writes a raster a run of rows at a time, north row first, so grids made
+// band by band never have to be in memory whole. 16-bit formats map
+// [low, high] onto 1..65535; the mapping is recorded in the PGM comment
+// or the .hdr.
+class RasterWriter {
+public:
+  RasterWriter();
+  ~RasterWriter();
+
+  // xll, yll: file coordinates of the grid's south-west corner
+  bool open(const std::string &path, RasterFormat format, int width,
+            int height, double cellSize, double xll, double yll, float low,
+            float high);
+  // rows * width elevations, NaN for empty cells
+  bool writeRows(const float *elevations, int rows);
+  bool close(); // Also checks that every row was written
+
+  const std::string &getError() const { return error; }
+
+private:
+  bool fail(const std::string &message);
+
+  FILE *file;
+  RasterFormat format;
+  int width, height, written;
+  float low, scale;
+  std::vector<unsigned char> row;
+  std::string error;
+};
+
+// Write a finished grid as one raster, format by extension. origin is the
+// file position of the viewer origin (see fileToViewer), so the raster is
+// placed and its elevations given in file coordinates.
+bool writeElevationGrid(const ElevationGrid &grid, const std::string &path,
+                        const double origin[3], std::string &error);
@@ -0,0 +1,126 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include "file_utils.h"
+#include <algorithm>
+#include <cctype>
+#include <stdio.h>
+#include <sys/stat.h>
+
+bool makeDirectory(const std::string &path) {
+#ifdef _WIN32
+  return _mkdir(path.c_str()) == 0 || isDirectory(path);
+#else
+  return mkdir(path.c_str(), 0755) == 0 || isDirectory(path);
+#endif
+}
+
+bool removeDirectory(const std::string &path) {
+#ifdef _WIN32
+  return _rmdir(path.c_str()) == 0;
+#else
+  return rmdir(path.c_str()) == 0;
+#endif
+}
+
+bool fileExists(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+bool isDirectory(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFDIR) != 0;
+}
+
+uint64_t getFileSize(const std::string &path) {
+#ifdef _WIN32
+  struct _stat64 st;
+  if (_stat64(path.c_str(), &st) != 0)
+    return 0;
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return 0;
+#endif
+  return (uint64_t)st.st_size;
+}
+
+std::string joinPath(const std::string &dir, const std::string &name) {
+  if (dir.empty())
+    return name;
+  char last = dir[dir.size() - 1];
+  if (last == '/' || last == '\\')
+    return dir + name;
+  return dir + "/" + name;
+}
+
+std::string getExtension(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return "";
+  std::string ext = path.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); ++i)
+    ext[i] = (char)tolower((unsigned char)ext[i]);
+  return ext;
+}
+
+std::vector<std::string> listDirectory(const std::string &dir,
+                                       const std::string &extension) {
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA(joinPath(dir, "*").c_str(), &data);
+  if (find == INVALID_HANDLE_VALUE)
+    return names;
+  do {
+    if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      names.push_back(data.cFileName);
+  } while (FindNextFileA(find, &data));
+  FindClose(find);
+#else
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return names;
+  while (struct dirent *entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != ".." && !isDirectory(joinPath(dir, name)))
+      names.push_back(name);
+  }
+  closedir(d);
+#endif
+
+  if (!extension.empty()) {
+    names.erase(std::remove_if(names.begin(), names.end(),
+                               [&](const std::string &name) {
+                                 return getExtension(name) != extension;
+                               }),
+                names.end());
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+int seekFile(FILE *f, uint64_t offset) {
+#ifdef _WIN32
+  return _fseeki64(f, (__int64)offset, SEEK_SET);
+#else
+  return fseeko(f, (off_t)offset, SEEK_SET);
+#endif
+}
+
+bool readFileRange(const std::string &path, uint64_t offset, size_t size,
+                   void *out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  bool ok = seekFile(f, offset) == 0 && fread(out, 1, size, f) == size;
+  fclose(f);
+  return ok;
+}
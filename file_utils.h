@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Small portable file system helpers (C++11 has no <filesystem>)
+bool makeDirectory(const std::string &path);
+bool removeDirectory(const std::string &path); // Must be empty
+bool fileExists(const std::string &path);
+bool isDirectory(const std::string &path);
+uint64_t getFileSize(const std::string &path);
+
+std::string joinPath(const std::string &dir, const std::string &name);
+std::string getExtension(const std::string &path); // Lowercase, no dot
+
+// Names (not paths) of regular files in dir, sorted; optionally only those
+// with the given lowercase extension
+std::vector<std::string> listDirectory(const std::string &dir,
+                                       const std::string &extension = "");
+
+// 64-bit offset seek on stdio streams
+int seekFile(FILE *f, uint64_t offset);
+
+// Read bytes [offset, offset + size) of a file
+bool readFileRange(const std::string &path, uint64_t offset, size_t size,
+                   void *out);
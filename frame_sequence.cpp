@@ -0,0 +1,221 @@
+#include "frame_sequence.h"
+#include "file_utils.h"
+#include "point_io.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const double ORIGIN[3] = {0.0, 0.0, 0.0}; // Sweeps are in the sensor frame
+
+std::string parentPath(const std::string &path) {
+  size_t end = path.find_last_not_of("/\\");
+  if (end == std::string::npos)
+    return path;
+  size_t slash = path.find_last_of("/\\", end);
+  if (slash == std::string::npos)
+    return ".";
+  return slash == 0 ? path.substr(0, 1) : path.substr(0, slash);
+}
+
+// Seconds from a line: either a plain number (odometry times.txt) or
+// "YYYY-MM-DD HH:MM:SS.fraction" (raw data timestamps.txt), where only the
+// time of day is used
+bool parseTime(const char *line, double &seconds) {
+  int year, month, day, hour, minute;
+  double second;
+  if (sscanf(line, "%d-%d-%d %d:%d:%lf", &year, &month, &day, &hour, &minute,
+             &second) == 6) {
+    seconds = hour * 3600.0 + minute * 60.0 + second;
+    return true;
+  }
+  return sscanf(line, "%lf", &seconds) == 1;
+}
+
+// Twelve numbers of a row-major 3x4 matrix, after an optional "Name:"
+bool parsePose(const char *line, Pose &pose) {
+  const char *colon = strchr(line, ':');
+  if (colon)
+    line = colon + 1;
+  float *m = pose.m;
+  return sscanf(line, "%f %f %f %f %f %f %f %f %f %f %f %f", &m[0], &m[1],
+                &m[2], &m[3], &m[4], &m[5], &m[6], &m[7], &m[8], &m[9],
+                &m[10], &m[11]) == 12;
+}
+
+// Sensor frame (x forward, y left, z up) to viewer axes (Y up), as
+// fileToViewer does for positions
+Pose sensorToViewer() {
+  Pose p;
+  const float m[12] = {1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 0};
+  for (int i = 0; i < 12; ++i)
+    p.m[i] = m[i];
+  return p;
+}
+
+} // namespace
+
+size_t FrameSequence::findFrame(double t) const {
+  std::vector<double>::const_iterator it =
+      std::upper_bound(times.begin(), times.end(), t);
+  return it == times.begin() ? 0 : (size_t)(it - times.begin()) - 1;
+}
+
+bool KittiSequence::open(const std::string &dir, double defaultRate) {
+  frames.clear();
+  times.clear();
+  poses.clear();
+  timestamped = false;
+  error.clear();
+
+  // Sweeps may sit in the KITTI subdirectories of the given one
+  std::string sweepDir = dir;
+  const char *subdirs[] = {"velodyne", "velodyne_points/data"};
+  for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); ++i) {
+    if (listDirectory(sweepDir, "bin").empty() &&
+        isDirectory(joinPath(dir, subdirs[i])))
+      sweepDir = joinPath(dir, subdirs[i]);
+  }
+
+  std::vector<std::string> names = listDirectory(sweepDir, "bin");
+  if (names.empty()) {
+    error = "no .bin sweeps in " + dir;
+    return false;
+  }
+  for (size_t i = 0; i < names.size(); ++i)
+    frames.push_back(joinPath(sweepDir, names[i]));
+
+  // times.txt sits next to velodyne/ (odometry), timestamps.txt in
+  // velodyne_points/ (raw data)
+  std::string candidates[] = {
+      joinPath(sweepDir, "times.txt"),
+      joinPath(parentPath(sweepDir), "times.txt"),
+      joinPath(parentPath(sweepDir), "timestamps.txt"),
+      joinPath(sweepDir, "timestamps.txt")};
+  for (size_t i = 0; i < 4 && !timestamped; ++i) {
+    if (fileExists(candidates[i]))
+      timestamped = readTimestamps(candidates[i]);
+  }
+  if (!timestamped) {
+    double period = 1.0 / std::max(defaultRate, 1e-3);
+    times.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i)
+      times[i] = i * period;
+  }
+
+  // Odometry layout: sequences/NN/velodyne, sequences/NN/calib.txt and
+  // poses/NN.txt
+  std::string sequenceDir = parentPath(sweepDir);
+  std::string name = sequenceDir.substr(sequenceDir.find_last_of("/\\") + 1);
+  std::string calib = joinPath(sequenceDir, "calib.txt");
+  std::string poseFiles[] = {
+      joinPath(sweepDir, "poses.txt"), joinPath(sequenceDir, "poses.txt"),
+      joinPath(joinPath(parentPath(parentPath(sequenceDir)), "poses"),
+               name + ".txt")};
+  for (size_t i = 0; i < 3 && poses.empty(); ++i) {
+    if (fileExists(poseFiles[i]))
+      readPoses(poseFiles[i], calib);
+  }
+  return true;
+}
+
+bool KittiSequence::readPoses(const std::string &path,
+                              const std::string &calibPath) {
+  // Ground truth poses are of the left camera; Tr maps velodyne to camera
+  Pose tr;
+  char line[1024];
+  FILE *f = fopen(calibPath.c_str(), "r");
+  if (f) {
+    while (fgets(line, sizeof(line), f)) {
+      if (strncmp(line, "Tr:", 3) == 0)
+        parsePose(line, tr);
+    }
+    fclose(f);
+  }
+
+  f = fopen(path.c_str(), "r");
+  if (!f)
+    return false;
+  std::vector<Pose> read;
+  Pose pose;
+  while (fgets(line, sizeof(line), f) && read.size() < frames.size()) {
+    if (parsePose(line, pose))
+      read.push_back(pose);
+  }
+  fclose(f);
+  if (read.size() != frames.size())
+    return false;
+
+  // Velodyne pose relative to the first sweep, then in viewer axes
+  Pose toViewer = sensorToViewer();
+  Pose fromViewer = toViewer.inverse();
+  Pose trInverse = tr.inverse();
+  Pose first = (trInverse * read[0] * tr).inverse();
+  poses.resize(read.size());
+  for (size_t i = 0; i < read.size(); ++i)
+    poses[i] = toViewer * first * trInverse * read[i] * tr * fromViewer;
+  return true;
+}
+
+bool KittiSequence::readTimestamps(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f)
+    return false;
+
+  std::vector<double> read;
+  char line[256];
+  double dayOffset = 0.0;
+  while (fgets(line, sizeof(line), f) && read.size() < frames.size()) {
+    double t;
+    if (!parseTime(line, t))
+      continue;
+    t += dayOffset;
+    if (!read.empty() && t < read.back() - 43200.0) {
+      dayOffset += 86400.0; // Recording ran past midnight
+      t += 86400.0;
+    }
+    read.push_back(t);
+  }
+  fclose(f);
+
+  // Times must match the sweeps one to one and never go backwards
+  if (read.size() != frames.size())
+    return false;
+  for (size_t i = 1; i < read.size(); ++i) {
+    if (read[i] < read[i - 1])
+      return false;
+  }
+  times.resize(read.size());
+  for (size_t i = 0; i < read.size(); ++i)
+    times[i] = read[i] - read[0];
+  return true;
+}
+
+bool KittiSequence::loadFrame(size_t frame,
+                              std::vector<Point3D> &out) const {
+  if (frame >= frames.size())
+    return false;
+
+  uint64_t bytes = getFileSize(frames[frame]);
+  size_t count = (size_t)(bytes / (4 * sizeof(float)));
+  std::vector<float> values(count * 4);
+  if (count > 0 && !readFileRange(frames[frame], 0,
+                                  values.size() * sizeof(float),
+                                  values.data()))
+    return false;
+
+  size_t first = out.size();
+  out.resize(first + count);
+  for (size_t i = 0; i < count; ++i) {
+    const float *v = &values[i * 4];
+    Point3D &p = out[first + i];
+    float pos[3];
+    fileToViewer(v[0], v[1], v[2], ORIGIN, pos);
+    p.x = pos[0];
+    p.y = pos[1];
+    p.z = pos[2];
+    p.r = p.g = p.b = p.intensity = v[3];
+  }
+  return true;
+}
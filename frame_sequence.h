@@ -0,0 +1,74 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include "pose.h"
+#include <string>
+#include <vector>
+
+// A recorded drive as a series of sweeps with capture times. Subclasses
+// read a particular recording format; the time index lives here so every
+// source seeks the same way.
+class FrameSequence {
+public:
+  FrameSequence() : timestamped(false) {}
+  virtual ~FrameSequence() {}
+
+  bool isOpen() const { return !times.empty(); }
+  const std::string &getError() const { return error; }
+
+  size_t getFrameCount() const { return times.size(); }
+
+  // Seconds from the first sweep
+  double getFrameTime(size_t frame) const { return times[frame]; }
+  double getDuration() const { return times.empty() ? 0.0 : times.back(); }
+  bool hasTimestamps() const { return timestamped; }
+
+  // Last frame whose time is at or before t (0 before the first), by
+  // binary search
+  size_t findFrame(double t) const;
+
+  // Append a sweep's points in viewer coordinates (Y up, sensor at the
+  // origin). Called from several threads at once.
+  virtual bool loadFrame(size_t frame, std::vector<Point3D> &out) const = 0;
+
+  // Sweeps carry their own r, g, b
+  virtual bool hasColor() const { return false; }
+
+  // Where each sweep's sensor was, in viewer coordinates relative to the
+  // first sweep; identity for recordings without poses
+  bool hasPoses() const { return !poses.empty(); }
+  Pose getFramePose(size_t frame) const {
+    return frame < poses.size() ? poses[frame] : Pose();
+  }
+
+protected:
+  std::vector<double> times; // Ascending
+  std::vector<Pose> poses;   // Empty or one per frame
+  bool timestamped;
+  std::string error;
+};
+
+// Sweeps stored one per file in the KITTI velodyne layout: little-endian
+// float32 x, y, z, reflectance per point, sensor frame (x forward, y left,
+// z up). Frames are the .bin files of the directory in name order; sweep
+// times come from the KITTI times.txt or timestamps.txt next to them when
+// present, else a fixed rate is assumed. Poses come from the odometry
+// ground truth (poses.txt next to the sweeps, or poses/NN.txt of the
+// dataset) moved into the sensor frame with the Tr of calib.txt.
+class KittiSequence : public FrameSequence {
+public:
+  // dir is the directory of .bin files, or a KITTI sequence or drive
+  // directory containing velodyne/ or velodyne_points/data/
+  bool open(const std::string &dir, double defaultRate = 10.0);
+
+  const std::string &getFramePath(size_t frame) const { return frames[frame]; }
+
+  // Reflectance becomes the intensity
+  bool loadFrame(size_t frame, std::vector<Point3D> &out) const override;
+
+private:
+  bool readTimestamps(const std::string &path);
+  bool readPoses(const std::string &path, const std::string &calibPath);
+
+  std::vector<std::string> frames;
+};
@@ -0,0 +1,126 @@
+#include "frame_stats.h"
+#include <algorithm>
+#include <stdio.h>
+
+FrameStats::FrameStats(size_t historySize)
+    : history(historySize, 0.0f), head(0), count(0), totalFrames(0),
+      hitchThresholdMs(50.0f), maxHitches(64) {}
+
+void FrameStats::addFrame(float frameMs) {
+  history[head] = frameMs;
+  head = (head + 1) % history.size();
+  if (count < history.size())
+    ++count;
+
+  std::string phases;
+  {
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    if (frameMs > hitchThresholdMs) {
+      for (size_t i = 0; i < framePhases.size(); ++i) {
+        if (i > 0)
+          phases += ";";
+        phases += framePhases[i];
+      }
+    }
+    // Phases still running carry over into the next frame
+    framePhases = activePhases;
+  }
+
+  if (frameMs > hitchThresholdMs) {
+    FrameHitch hitch;
+    hitch.frameIndex = totalFrames;
+    hitch.frameMs = frameMs;
+    hitch.phases = phases;
+    hitches.push_back(hitch);
+    if (hitches.size() > maxHitches)
+      hitches.pop_front();
+  }
+
+  ++totalFrames;
+}
+
+void FrameStats::beginPhase(const char *name) {
+  std::lock_guard<std::mutex> lock(phaseMutex);
+  activePhases.push_back(name);
+  if (std::find(framePhases.begin(), framePhases.end(), name) ==
+      framePhases.end())
+    framePhases.push_back(name);
+}
+
+void FrameStats::endPhase(const char *name) {
+  std::lock_guard<std::mutex> lock(phaseMutex);
+  std::vector<std::string>::iterator it =
+      std::find(activePhases.begin(), activePhases.end(), name);
+  if (it != activePhases.end())
+    activePhases.erase(it);
+}
+
+FrameSummary FrameStats::getSummary() const {
+  FrameSummary summary = {0, 0, 0, 0, 0, count};
+  if (count == 0)
+    return summary;
+
+  std::vector<float> sorted(history.begin(), history.begin() + count);
+  std::sort(sorted.begin(), sorted.end());
+
+  double sum = 0.0;
+  for (size_t i = 0; i < sorted.size(); ++i)
+    sum += sorted[i];
+
+  size_t last = sorted.size() - 1;
+  summary.p50 = sorted[(size_t)(last * 0.50f + 0.5f)];
+  summary.p95 = sorted[(size_t)(last * 0.95f + 0.5f)];
+  summary.p99 = sorted[(size_t)(last * 0.99f + 0.5f)];
+  summary.max = sorted[last];
+  summary.mean = (float)(sum / sorted.size());
+  return summary;
+}
+
+void FrameStats::getHistogram(std::vector<float> &bins, int binCount,
+                              float maxMs) const {
+  bins.assign(binCount, 0.0f);
+  if (binCount <= 0 || maxMs <= 0.0f)
+    return;
+
+  for (size_t i = 0; i < count; ++i) {
+    int bin = (int)(history[i] / maxMs * binCount);
+    bins[std::min(std::max(bin, 0), binCount - 1)] += 1.0f;
+  }
+}
+
+void FrameStats::clear() {
+  head = count = 0;
+  hitches.clear();
+  // Phases from before the clear mustn't label the next hitch; ones still
+  // running carry over as they do from frame to frame
+  std::lock_guard<std::mutex> lock(phaseMutex);
+  framePhases = activePhases;
+}
+
+bool FrameStats::exportCSV(const char *path) const {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+
+  fprintf(f, "frame,frame_ms,hitch,phases\n");
+
+  size_t start = getHistoryOffset();
+  unsigned long long firstFrame = totalFrames - count;
+  std::deque<FrameHitch>::const_iterator hitch = hitches.begin();
+
+  for (size_t i = 0; i < count; ++i) {
+    unsigned long long frame = firstFrame + i;
+    float ms = history[(start + i) % history.size()];
+
+    // Both sequences are chronological, so walk them together
+    while (hitch != hitches.end() && hitch->frameIndex < frame)
+      ++hitch;
+    bool isHitch = hitch != hitches.end() && hitch->frameIndex == frame;
+
+    fprintf(f, "%llu,%.3f,%d,\"%s\"\n", frame, ms, isHitch ? 1 : 0,
+            isHitch ? hitch->phases.c_str() : "");
+  }
+
+  fclose(f);
+  return true;
+}
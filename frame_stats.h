@@ -0,0 +1,83 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Percentile summary of the frames currently in the history
+struct FrameSummary {
+  float p50, p95, p99, max, mean;
+  size_t frames;
+};
+
+// A frame that took longer than the hitch threshold
+struct FrameHitch {
+  unsigned long long frameIndex;
+  float frameMs;
+  std::string phases; // Phases that were active during the frame
+};
+
+// Frame-time ring buffer with percentiles, histogram and hitch log.
+// Phases may be marked from any thread; frames are added by the main loop.
+class FrameStats {
+public:
+  explicit FrameStats(size_t historySize = 1024);
+
+  // Record the duration of the frame that just finished
+  void addFrame(float frameMs);
+
+  // Mark work (loading, index builds, ...) that may cause hitches
+  void beginPhase(const char *name);
+  void endPhase(const char *name);
+
+  void setHitchThreshold(float ms) { hitchThresholdMs = ms; }
+  float getHitchThreshold() const { return hitchThresholdMs; }
+
+  FrameSummary getSummary() const;
+
+  // Count frames into binCount buckets spanning [0, maxMs], overflow goes
+  // into the last bucket
+  void getHistogram(std::vector<float> &bins, int binCount, float maxMs) const;
+
+  // Raw history for plotting; values are chronological starting at offset
+  const float *getHistory() const { return history.data(); }
+  int getHistoryCount() const { return (int)count; }
+  int getHistoryOffset() const {
+    return count < history.size() ? 0 : (int)head;
+  }
+
+  const std::deque<FrameHitch> &getHitches() const { return hitches; }
+  void clear();
+
+  // Write one row per frame in the history (frame, ms, hitch, phases)
+  bool exportCSV(const char *path) const;
+
+private:
+  std::vector<float> history;
+  size_t head;  // Next slot to write
+  size_t count; // Valid entries
+  unsigned long long totalFrames;
+
+  float hitchThresholdMs;
+  std::deque<FrameHitch> hitches;
+  size_t maxHitches;
+
+  // Phases active right now, and every phase seen since the last frame
+  mutable std::mutex phaseMutex;
+  std::vector<std::string> activePhases;
+  std::vector<std::string> framePhases;
+};
+
+// Marks a phase for the lifetime of the scope
+class ScopedPhase {
+public:
+  ScopedPhase(FrameStats &stats, const char *name) : stats(stats), name(name) {
+    stats.beginPhase(name);
+  }
+  ~ScopedPhase() { stats.endPhase(name); }
+
+private:
+  FrameStats &stats;
+  const char *name;
+};
@@ -0,0 +1,66 @@
+#include "frustum.h"
+#include "point_cloud_renderer.h"
+#include <algorithm>
+#include <cmath>
+
+Frustum::Frustum() {
+  for (int i = 0; i < 6; ++i) {
+    planes[i][0] = planes[i][1] = planes[i][2] = 0.0f;
+    planes[i][3] = 1.0f;
+  }
+}
+
+void Frustum::set(const float modelview[16], const float projection[16]) {
+  float m[16];
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; ++k)
+        sum += projection[k * 4 + r] * modelview[c * 4 + k];
+      m[c * 4 + r] = sum;
+    }
+  }
+
+  // Each plane is the w row plus or minus the x, y or z row of the matrix
+  for (int i = 0; i < 6; ++i) {
+    int row = i / 2;
+    float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+    for (int c = 0; c < 4; ++c)
+      planes[i][c] = m[c * 4 + 3] + sign * m[c * 4 + row];
+
+    float length = std::sqrt(planes[i][0] * planes[i][0] +
+                             planes[i][1] * planes[i][1] +
+                             planes[i][2] * planes[i][2]);
+    if (length > 0.0f) {
+      for (int c = 0; c < 4; ++c)
+        planes[i][c] /= length;
+    }
+  }
+}
+
+void Frustum::setFromCamera(const Camera &camera, int width, int height) {
+  float modelview[16], projection[16];
+  camera.computeMatrices(modelview, projection, width, height);
+  set(modelview, projection);
+}
+
+bool Frustum::intersectsBox(const float min[3], const float max[3]) const {
+  for (int i = 0; i < 6; ++i) {
+    // Corner furthest along the plane normal
+    float d = planes[i][3];
+    for (int a = 0; a < 3; ++a)
+      d += planes[i][a] * (planes[i][a] >= 0.0f ? max[a] : min[a]);
+    if (d < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+float distanceToBox(const float p[3], const float min[3], const float max[3]) {
+  float sum = 0.0f;
+  for (int a = 0; a < 3; ++a) {
+    float d = std::max(std::max(min[a] - p[a], p[a] - max[a]), 0.0f);
+    sum += d * d;
+  }
+  return std::sqrt(sum);
+}
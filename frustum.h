@@ -0,0 +1,22 @@
+#pragma once
+
+class Camera;
+
+// View frustum planes for culling boxes in viewer coordinates
+class Frustum {
+public:
+  Frustum();
+
+  // Planes of projection * modelview (column-major, as in GL)
+  void set(const float modelview[16], const float projection[16]);
+  void setFromCamera(const Camera &camera, int width, int height);
+
+  // Conservative: may report boxes near the corners as visible
+  bool intersectsBox(const float min[3], const float max[3]) const;
+
+private:
+  float planes[6][4]; // ax + by + cz + d >= 0 inside, normalized
+};
+
+// Distance from a point to the closest point of a box (0 inside)
+float distanceToBox(const float p[3], const float min[3], const float max[3]);
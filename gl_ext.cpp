@@ -0,0 +1,89 @@
+#include "gl_ext.h"
+#include <cstring>
+#include <stdio.h>
+
+static GLBufferFunctions g_Buffers;
+static GLFramebufferFunctions g_Framebuffers;
+
+bool loadGLBufferFunctions(GLGetProcAddress getProc) {
+  memset(&g_Buffers, 0, sizeof(g_Buffers));
+  if (!getProc)
+    return false;
+
+  g_Buffers.genBuffers = (GLGenBuffersProc)getProc("glGenBuffers");
+  g_Buffers.deleteBuffers = (GLDeleteBuffersProc)getProc("glDeleteBuffers");
+  g_Buffers.bindBuffer = (GLBindBufferProc)getProc("glBindBuffer");
+  g_Buffers.bufferData = (GLBufferDataProc)getProc("glBufferData");
+  g_Buffers.bufferSubData = (GLBufferSubDataProc)getProc("glBufferSubData");
+  g_Buffers.fogCoordPointer =
+      (GLFogCoordPointerProc)getProc("glFogCoordPointer");
+
+  if (!hasGLBufferFunctions()) {
+    memset(&g_Buffers, 0, sizeof(g_Buffers));
+    return false;
+  }
+  return true;
+}
+
+bool hasGLBufferFunctions() {
+  return g_Buffers.genBuffers && g_Buffers.deleteBuffers &&
+         g_Buffers.bindBuffer && g_Buffers.bufferData &&
+         g_Buffers.bufferSubData;
+}
+
+const GLBufferFunctions &getGLBufferFunctions() { return g_Buffers; }
+
+// Core name, or the EXT one when the core name is missing
+static GLProc getProcOrExt(GLGetProcAddress getProc, const char *name) {
+  GLProc proc = getProc(name);
+  if (!proc) {
+    char ext[64];
+    snprintf(ext, sizeof(ext), "%sEXT", name);
+    proc = getProc(ext);
+  }
+  return proc;
+}
+
+bool loadGLFramebufferFunctions(GLGetProcAddress getProc) {
+  memset(&g_Framebuffers, 0, sizeof(g_Framebuffers));
+  if (!getProc)
+    return false;
+
+  GLFramebufferFunctions &f = g_Framebuffers;
+  f.genFramebuffers =
+      (GLGenObjectsProc)getProcOrExt(getProc, "glGenFramebuffers");
+  f.deleteFramebuffers =
+      (GLDeleteObjectsProc)getProcOrExt(getProc, "glDeleteFramebuffers");
+  f.bindFramebuffer =
+      (GLBindObjectProc)getProcOrExt(getProc, "glBindFramebuffer");
+  f.genRenderbuffers =
+      (GLGenObjectsProc)getProcOrExt(getProc, "glGenRenderbuffers");
+  f.deleteRenderbuffers =
+      (GLDeleteObjectsProc)getProcOrExt(getProc, "glDeleteRenderbuffers");
+  f.bindRenderbuffer =
+      (GLBindObjectProc)getProcOrExt(getProc, "glBindRenderbuffer");
+  f.renderbufferStorage = (GLRenderbufferStorageProc)getProcOrExt(
+      getProc, "glRenderbufferStorage");
+  f.framebufferRenderbuffer = (GLFramebufferRenderbufferProc)getProcOrExt(
+      getProc, "glFramebufferRenderbuffer");
+  f.checkFramebufferStatus = (GLCheckFramebufferStatusProc)getProcOrExt(
+      getProc, "glCheckFramebufferStatus");
+
+  if (!hasGLFramebufferFunctions()) {
+    memset(&g_Framebuffers, 0, sizeof(g_Framebuffers));
+    return false;
+  }
+  return true;
+}
+
+bool hasGLFramebufferFunctions() {
+  const GLFramebufferFunctions &f = g_Framebuffers;
+  return f.genFramebuffers && f.deleteFramebuffers && f.bindFramebuffer &&
+         f.genRenderbuffers && f.deleteRenderbuffers && f.bindRenderbuffer &&
+         f.renderbufferStorage && f.framebufferRenderbuffer &&
+         f.checkFramebufferStatus;
+}
+
+const GLFramebufferFunctions &getGLFramebufferFunctions() {
+  return g_Framebuffers;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <cstddef>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// Buffer objects are GL 1.5, past what the system GL headers and
+// libraries promise (opengl32.dll stops at 1.1), so their entry points are
+// looked up at runtime through the window toolkit.
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+// Texture edge clamping is GL 1.2
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+// Mipmaps generated on upload are GL 1.4
+#ifndef GL_GENERATE_MIPMAP
+#define GL_GENERATE_MIPMAP 0x8191
+#endif
+
+// Fog coordinates (GL 1.4) let a per-vertex value drive the fog factor
+#ifndef GL_FOG_COORDINATE_SOURCE
+#define GL_FOG_COORDINATE_SOURCE 0x8450
+#endif
+#ifndef GL_FOG_COORDINATE
+#define GL_FOG_COORDINATE 0x8451
+#endif
+#ifndef GL_FRAGMENT_DEPTH
+#define GL_FRAGMENT_DEPTH 0x8452
+#endif
+#ifndef GL_FOG_COORDINATE_ARRAY
+#define GL_FOG_COORDINATE_ARRAY 0x8457
+#endif
+
+// Framebuffer objects are GL 3.0 (EXT_framebuffer_object before that)
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_RENDERBUFFER
+#define GL_RENDERBUFFER 0x8D41
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_MAX_RENDERBUFFER_SIZE
+#define GL_MAX_RENDERBUFFER_SIZE 0x84E8
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+
+typedef void (APIENTRY *GLGenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *GLDeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *GLBindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *GLBufferDataProc)(GLenum target, ptrdiff_t size,
+                                          const void *data, GLenum usage);
+typedef void (APIENTRY *GLBufferSubDataProc)(GLenum target, ptrdiff_t offset,
+                                             ptrdiff_t size, const void *data);
+typedef void (APIENTRY *GLFogCoordPointerProc)(GLenum type, GLsizei stride,
+                                               const void *pointer);
+
+typedef void (APIENTRY *GLGenObjectsProc)(GLsizei n, GLuint *names);
+typedef void (APIENTRY *GLDeleteObjectsProc)(GLsizei n, const GLuint *names);
+typedef void (APIENTRY *GLBindObjectProc)(GLenum target, GLuint name);
+typedef void (APIENTRY *GLRenderbufferStorageProc)(GLenum target,
+                                                   GLenum format,
+                                                   GLsizei width,
+                                                   GLsizei height);
+typedef void (APIENTRY *GLFramebufferRenderbufferProc)(GLenum target,
+                                                       GLenum attachment,
+                                                       GLenum bufferTarget,
+                                                       GLuint buffer);
+typedef GLenum (APIENTRY *GLCheckFramebufferStatusProc)(GLenum target);
+
+struct GLBufferFunctions {
+  GLGenBuffersProc genBuffers;
+  GLDeleteBuffersProc deleteBuffers;
+  GLBindBufferProc bindBuffer;
+  GLBufferDataProc bufferData;
+  GLBufferSubDataProc bufferSubData;
+  GLFogCoordPointerProc fogCoordPointer; // Optional, may be null
+};
+
+// Pointer type returned by glfwGetProcAddress and similar loaders
+typedef void (*GLProc)(void);
+typedef GLProc (*GLGetProcAddress)(const char *name);
+
+// Look up the buffer object entry points in the current context; false
+// (and all pointers null) if the context doesn't provide them
+bool loadGLBufferFunctions(GLGetProcAddress getProc);
+bool hasGLBufferFunctions();
+const GLBufferFunctions &getGLBufferFunctions();
+
+struct GLFramebufferFunctions {
+  GLGenObjectsProc genFramebuffers;
+  GLDeleteObjectsProc deleteFramebuffers;
+  GLBindObjectProc bindFramebuffer;
+  GLGenObjectsProc genRenderbuffers;
+  GLDeleteObjectsProc deleteRenderbuffers;
+  GLBindObjectProc bindRenderbuffer;
+  GLRenderbufferStorageProc renderbufferStorage;
+  GLFramebufferRenderbufferProc framebufferRenderbuffer;
+  GLCheckFramebufferStatusProc checkFramebufferStatus;
+};
+
+// Same for framebuffer objects, trying the core names and then the EXT
+// extension's (whose enums are the same)
+bool loadGLFramebufferFunctions(GLGetProcAddress getProc);
+bool hasGLFramebufferFunctions();
+const GLFramebufferFunctions &getGLFramebufferFunctions();
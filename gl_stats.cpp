@@ -0,0 +1,19 @@
+#include "gl_stats.h"
+#include <cstring>
+
+bool GLStats::enabled = false;
+GLCounters GLStats::current;
+GLCounters GLStats::lastFrame;
+
+void GLStats::setEnabled(bool enable) {
+  enabled = enable;
+  memset(&current, 0, sizeof(current));
+  memset(&lastFrame, 0, sizeof(lastFrame));
+}
+
+void GLStats::endFrame() {
+  if (!enabled)
+    return;
+  lastFrame = current;
+  memset(&current, 0, sizeof(current));
+}
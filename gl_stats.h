@@ -0,0 +1,115 @@
+#pragma once
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <cstddef>
+
+// Per-frame counts of the GL work issued by the renderer
+struct GLCounters {
+  unsigned long drawCalls;         // glBegin blocks and glDraw* calls
+  unsigned long vertices;          // Vertices submitted by any path
+  unsigned long immediateVertices; // Subset submitted through glVertex*
+  unsigned long stateChanges;      // Enables, blend, line/point size, binds
+  unsigned long bufferUploads;     // Buffer and texture uploads
+  unsigned long long uploadBytes;
+};
+
+// Runtime-toggleable GL call counters. When disabled the wrappers below cost
+// a single branch on top of the GL call they forward to.
+class GLStats {
+public:
+  static void setEnabled(bool enable);
+  static bool isEnabled() { return enabled; }
+
+  // Publish this frame's counters and start counting the next frame
+  static void endFrame();
+  static const GLCounters &getLastFrame() { return lastFrame; }
+
+  static void countUpload(size_t bytes) {
+    if (enabled) {
+      ++current.bufferUploads;
+      current.uploadBytes += bytes;
+    }
+  }
+
+  static bool enabled;
+  static GLCounters current;
+
+private:
+  static GLCounters lastFrame;
+};
+
+// Instrumented replacements for the GL entry points used by the renderer
+inline void gliBegin(GLenum mode) {
+  if (GLStats::enabled)
+    ++GLStats::current.drawCalls;
+  glBegin(mode);
+}
+
+inline void gliEnd() { glEnd(); }
+
+inline void gliVertex3f(GLfloat x, GLfloat y, GLfloat z) {
+  if (GLStats::enabled) {
+    ++GLStats::current.vertices;
+    ++GLStats::current.immediateVertices;
+  }
+  glVertex3f(x, y, z);
+}
+
+inline void gliDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  if (GLStats::enabled) {
+    ++GLStats::current.drawCalls;
+    GLStats::current.vertices += count;
+  }
+  glDrawArrays(mode, first, count);
+}
+
+inline void gliDrawElements(GLenum mode, GLsizei count, GLenum type,
+                            const void *indices) {
+  if (GLStats::enabled) {
+    ++GLStats::current.drawCalls;
+    GLStats::current.vertices += count;
+  }
+  glDrawElements(mode, count, type, indices);
+}
+
+inline void gliEnable(GLenum cap) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glEnable(cap);
+}
+
+inline void gliDisable(GLenum cap) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glDisable(cap);
+}
+
+inline void gliBlendFunc(GLenum sfactor, GLenum dfactor) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glBlendFunc(sfactor, dfactor);
+}
+
+inline void gliLineWidth(GLfloat width) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glLineWidth(width);
+}
+
+inline void gliPointSize(GLfloat size) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glPointSize(size);
+}
+
+inline void gliBindTexture(GLenum target, GLuint texture) {
+  if (GLStats::enabled)
+    ++GLStats::current.stateChanges;
+  glBindTexture(target, texture);
+}
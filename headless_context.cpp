@@ -0,0 +1,139 @@
+#include "headless_context.h"
+#include "memory_stats.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <cstring>
+#include <stdio.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+HeadlessContext::HeadlessContext()
+    : display(0), context(0), surface(0), width(0), height(0) {}
+
+HeadlessContext::~HeadlessContext() { destroy(); }
+
+// Surfaceless Mesa first, then whatever the default display is
+static EGLDisplay openDisplay() {
+  const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+            "eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+      EGLDisplay dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                          EGL_DEFAULT_DISPLAY, NULL);
+      if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL))
+        return dpy;
+    }
+  }
+
+  EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL))
+    return dpy;
+  return EGL_NO_DISPLAY;
+}
+
+bool HeadlessContext::create(int w, int h) {
+  destroy();
+
+  EGLDisplay dpy = openDisplay();
+  if (dpy == EGL_NO_DISPLAY) {
+    fprintf(stderr, "Headless: no EGL display available\n");
+    return false;
+  }
+  display = dpy;
+
+  const EGLint configAttribs[] = {EGL_SURFACE_TYPE,
+                                  EGL_PBUFFER_BIT,
+                                  EGL_RENDERABLE_TYPE,
+                                  EGL_OPENGL_BIT,
+                                  EGL_RED_SIZE,
+                                  8,
+                                  EGL_GREEN_SIZE,
+                                  8,
+                                  EGL_BLUE_SIZE,
+                                  8,
+                                  EGL_DEPTH_SIZE,
+                                  24,
+                                  EGL_NONE};
+  EGLConfig config;
+  EGLint numConfigs = 0;
+  if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) ||
+      numConfigs == 0) {
+    fprintf(stderr, "Headless: no pbuffer-capable OpenGL config\n");
+    destroy();
+    return false;
+  }
+
+  const EGLint surfaceAttribs[] = {EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE};
+  EGLSurface surf = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+  if (surf == EGL_NO_SURFACE) {
+    fprintf(stderr, "Headless: cannot create %dx%d pbuffer\n", w, h);
+    destroy();
+    return false;
+  }
+  surface = surf;
+
+  // Desktop GL (not ES) so the fixed-function renderer path works unchanged
+  eglBindAPI(EGL_OPENGL_API);
+  EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+  if (ctx == EGL_NO_CONTEXT) {
+    fprintf(stderr, "Headless: cannot create OpenGL context\n");
+    destroy();
+    return false;
+  }
+  context = ctx;
+
+  if (!eglMakeCurrent(dpy, surf, surf, ctx)) {
+    fprintf(stderr, "Headless: cannot make context current\n");
+    destroy();
+    return false;
+  }
+
+  width = w;
+  height = h;
+  // Color and depth, about 4 bytes each per pixel
+  MemoryStats::add(MEM_FRAMEBUFFERS, (size_t)width * height * 8);
+  return true;
+}
+
+void HeadlessContext::destroy() {
+  if (display) {
+    eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (context)
+      eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+    if (surface)
+      eglDestroySurface((EGLDisplay)display, (EGLSurface)surface);
+    eglTerminate((EGLDisplay)display);
+  }
+  if (width > 0)
+    MemoryStats::remove(MEM_FRAMEBUFFERS, (size_t)width * height * 8);
+  display = context = surface = 0;
+  width = height = 0;
+}
+
+void *HeadlessContext::getProcAddress(const char *name) {
+  return (void *)eglGetProcAddress(name);
+}
+
+void HeadlessContext::readPixels(std::vector<unsigned char> &rgb) const {
+  rgb.resize((size_t)width * height * 3);
+  if (rgb.empty())
+    return;
+
+  // GL rows are bottom-up; flip while copying out
+  std::vector<unsigned char> row((size_t)width * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+  for (int y = 0; y < height / 2; ++y) {
+    unsigned char *a = &rgb[(size_t)y * width * 3];
+    unsigned char *b = &rgb[(size_t)(height - 1 - y) * width * 3];
+    memcpy(row.data(), a, row.size());
+    memcpy(a, b, row.size());
+    memcpy(b, row.data(), row.size());
+  }
+}
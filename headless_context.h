@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+// Offscreen OpenGL context for machines without a display or GPU.
+// Uses EGL with a pbuffer surface, preferring Mesa's surfaceless platform
+// (llvmpipe) so no X server or DRM device is needed.
+class HeadlessContext {
+public:
+  HeadlessContext();
+  ~HeadlessContext();
+
+  // Create a width x height compatibility-profile context and make it current
+  bool create(int width, int height);
+  void destroy();
+
+  bool isValid() const { return context != 0; }
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // Entry point lookup for GL functions beyond 1.1
+  static void *getProcAddress(const char *name);
+
+  // Read the color buffer as 8-bit RGB, top row first
+  void readPixels(std::vector<unsigned char> &rgb) const;
+
+private:
+  void *display;
+  void *context;
+  void *surface;
+  int width, height;
+};
@@ -0,0 +1,291 @@
+#include "heightmap_layer.h"
+#include "contours.h"
+#include "elevation_grid.h"
+#include "gl_ext.h"
+#include "gl_stats.h"
+#include "memory_stats.h"
+#include <algorithm>
+#include <cmath>
+
+HeightmapLayer::HeightmapLayer()
+    : texture(0), vertexBytes(0), indexBytes(0), textureBytes(0),
+      indexCount(0) {
+  buffers[0] = buffers[1] = 0;
+  for (int i = 0; i < 4; ++i)
+    planeS[i] = planeT[i] = 0.0f;
+}
+
+void HeightmapLayer::upload(const ElevationGrid &grid) {
+  release();
+  int width = grid.getWidth(), height = grid.getHeight();
+  float low, high;
+  if (!grid.isFinished() || !grid.getRange(low, high))
+    return;
+  const std::vector<float> &h = grid.getElevations();
+  float cell = grid.getCellSize();
+
+  // A vertex at every cell center; empty cells get one too, unused
+  std::vector<float> vertices((size_t)width * height * 3);
+  for (int row = 0; row < height; ++row) {
+    for (int x = 0; x < width; ++x) {
+      size_t i = (size_t)row * width + x;
+      vertices[i * 3] = grid.getMinX() + (x + 0.5f) * cell;
+      vertices[i * 3 + 1] = h[i] == h[i] ? h[i] : 0.0f;
+      vertices[i * 3 + 2] = grid.getMinZ() + (row + 0.5f) * cell;
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  for (int row = 0; row + 1 < height; ++row) {
+    for (int x = 0; x + 1 < width; ++x) {
+      uint32_t c[4];
+      c[0] = (uint32_t)row * width + x;
+      c[1] = c[0] + 1;
+      c[2] = c[0] + width + 1;
+      c[3] = c[0] + width;
+      uint32_t filled[4];
+      int n = 0;
+      for (int k = 0; k < 4; ++k) {
+        if (h[c[k]] == h[c[k]])
+          filled[n++] = c[k];
+      }
+      if (n == 4) {
+        uint32_t quad[6] = {c[0], c[3], c[1], c[1], c[3], c[2]};
+        indices.insert(indices.end(), quad, quad + 6);
+      } else if (n == 3) {
+        indices.insert(indices.end(), filled, filled + 3);
+      }
+    }
+  }
+
+  // Height colors (as the renderer's height mode) times a hillshade lit
+  // from the north-west (-x, -z) at 45 degrees
+  const float light[3] = {-0.5f, 0.70710678f, -0.5f};
+  float range = high > low ? high - low : 1.0f;
+  std::vector<unsigned char> rgb((size_t)width * height * 3, 0);
+  for (int row = 0; row < height; ++row) {
+    for (int x = 0; x < width; ++x) {
+      size_t i = (size_t)row * width + x;
+      if (!(h[i] == h[i]))
+        continue;
+      // Central differences, one-sided at edges and next to holes
+      float dx = 0.0f, dz = 0.0f;
+      int x0 = x > 0 && h[i - 1] == h[i - 1] ? x - 1 : x;
+      int x1 = x + 1 < width && h[i + 1] == h[i + 1] ? x + 1 : x;
+      if (x1 > x0)
+        dx = (h[i + (x1 - x)] - h[i - (x - x0)]) / ((x1 - x0) * cell);
+      size_t up = i - width, down = i + width;
+      int r0 = row > 0 && h[up] == h[up] ? row - 1 : row;
+      int r1 = row + 1 < height && h[down] == h[down] ? row + 1 : row;
+      if (r1 > r0)
+        dz = (h[(size_t)r1 * width + x] - h[(size_t)r0 * width + x]) /
+             ((r1 - r0) * cell);
+      float shade = (-dx * light[0] + light[1] - dz * light[2]) /
+                    std::sqrt(dx * dx + 1.0f + dz * dz);
+      shade = 0.35f + 0.65f * std::max(shade, 0.0f);
+
+      float t = (h[i] - low) / range;
+      float color[3] = {t, 1.0f - std::fabs(t - 0.5f) * 2.0f, 1.0f - t};
+      for (int c = 0; c < 3; ++c)
+        rgb[i * 3 + c] = (unsigned char)(color[c] * shade * 255.0f + 0.5f);
+    }
+  }
+
+  // Texel centers land on the vertices: s = (x - minX) / (width * cell)
+  planeS[0] = 1.0f / (width * cell);
+  planeS[3] = -grid.getMinX() * planeS[0];
+  planeT[2] = 1.0f / (height * cell);
+  planeT[3] = -grid.getMinZ() * planeT[2];
+
+  glGenTextures(1, &texture);
+  gliBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+               GL_UNSIGNED_BYTE, rgb.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  gliBindTexture(GL_TEXTURE_2D, 0);
+  textureBytes = rgb.size();
+  MemoryStats::add(MEM_TEXTURES, textureBytes);
+  GLStats::countUpload(textureBytes);
+
+  indexCount = indices.size();
+  if (indexCount == 0)
+    return;
+  vertexBytes = vertices.size() * sizeof(float);
+  indexBytes = indices.size() * sizeof(uint32_t);
+  GLStats::countUpload(vertexBytes + indexBytes);
+  if (!hasGLBufferFunctions()) {
+    clientVertices.swap(vertices);
+    clientIndices.swap(indices);
+    return;
+  }
+  const GLBufferFunctions &gl = getGLBufferFunctions();
+  gl.genBuffers(2, buffers);
+  gl.bindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  gl.bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)vertexBytes, vertices.data(),
+                GL_STATIC_DRAW);
+  gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, (ptrdiff_t)indexBytes,
+                indices.data(), GL_STATIC_DRAW);
+  gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  MemoryStats::add(MEM_GPU_BUFFERS, vertexBytes + indexBytes);
+}
+
+void HeightmapLayer::draw() const {
+  if (indexCount == 0)
+    return;
+
+  gliEnable(GL_DEPTH_TEST);
+  gliEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(1.0f, 1.0f);
+  gliEnable(GL_TEXTURE_2D);
+  gliBindTexture(GL_TEXTURE_2D, texture);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+  glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+  glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+  glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+  glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+  gliEnable(GL_TEXTURE_GEN_S);
+  gliEnable(GL_TEXTURE_GEN_T);
+  glEnableClientState(GL_VERTEX_ARRAY);
+
+  if (buffers[0] != 0) {
+    const GLBufferFunctions &gl = getGLBufferFunctions();
+    gl.bindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    gliDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, NULL);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  } else {
+    glVertexPointer(3, GL_FLOAT, 0, clientVertices.data());
+    gliDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT,
+                    clientIndices.data());
+  }
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  gliDisable(GL_TEXTURE_GEN_T);
+  gliDisable(GL_TEXTURE_GEN_S);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+  gliBindTexture(GL_TEXTURE_2D, 0);
+  gliDisable(GL_TEXTURE_2D);
+  gliDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+void HeightmapLayer::release() {
+  if (texture != 0) {
+    glDeleteTextures(1, &texture);
+    MemoryStats::remove(MEM_TEXTURES, textureBytes);
+    texture = 0;
+  }
+  if (buffers[0] != 0) {
+    getGLBufferFunctions().deleteBuffers(2, buffers);
+    MemoryStats::remove(MEM_GPU_BUFFERS, vertexBytes + indexBytes);
+    buffers[0] = buffers[1] = 0;
+  }
+  vertexBytes = indexBytes = textureBytes = 0;
+  indexCount = 0;
+  std::vector<float>().swap(clientVertices);
+  std::vector<uint32_t>().swap(clientIndices);
+}
+
+ContourLayer::ContourLayer()
+    : vertexBytes(0), indexBytes(0), minorCount(0), majorCount(0) {
+  buffers[0] = buffers[1] = 0;
+}
+
+void ContourLayer::upload(const ContourSet &contours, int majorEvery) {
+  release();
+  const std::vector<float> &vertices = contours.getVertices();
+  const std::vector<ContourLine> &lines = contours.getLines();
+  std::vector<uint32_t> minor, major;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    const ContourLine &line = lines[i];
+    int phase = majorEvery > 0 ? line.level % majorEvery : 1;
+    std::vector<uint32_t> &out = phase == 0 ? major : minor;
+    size_t segments = line.closed ? line.count : line.count - 1;
+    for (size_t k = 0; k < segments; ++k) {
+      out.push_back((uint32_t)(line.first + k));
+      out.push_back((uint32_t)(line.first + (k + 1) % line.count));
+    }
+  }
+  minorCount = minor.size();
+  majorCount = major.size();
+  if (minorCount + majorCount == 0)
+    return;
+  minor.insert(minor.end(), major.begin(), major.end());
+
+  vertexBytes = vertices.size() * sizeof(float);
+  indexBytes = minor.size() * sizeof(uint32_t);
+  GLStats::countUpload(vertexBytes + indexBytes);
+  if (!hasGLBufferFunctions()) {
+    clientVertices = vertices;
+    clientIndices.swap(minor);
+    return;
+  }
+  const GLBufferFunctions &gl = getGLBufferFunctions();
+  gl.genBuffers(2, buffers);
+  gl.bindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  gl.bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)vertexBytes, vertices.data(),
+                GL_STATIC_DRAW);
+  gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, (ptrdiff_t)indexBytes, minor.data(),
+                GL_STATIC_DRAW);
+  gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  MemoryStats::add(MEM_GPU_BUFFERS, vertexBytes + indexBytes);
+}
+
+void ContourLayer::draw(const float color[3]) const {
+  if (minorCount + majorCount == 0)
+    return;
+
+  gliEnable(GL_DEPTH_TEST);
+  glColor3f(color[0], color[1], color[2]);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  const char *indices = (const char *)clientIndices.data();
+  if (buffers[0] != 0) {
+    const GLBufferFunctions &gl = getGLBufferFunctions();
+    gl.bindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    indices = NULL; // Offsets into the bound index buffer
+  } else {
+    glVertexPointer(3, GL_FLOAT, 0, clientVertices.data());
+  }
+
+  if (minorCount > 0) {
+    gliLineWidth(1.0f);
+    gliDrawElements(GL_LINES, (GLsizei)minorCount, GL_UNSIGNED_INT, indices);
+  }
+  if (majorCount > 0) {
+    gliLineWidth(2.0f);
+    gliDrawElements(GL_LINES, (GLsizei)majorCount, GL_UNSIGNED_INT,
+                    indices + minorCount * sizeof(uint32_t));
+    gliLineWidth(1.0f);
+  }
+
+  if (buffers[0] != 0) {
+    const GLBufferFunctions &gl = getGLBufferFunctions();
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void ContourLayer::release() {
+  if (buffers[0] != 0) {
+    getGLBufferFunctions().deleteBuffers(2, buffers);
+    MemoryStats::remove(MEM_GPU_BUFFERS, vertexBytes + indexBytes);
+    buffers[0] = buffers[1] = 0;
+  }
+  vertexBytes = indexBytes = 0;
+  minorCount = majorCount = 0;
+  std::vector<float>().swap(clientVertices);
+  std::vector<uint32_t>().swap(clientIndices);
+}
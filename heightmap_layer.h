@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ContourSet;
+class ElevationGrid;
+
+// An ElevationGrid drawn as a surface: one vertex per cell at its
+// elevation, two triangles per square of filled cells (one where a corner
+// is empty), textured with the height colormap shaded by a north-west
+// hillshade. Texture coordinates come from glTexGen, so vertices are bare
+// positions and the cell colors live in a texture the size of the grid.
+//
+// Uses buffer objects when the context has them (call
+// loadGLBufferFunctions first) and client arrays otherwise. Needs a current
+// GL context; call release() before the context goes away.
+class HeightmapLayer {
+public:
+  HeightmapLayer();
+
+  // Build the mesh and texture of a finished grid
+  void upload(const ElevationGrid &grid);
+
+  // Draw with the modelview and projection currently set. The surface is
+  // pushed back slightly in depth so points lying on it stay visible.
+  void draw() const;
+
+  void release();
+
+  bool isEmpty() const { return indexCount == 0; }
+  size_t getTriangleCount() const { return indexCount / 3; }
+
+private:
+  unsigned texture;
+  unsigned buffers[2]; // Vertices, indices
+  size_t vertexBytes, indexBytes, textureBytes;
+  size_t indexCount;
+  float planeS[4], planeT[4]; // Object-linear texture coordinates
+  std::vector<float> clientVertices; // Without buffer objects
+  std::vector<uint32_t> clientIndices;
+};
+
+// Contour lines in GPU buffers: the line vertices once, and an index
+// buffer of segment pairs with every majorEvery-th level after the rest so
+// both runs draw in one call each, the major lines wider. Same buffer and
+// context rules as HeightmapLayer.
+class ContourLayer {
+public:
+  ContourLayer();
+
+  void upload(const ContourSet &contours, int majorEvery = 5);
+  void draw(const float color[3]) const;
+  void release();
+
+  bool isEmpty() const { return minorCount + majorCount == 0; }
+  size_t getSegmentCount() const { return (minorCount + majorCount) / 2; }
+
+private:
+  unsigned buffers[2]; // Vertices, indices
+  size_t vertexBytes, indexBytes;
+  size_t minorCount, majorCount; // Indices of each run
+  std::vector<float> clientVertices; // Without buffer objects
+  std::vector<uint32_t> clientIndices;
+};
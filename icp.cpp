@@ -0,0 +1,304 @@
+#include "icp.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+const size_t BLOCK = 256; // Sample points per task
+const int LANES = 8;      // Independent partial sums per equation
+const int MAX_NEIGHBORS = 32;
+
+// Upper triangle of [A | b]^T [A | b]: A^T A (21), A^T b (6) and b^T b
+const int SUMS = 28;
+
+struct Partial {
+  double sums[SUMS];
+  size_t pairs;
+};
+
+// Eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix, by
+// Jacobi rotations; returns the middle eigenvalue
+double getSmallestEigenvector(double a[3][3], float normal[3]) {
+  double v[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  for (int sweep = 0; sweep < 8; ++sweep) {
+    double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    if (off < 1e-30)
+      break;
+    for (int p = 0; p < 2; ++p) {
+      for (int q = p + 1; q < 3; ++q) {
+        if (a[p][q] == 0.0)
+          continue;
+        double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+        double t = (theta >= 0.0 ? 1.0 : -1.0) /
+                   (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+        double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+        for (int k = 0; k < 3; ++k) {
+          double akp = a[k][p], akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < 3; ++k) {
+          double apk = a[p][k], aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < 3; ++k) {
+          double vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  int order[3] = {0, 1, 2};
+  std::sort(order, order + 3,
+            [&](int i, int j) { return a[i][i] < a[j][j]; });
+  for (int k = 0; k < 3; ++k)
+    normal[k] = (float)v[k][order[0]];
+  return a[order[1]][order[1]];
+}
+
+// Solve the symmetric positive semi-definite system a x = b by Cholesky,
+// with a little damping so directions the pairs don't constrain (sliding
+// along a flat ground) stay put instead of making it singular
+bool solve6(double a[6][6], const double b[6], double x[6]) {
+  double trace = 0.0;
+  for (int i = 0; i < 6; ++i)
+    trace += a[i][i];
+  if (!(trace > 0.0))
+    return false;
+  for (int i = 0; i < 6; ++i)
+    a[i][i] += 1e-9 * trace;
+
+  double l[6][6] = {};
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j <= i; ++j) {
+      double s = a[i][j];
+      for (int k = 0; k < j; ++k)
+        s -= l[i][k] * l[j][k];
+      if (i == j) {
+        if (!(s > 0.0))
+          return false;
+        l[i][i] = std::sqrt(s);
+      } else {
+        l[i][j] = s / l[j][j];
+      }
+    }
+  }
+  double y[6];
+  for (int i = 0; i < 6; ++i) {
+    double s = b[i];
+    for (int k = 0; k < i; ++k)
+      s -= l[i][k] * y[k];
+    y[i] = s / l[i][i];
+  }
+  for (int i = 5; i >= 0; --i) {
+    double s = y[i];
+    for (int k = i + 1; k < 6; ++k)
+      s -= l[k][i] * x[k];
+    x[i] = s / l[i][i];
+  }
+  return true;
+}
+
+// Rotation by the vector w (axis times angle), Rodrigues' formula
+void getRotation(const double w[3], float r[9]) {
+  double angle = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+  if (angle < 1e-12) {
+    for (int i = 0; i < 9; ++i)
+      r[i] = (i % 4 == 0) ? 1.0f : 0.0f;
+    return;
+  }
+  double k[3] = {w[0] / angle, w[1] / angle, w[2] / angle};
+  double c = std::cos(angle), s = std::sin(angle), t = 1.0 - c;
+  r[0] = (float)(c + t * k[0] * k[0]);
+  r[1] = (float)(t * k[0] * k[1] - s * k[2]);
+  r[2] = (float)(t * k[0] * k[2] + s * k[1]);
+  r[3] = (float)(t * k[0] * k[1] + s * k[2]);
+  r[4] = (float)(c + t * k[1] * k[1]);
+  r[5] = (float)(t * k[1] * k[2] - s * k[0]);
+  r[6] = (float)(t * k[0] * k[2] - s * k[1]);
+  r[7] = (float)(t * k[1] * k[2] + s * k[0]);
+  r[8] = (float)(c + t * k[2] * k[2]);
+}
+
+} // namespace
+
+IcpRegistration::IcpRegistration(const IcpOptions &o)
+    : options(o), fixed(NULL) {}
+
+bool IcpRegistration::setFixed(const Point3D *points, size_t count) {
+  fixed = points;
+  return tree.build(points, count, options.threads);
+}
+
+void IcpRegistration::setMoving(const Point3D *points, size_t count) {
+  // A fixed random subset, the same every iteration so the residual
+  // falls steadily
+  std::vector<size_t> order(count);
+  for (size_t i = 0; i < count; ++i)
+    order[i] = i;
+  size_t n = std::min(count, options.samplePoints);
+  std::mt19937 random(1);
+  for (size_t i = 0; i < n; ++i)
+    std::swap(order[i], order[i + random() % (count - i)]);
+
+  sample.resize(n * 3);
+  for (size_t i = 0; i < n; ++i) {
+    const Point3D &p = points[order[i]];
+    sample[i * 3] = p.x;
+    sample[i * 3 + 1] = p.y;
+    sample[i * 3 + 2] = p.z;
+  }
+}
+
+IcpIteration IcpRegistration::iterate(Pose &pose) const {
+  IcpIteration result = {0, 0.0f, 0.0f, 0.0f, false};
+  size_t count = sample.size() / 3;
+  if (tree.isEmpty() || count == 0)
+    return result;
+
+  // Rotate about the sample's center rather than the origin, which keeps
+  // the equations well conditioned far from the origin
+  double center[3] = {0.0, 0.0, 0.0};
+  for (size_t i = 0; i < count; ++i)
+    for (int a = 0; a < 3; ++a)
+      center[a] += sample[i * 3 + a];
+  float localCenter[3], c[3];
+  for (int a = 0; a < 3; ++a)
+    localCenter[a] = (float)(center[a] / count);
+  pose.apply(localCenter, c);
+
+  size_t k = (size_t)std::min(std::max(options.normalNeighbors, 3),
+                              MAX_NEIGHBORS);
+  std::vector<Partial> partials((count + BLOCK - 1) / BLOCK);
+  parallelFor(
+      partials.size(),
+      [&](size_t block) {
+        // One row [p x n, n | -n.(p - q)] per pair, by columns
+        float rows[7][BLOCK];
+        size_t n = 0;
+        size_t end = std::min(count, (block + 1) * BLOCK);
+        for (size_t i = block * BLOCK; i < end; ++i) {
+          float p[3];
+          pose.apply(&sample[i * 3], p);
+          KdNeighbor nearest[MAX_NEIGHBORS];
+          size_t found = tree.findNearest(p, k, options.maxDistance, nearest);
+          if (found < 3)
+            continue;
+
+          // The plane through the neighbors
+          double q[3] = {0.0, 0.0, 0.0};
+          for (size_t j = 0; j < found; ++j) {
+            const Point3D &f = fixed[nearest[j].index];
+            q[0] += f.x;
+            q[1] += f.y;
+            q[2] += f.z;
+          }
+          for (int a = 0; a < 3; ++a)
+            q[a] /= found;
+          double cov[3][3] = {};
+          for (size_t j = 0; j < found; ++j) {
+            const Point3D &f = fixed[nearest[j].index];
+            double d[3] = {f.x - q[0], f.y - q[1], f.z - q[2]};
+            for (int a = 0; a < 3; ++a)
+              for (int b = 0; b < 3; ++b)
+                cov[a][b] += d[a] * d[b];
+          }
+          float normal[3];
+          if (!(getSmallestEigenvector(cov, normal) > 1e-12))
+            continue; // Neighbors on a line: no plane
+
+          float x[3] = {p[0] - c[0], p[1] - c[1], p[2] - c[2]};
+          rows[0][n] = x[1] * normal[2] - x[2] * normal[1];
+          rows[1][n] = x[2] * normal[0] - x[0] * normal[2];
+          rows[2][n] = x[0] * normal[1] - x[1] * normal[0];
+          rows[3][n] = normal[0];
+          rows[4][n] = normal[1];
+          rows[5][n] = normal[2];
+          rows[6][n] = -(float)((p[0] - q[0]) * normal[0] +
+                                (p[1] - q[1]) * normal[1] +
+                                (p[2] - q[2]) * normal[2]);
+          ++n;
+        }
+
+        // Zero rows up to a whole number of lanes, then accumulate every
+        // product in LANES separate sums; the lanes don't depend on each
+        // other, so the inner loop vectorizes without reordering floats
+        size_t padded = (n + LANES - 1) / LANES * LANES;
+        for (int a = 0; a < 7; ++a)
+          std::fill(rows[a] + n, rows[a] + padded, 0.0f);
+        float acc[SUMS][LANES] = {};
+        for (size_t i = 0; i < padded; i += LANES) {
+          int s = 0;
+          for (int a = 0; a < 7; ++a) {
+            for (int b = a; b < 7; ++b, ++s)
+              for (int l = 0; l < LANES; ++l)
+                acc[s][l] += rows[a][i + l] * rows[b][i + l];
+          }
+        }
+        Partial &partial = partials[block];
+        partial.pairs = n;
+        for (int s = 0; s < SUMS; ++s) {
+          double sum = 0.0;
+          for (int l = 0; l < LANES; ++l)
+            sum += acc[s][l];
+          partial.sums[s] = sum;
+        }
+      },
+      options.threads);
+
+  double sums[SUMS] = {};
+  for (size_t b = 0; b < partials.size(); ++b) {
+    result.pairs += partials[b].pairs;
+    for (int s = 0; s < SUMS; ++s)
+      sums[s] += partials[b].sums[s];
+  }
+  if (result.pairs < 6)
+    return result;
+
+  // Unpack: sums run over the upper triangle of the 7x7 [A | b]^T [A | b]
+  double ata[6][6], atb[6];
+  int s = 0;
+  for (int a = 0; a < 7; ++a) {
+    for (int b = a; b < 7; ++b, ++s) {
+      if (a == 6)
+        result.rms = (float)std::sqrt(sums[s] / result.pairs);
+      else if (b == 6)
+        atb[a] = sums[s];
+      else
+        ata[a][b] = ata[b][a] = sums[s];
+    }
+  }
+  double x[6];
+  if (!solve6(ata, atb, x))
+    return result;
+
+  // Rotate by w about c, then move by t
+  Pose delta;
+  float r[9];
+  getRotation(x, r);
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col)
+      delta.m[row * 4 + col] = r[row * 3 + col];
+    delta.m[row * 4 + 3] =
+        (float)(c[row] + x[3 + row] - r[row * 3] * c[0] -
+                r[row * 3 + 1] * c[1] - r[row * 3 + 2] * c[2]);
+  }
+  pose = delta * pose;
+
+  result.rotation =
+      (float)(std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]) * 180.0 /
+              M_PI);
+  result.translation =
+      (float)std::sqrt(x[3] * x[3] + x[4] * x[4] + x[5] * x[5]);
+  result.converged = result.rotation < options.minRotation &&
+                     result.translation < options.minTranslation;
+  return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "kd_tree.h"
+#include "point_cloud_renderer.h"
+#include "pose.h"
+#include <cstddef>
+#include <vector>
+
+struct IcpOptions {
+  size_t samplePoints;  // Moving points matched per iteration
+  float maxDistance;    // Pairs farther apart are left out
+  int normalNeighbors;  // Fixed points fitting the plane at each match
+  float minRotation;    // Converged once an update turns less (degrees)
+  float minTranslation; // ... and moves less than this
+  unsigned threads;     // 0 = all cores
+
+  IcpOptions()
+      : samplePoints(50000), maxDistance(1.0f), normalNeighbors(8),
+        minRotation(0.001f), minTranslation(1e-4f), threads(0) {}
+};
+
+// Result of one iteration
+struct IcpIteration {
+  size_t pairs; // Sample points matched to a plane
+  float rms;    // Point-to-plane residual before the update
+  float rotation, translation; // Size of the update (degrees, units)
+  bool converged;
+};
+
+// Point-to-plane ICP: finds the pose that places a moving cloud onto a
+// fixed one. The moving cloud is subsampled to a fixed random sample; each
+// iteration places the sample by the current pose and finds, through a
+// KD-tree over the fixed cloud, the nearest fixed points around every
+// sample point. Their plane gives the correspondence. The linearized
+// problem (small rotation and translation along the plane normals) is
+// solved with 6x6 normal equations and the update is applied to the pose.
+//
+// Sample points are matched on worker threads in blocks; each block
+// accumulates its equations in eight independent lanes that the compiler
+// turns into vector arithmetic, and the blocks are summed in order so
+// results don't depend on the thread count.
+class IcpRegistration {
+public:
+  explicit IcpRegistration(const IcpOptions &options = IcpOptions());
+
+  const IcpOptions &getOptions() const { return options; }
+  void setOptions(const IcpOptions &o) { options = o; }
+
+  // The fixed cloud, which must outlive the registration; builds the tree
+  bool setFixed(const Point3D *points, size_t count);
+  // Take a sample of the moving cloud (in its own frame)
+  void setMoving(const Point3D *points, size_t count);
+
+  bool hasFixed() const { return !tree.isEmpty(); }
+
+  // One iteration from pose (moving frame to fixed frame), updating it
+  IcpIteration iterate(Pose &pose) const;
+
+private:
+  IcpOptions options;
+  const Point3D *fixed;
+  KdTree tree;
+  std::vector<float> sample; // xyz
+};
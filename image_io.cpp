@@ -0,0 +1,91 @@
+#include "image_io.h"
+#include <cstring>
+#include <stdio.h>
+
+bool writePPM(const char *path, int width, int height,
+              const unsigned char *rgb) {
+  FILE *f = fopen(path, "wb");
+  if (!f)
+    return false;
+
+  fprintf(f, "P6\n%d %d\n255\n", width, height);
+  size_t bytes = (size_t)width * height * 3;
+  bool ok = fwrite(rgb, 1, bytes, f) == bytes;
+  fclose(f);
+  return ok;
+}
+
+bool readPPM(const char *path, int &width, int &height,
+             std::vector<unsigned char> &rgb) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+
+  int maxValue = 0;
+  if (fscanf(f, "P6 %d %d %d", &width, &height, &maxValue) != 3 ||
+      maxValue != 255 || width <= 0 || height <= 0) {
+    fclose(f);
+    return false;
+  }
+  fgetc(f); // Single whitespace before the pixel data
+
+  rgb.resize((size_t)width * height * 3);
+  bool ok = fread(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  fclose(f);
+  return ok;
+}
+
+ImageRowWriter::ImageRowWriter()
+    : file(NULL), gray(false), width(0), height(0), written(0) {}
+
+ImageRowWriter::~ImageRowWriter() {
+  if (file)
+    fclose(file);
+}
+
+bool ImageRowWriter::open(const char *path, int w, int h) {
+  close();
+  if (w <= 0 || h <= 0)
+    return false;
+  size_t length = strlen(path);
+  gray = length >= 4 && (!strcmp(path + length - 4, ".pgm") ||
+                         !strcmp(path + length - 4, ".PGM"));
+  file = fopen(path, "wb");
+  if (!file)
+    return false;
+  width = w;
+  height = h;
+  written = 0;
+  fprintf(file, "%s\n%d %d\n255\n", gray ? "P5" : "P6", width, height);
+  return true;
+}
+
+bool ImageRowWriter::writeRows(const unsigned char *rgb, int rows) {
+  if (!file || rows < 0 || written + rows > height)
+    return false;
+  written += rows;
+  size_t pixels = (size_t)width * rows;
+  if (!gray)
+    return fwrite(rgb, 3, pixels, file) == pixels;
+
+  // Rec. 601 luma, a row at a time
+  line.resize(width);
+  for (int y = 0; y < rows; ++y) {
+    const unsigned char *in = rgb + (size_t)y * width * 3;
+    for (int x = 0; x < width; ++x)
+      line[x] = (unsigned char)((in[x * 3] * 299 + in[x * 3 + 1] * 587 +
+                                 in[x * 3 + 2] * 114 + 500) /
+                                1000);
+    if (fwrite(line.data(), 1, width, file) != (size_t)width)
+      return false;
+  }
+  return true;
+}
+
+bool ImageRowWriter::close() {
+  if (!file)
+    return false;
+  bool ok = fclose(file) == 0 && written == height;
+  file = NULL;
+  return ok;
+}
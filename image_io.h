@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+// Binary PPM (P6) images with 8-bit RGB pixels, top row first
+bool writePPM(const char *path, int width, int height,
+              const unsigned char *rgb);
+bool readPPM(const char *path, int &width, int &height,
+             std::vector<unsigned char> &rgb);
+
+// Writes a binary PPM a run of rows at a time, so images far larger than
+// memory can be streamed out; a path ending in .pgm gets a PGM of the
+// luminance instead
+class ImageRowWriter {
+public:
+  ImageRowWriter();
+  ~ImageRowWriter();
+
+  bool open(const char *path, int width, int height);
+  // rows * width RGB pixels, continuing down from the last row written
+  bool writeRows(const unsigned char *rgb, int rows);
+  bool close(); // Also checks that every row was written
+
+  bool isGray() const { return gray; }
+  int getRowsWritten() const { return written; }
+
+private:
+  FILE *file;
+  bool gray;
+  int width, height, written;
+  std::vector<unsigned char> line; // Gray conversion scratch
+};
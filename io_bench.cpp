@@ -0,0 +1,261 @@
+// Compares chunk read throughput of blocking pread, mmap, a pread thread
+// pool and io_uring (buffered and O_DIRECT) on the same random offsets.
+#include "async_reader.h"
+#include "file_utils.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+  std::string path;
+  size_t fileMB;
+  size_t chunkKB;
+  size_t reads;
+  unsigned depth;
+  unsigned threads;
+};
+
+struct Result {
+  double seconds;
+  uint64_t checksum; // Of the bytes read, to check methods agree
+  bool ok;
+};
+
+// Samples every 64th byte: enough to catch misplaced reads without the
+// checksum becoming the bottleneck
+static uint64_t sumBytes(const char *data, size_t size) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; i += 64)
+    sum += (unsigned char)data[i] * (i + 1);
+  return sum;
+}
+
+static bool createTestFile(const Options &opt) {
+  FILE *f = fopen(opt.path.c_str(), "wb");
+  if (!f)
+    return false;
+  std::mt19937 rng(42);
+  std::vector<uint32_t> block(1 << 18); // 1 MB
+  bool ok = true;
+  for (size_t mb = 0; mb < opt.fileMB && ok; ++mb) {
+    for (size_t i = 0; i < block.size(); ++i)
+      block[i] = rng();
+    ok = fwrite(block.data(), 4, block.size(), f) == block.size();
+  }
+  return fclose(f) == 0 && ok;
+}
+
+// Drop the file from the page cache so every method starts cold
+static void evictCache(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  fdatasync(fd);
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  close(fd);
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static Result runPread(const Options &opt,
+                       const std::vector<uint64_t> &offsets) {
+  Result result = {0.0, 0, true};
+  int fd = open(opt.path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    result.ok = false;
+    return result;
+  }
+  size_t size = opt.chunkKB * 1024;
+  std::vector<char> buffer(size);
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    if (pread(fd, buffer.data(), size, (off_t)offsets[i]) != (ssize_t)size)
+      result.ok = false;
+    result.checksum += sumBytes(buffer.data(), size);
+  }
+  result.seconds = secondsSince(start);
+  close(fd);
+  return result;
+}
+
+static Result runMmap(const Options &opt,
+                      const std::vector<uint64_t> &offsets) {
+  Result result = {0.0, 0, true};
+  int fd = open(opt.path.c_str(), O_RDONLY);
+  size_t fileSize = (size_t)getFileSize(opt.path);
+  void *map = fd >= 0 ? mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0)
+                      : MAP_FAILED;
+  if (map == MAP_FAILED) {
+    if (fd >= 0)
+      close(fd);
+    result.ok = false;
+    return result;
+  }
+  size_t size = opt.chunkKB * 1024;
+  std::vector<char> buffer(size);
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    // Copy out as a decoder would, which faults the pages in
+    memcpy(buffer.data(), (const char *)map + offsets[i], size);
+    result.checksum += sumBytes(buffer.data(), size);
+  }
+  result.seconds = secondsSince(start);
+  munmap(map, fileSize);
+  close(fd);
+  return result;
+}
+
+static Result runAsync(const Options &opt,
+                       const std::vector<uint64_t> &offsets, bool direct,
+                       bool forceThreads, std::string &backend) {
+  Result result = {0.0, 0, true};
+  AsyncFileReader reader;
+  reader.init(opt.depth, direct, forceThreads, opt.threads);
+  int handle = reader.openFile(opt.path);
+  if (handle < 0) {
+    result.ok = false;
+    return result;
+  }
+  backend = reader.getBackendName();
+  if (direct && !reader.isDirect(handle))
+    backend += " (O_DIRECT unsupported, buffered)";
+
+  size_t size = opt.chunkKB * 1024;
+  std::vector<ReadCompletion> batch;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  // Keep the queue full: top it up as completions come back
+  size_t issued = 0;
+  while (issued < offsets.size() || reader.getOutstanding() > 0) {
+    while (issued < offsets.size() &&
+           reader.getOutstanding() < opt.depth * 2) {
+      reader.read(handle, offsets[issued], size, issued);
+      ++issued;
+    }
+    batch.clear();
+    reader.poll(batch, true);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (batch[i].error != 0)
+        result.ok = false;
+      result.checksum += sumBytes(batch[i].data(), batch[i].size);
+    }
+  }
+  result.seconds = secondsSince(start);
+  return result;
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  opt.path = "io_bench.dat";
+  opt.fileMB = 1024;
+  opt.chunkKB = 256;
+  opt.reads = 4096;
+  opt.depth = 64;
+  opt.threads = 8;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--file") && i + 1 < argc) {
+      opt.path = argv[++i];
+    } else if (!strcmp(argv[i], "--size-mb") && i + 1 < argc) {
+      opt.fileMB = (size_t)atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--chunk-kb") && i + 1 < argc) {
+      opt.chunkKB = (size_t)atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--reads") && i + 1 < argc) {
+      opt.reads = (size_t)atol(argv[++i]);
+    } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+      opt.depth = (unsigned)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      opt.threads = (unsigned)atoi(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--file PATH] [--size-mb N] [--chunk-kb N]\n"
+              "          [--reads N] [--depth N] [--threads N]\n"
+              "The file is created with random data if it doesn't exist.\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (!fileExists(opt.path)) {
+    printf("Creating %s (%zu MB)\n", opt.path.c_str(), opt.fileMB);
+    if (!createTestFile(opt)) {
+      fprintf(stderr, "Cannot write %s\n", opt.path.c_str());
+      return 1;
+    }
+  }
+  uint64_t fileSize = getFileSize(opt.path);
+  size_t size = opt.chunkKB * 1024;
+  if (size == 0 || fileSize < size) {
+    fprintf(stderr, "%s is smaller than one chunk\n", opt.path.c_str());
+    return 1;
+  }
+
+  // Chunk offsets in point files are multiples of the record size, not of
+  // the block size, so O_DIRECT has to widen them
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<uint64_t> pick(0, (fileSize - size) / 28);
+  std::vector<uint64_t> offsets(opt.reads);
+  for (size_t i = 0; i < offsets.size(); ++i)
+    offsets[i] = pick(rng) * 28;
+
+  printf("%zu reads of %zu KB, queue depth %u, %u pool threads\n",
+         opt.reads, opt.chunkKB, opt.depth, opt.threads);
+  printf("%-44s %10s %10s\n", "Method", "MB/s", "IOPS");
+
+  struct Run {
+    const char *name;
+    int kind; // 0 pread, 1 mmap, 2 async
+    bool direct, forceThreads;
+  };
+  const Run runs[] = {{"pread", 0, false, false},
+                      {"mmap", 1, false, false},
+                      {"thread pool", 2, false, true},
+                      {"thread pool O_DIRECT", 2, true, true},
+                      {"io_uring", 2, false, false},
+                      {"io_uring O_DIRECT", 2, true, false}};
+
+  uint64_t expected = 0;
+  bool failed = false;
+  for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+    evictCache(opt.path);
+    std::string name = runs[r].name;
+    Result result;
+    if (runs[r].kind == 0) {
+      result = runPread(opt, offsets);
+    } else if (runs[r].kind == 1) {
+      result = runMmap(opt, offsets);
+    } else {
+      std::string backend;
+      result =
+          runAsync(opt, offsets, runs[r].direct, runs[r].forceThreads, backend);
+      // io_uring may be unavailable; say what actually ran
+      if (!runs[r].forceThreads || runs[r].direct)
+        name += " [" + backend + "]";
+    }
+
+    if (r == 0)
+      expected = result.checksum;
+    bool ok = result.ok && result.checksum == expected;
+    failed = failed || !ok;
+    double mb = opt.reads * (double)size / (1024.0 * 1024.0);
+    printf("%-44s %10.1f %10.0f%s\n", name.c_str(), mb / result.seconds,
+           opt.reads / result.seconds, ok ? "" : "  MISMATCH");
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+#include "kd_tree.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t LEAF_SIZE = 16;
+
+struct Box {
+  float min[3], max[3];
+};
+
+} // namespace
+
+// One query's state: the best points so far, kept sorted, and the squared
+// distance from the query to the box of the node being visited, built up
+// one axis at a time (Arya and Mount's incremental distance)
+struct KdTree::Search {
+  float query[3];
+  float offset[3]; // Per axis part of the box distance
+  size_t k, found;
+  float limit2; // Farthest distance still worth visiting
+  KdNeighbor *best;
+
+  void insert(uint32_t index, float distance2) {
+    size_t i = found < k ? found++ : k - 1;
+    while (i > 0 && best[i - 1].distance2 > distance2) {
+      best[i] = best[i - 1];
+      --i;
+    }
+    best[i].index = index;
+    best[i].distance2 = distance2;
+    if (found == k)
+      limit2 = std::min(limit2, best[k - 1].distance2);
+  }
+};
+
+bool KdTree::build(const Point3D *points, size_t count, unsigned threads) {
+  clear();
+  if (count == 0 || count >= 0xffffffffu)
+    return count == 0;
+
+  entries.resize(count);
+  parallelFor(
+      (count + 65535) / 65536,
+      [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * 65536);
+        for (size_t i = block * 65536; i < end; ++i) {
+          Entry &e = entries[i];
+          e.p[0] = points[i].x;
+          e.p[1] = points[i].y;
+          e.p[2] = points[i].z;
+          e.index = (uint32_t)i;
+        }
+      },
+      threads);
+
+  Box root;
+  for (int a = 0; a < 3; ++a) {
+    root.min[a] = HUGE_VALF;
+    root.max[a] = -HUGE_VALF;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    for (int a = 0; a < 3; ++a) {
+      root.min[a] = std::min(root.min[a], entries[i].p[a]);
+      root.max[a] = std::max(root.max[a], entries[i].p[a]);
+    }
+  }
+
+  while ((count >> levels) > LEAF_SIZE)
+    ++levels;
+  nodes.resize(((size_t)1 << levels) - 1);
+
+  // Level by level: the nodes of a level cover disjoint ranges, so they
+  // are partitioned in parallel
+  std::vector<Box> boxes(1, root), nextBoxes;
+  std::vector<size_t> starts, nextStarts;
+  starts.push_back(0);
+  starts.push_back(count);
+  for (int level = 0; level < levels; ++level) {
+    size_t width = (size_t)1 << level;
+    size_t first = width - 1;
+    nextBoxes.resize(width * 2);
+    nextStarts.resize(width * 2 + 1);
+    parallelFor(
+        width,
+        [&](size_t j) {
+          const Box &box = boxes[j];
+          int axis = 0;
+          for (int a = 1; a < 3; ++a) {
+            if (box.max[a] - box.min[a] > box.max[axis] - box.min[axis])
+              axis = a;
+          }
+          size_t begin = starts[j], end = starts[j + 1];
+          size_t mid = begin + (end - begin) / 2;
+          std::nth_element(entries.begin() + begin, entries.begin() + mid,
+                           entries.begin() + end,
+                           [axis](const Entry &a, const Entry &b) {
+                             return a.p[axis] < b.p[axis];
+                           });
+          Node &node = nodes[first + j];
+          node.axis = axis;
+          node.split = entries[mid].p[axis];
+
+          nextBoxes[j * 2] = nextBoxes[j * 2 + 1] = box;
+          nextBoxes[j * 2].max[axis] = node.split;
+          nextBoxes[j * 2 + 1].min[axis] = node.split;
+          nextStarts[j * 2] = begin;
+          nextStarts[j * 2 + 1] = mid;
+        },
+        threads);
+    nextStarts[width * 2] = count;
+    boxes.swap(nextBoxes);
+    starts.swap(nextStarts);
+  }
+  return true;
+}
+
+void KdTree::clear() {
+  std::vector<Entry>().swap(entries);
+  std::vector<Node>().swap(nodes);
+  levels = 0;
+}
+
+bool KdTree::findNearest(const float query[3], float maxDistance,
+                         KdNeighbor &nearest) const {
+  return findNearest(query, 1, maxDistance, &nearest) == 1;
+}
+
+size_t KdTree::findNearest(const float query[3], size_t k, float maxDistance,
+                           KdNeighbor *nearest) const {
+  if (entries.empty() || k == 0)
+    return 0;
+  Search s;
+  for (int a = 0; a < 3; ++a) {
+    s.query[a] = query[a];
+    s.offset[a] = 0.0f;
+  }
+  s.k = k;
+  s.found = 0;
+  s.limit2 = maxDistance * maxDistance;
+  s.best = nearest;
+  search(s, 0, 0, entries.size(), 0);
+  return s.found;
+}
+
+void KdTree::search(Search &s, size_t node, size_t begin, size_t end,
+                    int level) const {
+  if (level == levels) {
+    for (size_t i = begin; i < end; ++i) {
+      const Entry &e = entries[i];
+      float dx = e.p[0] - s.query[0];
+      float dy = e.p[1] - s.query[1];
+      float dz = e.p[2] - s.query[2];
+      float d2 = dx * dx + dy * dy + dz * dz;
+      if (d2 <= s.limit2)
+        s.insert(e.index, d2);
+    }
+    return;
+  }
+
+  const Node &n = nodes[node];
+  size_t mid = begin + (end - begin) / 2;
+  float diff = s.query[n.axis] - n.split;
+  size_t left = node * 2 + 1, right = node * 2 + 2;
+  if (diff < 0.0f)
+    search(s, left, begin, mid, level + 1);
+  else
+    search(s, right, mid, end, level + 1);
+
+  // The far side's box is diff away along this axis instead of offset
+  float old = s.offset[n.axis];
+  float rd = diff * diff - old * old;
+  for (int a = 0; a < 3; ++a)
+    rd += s.offset[a] * s.offset[a];
+  if (rd <= s.limit2) {
+    s.offset[n.axis] = diff;
+    if (diff < 0.0f)
+      search(s, right, mid, end, level + 1);
+    else
+      search(s, left, begin, mid, level + 1);
+    s.offset[n.axis] = old;
+  }
+}
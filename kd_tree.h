@@ -0,0 +1,61 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A point found by KdTree, by its index in the array the tree was built from
+struct KdNeighbor {
+  uint32_t index;
+  float distance2; // Squared distance to the query
+};
+
+// Static 3D KD-tree over point positions for nearest neighbor queries.
+// Every node splits its points at the median along the longest side of its
+// box, so the tree is balanced and its shape follows from the point count
+// alone: nodes live in one array in heap order and need no child links.
+// Leaves hold up to 16 points, stored with their positions for cache-
+// friendly scans.
+//
+// The tree keeps its own copy of the positions (16 bytes a point). It is
+// built one level at a time, the nodes of each level in parallel, and is
+// read-only afterwards, so any number of threads can query it at once.
+class KdTree {
+public:
+  KdTree() : levels(0) {}
+
+  // False (and empty) if there are 2^32 points or more
+  bool build(const Point3D *points, size_t count, unsigned threads = 0);
+  void clear();
+
+  size_t size() const { return entries.size(); }
+  bool isEmpty() const { return entries.empty(); }
+
+  // The nearest point no farther than maxDistance; false if there is none
+  bool findNearest(const float query[3], float maxDistance,
+                   KdNeighbor &nearest) const;
+
+  // Up to k nearest points no farther than maxDistance, closest first;
+  // returns how many were found
+  size_t findNearest(const float query[3], size_t k, float maxDistance,
+                     KdNeighbor *nearest) const;
+
+private:
+  struct Entry {
+    float p[3];
+    uint32_t index;
+  };
+  struct Node {
+    float split;
+    int axis;
+  };
+  struct Search;
+
+  void search(Search &s, size_t node, size_t begin, size_t end,
+              int level) const;
+
+  std::vector<Entry> entries; // In tree order
+  std::vector<Node> nodes;    // Inner nodes, heap order
+  int levels;                 // Of inner nodes
+};
@@ -0,0 +1,161 @@
+// Rendering benchmark for the point cloud renderer.
+// Runs the real OpenGL path in a headless EGL context (or the software
+// rasterizer) so it works on display-less machines without GPUs.
+#ifdef LIDAR_HEADLESS_EGL
+#include "headless_context.h"
+#include <GL/gl.h>
+#endif
+#include "frame_stats.h"
+#include "gl_stats.h"
+#include "image_io.h"
+#include "point_cloud_renderer.h"
+#include "sample_scenes.h"
+#include "software_rasterizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--backend gl|software] [--scene spiral|terrain|boxes]"
+          "\n          [--points N] [--frames N] [--size W H]\n"
+          "          [--color-mode 0-3] [--point-size S] [--no-grid]\n"
+          "          [--output last_frame.ppm]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  std::string backend = "gl";
+  std::string scene = "spiral";
+  std::string output;
+  int numPoints = 1000000;
+  int frames = 100;
+  int width = 1280, height = 720;
+  int colorMode = PointCloudRenderer::COLOR_RGB;
+  float pointSize = 2.0f;
+  bool showGrid = true;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--backend") && i + 1 < argc) {
+      backend = argv[++i];
+    } else if (!strcmp(argv[i], "--scene") && i + 1 < argc) {
+      scene = argv[++i];
+    } else if (!strcmp(argv[i], "--points") && i + 1 < argc) {
+      numPoints = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--size") && i + 2 < argc) {
+      width = atoi(argv[++i]);
+      height = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--color-mode") && i + 1 < argc) {
+      colorMode = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--point-size") && i + 1 < argc) {
+      pointSize = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--no-grid")) {
+      showGrid = false;
+    } else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  // atoi gives 0 for non-numbers; stats and the orbit step need a frame
+  if (frames <= 0 || (backend != "gl" && backend != "software")) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  bool useGL = backend == "gl";
+#ifdef LIDAR_HEADLESS_EGL
+  HeadlessContext context;
+  if (useGL) {
+    if (!context.create(width, height))
+      return 1;
+    printf("GL renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    printf("GL version:  %s\n", (const char *)glGetString(GL_VERSION));
+  }
+#else
+  if (useGL) {
+    fprintf(stderr, "Built without headless GL support, use --backend "
+                    "software\n");
+    return 1;
+  }
+#endif
+
+  std::vector<Point3D> points;
+  if (!makeScene(scene.c_str(), numPoints, points)) {
+    fprintf(stderr, "Unknown scene '%s'\n", scene.c_str());
+    return 2;
+  }
+
+  PointCloudRenderer renderer;
+  renderer.setPointCloud(points);
+  renderer.setColorMode(colorMode);
+  renderer.setPointSize(pointSize);
+  renderer.setShowGrid(showGrid);
+  renderer.getCamera().setIsometricView();
+
+  SoftwareRasterizer raster(useGL ? 0 : width, useGL ? 0 : height);
+  FrameStats stats((size_t)frames);
+  GLStats::setEnabled(true);
+
+  // Orbit once around the cloud so every frame sees a different view
+  float yawStep = 360.0f / frames;
+  auto total = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; ++f) {
+    renderer.getCamera().orbit(yawStep, 0.0f);
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef LIDAR_HEADLESS_EGL
+    if (useGL) {
+      glViewport(0, 0, width, height);
+      glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      renderer.render(width, height);
+      glFinish(); // Count the work, not just the submission
+    }
+#endif
+    if (!useGL) {
+      raster.clear(0.1f, 0.1f, 0.15f);
+      raster.render(renderer);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    stats.addFrame(
+        std::chrono::duration<float, std::milli>(end - start).count());
+    GLStats::endFrame();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - total)
+                       .count();
+
+  FrameSummary summary = stats.getSummary();
+  const GLCounters &gl = GLStats::getLastFrame();
+  printf("Backend:     %s, %dx%d, %zu points, %d frames\n", backend.c_str(),
+         width, height, renderer.getPointCount(), frames);
+  printf("Frame time:  mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms\n",
+         summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+  printf("Throughput:  %.1f frames/s, %.1f Mpoints/s\n", frames / seconds,
+         renderer.getPointCount() * (double)frames / seconds / 1e6);
+  if (useGL) {
+    printf("GL / frame:  %lu draw calls, %lu vertices (%lu immediate), "
+           "%lu state changes\n",
+           gl.drawCalls, gl.vertices, gl.immediateVertices, gl.stateChanges);
+  }
+
+  if (!output.empty()) {
+#ifdef LIDAR_HEADLESS_EGL
+    if (useGL) {
+      std::vector<unsigned char> rgb;
+      context.readPixels(rgb);
+      writePPM(output.c_str(), width, height, rgb.data());
+    }
+#endif
+    if (!useGL)
+      raster.writePPM(output.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+// Converts LAS, PLY and XYZ files into a tiled octree dataset that the
+// viewer opens without loading every point.
+#include "file_utils.h"
+#include "octree_builder.h"
+#include "point_io.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] INPUT... OUTPUT_DIR\n"
+          "  INPUT is a LAS/PLY/XYZ file or a directory of them\n"
+          "  --chunk-points N   points per parallel subtree (5000000)\n"
+          "  --node-points N    leaf node capacity (20000)\n"
+          "  --grid N           subsampling cells per node axis (128)\n"
+          "  --buffer-points N  partition buffer size (4000000)\n"
+          "  --threads N        worker threads (all cores)\n"
+          "  --compress         store nodes with the point codec\n"
+          "  --precision P      position step when compressing (0.001)\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  OctreeBuildOptions opt;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--chunk-points") && i + 1 < argc) {
+      opt.maxChunkPoints = (size_t)atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--node-points") && i + 1 < argc) {
+      opt.nodeCapacity = (size_t)atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--grid") && i + 1 < argc) {
+      opt.gridResolution = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--buffer-points") && i + 1 < argc) {
+      opt.bufferPoints = (size_t)atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      opt.threads = (unsigned)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--compress")) {
+      opt.compress = true;
+    } else if (!strcmp(argv[i], "--precision") && i + 1 < argc) {
+      opt.precision = (float)atof(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() < 2 || opt.gridResolution < 2 ||
+      opt.gridResolution > 1024 || opt.maxChunkPoints == 0 ||
+      !(opt.precision > 0.0f)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  opt.outputDir = paths.back();
+  paths.pop_back();
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!isDirectory(paths[i])) {
+      opt.inputs.push_back(paths[i]);
+      continue;
+    }
+    std::vector<std::string> names = listDirectory(paths[i]);
+    for (size_t n = 0; n < names.size(); ++n) {
+      if (createPointReader(names[n]))
+        opt.inputs.push_back(joinPath(paths[i], names[n]));
+    }
+  }
+
+  uint64_t inputBytes = 0;
+  for (size_t i = 0; i < opt.inputs.size(); ++i)
+    inputBytes += getFileSize(opt.inputs[i]);
+  printf("Converting %zu files (%.1f MB) into %s\n", opt.inputs.size(),
+         inputBytes / (1024.0 * 1024.0), opt.outputDir.c_str());
+
+  OctreeBuildReport report;
+  std::string error;
+  if (!buildOctree(opt, report, error)) {
+    fprintf(stderr, "Error: %s\n", error.c_str());
+    return 1;
+  }
+
+  double mpoints = report.points / 1e6;
+  double total =
+      report.countSeconds + report.partitionSeconds + report.indexSeconds;
+  printf("Counting:     %8.2f s  %8.2f Mpoints/s\n", report.countSeconds,
+         mpoints / std::max(report.countSeconds, 1e-9));
+  printf("Partitioning: %8.2f s  %8.2f Mpoints/s\n", report.partitionSeconds,
+         mpoints / std::max(report.partitionSeconds, 1e-9));
+  printf("Indexing:     %8.2f s  %8.2f Mpoints/s\n", report.indexSeconds,
+         mpoints / std::max(report.indexSeconds, 1e-9));
+  printf("Total:        %8.2f s  %8.2f Mpoints/s, %.1f MB/s\n", total,
+         mpoints / std::max(total, 1e-9),
+         inputBytes / (1024.0 * 1024.0) / std::max(total, 1e-9));
+  printf("%llu points, %zu chunks, %zu nodes, depth %d\n",
+         (unsigned long long)report.points, report.chunks, report.nodes,
+         report.depth);
+  // Upper levels repeat points of the levels below, so uncompressed
+  // output can be larger than the input
+  printf("Node data: %.1f MB, %.2fx the input size\n",
+         report.storedBytes / (1024.0 * 1024.0),
+         report.storedBytes / (double)std::max<uint64_t>(inputBytes, 1));
+  printf("Peak RSS: %.1f MB\n", report.peakResidentBytes / (1024.0 * 1024.0));
+  return 0;
+}
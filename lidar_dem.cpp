@@ -0,0 +1,279 @@
+// Rasterizes LAS, PLY and XYZ files into an elevation model (DEM/DSM)
+// without holding the points or, past the memory budget, the whole grid:
+// the grid is made in bands of rows, each band reading only the input
+// files whose bounds reach it, and written out before the next begins.
+#include "elevation_grid.h"
+#include "file_utils.h"
+#include "memory_stats.h"
+#include "point_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+
+namespace {
+
+struct InputFile {
+  std::string path;
+  double min[3], max[3];
+  uint64_t points;
+};
+
+const size_t READ_POINTS = 2 << 20; // Points per read
+
+void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] INPUT... OUTPUT\n"
+          "  INPUT is a LAS/PLY/XYZ file or a directory of them\n"
+          "  OUTPUT is .flt (float + .hdr), .pgm (16-bit) or .raw (16-bit "
+          "+ .hdr)\n"
+          "  --cell SIZE       cell size in file units (1.0)\n"
+          "  --stat STAT       min, max, mean or idw (max)\n"
+          "  --power P         inverse distance power for idw and fill (2)\n"
+          "  --fill CELLS      fill holes from filled cells this close (0)\n"
+          "  --memory MB       grid memory per band (1024)\n"
+          "  --threads N       worker threads (all cores)\n",
+          program);
+}
+
+// Bounds from the header, or by reading the file when it has none
+bool scanInput(const std::string &path, InputFile &input,
+               std::string &error) {
+  std::unique_ptr<PointReader> reader = createPointReader(path);
+  if (!reader || !reader->open(path)) {
+    error = reader ? reader->getError() : "unknown format";
+    return false;
+  }
+  const PointFileInfo &info = reader->getInfo();
+  input.path = path;
+  input.points = info.pointCount;
+  if (info.hasBounds) {
+    std::copy(info.min, info.min + 3, input.min);
+    std::copy(info.max, info.max + 3, input.max);
+    return true;
+  }
+
+  // Origin 0: viewer x, y, z are file X, Z, -Y
+  for (int a = 0; a < 3; ++a) {
+    input.min[a] = HUGE_VAL;
+    input.max[a] = -HUGE_VAL;
+  }
+  input.points = 0;
+  std::vector<Point3D> points;
+  while (reader->read(points, READ_POINTS) > 0) {
+    for (size_t i = 0; i < points.size(); ++i) {
+      double p[3] = {points[i].x, -points[i].z, points[i].y};
+      for (int a = 0; a < 3; ++a) {
+        input.min[a] = std::min(input.min[a], p[a]);
+        input.max[a] = std::max(input.max[a], p[a]);
+      }
+    }
+    input.points += points.size();
+    points.clear();
+  }
+  if (!reader->getError().empty()) {
+    error = reader->getError();
+    return false;
+  }
+  return input.points > 0;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  float cellSize = 1.0f, power = 2.0f;
+  GridStatistic statistic = GRID_MAX;
+  int fillRadius = 0;
+  size_t memoryMB = 1024;
+  unsigned threads = 0;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--cell") && i + 1 < argc) {
+      cellSize = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--stat") && i + 1 < argc) {
+      const char *names[] = {"min", "max", "mean", "idw"};
+      const char *name = argv[++i];
+      int found = -1;
+      for (int s = 0; s < 4; ++s) {
+        if (!strcmp(name, names[s]))
+          found = s;
+      }
+      if (found < 0) {
+        usage(argv[0]);
+        return 2;
+      }
+      statistic = (GridStatistic)found;
+    } else if (!strcmp(argv[i], "--power") && i + 1 < argc) {
+      power = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--fill") && i + 1 < argc) {
+      fillRadius = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--memory") && i + 1 < argc) {
+      memoryMB = (size_t)atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  RasterFormat format;
+  if (paths.size() < 2 || !(cellSize > 0.0f) || !(power > 0.0f) ||
+      fillRadius < 0 || memoryMB == 0 ||
+      !getRasterFormat(paths.back(), format)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::string outputPath = paths.back();
+  paths.pop_back();
+
+  std::vector<std::string> inputPaths;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!isDirectory(paths[i])) {
+      inputPaths.push_back(paths[i]);
+      continue;
+    }
+    std::vector<std::string> names = listDirectory(paths[i]);
+    for (size_t n = 0; n < names.size(); ++n) {
+      if (createPointReader(names[n]))
+        inputPaths.push_back(joinPath(paths[i], names[n]));
+    }
+  }
+
+  // Extent of everything, from headers where they have bounds
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<InputFile> inputs;
+  double min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+  double max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  for (size_t i = 0; i < inputPaths.size(); ++i) {
+    InputFile input;
+    std::string error;
+    if (!scanInput(inputPaths[i], input, error)) {
+      fprintf(stderr, "Skipping %s: %s\n", inputPaths[i].c_str(),
+              error.empty() ? "no points" : error.c_str());
+      continue;
+    }
+    for (int a = 0; a < 3; ++a) {
+      min[a] = std::min(min[a], input.min[a]);
+      max[a] = std::max(max[a], input.max[a]);
+    }
+    inputs.push_back(input);
+  }
+  if (inputs.empty()) {
+    fprintf(stderr, "Error: no readable input\n");
+    return 1;
+  }
+
+  double columns = std::floor((max[0] - min[0]) / cellSize) + 1.0;
+  double rows = std::floor((max[1] - min[1]) / cellSize) + 1.0;
+  if (columns * rows >= 4294967295.0 || columns > 2147483647.0) {
+    fprintf(stderr, "Error: %.0f x %.0f cells is too large\n", columns,
+            rows);
+    return 1;
+  }
+  int width = (int)columns, height = (int)rows;
+
+  // Rows per band: heights, counts (and IDW weights) plus the copy and
+  // count table hole filling reads from, over the band and the overlap it
+  // needs
+  size_t cellBytes = statistic == GRID_IDW ? 20 : 16;
+  size_t budgetRows = (memoryMB << 20) / ((size_t)width * cellBytes);
+  int bandRows = (int)std::min<size_t>(
+      (size_t)height, std::max<size_t>(budgetRows, 2 * fillRadius + 1) -
+                          2 * fillRadius);
+  int bands = (height + bandRows - 1) / bandRows;
+  printf("%zu files, %d x %d cells of %g, %d band%s of %d rows\n",
+         inputs.size(), width, height, cellSize, bands, bands > 1 ? "s" : "",
+         bandRows);
+
+  // Row 0 is the north edge: viewer z = north edge - Y, x = X - west edge
+  double origin[3] = {min[0], max[1], 0.0};
+  double yll = max[1] - height * (double)cellSize;
+  RasterWriter writer;
+  if (!writer.open(outputPath, format, width, height, cellSize, min[0], yll,
+                   (float)min[2], (float)max[2])) {
+    fprintf(stderr, "Error: %s\n", writer.getError().c_str());
+    return 1;
+  }
+
+  ElevationGrid grid;
+  std::vector<Point3D> points;
+  uint64_t pointsRead = 0;
+  size_t filesRead = 0, filled = 0, covered = 0;
+  for (int band = 0; band < bands; ++band) {
+    int first = band * bandRows;
+    int last = std::min(first + bandRows, height);
+    int gridFirst = std::max(first - fillRadius, 0);
+    int gridLast = std::min(last + fillRadius, height);
+    if (!grid.create(0.0f, gridFirst * cellSize, width, gridLast - gridFirst,
+                     cellSize, statistic, power)) {
+      fprintf(stderr, "Error: cannot allocate the band grid\n");
+      return 1;
+    }
+
+    // File Y covered by the band's grid rows
+    double north = max[1] - gridFirst * (double)cellSize;
+    double south = max[1] - gridLast * (double)cellSize;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (inputs[i].min[1] > north || inputs[i].max[1] < south)
+        continue;
+      std::unique_ptr<PointReader> reader =
+          createPointReader(inputs[i].path);
+      if (!reader->open(inputs[i].path)) {
+        fprintf(stderr, "Error: %s: %s\n", inputs[i].path.c_str(),
+                reader->getError().c_str());
+        return 1;
+      }
+      reader->setOrigin(origin[0], origin[1], origin[2]);
+      ++filesRead;
+      while (reader->read(points, READ_POINTS) > 0) {
+        grid.addPoints(points.data(), points.size(), threads);
+        pointsRead += points.size();
+        points.clear();
+      }
+    }
+
+    grid.finish();
+    if (fillRadius > 0)
+      filled += grid.fillHoles(fillRadius, power, threads);
+    const float *rowsOut =
+        grid.getElevations().data() + (size_t)(first - gridFirst) * width;
+    for (size_t c = 0; c < (size_t)(last - first) * width; ++c)
+      covered += rowsOut[c] == rowsOut[c];
+    if (!writer.writeRows(rowsOut, last - first)) {
+      fprintf(stderr, "Error: %s\n", writer.getError().c_str());
+      return 1;
+    }
+    if (bands > 1 && (band + 1) * 100 / bands != band * 100 / bands) {
+      printf("\rBand %d / %d", band + 1, bands);
+      fflush(stdout);
+    }
+  }
+  if (bands > 1)
+    printf("\n");
+  if (!writer.close()) {
+    fprintf(stderr, "Error: %s\n", writer.getError().c_str());
+    return 1;
+  }
+
+  double seconds = secondsSince(start);
+  printf("Read %llu points (%zu file reads) in %.2f s, %.2f Mpoints/s\n",
+         (unsigned long long)pointsRead, filesRead, seconds,
+         pointsRead / 1e6 / std::max(seconds, 1e-9));
+  printf("%.1f%% of cells have an elevation (%zu filled), %g to %g\n",
+         100.0 * covered / ((double)width * height), filled, min[2], max[2]);
+  printf("Peak RSS: %.1f MB\n",
+         MemoryStats::getProcessPeakResidentBytes() / (1024.0 * 1024.0));
+  return 0;
+}
@@ -2,11 +2,39 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "birds_eye.h"
+#include "camera_path.h"
+#include "cloud_compare.h"
+#include "contours.h"
+#include "elevation_grid.h"
+#include "file_utils.h"
+#include "frame_stats.h"
+#include "gl_ext.h"
+#include "gl_stats.h"
+#include "heightmap_layer.h"
+#include "icp.h"
+#include "mcap_reader.h"
+#include "octree_dataset.h"
+#include "octree_streamer.h"
+#include "point_buffer.h"
 #include "point_cloud_renderer.h"
+#include "point_export.h"
+#include "point_io.h"
+#include "range_image.h"
+#include "sequence_player.h"
+#include "tile_index.h"
+#include "tile_streamer.h"
+#include "tiled_capture.h"
+#include "time_index.h"
+#include "voxel_map.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cmath>
+#include <memory>
 #include <random>
+#include <set>
 #include <stdio.h>
+#include <string>
 #include <vector>
 
 #ifndef M_PI
@@ -52,6 +80,240 @@ struct MouseState {
   double lastX = 0, lastY = 0;
 };
 
+// Copy points with the renderer's current color mode baked into r, g, b,
+// for point sets drawn outside the renderer
+static void colorPoints(const PointCloudRenderer &renderer,
+                        const std::vector<Point3D> &points,
+                        std::vector<Point3D> &out) {
+  out.assign(points.begin(), points.end());
+  for (size_t i = 0; i < out.size(); ++i) {
+    float rgb[3];
+    renderer.getPointColor(out[i], rgb);
+    out[i].r = rgb[0];
+    out[i].g = rgb[1];
+    out[i].b = rgb[2];
+  }
+}
+
+// Grid every point the renderer holds (file, chunks or tiles) plus timed
+// points, over the scene bounds in cells no smaller than needed to keep
+// the grid within 1024 cells a side
+static void buildElevationGrid(const PointCloudRenderer &renderer,
+                               const TimeIndex &timeIndex, float cellSize,
+                               GridStatistic statistic, int fillRadius,
+                               ElevationGrid &grid) {
+  float min[3], max[3];
+  renderer.getBounds(min, max);
+  float extent = std::max(max[0] - min[0], max[2] - min[2]);
+  cellSize = std::max(cellSize, extent / 1024.0f);
+  int width = (int)((max[0] - min[0]) / cellSize) + 1;
+  int height = (int)((max[2] - min[2]) / cellSize) + 1;
+  grid.create(min[0], min[2], width, height, cellSize, statistic);
+
+  const PointCloudRenderer::PointStorage &points = renderer.getPoints();
+  grid.addPoints(points.data(), points.size());
+  const std::map<int, PointCloudRenderer::PointStorage> &chunks =
+      renderer.getChunks();
+  for (std::map<int, PointCloudRenderer::PointStorage>::const_iterator it =
+           chunks.begin();
+       it != chunks.end(); ++it)
+    grid.addPoints(it->second.data(), it->second.size());
+  grid.addPoints(timeIndex.getPoints().data(), timeIndex.getPoints().size());
+  grid.finish();
+  grid.fillHoles(fillRadius);
+}
+
+// Export the renderer's points and streamed chunks, or for timed data the
+// points in the time window with their times, through the clip box when
+// there is one. When the renderer's cloud came from `points` (it may be a
+// distance-colored copy) those are written instead, which keep the file
+// colors. C2C distances go along as a PLY property. Returns the status line.
+static std::string exportSubset(const PointCloudRenderer &renderer,
+                                const std::vector<Point3D> &points,
+                                bool pointsShown,
+                                const TimeIndex &timeIndex,
+                                const float timeWindow[2],
+                                const double fileOrigin[3],
+                                const float *clipMin, const float *clipMax,
+                                const std::vector<float> &distances,
+                                const std::string &path) {
+  std::vector<PointSpan> spans;
+  PointExportOptions options;
+  std::copy(fileOrigin, fileOrigin + 3, options.origin);
+  if (clipMin && clipMax) {
+    options.clip = true;
+    std::copy(clipMin, clipMin + 3, options.clipMin);
+    std::copy(clipMax, clipMax + 3, options.clipMax);
+  }
+  if (!timeIndex.isEmpty()) {
+    std::vector<TimeIndex::Range> ranges;
+    timeIndex.selectWindow(timeWindow[0], timeWindow[1], ranges);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      size_t first =
+          timeIndex.getChunks()[ranges[i].chunk].first + ranges[i].first;
+      spans.push_back(PointSpan(&timeIndex.getPoints()[first],
+                                ranges[i].count,
+                                &timeIndex.getTimes()[first]));
+    }
+    options.hasTime = true;
+    options.timeBase = timeIndex.getBaseTime();
+  } else {
+    const PointCloudRenderer::PointStorage &shown = renderer.getPoints();
+    if (pointsShown) {
+      bool withDistances = distances.size() == points.size();
+      spans.push_back(PointSpan(points.data(), points.size(), NULL,
+                                withDistances ? distances.data() : NULL));
+      if (withDistances)
+        options.scalarName = "c2c_distance";
+    } else {
+      spans.push_back(PointSpan(shown.data(), shown.size()));
+    }
+    const std::map<int, PointCloudRenderer::PointStorage> &chunks =
+        renderer.getChunks();
+    for (std::map<int, PointCloudRenderer::PointStorage>::const_iterator it =
+             chunks.begin();
+         it != chunks.end(); ++it)
+      spans.push_back(PointSpan(it->second.data(), it->second.size()));
+  }
+
+  PointExportReport report;
+  std::string error;
+  if (!exportPoints(spans, options, path, report, error))
+    return error;
+  char line[160];
+  snprintf(line, sizeof(line), "Wrote %llu points to %s in %.2f s (%.0f MB/s)",
+           (unsigned long long)report.points, path.c_str(), report.seconds,
+           report.bytes / (report.seconds * (1 << 20) + 1e-9));
+  return line;
+}
+
+// Bounding box of points, zero when there are none
+static void getPointBounds(const std::vector<Point3D> &points, float min[3],
+                           float max[3]) {
+  if (points.empty()) {
+    std::fill(min, min + 3, 0.0f);
+    std::fill(max, max + 3, 0.0f);
+    return;
+  }
+  min[0] = max[0] = points[0].x;
+  min[1] = max[1] = points[0].y;
+  min[2] = max[2] = points[0].z;
+  for (size_t i = 1; i < points.size(); ++i) {
+    const Point3D &p = points[i];
+    min[0] = std::min(min[0], p.x);
+    max[0] = std::max(max[0], p.x);
+    min[1] = std::min(min[1], p.y);
+    max[1] = std::max(max[1], p.y);
+    min[2] = std::min(min[2], p.z);
+    max[2] = std::max(max[2], p.z);
+  }
+}
+
+// Contours at multiples of interval in file elevation, so levels land on
+// round numbers whatever the viewer origin; returns the build time in ms
+static double buildContours(const ElevationGrid &grid, float interval,
+                            const double fileOrigin[3], ContourSet &contours,
+                            ContourLayer &layer) {
+  double start = glfwGetTime();
+  contours.build(grid, interval, (float)-std::fmod(fileOrigin[2], interval));
+  layer.upload(contours);
+  return (glfwGetTime() - start) * 1000.0;
+}
+
+// Bin the renderer's chunks that aren't in binned yet into the raster;
+// returns how many there were
+static size_t addBirdsEyeChunks(const PointCloudRenderer &renderer,
+                                BirdsEyeRaster &raster,
+                                std::set<int> &binned) {
+  const std::map<int, PointCloudRenderer::PointStorage> &chunks =
+      renderer.getChunks();
+  size_t added = 0;
+  for (std::map<int, PointCloudRenderer::PointStorage>::const_iterator it =
+           chunks.begin();
+       it != chunks.end(); ++it) {
+    if (binned.insert(it->first).second) {
+      raster.addPoints(it->second.data(), it->second.size());
+      ++added;
+    }
+  }
+  return added;
+}
+
+// Bird's-eye raster of the renderer's points and chunks over their bounds,
+// at most 1024 cells a side and about four points a cell (of
+// expectedPoints when more will stream in) so it isn't speckled with
+// holes, uploaded in the given channel; returns the build time in ms
+static double buildBirdsEye(const PointCloudRenderer &renderer,
+                            BirdsEyeChannel channel, uint64_t expectedPoints,
+                            BirdsEyeRaster &raster, BirdsEyeLayer &layer,
+                            std::set<int> &binned) {
+  double start = glfwGetTime();
+  float min[3], max[3];
+  renderer.getBounds(min, max);
+  float sizeX = max[0] - min[0], sizeZ = max[2] - min[2];
+  float cellSize = std::max(std::max(sizeX, sizeZ) / 1024.0f, 1e-3f);
+  expectedPoints = std::max<uint64_t>(expectedPoints, renderer.getPointCount());
+  if (expectedPoints > 0)
+    cellSize = std::max(cellSize,
+                        std::sqrt(sizeX * sizeZ * 4.0f / expectedPoints));
+  raster.create(min[0], min[2], (int)(sizeX / cellSize) + 1,
+                (int)(sizeZ / cellSize) + 1, cellSize);
+  const PointCloudRenderer::PointStorage &points = renderer.getPoints();
+  raster.addPoints(points.data(), points.size());
+  binned.clear();
+  addBirdsEyeChunks(renderer, raster, binned);
+  layer.upload(raster, channel, renderer);
+  return (glfwGetTime() - start) * 1000.0;
+}
+
+// Sweep views computed from the range image
+enum SweepView { SWEEP_POINTS, SWEEP_NORMALS, SWEEP_SEGMENTS };
+
+// Rebuild a sweep through its range image, colored by normal or by ground
+// and cluster; returns the number of clusters
+static int analyzeSweep(RangeImage &image, int view,
+                        const std::vector<Point3D> &sweep,
+                        std::vector<Point3D> &out) {
+  static std::vector<float> xyz, normals;
+  static std::vector<uint8_t> ground;
+  static std::vector<int> labels;
+  RangeSegmentOptions options;
+  image.fromPoints(sweep);
+  image.computePositions(xyz);
+  int clusters = 0;
+  if (view == SWEEP_NORMALS) {
+    image.computeNormals(xyz, normals);
+  } else {
+    image.segmentGround(xyz, options, ground);
+    clusters = image.cluster(ground, options, labels);
+  }
+
+  out.clear();
+  for (size_t cell = 0; cell * 3 < xyz.size(); ++cell) {
+    if (!(xyz[cell * 3] == xyz[cell * 3]))
+      continue; // Empty cell (NaN)
+    Point3D p(xyz[cell * 3], xyz[cell * 3 + 1], xyz[cell * 3 + 2]);
+    if (view == SWEEP_NORMALS) {
+      p.r = std::fabs(normals[cell * 3]);
+      p.g = std::fabs(normals[cell * 3 + 1]);
+      p.b = std::fabs(normals[cell * 3 + 2]);
+    } else if (ground[cell]) {
+      p.r = p.b = 0.35f;
+      p.g = 0.45f;
+    } else if (labels[cell] == 0) {
+      p.r = p.g = p.b = 0.8f;
+    } else {
+      // Scatter neighboring labels across the hue circle
+      uint32_t h = (uint32_t)labels[cell] * 2654435761u;
+      p.r = 0.3f + 0.7f * ((h >> 8) & 0xff) / 255.0f;
+      p.g = 0.3f + 0.7f * ((h >> 16) & 0xff) / 255.0f;
+      p.b = 0.3f + 0.7f * ((h >> 24) & 0xff) / 255.0f;
+    }
+    out.push_back(p);
+  }
+  return clusters;
+}
+
 static void glfw_error_callback(int error, const char *description) {
   fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
@@ -62,7 +324,7 @@ static void glfw_scroll_callback(GLFWwindow *window, double xoffset,
   g_ScrollOffset += (float)yoffset;
 }
 
-int main(int, char **) {
+int main(int argc, char **argv) {
   // Setup GLFW
   glfwSetErrorCallback(glfw_error_callback);
   if (!glfwInit())
@@ -80,6 +342,8 @@ int main(int, char **) {
   glfwMakeContextCurrent(window);
   glfwSwapInterval(1); // Enable vsync
   glfwSetScrollCallback(window, glfw_scroll_callback);
+  loadGLBufferFunctions((GLGetProcAddress)glfwGetProcAddress);
+  loadGLFramebufferFunctions((GLGetProcAddress)glfwGetProcAddress);
 
   // Setup Dear ImGui
   IMGUI_CHECKVERSION();
@@ -95,10 +359,180 @@ int main(int, char **) {
   // Create point cloud renderer
   PointCloudRenderer renderer;
 
-  // Generate initial sample data
+  // Open a converted dataset, a sweep sequence (KITTI directory or MCAP
+  // recording), a directory of tiles or a point file given on the command
+  // line, otherwise start with sample data
   int numPoints = 100000;
-  auto points = generateSampleLidarData(numPoints);
-  renderer.setPointCloud(points);
+  std::vector<Point3D> points;
+  std::string sourceName;
+  double fileOrigin[3] = {0.0, 0.0, 0.0}; // Of the viewer origin
+  OctreeDataset dataset;
+  size_t overviewNodes = 0;
+  std::unique_ptr<OctreeStreamer> octreeStreamer; // Refines past the overview
+  TileIndex tileIndex;
+  std::unique_ptr<TileStreamer> tileStreamer;
+  std::unique_ptr<FrameSequence> sequence;
+  std::unique_ptr<SequencePlayer> sequencePlayer;
+  StreamingPointBuffer sequenceBuffer;
+  VoxelMap sweepMap;
+  VoxelMapBuffer mapBuffer;
+  std::vector<char> mappedSweeps; // Sweeps already merged into the map
+  bool accumulateMap = false;
+  RangeImage rangeImage;
+  rangeImage.setCalibration(RangeImageCalibration::hdl64());
+  std::vector<Point3D> analyzedSweep;
+  int sweepView = SWEEP_POINTS;
+  int sensorModel = 0;
+  int sweepClusters = 0;
+  bool sweepViewChanged = false;
+  std::vector<double> pointTimes;
+  TimeIndex timeIndex;
+  TimedPointBuffer timedBuffer;
+  if (argc > 1) {
+    std::string error;
+    sourceName = argv[1];
+    if (isDirectory(argv[1]) &&
+        !fileExists(joinPath(argv[1], OctreeDataset::getHierarchyFileName()))) {
+      std::unique_ptr<KittiSequence> kitti(new KittiSequence());
+      if (kitti->open(argv[1])) {
+        sequence.reset(kitti.release());
+        sequencePlayer.reset(new SequencePlayer(*sequence));
+      } else if (tileIndex.build(argv[1])) {
+        tileStreamer.reset(new TileStreamer(tileIndex));
+        std::copy(tileIndex.getOrigin(), tileIndex.getOrigin() + 3,
+                  fileOrigin);
+      } else {
+        error = tileIndex.getError();
+      }
+    } else if (getExtension(argv[1]) == "mcap") {
+      std::unique_ptr<McapSequence> mcap(new McapSequence());
+      if (mcap->open(argv[1])) {
+        sourceName += " (" + mcap->getTopic() + ")";
+        sequence.reset(mcap.release());
+        sequencePlayer.reset(new SequencePlayer(*sequence));
+      } else {
+        error = mcap->getError();
+      }
+    } else if (isDirectory(argv[1])) {
+      if (dataset.open(argv[1])) {
+        overviewNodes = dataset.loadOverview(5000000, points);
+        octreeStreamer.reset(new OctreeStreamer(dataset, overviewNodes));
+        std::copy(dataset.getOrigin(), dataset.getOrigin() + 3, fileOrigin);
+      } else {
+        error = dataset.getError();
+      }
+    } else {
+      loadPointFile(argv[1], points, fileOrigin, &error, &pointTimes);
+    }
+    if (!error.empty()) {
+      fprintf(stderr, "Cannot open %s: %s\n", argv[1], error.c_str());
+      sourceName.clear();
+    }
+  }
+  // Whether the renderer's point cloud is `points` (or a recolored copy),
+  // rather than a stand-in or nothing
+  bool pointsShown = false;
+  if (tileStreamer) {
+    float min[3], max[3];
+    tileIndex.getBounds(min, max);
+    renderer.setSceneBounds(min, max);
+  } else if (sequencePlayer) {
+    // Frame the first sweep; later sweeps are drawn from GPU buffers
+    // without going through the renderer's point storage
+    std::vector<Point3D> first;
+    sequence->loadFrame(0, first);
+    float min[3], max[3];
+    getPointBounds(first, min, max);
+    renderer.setSceneBounds(min, max);
+    sequencePlayer->setHeightRange(min[1], max[1]);
+    sequencePlayer->play();
+  } else if (!pointTimes.empty()) {
+    // Timed points are drawn by time window from their own buffers
+    float min[3], max[3];
+    getPointBounds(points, min, max);
+    renderer.setSceneBounds(min, max);
+    timeIndex.build(points, pointTimes);
+    pointTimes.clear();
+    pointTimes.shrink_to_fit();
+    colorPoints(renderer, timeIndex.getPoints(), points);
+    timedBuffer.upload(timeIndex, points);
+    points.clear();
+  } else {
+    if (points.empty())
+      points = generateSampleLidarData(numPoints);
+    renderer.setPointCloud(points);
+    pointsShown = true;
+  }
+
+  // A second point file is a reference layer, e.g. an earlier survey of
+  // the same site, read around the first file's origin so the two line up
+  std::vector<Point3D> referencePoints;
+  StreamingPointBuffer referenceBuffer;
+  if (argc > 2) {
+    std::string error;
+    if (loadPointFileAt(argv[2], fileOrigin, referencePoints, &error))
+      referenceBuffer.upload(referencePoints);
+    else
+      fprintf(stderr, "Cannot open %s: %s\n", argv[2], error.c_str());
+  }
+  bool showReference = true;
+  KdTree referenceTree; // Built on the first comparison
+  std::vector<float> distances; // C2C, one per point of `points`
+  DistanceSummary distanceSummary = {0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  float maxDistance = 1.0f;
+  float distanceRange = 1.0f;
+  bool colorDistances = true;
+  bool recolorCloud = false;
+  double compareMs = 0.0;
+  // Registration moves the reference layer onto the loaded cloud; its pose
+  // takes reference coordinates to the cloud's
+  Pose referencePose;
+  IcpRegistration icp; // Fixed cloud set on the first run
+  bool runningIcp = false;
+  int icpIterations = 0, maxIcpIterations = 50;
+  std::vector<float> icpHistory; // RMS per iteration
+  IcpIteration icpLast = {0, 0.0f, 0.0f, 0.0f, false};
+  std::string icpStatus;
+  int tileBudgetMillions = 20;
+  float timeWindow[2] = {0.0f, timeIndex.getDuration()};
+  float fadeSeconds = 0.0f;
+  bool liveTime = false;
+  ElevationGrid elevationGrid;
+  HeightmapLayer heightmap;
+  int gridStatistic = GRID_MAX;
+  float gridCellSize = 0.5f;
+  int gridFill = 3;
+  bool showHeightmap = true;
+  std::string rasterStatus;
+  ContourSet contours;
+  ContourLayer contourLayer;
+  float contourInterval = 1.0f;
+  bool showContours = true;
+  double contourMs = 0.0;
+  BirdsEyeRaster birdsEye;
+  BirdsEyeLayer birdsEyeLayer;
+  bool showBirdsEye = false;
+  int birdsEyeChannel = BEV_POINTS;
+  bool birdsEyeStale = true; // Rebuild from all points before showing
+  size_t birdsEyeBase = 0;    // Size of the renderer's cloud when built
+  std::set<int> birdsEyeChunks; // Chunks binned since, kept when removed
+  double birdsEyeBuiltAt = 0.0;
+  double birdsEyeMs = 0.0;
+  float birdsEyeOpacity = 0.0f;
+  float orthoPixelSize = 0.1f;
+  int captureBackend = 0; // GL, software
+  std::string captureStatus;
+  int screenshotScale = 4; // Times the window size
+  bool screenshotOverlays = true;
+  bool screenshotRequested = false;
+  CameraPath cameraPath;
+  float keySpacing = 2.0f; // Seconds between keys added from the view
+  bool playingPath = false;
+  double pathStartTime = 0.0;
+  std::string pathStatus;
+  bool clipExport = false;
+  float clipMin[3] = {0.0f, 0.0f, 0.0f}, clipMax[3] = {0.0f, 0.0f, 0.0f};
+  std::string exportStatus;
 
   // UI State
   float pointSize = renderer.getPointSize();
@@ -113,10 +547,73 @@ int main(int, char **) {
   MouseState mouse;
   ImVec4 clearColor = ImVec4(0.1f, 0.1f, 0.15f, 1.00f);
 
+  // Frame timing
+  FrameStats frameStats;
+  float hitchThreshold = frameStats.getHitchThreshold();
+  std::vector<float> frameHistogram;
+  double lastFrameTime = glfwGetTime();
+
+  // Layers drawn over the renderer's points, with its matrices loaded
+  auto drawLayers = [&]() {
+    if (showReference) {
+      float pose[16];
+      referencePose.toMatrix(pose);
+      glMatrixMode(GL_MODELVIEW);
+      glPushMatrix();
+      glMultMatrixf(pose);
+      referenceBuffer.draw(renderer.getPointSize());
+      glPopMatrix();
+    }
+    birdsEyeLayer.draw(birdsEyeOpacity);
+    if (showHeightmap)
+      heightmap.draw();
+    if (showContours) {
+      // Dark over the heightmap, light over points
+      const float dark[3] = {0.1f, 0.1f, 0.1f}, light[3] = {0.9f, 0.9f, 0.9f};
+      contourLayer.draw(showHeightmap && !heightmap.isEmpty() ? dark : light);
+    }
+    if (accumulateMap)
+      mapBuffer.draw(renderer.getPointSize());
+    if (!timeIndex.isEmpty())
+      timedBuffer.draw(timeIndex, timeWindow[0], timeWindow[1], fadeSeconds,
+                       &clearColor.x, renderer.getPointSize());
+    if (clipExport) {
+      // The export clip box's edges
+      glColor4f(1.0f, 0.8f, 0.2f, 1.0f);
+      gliBegin(GL_LINES);
+      for (int edge = 0; edge < 12; ++edge) {
+        int axis = edge / 4, a = (axis + 1) % 3, b = (axis + 2) % 3;
+        float p[3];
+        p[a] = edge & 1 ? clipMax[a] : clipMin[a];
+        p[b] = edge & 2 ? clipMax[b] : clipMin[b];
+        p[axis] = clipMin[axis];
+        gliVertex3f(p[0], p[1], p[2]);
+        p[axis] = clipMax[axis];
+        gliVertex3f(p[0], p[1], p[2]);
+      }
+      gliEnd();
+    }
+    if (sequencePlayer) {
+      // The live sweep sits at its pose in the map
+      float pose[16];
+      sequence->getFramePose(sequencePlayer->getFrame()).toMatrix(pose);
+      glMatrixMode(GL_MODELVIEW);
+      glPushMatrix();
+      glMultMatrixf(pose);
+      sequenceBuffer.draw(renderer.getPointSize());
+      glPopMatrix();
+    }
+  };
+
   // Main loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
+    // Record the previous iteration, including any phases it ran
+    double now = glfwGetTime();
+    frameStats.addFrame((float)((now - lastFrameTime) * 1000.0));
+    lastFrameTime = now;
+
     // Handle mouse input for 3D camera control (when not over ImGui)
     if (!io.WantCaptureMouse) {
       double mouseX, mouseY;
@@ -154,6 +651,49 @@ int main(int, char **) {
       g_ScrollOffset = 0;
     }
 
+    // Path preview drives the camera until the last key
+    if (playingPath) {
+      float pathTime = (float)(glfwGetTime() - pathStartTime);
+      cameraPath.evaluate(pathTime, renderer.getCamera());
+      playingPath = pathTime < cameraPath.getDuration();
+    }
+
+    // One ICP iteration a frame, so the reference visibly settles into
+    // place
+    if (runningIcp) {
+      ScopedPhase phase(frameStats, "ICP");
+      icpLast = icp.iterate(referencePose);
+      icpHistory.push_back(icpLast.rms);
+      ++icpIterations;
+      if (icpLast.pairs < 6) {
+        icpStatus = "Too few pairs; raise the ICP max distance";
+        runningIcp = false;
+      } else if (icpLast.converged) {
+        icpStatus = "Converged";
+        runningIcp = false;
+      } else if (icpIterations >= maxIcpIterations) {
+        icpStatus = "Stopped at the iteration limit";
+        runningIcp = false;
+      }
+    }
+
+    // Distance colors go into a copy, so the file's colors come back when
+    // they are turned off
+    if (recolorCloud) {
+      recolorCloud = false;
+      Camera camera = renderer.getCamera();
+      if (colorDistances && distances.size() == points.size()) {
+        std::vector<Point3D> colored(points);
+        colorByDistance(distances.data(), distances.size(), distanceRange,
+                        colored.data());
+        renderer.setPointCloud(colored);
+      } else {
+        renderer.setPointCloud(points);
+      }
+      pointsShown = true;
+      renderer.getCamera() = camera;
+    }
+
     // Start ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -170,6 +710,175 @@ int main(int, char **) {
 
       // Point cloud info
       ImGui::Text("Points: %zu", renderer.getPointCount());
+      if (!sourceName.empty())
+        ImGui::TextWrapped("Source: %s", sourceName.c_str());
+      if (dataset.isOpen()) {
+        ImGui::Text("Octree: %zu nodes, %llu points%s",
+                    dataset.getNodes().size(),
+                    (unsigned long long)dataset.getTotalPoints(),
+                    dataset.isCompressed() ? " (compressed)" : "");
+        ImGui::Text("Overview: %zu nodes", overviewNodes);
+      }
+      if (octreeStreamer) {
+        // Nodes past the overview follow the camera
+        ImGui::Text("Refined: %zu of %zu nodes wanted, %.1f M points",
+                    octreeStreamer->getLoadedCount(),
+                    octreeStreamer->getWantedCount(),
+                    octreeStreamer->getLoadedPoints() / 1e6);
+        ImGui::Text("Loading %zu, failed %zu, deepest level %d",
+                    octreeStreamer->getPendingCount(),
+                    octreeStreamer->getFailedCount(),
+                    octreeStreamer->getDeepestLevel());
+        if (ImGui::SliderInt("Point Budget", &tileBudgetMillions, 1, 200,
+                             "%d M"))
+          octreeStreamer->setPointBudget((uint64_t)tileBudgetMillions *
+                                         1000000);
+        float nodePixels = octreeStreamer->getMinNodePixels();
+        if (ImGui::SliderFloat("Min Node Size", &nodePixels, 20.0f, 1000.0f,
+                               "%.0f px"))
+          octreeStreamer->setMinNodePixels(nodePixels);
+      }
+      if (sequencePlayer) {
+        ImGui::Text("Sweeps: %zu, %.1f s%s", sequence->getFrameCount(),
+                    sequence->getDuration(),
+                    sequence->hasTimestamps() ? "" : " (assumed 10 Hz)");
+        if (ImGui::Button(sequencePlayer->isPlaying() ? "Pause" : "Play")) {
+          if (sequencePlayer->isPlaying())
+            sequencePlayer->pause();
+          else
+            sequencePlayer->play();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("<"))
+          sequencePlayer->step(-1);
+        ImGui::SameLine();
+        if (ImGui::Button(">"))
+          sequencePlayer->step(1);
+        ImGui::SameLine();
+        bool loop = sequencePlayer->getLoop();
+        if (ImGui::Checkbox("Loop", &loop))
+          sequencePlayer->setLoop(loop);
+
+        int frame = (int)sequencePlayer->getFrame();
+        if (ImGui::SliderInt("Sweep", &frame, 0,
+                             (int)sequence->getFrameCount() - 1))
+          sequencePlayer->seek((size_t)frame);
+        float speed = sequencePlayer->getSpeed();
+        if (ImGui::SliderFloat("Speed", &speed, 0.1f, 4.0f, "%.2fx"))
+          sequencePlayer->setSpeed(speed);
+        ImGui::Text("t = %.3f s, %zu points", sequencePlayer->getTime(),
+                    sequenceBuffer.getPointCount());
+        ImGui::Text("Decoded ahead %zu, decoding %zu",
+                    sequencePlayer->getReadyCount(),
+                    sequencePlayer->getPendingCount());
+        ImGui::Text("Stalls %zu, skipped %zu, %s uploads",
+                    sequencePlayer->getStallCount(),
+                    sequencePlayer->getSkippedCount(),
+                    sequenceBuffer.isUsingBuffers() ? "VBO" : "client array");
+
+        // Organized per-sweep processing: constant-time neighbors
+        const char *sweepViews[] = {"Points", "Normals", "Ground + clusters"};
+        if (ImGui::Combo("Sweep view", &sweepView, sweepViews, 3))
+          sweepViewChanged = true;
+        if (sweepView != SWEEP_POINTS) {
+          const char *sensors[] = {"HDL-64E (KITTI)", "VLP-16",
+                                   "64 rings, 45 deg", "128 rings, 45 deg"};
+          if (ImGui::Combo("Sensor", &sensorModel, sensors, 4)) {
+            RangeImageCalibration calibrations[] = {
+                RangeImageCalibration::hdl64(),
+                RangeImageCalibration::uniform(16, 15.0f, -15.0f, 1800),
+                RangeImageCalibration::uniform(64, 22.5f, -22.5f, 2048),
+                RangeImageCalibration::uniform(128, 22.5f, -22.5f, 2048)};
+            rangeImage.setCalibration(calibrations[sensorModel]);
+            sweepViewChanged = true;
+          }
+          ImGui::Text("Range image %d x %d", rangeImage.getRows(),
+                      rangeImage.getColumns());
+          if (sweepView == SWEEP_SEGMENTS) {
+            ImGui::SameLine();
+            ImGui::Text(", %d clusters", sweepClusters);
+          }
+        }
+
+        // Sweeps placed by their poses and merged voxel by voxel
+        if (ImGui::Checkbox("Accumulate map", &accumulateMap))
+          mappedSweeps.assign(sequence->getFrameCount(), 0);
+        if (!sequence->hasPoses()) {
+          ImGui::SameLine();
+          ImGui::TextDisabled("(no poses)");
+        }
+        float voxel = sweepMap.getVoxelSize() * 100.0f;
+        if (ImGui::SliderFloat("Voxel", &voxel, 2.0f, 100.0f, "%.0f cm")) {
+          sweepMap.setVoxelSize(voxel / 100.0f);
+          mapBuffer.release();
+          mappedSweeps.assign(sequence->getFrameCount(), 0);
+        }
+        if (ImGui::Button("Clear map")) {
+          sweepMap.clear();
+          mapBuffer.release();
+          mappedSweeps.assign(sequence->getFrameCount(), 0);
+        }
+        ImGui::Text("Map: %zu sweeps, %zu points in %zu blocks, %.1f MB",
+                    sweepMap.getSweepCount(), sweepMap.getPointCount(),
+                    sweepMap.getBlockCount(),
+                    sweepMap.getMemoryBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Blocks uploaded last frame: %zu",
+                    mapBuffer.getLastUploadCount());
+      }
+      if (!timeIndex.isEmpty()) {
+        // Only draw ranges change as the window moves
+        float duration = timeIndex.getDuration();
+        ImGui::Text("Times: %.2f s from %.3f, %zu chunks", duration,
+                    timeIndex.getBaseTime(), timeIndex.getChunks().size());
+        ImGui::DragFloatRange2("Window", &timeWindow[0], &timeWindow[1],
+                               std::max(duration / 500.0f, 0.001f), 0.0f,
+                               duration, "%.2f s");
+        ImGui::Checkbox("Live", &liveTime);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Fade", &fadeSeconds, 0.0f, duration, "%.2f s");
+        if (!timedBuffer.canFade())
+          ImGui::TextDisabled("Fading needs glFogCoordPointer (GL 1.4)");
+        ImGui::Text("In window: %zu points", timedBuffer.getDrawnCount());
+      }
+      if (tileStreamer) {
+        ImGui::Text("Tiles: %zu (%llu points, %zu skipped)",
+                    tileIndex.getTiles().size(),
+                    (unsigned long long)tileIndex.getTotalPoints(),
+                    tileIndex.getSkippedCount());
+        ImGui::Text("Index built in %.2f s", tileIndex.getBuildSeconds());
+        ImGui::Text("Visible %zu, loaded %zu, pending %zu",
+                    tileStreamer->getVisibleCount(),
+                    tileStreamer->getLoadedCount(),
+                    tileStreamer->getPendingCount());
+        if (ImGui::SliderInt("Point Budget", &tileBudgetMillions, 1, 200,
+                             "%d M")) {
+          tileStreamer->setPointBudget((uint64_t)tileBudgetMillions * 1000000);
+        }
+        float prefetch = tileStreamer->getPrefetchSeconds();
+        if (ImGui::SliderFloat("Prefetch Ahead", &prefetch, 0.0f, 1.0f,
+                               "%.2f s")) {
+          tileStreamer->setPrefetchSeconds(prefetch);
+        }
+        ImGui::Text("Prefetching %zu, cancelled %zu",
+                    tileStreamer->getPrefetchCount(),
+                    tileStreamer->getCancelledCount());
+
+        int cacheMB = (int)(tileStreamer->getCacheBytes() >> 20);
+        if (ImGui::SliderInt("Tile Cache", &cacheMB, 0, 4096, "%d MB"))
+          tileStreamer->setCacheBytes((size_t)cacheMB << 20);
+        ChunkCacheStats cache = tileStreamer->getCacheStats();
+        size_t lookups = cache.hits + cache.misses;
+        ImGui::Text("Cache: %zu tiles, %.1f MB (%.1fx), %.0f%% hits",
+                    cache.entries, cache.compressedBytes / (1024.0 * 1024.0),
+                    cache.compressedBytes
+                        ? (double)cache.rawBytes / cache.compressedBytes
+                        : 0.0,
+                    lookups ? 100.0 * cache.hits / lookups : 0.0);
+        ImGui::Text("Decode load %.2f cores, out of view %.1f / %.1f M",
+                    cache.decodeLoad,
+                    tileStreamer->getRetainedPoints() / 1e6,
+                    tileStreamer->getRetainPoints() / 1e6);
+      }
       ImGui::Spacing();
 
       // Point size control
@@ -180,7 +889,16 @@ int main(int, char **) {
       // Color mode selection
       if (ImGui::Combo("Color Mode", &colorMode, colorModeNames, 4)) {
         renderer.setColorMode(colorMode);
+        if (sequencePlayer)
+          sequencePlayer->setColorMode(colorMode);
+        if (!timeIndex.isEmpty()) {
+          std::vector<Point3D> colored;
+          colorPoints(renderer, timeIndex.getPoints(), colored);
+          timedBuffer.upload(timeIndex, colored);
+        }
         // Immediate mode renders colors on-the-fly, no need to regenerate
+        if (showBirdsEye && birdsEyeChannel == BEV_POINTS)
+          birdsEyeLayer.upload(birdsEye, BEV_POINTS, renderer);
       }
 
       ImGui::Spacing();
@@ -198,6 +916,10 @@ int main(int, char **) {
                                "%.1f units")) {
           renderer.setGridSpacing(gridSpacing);
         }
+        // Coarser when zoomed out or over large bounds
+        if (renderer.getEffectiveGridSpacing() != gridSpacing)
+          ImGui::Text("Drawn every %g units",
+                      renderer.getEffectiveGridSpacing());
 
         bool showAxisLabels = renderer.getShowAxisLabels();
         if (ImGui::Checkbox("Show Axis Labels", &showAxisLabels)) {
@@ -208,6 +930,337 @@ int main(int, char **) {
         ImGui::Text("X-axis: Red, Y: Green, Z: Blue");
       }
 
+      ImGui::Spacing();
+      ImGui::Separator();
+      ImGui::Text("Elevation Model");
+
+      // Gridded in parallel from the loaded points; exports keep the file
+      // coordinates
+      const char *gridStatistics[] = {"Min (terrain)", "Max (surface)",
+                                      "Mean", "Inverse distance"};
+      ImGui::Combo("Cell Value", &gridStatistic, gridStatistics, 4);
+      ImGui::SliderFloat("Cell Size", &gridCellSize, 0.05f, 10.0f, "%.2f");
+      ImGui::SliderInt("Fill Holes", &gridFill, 0, 16, "%d cells");
+      if (ImGui::Button("Build Elevation Model", ImVec2(-1, 0))) {
+        ScopedPhase phase(frameStats, "Elevation Model");
+        buildElevationGrid(renderer, timeIndex, gridCellSize,
+                           (GridStatistic)gridStatistic, gridFill,
+                           elevationGrid);
+        heightmap.upload(elevationGrid);
+        contourMs = buildContours(elevationGrid, contourInterval, fileOrigin,
+                                  contours, contourLayer);
+        rasterStatus.clear();
+      }
+      if (elevationGrid.isFinished()) {
+        ImGui::Checkbox("Show Heightmap", &showHeightmap);
+        ImGui::SameLine();
+        ImGui::Checkbox("Contours", &showContours);
+        if (ImGui::SliderFloat("Interval", &contourInterval, 0.1f, 50.0f,
+                               "%.1f")) {
+          ScopedPhase phase(frameStats, "Contours");
+          contourMs = buildContours(elevationGrid, contourInterval,
+                                    fileOrigin, contours, contourLayer);
+        }
+        if (contours.getLines().empty() && contourInterval > 0.0f)
+          ImGui::TextDisabled("No contours at this interval");
+        else
+          ImGui::Text("%zu lines, %zu segments in %.0f ms",
+                      contours.getLines().size(),
+                      contours.getSegmentCount(), contourMs);
+        ImGui::Text("%d x %d cells of %.2f, %.0f%% filled",
+                    elevationGrid.getWidth(), elevationGrid.getHeight(),
+                    elevationGrid.getCellSize(),
+                    100.0 * elevationGrid.getFilledCount() /
+                        ((double)elevationGrid.getWidth() *
+                         elevationGrid.getHeight()));
+        const char *exports[] = {"dem.flt", "dem.pgm", "dem.raw"};
+        for (int i = 0; i < 3; ++i) {
+          if (i > 0)
+            ImGui::SameLine();
+          if (ImGui::Button(exports[i])) {
+            std::string error;
+            if (writeElevationGrid(elevationGrid, exports[i], fileOrigin,
+                                   error))
+              rasterStatus = std::string("Wrote ") + exports[i];
+            else
+              rasterStatus = error;
+          }
+        }
+        if (!rasterStatus.empty())
+          ImGui::TextWrapped("%s", rasterStatus.c_str());
+      }
+
+      ImGui::Spacing();
+      ImGui::Separator();
+      ImGui::Text("Bird's-Eye Raster");
+
+      // Stands in for the points when they would be a pixel or less, from
+      // above or far away; extended as points stream in
+      if (ImGui::Checkbox("Show Raster", &showBirdsEye) && !showBirdsEye) {
+        birdsEye.clear();
+        birdsEyeLayer.release();
+        birdsEyeStale = true;
+      }
+      const char *birdsEyeChannels[] = {"Point Colors", "Max Height",
+                                        "Intensity", "Density"};
+      if (ImGui::Combo("Raster Channel", &birdsEyeChannel, birdsEyeChannels,
+                       4) &&
+          showBirdsEye)
+        birdsEyeLayer.upload(birdsEye, (BirdsEyeChannel)birdsEyeChannel,
+                             renderer);
+      if (showBirdsEye && !birdsEyeLayer.isEmpty()) {
+        ImGui::Text("%d x %d cells of %.2f, %zu occupied",
+                    birdsEye.getWidth(), birdsEye.getHeight(),
+                    birdsEye.getCellSize(), birdsEye.getOccupiedCount());
+        ImGui::Text("Built in %.0f ms, showing %.0f%%", birdsEyeMs,
+                    birdsEyeOpacity * 100.0f);
+      }
+
+      ImGui::Spacing();
+      ImGui::Separator();
+      ImGui::Text("Image Export");
+
+      // Rendered in tiles and streamed to disk a strip at a time, so the
+      // image can be far larger than the window or memory
+      const char *captureBackends[] = {"OpenGL", "Software"};
+      ImGui::Combo("Backend", &captureBackend, captureBackends, 2);
+      if (ImGui::InputFloat("Ortho Pixel", &orthoPixelSize, 0.01f, 0.1f,
+                            "%.3f units"))
+        orthoPixelSize = std::max(orthoPixelSize, 0.001f);
+      OrthoExportOptions ortho;
+      ortho.setArea(renderer);
+      ortho.pixelSize = orthoPixelSize;
+      ortho.background[0] = clearColor.x;
+      ortho.background[1] = clearColor.y;
+      ortho.background[2] = clearColor.z;
+      int orthoWidth, orthoHeight;
+      if (getOrthoImageSize(ortho, orthoWidth, orthoHeight)) {
+        ImGui::Text("%d x %d pixels, %.0f MB", orthoWidth, orthoHeight,
+                    orthoWidth * (double)orthoHeight * 3.0 / (1 << 20));
+        const char *orthoFiles[] = {"ortho.ppm", "ortho.pgm"};
+        for (int i = 0; i < 2; ++i) {
+          if (i > 0)
+            ImGui::SameLine();
+          if (ImGui::Button(orthoFiles[i])) {
+            ScopedPhase phase(frameStats, "Orthophoto");
+            CaptureStats stats;
+            std::string error;
+            GLTileTarget glTarget;
+            SoftwareTileTarget softwareTarget;
+            bool ok;
+            if (captureBackend == 0) {
+              int windowWidth, windowHeight;
+              glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+              glTarget.create(windowWidth, windowHeight);
+              ok = exportOrthophoto(renderer, glTarget, ortho, orthoFiles[i],
+                                    stats, error);
+              glTarget.release();
+            } else {
+              ok = exportOrthophoto(renderer, softwareTarget, ortho,
+                                    orthoFiles[i], stats, error);
+            }
+            char line[160];
+            snprintf(line, sizeof(line),
+                     "Wrote %s: %d x %d in %d tiles, %.1f s", orthoFiles[i],
+                     stats.width, stats.height, stats.tiles, stats.seconds);
+            captureStatus = ok ? line : error;
+          }
+        }
+      } else {
+        ImGui::TextDisabled("Nothing to export at this pixel size");
+      }
+      // The current view at a multiple of the window size, so labels and
+      // points keep their place and look
+      ImGui::SliderInt("Screenshot Scale", &screenshotScale, 2, 16, "%dx");
+      ImGui::Checkbox("Layers and Labels", &screenshotOverlays);
+      ImGui::SameLine();
+      if (ImGui::Button("screenshot.ppm"))
+        screenshotRequested = true;
+      if (!captureStatus.empty())
+        ImGui::TextWrapped("%s", captureStatus.c_str());
+
+      ImGui::Spacing();
+      ImGui::Separator();
+      ImGui::Text("Camera Path");
+
+      // Keys for fly-through videos rendered by lidar_render --path
+      ImGui::SliderFloat("Key Spacing", &keySpacing, 0.5f, 10.0f, "%.1f s");
+      if (ImGui::Button("Add Key")) {
+        float time = cameraPath.isEmpty()
+                         ? 0.0f
+                         : cameraPath.getDuration() + keySpacing;
+        cameraPath.addKey(CameraPath::makeKey(time, renderer.getCamera()));
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Clear Keys")) {
+        cameraPath.clear();
+        playingPath = false;
+      }
+      ImGui::SameLine();
+      if (ImGui::Button(playingPath ? "Stop" : "Play") &&
+          cameraPath.getKeys().size() > 1) {
+        playingPath = !playingPath;
+        pathStartTime = glfwGetTime();
+      }
+      if (ImGui::Button("Save camera_path.txt")) {
+        std::string error;
+        pathStatus = cameraPath.save("camera_path.txt", error)
+                         ? "Saved camera_path.txt"
+                         : error;
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Load")) {
+        std::string error;
+        pathStatus = cameraPath.load("camera_path.txt", error)
+                         ? "Loaded camera_path.txt"
+                         : error;
+      }
+      ImGui::Text("%zu keys, %.1f s", cameraPath.getKeys().size(),
+                  cameraPath.getDuration());
+      if (!pathStatus.empty())
+        ImGui::TextWrapped("%s", pathStatus.c_str());
+
+      ImGui::Spacing();
+      ImGui::Separator();
+      ImGui::Text("Point Export");
+
+      // The loaded points, or the time window of timed data, optionally
+      // clipped to a box; streamed to disk without copying the subset
+      if (ImGui::Checkbox("Clip to Box", &clipExport) && clipExport &&
+          !(clipMax[0] > clipMin[0]))
+        renderer.getBounds(clipMin, clipMax);
+      if (clipExport) {
+        ImGui::DragFloat3("Clip Min", clipMin, 0.1f);
+        ImGui::DragFloat3("Clip Max", clipMax, 0.1f);
+        if (ImGui::Button("Clip to Bounds"))
+          renderer.getBounds(clipMin, clipMax);
+      }
+      const char *exportFiles[] = {"export.las", "export.ply"};
+      for (int i = 0; i < 2; ++i) {
+        if (i > 0)
+          ImGui::SameLine();
+        if (ImGui::Button(exportFiles[i])) {
+          ScopedPhase phase(frameStats, "Point Export");
+          exportStatus = exportSubset(
+              renderer, points, pointsShown, timeIndex, timeWindow, fileOrigin,
+              clipExport ? clipMin : NULL, clipExport ? clipMax : NULL,
+              distances, exportFiles[i]);
+        }
+      }
+      if (!exportStatus.empty())
+        ImGui::TextWrapped("%s", exportStatus.c_str());
+
+      if (!referencePoints.empty()) {
+        ImGui::Spacing();
+        ImGui::Separator();
+        ImGui::Text("Change Detection");
+
+        // Signed distances from the loaded cloud to the reference layer,
+        // positive where the cloud lies above it
+        ImGui::Text("Reference: %zu points", referencePoints.size());
+        ImGui::Checkbox("Show Reference", &showReference);
+        if (ImGui::InputFloat("Max Distance", &maxDistance, 0.1f, 1.0f,
+                              "%.3f"))
+          maxDistance = std::max(maxDistance, 0.001f);
+        bool canCompare = !points.empty() &&
+                          renderer.getPoints().size() == points.size();
+        if (!canCompare)
+          ImGui::TextDisabled("Needs a point file or generated cloud");
+        if (ImGui::Button("Compute C2C") && canCompare) {
+          ScopedPhase phase(frameStats, "C2C");
+          double start = glfwGetTime();
+          if (referenceTree.isEmpty())
+            referenceTree.build(referencePoints.data(),
+                                referencePoints.size());
+          distances.resize(points.size());
+          computeCloudDistances(referencePoints.data(), referenceTree,
+                                points.data(), points.size(), maxDistance,
+                                distances.data(), 0, referencePose);
+          distanceSummary = summarizeDistances(distances);
+          distanceRange =
+              distanceSummary.p95 > 0.0f ? distanceSummary.p95 : maxDistance;
+          compareMs = (glfwGetTime() - start) * 1000.0;
+          recolorCloud = true;
+        }
+        if (!distances.empty()) {
+          ImGui::Text("%zu of %zu within range, %.0f ms",
+                      distanceSummary.matched, distances.size(), compareMs);
+          ImGui::Text("Mean %+.3f, RMS %.3f, |d| p95 %.3f",
+                      distanceSummary.mean, distanceSummary.rms,
+                      distanceSummary.p95);
+          if (ImGui::Checkbox("Color by Distance", &colorDistances))
+            recolorCloud = true;
+          if (ImGui::SliderFloat("Color Range", &distanceRange, 0.001f,
+                                 maxDistance, "+-%.3f"))
+            recolorCloud = colorDistances;
+        }
+
+        // Point-to-plane ICP from the reference layer to the cloud
+        ImGui::Spacing();
+        ImGui::Text("Registration");
+        IcpOptions icpOptions = icp.getOptions();
+        if (ImGui::InputFloat("ICP Max Distance", &icpOptions.maxDistance,
+                              0.1f, 1.0f, "%.3f"))
+          icpOptions.maxDistance = std::max(icpOptions.maxDistance, 0.001f);
+        int samplePoints = (int)icpOptions.samplePoints;
+        if (ImGui::SliderInt("ICP Samples", &samplePoints, 1000, 200000))
+          icpOptions.samplePoints = (size_t)samplePoints;
+        ImGui::SliderInt("ICP Iterations", &maxIcpIterations, 1, 200);
+        if (!runningIcp) // The sample is taken when a run starts
+          icp.setOptions(icpOptions);
+        if (ImGui::Button(runningIcp ? "Stop ICP" : "Run ICP") &&
+            (runningIcp || canCompare)) {
+          runningIcp = !runningIcp;
+          if (runningIcp) {
+            ScopedPhase phase(frameStats, "ICP Setup");
+            if (!icp.hasFixed())
+              icp.setFixed(points.data(), points.size());
+            icp.setMoving(referencePoints.data(), referencePoints.size());
+            icpIterations = 0;
+            icpHistory.clear();
+            icpStatus.clear();
+            // Distances to the old placement no longer hold
+            recolorCloud = !distances.empty();
+            distances.clear();
+          }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Reset Pose")) {
+          referencePose = Pose();
+          runningIcp = false;
+          icpHistory.clear();
+          recolorCloud = !distances.empty();
+          distances.clear();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save Pose")) {
+          // One KITTI pose line: the row-major 3x4 matrix
+          FILE *file = fopen("reference_pose.txt", "w");
+          if (file) {
+            for (int i = 0; i < 12; ++i)
+              fprintf(file, i < 11 ? "%.9g " : "%.9g\n", referencePose.m[i]);
+            fclose(file);
+            icpStatus = "Saved reference_pose.txt";
+          } else {
+            icpStatus = "Cannot write reference_pose.txt";
+          }
+        }
+        if (!icpHistory.empty()) {
+          ImGui::Text("Iteration %d: RMS %.4f, %zu pairs", icpIterations,
+                      icpLast.rms, icpLast.pairs);
+          ImGui::Text("Step %.4f deg, %.4f", icpLast.rotation,
+                      icpLast.translation);
+          ImGui::PlotLines("##IcpRms", icpHistory.data(),
+                           (int)icpHistory.size(), 0, NULL, 0.0f, 3.4e38f,
+                           ImVec2(220, 40));
+        }
+        ImGui::Text("Offset %.3f, %.3f, %.3f", referencePose.getTranslation(0),
+                    referencePose.getTranslation(1),
+                    referencePose.getTranslation(2));
+        if (!icpStatus.empty())
+          ImGui::TextWrapped("%s", icpStatus.c_str());
+      }
+
       ImGui::Spacing();
       ImGui::Separator();
       ImGui::Text("Point Cloud Generation");
@@ -218,12 +1271,36 @@ int main(int, char **) {
       }
 
       if (ImGui::Button("Generate New Cloud", ImVec2(-1, 0))) {
+        ScopedPhase phase(frameStats, "Generate Cloud");
+        tileStreamer.reset();
+        octreeStreamer.reset(); // Before the dataset it reads from
+        dataset = OctreeDataset();
+        overviewNodes = 0;
+        sequencePlayer.reset();
+        sequence.reset();
+        sequenceBuffer.release();
+        sweepMap.clear();
+        mapBuffer.release();
+        accumulateMap = false;
+        timeIndex.clear();
+        timedBuffer.release();
+        elevationGrid.clear();
+        heightmap.release();
+        contours.clear();
+        contourLayer.release();
+        birdsEyeStale = true; // Rebuilt below if shown
+        renderer.clearChunks();
         points = generateSampleLidarData(numPoints);
         renderer.setPointCloud(points);
+        pointsShown = true;
+        distances.clear();
+        icp = IcpRegistration(icp.getOptions()); // Its fixed cloud is gone
+        runningIcp = false;
       }
 
       if (ImGui::Button("Clear Point Cloud", ImVec2(-1, 0))) {
         renderer.clearPointCloud();
+        pointsShown = false;
       }
 
       ImGui::Spacing();
@@ -232,7 +1309,19 @@ int main(int, char **) {
 
       if (ImGui::Button("Reset Camera", ImVec2(-1, 0))) {
         renderer.getCamera().reset();
-        renderer.setPointCloud(points); // Re-center
+        if (tileStreamer) {
+          float min[3], max[3];
+          tileIndex.getBounds(min, max);
+          renderer.setSceneBounds(min, max);
+        } else if (sequencePlayer) {
+          float min[3], max[3];
+          renderer.getBounds(min, max);
+          renderer.setSceneBounds(min, max);
+        } else {
+          renderer.setPointCloud(points); // Re-center
+          pointsShown = true;
+          recolorCloud = !distances.empty() && colorDistances;
+        }
       }
 
       ImGui::Text("View Presets:");
@@ -267,6 +1356,24 @@ int main(int, char **) {
       ImGui::Checkbox("Show Demo Window", &showDemoWindow);
       ImGui::Checkbox("Show Statistics", &showStats);
 
+      if (ImGui::Button("Dump Memory Report", ImVec2(-1, 0))) {
+        MemoryStats::dump(stdout);
+        MemoryStats::dumpToFile("memory_report.txt");
+      }
+
+      if (ImGui::SliderFloat("Hitch Threshold", &hitchThreshold, 5.0f,
+                             200.0f, "%.0f ms")) {
+        frameStats.setHitchThreshold(hitchThreshold);
+      }
+      if (ImGui::Button("Export Frame Times CSV", ImVec2(-1, 0))) {
+        frameStats.exportCSV("frame_times.csv");
+      }
+
+      bool countGL = GLStats::isEnabled();
+      if (ImGui::Checkbox("Count GL Calls", &countGL)) {
+        GLStats::setEnabled(countGL);
+      }
+
       ImGui::ColorEdit3("Background", (float *)&clearColor);
 
       ImGui::End();
@@ -287,6 +1394,63 @@ int main(int, char **) {
       ImGui::Text("FPS: %.1f", io.Framerate);
       ImGui::Text("Frame Time: %.3f ms", 1000.0f / io.Framerate);
       ImGui::Text("Points: %zu", renderer.getPointCount());
+
+      FrameSummary summary = frameStats.getSummary();
+      ImGui::Text("p50 %.1f  p95 %.1f  p99 %.1f  max %.1f ms", summary.p50,
+                  summary.p95, summary.p99, summary.max);
+      ImGui::PlotLines("##FrameTimes", frameStats.getHistory(),
+                       frameStats.getHistoryCount(),
+                       frameStats.getHistoryOffset(), NULL, 0.0f,
+                       std::max(summary.p99 * 1.5f, 20.0f), ImVec2(220, 40));
+      float histogramMax = std::max(summary.max, 33.3f);
+      frameStats.getHistogram(frameHistogram, 32, histogramMax);
+      ImGui::PlotHistogram("##FrameHistogram", frameHistogram.data(),
+                           (int)frameHistogram.size(), 0, NULL, 0.0f,
+                           3.4e38f, ImVec2(220, 40));
+      ImGui::Text("0 - %.0f ms", histogramMax);
+
+      const std::deque<FrameHitch> &hitches = frameStats.getHitches();
+      ImGui::Text("Hitches (> %.0f ms): %zu", frameStats.getHitchThreshold(),
+                  hitches.size());
+      for (size_t i = hitches.size() > 3 ? hitches.size() - 3 : 0;
+           i < hitches.size(); ++i) {
+        ImGui::Text("  #%llu %.1f ms %s", hitches[i].frameIndex,
+                    hitches[i].frameMs, hitches[i].phases.c_str());
+      }
+
+      if (GLStats::isEnabled()) {
+        const GLCounters &gl = GLStats::getLastFrame();
+        ImGui::Spacing();
+        ImGui::Text("GL Calls");
+        ImGui::Separator();
+        ImGui::Text("Draw Calls: %lu", gl.drawCalls);
+        ImGui::Text("Vertices: %lu (%lu immediate)", gl.vertices,
+                    gl.immediateVertices);
+        ImGui::Text("State Changes: %lu", gl.stateChanges);
+        ImGui::Text("Uploads: %lu (%.2f MB)", gl.bufferUploads,
+                    gl.uploadBytes / (1024.0 * 1024.0));
+      }
+
+      ImGui::Spacing();
+      ImGui::Text("Memory");
+      ImGui::Separator();
+      const float MB = 1024.0f * 1024.0f;
+      for (int i = 0; i < MEM_CATEGORY_COUNT; ++i) {
+        MemoryCategory c = (MemoryCategory)i;
+        ImGui::Text("%s: %.2f MB", MemoryStats::getCategoryName(c),
+                    MemoryStats::getBytes(c) / MB);
+      }
+      ImGui::Text("Tracked: %.1f MB CPU, %.1f MB GPU",
+                  MemoryStats::getTotalBytes(false) / MB,
+                  MemoryStats::getTotalBytes(true) / MB);
+      ImGui::Text("Process RSS: %.1f MB",
+                  MemoryStats::getProcessResidentBytes() / MB);
+      if (renderer.getPointCount() > 0) {
+        float count = (float)renderer.getPointCount();
+        ImGui::Text("Bytes/Point: %.1f resident, %.1f logical",
+                    renderer.getResidentBytes() / count,
+                    renderer.getLogicalBytes() / count);
+      }
       ImGui::End();
     }
 
@@ -298,6 +1462,47 @@ int main(int, char **) {
     int display_w, display_h;
     glfwGetFramebufferSize(window, &display_w, &display_h);
 
+    // Queue loads for the new view and add tiles that finished loading
+    if (tileStreamer)
+      tileStreamer->update(renderer, display_w, display_h);
+    if (octreeStreamer)
+      octreeStreamer->update(renderer, display_w, display_h);
+
+    // Advance playback; a new sweep replaces the GPU buffer not in use
+    bool newSweep = sequencePlayer && sequencePlayer->update(io.DeltaTime);
+    if (newSweep || (sequencePlayer && sweepViewChanged)) {
+      if (sweepView != SWEEP_POINTS) {
+        ScopedPhase phase(frameStats, "Range Image");
+        sweepClusters = analyzeSweep(rangeImage, sweepView,
+                                     sequencePlayer->getFramePoints(),
+                                     analyzedSweep);
+        sequenceBuffer.upload(analyzedSweep);
+      } else {
+        sequenceBuffer.upload(sequencePlayer->getFramePoints());
+      }
+      sweepViewChanged = false;
+    }
+    if (newSweep) {
+      size_t frame = sequencePlayer->getFrame();
+      if (accumulateMap && !mappedSweeps[frame]) {
+        ScopedPhase phase(frameStats, "Map Merge");
+        mappedSweeps[frame] = 1;
+        sweepMap.integrate(sequencePlayer->getFramePoints(),
+                           sequence->getFramePose(frame));
+      }
+    }
+    if (accumulateMap)
+      mapBuffer.update(sweepMap);
+
+    // Live mode slides the time window along at real time, then wraps
+    if (liveTime && !timeIndex.isEmpty()) {
+      float width = timeWindow[1] - timeWindow[0];
+      timeWindow[1] += io.DeltaTime;
+      if (timeWindow[1] > timeIndex.getDuration())
+        timeWindow[1] = width;
+      timeWindow[0] = timeWindow[1] - width;
+    }
+
     // Render axis labels BEFORE ImGui::Render() (during frame building)
     renderer.renderAxisLabels(display_w, display_h);
 
@@ -309,16 +1514,113 @@ int main(int, char **) {
     glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // The raster replaces the points once it covers them. It is built
+    // once from everything loaded; streamed chunks are then binned into it
+    // as they arrive, at most every two seconds, instead of rebuilding.
+    birdsEyeOpacity = 0.0f;
+    if (showBirdsEye) {
+      if (birdsEyeStale || renderer.getPoints().size() != birdsEyeBase) {
+        ScopedPhase phase(frameStats, "Bird's-Eye");
+        birdsEyeMs = buildBirdsEye(
+            renderer, (BirdsEyeChannel)birdsEyeChannel,
+            tileStreamer ? tileIndex.getTotalPoints() : 0, birdsEye,
+            birdsEyeLayer, birdsEyeChunks);
+        birdsEyeStale = false;
+        birdsEyeBase = renderer.getPoints().size();
+        birdsEyeBuiltAt = glfwGetTime();
+      } else if (glfwGetTime() - birdsEyeBuiltAt > 2.0) {
+        ScopedPhase phase(frameStats, "Bird's-Eye");
+        double start = glfwGetTime();
+        if (addBirdsEyeChunks(renderer, birdsEye, birdsEyeChunks) > 0) {
+          birdsEyeLayer.upload(birdsEye, (BirdsEyeChannel)birdsEyeChannel,
+                               renderer);
+          birdsEyeMs = (glfwGetTime() - start) * 1000.0;
+        }
+        birdsEyeBuiltAt = glfwGetTime();
+      }
+      birdsEyeOpacity =
+          birdsEyeLayer.getOpacity(renderer.getCamera(), display_h);
+    }
+    renderer.setShowPoints(birdsEyeOpacity < 1.0f);
+
     // Render point cloud
     renderer.render(display_w, display_h);
+    drawLayers();
+
+    // Screenshots are taken here, once this frame's axis labels are in the
+    // draw data
+    if (screenshotRequested) {
+      screenshotRequested = false;
+      ScopedPhase phase(frameStats, "Screenshot");
+      ScreenshotOptions shot;
+      shot.width = display_w * screenshotScale;
+      shot.height = display_h * screenshotScale;
+      shot.pointScale = (float)screenshotScale;
+      shot.background[0] = clearColor.x;
+      shot.background[1] = clearColor.y;
+      shot.background[2] = clearColor.z;
+      if (screenshotOverlays) {
+        // The other layers, then the labels: ImGui's background list (the
+        // first in the draw data) shifted and scaled onto each tile
+        shot.overlay = [&](const TileRect &tile) {
+          drawLayers();
+          ImDrawData *drawData = ImGui::GetDrawData();
+          if (!drawData || drawData->CmdListsCount == 0 ||
+              drawData->CmdLists[0] != ImGui::GetBackgroundDrawList())
+            return;
+          float scale = shot.width / io.DisplaySize.x;
+          ImDrawData labels = *drawData;
+          labels.CmdListsCount = 1;
+          labels.DisplayPos = ImVec2(drawData->DisplayPos.x + tile.x / scale,
+                                     drawData->DisplayPos.y + tile.y / scale);
+          labels.DisplaySize = ImVec2(tile.width / scale, tile.height / scale);
+          labels.FramebufferScale = ImVec2(scale, scale);
+          ImGui_ImplOpenGL3_RenderDrawData(&labels);
+        };
+      }
+      CaptureStats stats;
+      std::string error;
+      bool ok;
+      if (captureBackend == 0) {
+        GLTileTarget target;
+        target.create(display_w, display_h);
+        ok = captureScreenshot(renderer, target, shot, "screenshot.ppm",
+                               stats, error);
+        target.release();
+      } else {
+        SoftwareTileTarget target;
+        ok = captureScreenshot(renderer, target, shot, "screenshot.ppm",
+                               stats, error);
+      }
+      char line[160];
+      snprintf(line, sizeof(line),
+               "Wrote screenshot.ppm: %d x %d in %d tiles, %.1f s",
+               stats.width, stats.height, stats.tiles, stats.seconds);
+      captureStatus = ok ? line : error;
+
+      // Tiles drew over the window's buffer
+      glViewport(0, 0, display_w, display_h);
+      glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      renderer.render(display_w, display_h);
+      drawLayers();
+    }
 
     // Render ImGui on top
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    GLStats::endFrame();
 
     glfwSwapBuffers(window);
   }
 
   // Cleanup
+  sequenceBuffer.release();
+  mapBuffer.release();
+  timedBuffer.release();
+  heightmap.release();
+  contourLayer.release();
+  birdsEyeLayer.release();
+  referenceBuffer.release();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
@@ -0,0 +1,329 @@
+// Renders fly-through videos along a keyframed camera path without a
+// display: frames go to numbered PPM/PGM images or, as raw RGB, down a pipe
+// to an encoder such as ffmpeg. The software backend renders several frames
+// at once, one rasterizer per thread; the GL backend uses a headless EGL
+// context.
+#ifdef LIDAR_HEADLESS_EGL
+#include "headless_context.h"
+#include <GL/gl.h>
+#endif
+#include "camera_path.h"
+#include "frame_stats.h"
+#include "image_io.h"
+#include "parallel.h"
+#include "point_cloud_renderer.h"
+#include "point_io.h"
+#include "sample_scenes.h"
+#include "software_rasterizer.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdio.h>
+#include <string>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+const float BACKGROUND[3] = {0.1f, 0.1f, 0.15f};
+
+void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] [INPUT]\n"
+          "  INPUT is a LAS/PLY/XYZ file; without one a sample scene is "
+          "used\n"
+          "  --scene NAME      spiral, terrain or boxes (spiral)\n"
+          "  --points N        sample scene points (1000000)\n"
+          "  --path FILE       camera keys, \"time yaw pitch distance tx ty "
+          "tz\" per line\n"
+          "                    (default: one orbit from the isometric "
+          "view)\n"
+          "  --duration S      seconds to render (the path's, or 10 for the "
+          "orbit)\n"
+          "  --fps N           frames per second (30)\n"
+          "  --size W H        frame size (1280 720)\n"
+          "  --budget N        points drawn per frame, a fixed random subset "
+          "(all)\n"
+          "  --backend B       software or gl (software)\n"
+          "  --threads N       frames rendered at once, software only (all "
+          "cores)\n"
+          "  --color-mode M    0-3 (0)\n"
+          "  --point-size S    (2)\n"
+          "  --no-grid\n"
+          "  --output PATTERN  numbered images, e.g. frames/%%05d.ppm (.pgm "
+          "for gray)\n"
+          "  --pipe COMMAND    raw rgb24 frames to COMMAND's stdin, e.g.\n"
+          "                    \"ffmpeg -f rawvideo -pix_fmt rgb24 -s 1280x720 "
+          "-r 30 -i - out.mp4\"\n",
+          program);
+}
+
+// Exactly one integer conversion (%d, %05d, ...) and no other '%'
+bool isFramePattern(const std::string &pattern) {
+  int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%')
+      continue;
+    size_t j = i + 1;
+    while (j < pattern.size() && isdigit((unsigned char)pattern[j]))
+      ++j;
+    if (j >= pattern.size() || pattern[j] != 'd')
+      return false;
+    ++conversions;
+    i = j;
+  }
+  return conversions == 1;
+}
+
+bool writeImage(const std::string &pattern, int index, int width, int height,
+                const unsigned char *rgb) {
+  char path[1024];
+  snprintf(path, sizeof(path), pattern.c_str(), index);
+  ImageRowWriter writer;
+  return writer.open(path, width, height) && writer.writeRows(rgb, height) &&
+         writer.close();
+}
+
+// Keep a fixed random subset of the points, the same for every frame so
+// the picture doesn't shimmer as the camera moves
+void applyBudget(std::vector<Point3D> &points, size_t budget) {
+  if (budget == 0 || budget >= points.size())
+    return;
+  std::mt19937 random(1);
+  for (size_t i = 0; i < budget; ++i) {
+    std::uniform_int_distribution<size_t> pick(i, points.size() - 1);
+    std::swap(points[i], points[pick(random)]);
+  }
+  points.resize(budget);
+  points.shrink_to_fit();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string backend = "software";
+  std::string scene = "spiral";
+  std::string inputPath, pathFile, outputPattern, pipeCommand;
+  int numPoints = 1000000;
+  int width = 1280, height = 720;
+  float fps = 30.0f, duration = 0.0f;
+  size_t budget = 0;
+  unsigned threads = 0;
+  int colorMode = PointCloudRenderer::COLOR_RGB;
+  float pointSize = 2.0f;
+  bool showGrid = true;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--scene") && i + 1 < argc) {
+      scene = argv[++i];
+    } else if (!strcmp(argv[i], "--points") && i + 1 < argc) {
+      numPoints = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--path") && i + 1 < argc) {
+      pathFile = argv[++i];
+    } else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+      duration = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+      fps = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--size") && i + 2 < argc) {
+      width = atoi(argv[++i]);
+      height = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--budget") && i + 1 < argc) {
+      budget = (size_t)atoll(argv[++i]);
+    } else if (!strcmp(argv[i], "--backend") && i + 1 < argc) {
+      backend = argv[++i];
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--color-mode") && i + 1 < argc) {
+      colorMode = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--point-size") && i + 1 < argc) {
+      pointSize = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--no-grid")) {
+      showGrid = false;
+    } else if (!strcmp(argv[i], "--output") && i + 1 < argc) {
+      outputPattern = argv[++i];
+    } else if (!strcmp(argv[i], "--pipe") && i + 1 < argc) {
+      pipeCommand = argv[++i];
+    } else if (argv[i][0] != '-' && inputPath.empty()) {
+      inputPath = argv[i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (width <= 0 || height <= 0 || !(fps > 0.0f) || duration < 0.0f ||
+      (backend != "software" && backend != "gl") ||
+      (!outputPattern.empty() && !isFramePattern(outputPattern))) {
+    usage(argv[0]);
+    return 2;
+  }
+  bool useGL = backend == "gl";
+#ifdef LIDAR_HEADLESS_EGL
+  HeadlessContext context;
+  if (useGL) {
+    if (!context.create(width, height))
+      return 1;
+    printf("GL renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+  }
+#else
+  if (useGL) {
+    fprintf(stderr, "Built without headless GL support, use --backend "
+                    "software\n");
+    return 1;
+  }
+#endif
+
+  std::vector<Point3D> points;
+  if (!inputPath.empty()) {
+    double origin[3];
+    std::string error;
+    if (!loadPointFile(inputPath, points, origin, &error)) {
+      fprintf(stderr, "Cannot open %s: %s\n", inputPath.c_str(),
+              error.c_str());
+      return 1;
+    }
+  } else if (!makeScene(scene.c_str(), numPoints, points)) {
+    fprintf(stderr, "Unknown scene '%s'\n", scene.c_str());
+    return 2;
+  }
+  size_t totalPoints = points.size();
+  applyBudget(points, budget);
+
+  PointCloudRenderer renderer;
+  renderer.setPointCloud(points);
+  std::vector<Point3D>().swap(points);
+  renderer.setColorMode(colorMode);
+  renderer.setPointSize(pointSize);
+  renderer.setShowGrid(showGrid);
+
+  CameraPath path;
+  if (!pathFile.empty()) {
+    std::string error;
+    if (!path.load(pathFile, error)) {
+      fprintf(stderr, "Cannot load %s: %s\n", pathFile.c_str(),
+              error.c_str());
+      return 1;
+    }
+    if (duration == 0.0f)
+      duration = path.getDuration();
+  } else {
+    if (duration == 0.0f)
+      duration = 10.0f;
+    Camera start = renderer.getCamera();
+    start.setIsometricView();
+    path = CameraPath::makeOrbit(start, duration);
+  }
+  int frames = std::max(1, (int)std::floor(duration * fps + 0.5f));
+
+  FILE *pipe = NULL;
+  if (!pipeCommand.empty()) {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN); // A failed encoder shows up as a write error
+    pipe = popen(pipeCommand.c_str(), "w");
+#else
+    pipe = popen(pipeCommand.c_str(), "wb");
+#endif
+    if (!pipe) {
+      fprintf(stderr, "Cannot run %s\n", pipeCommand.c_str());
+      return 1;
+    }
+  }
+
+  // Software frames are rendered a batch at a time, one per thread, then
+  // handed to the pipe in order; images are written by the threads
+  if (threads == 0)
+    threads = getWorkerCount();
+  unsigned batch = useGL ? 1 : std::min<unsigned>(threads, (unsigned)frames);
+  std::vector<SoftwareRasterizer> rasters(useGL ? 0 : batch);
+  for (size_t r = 0; r < rasters.size(); ++r)
+    rasters[r].resize(width, height);
+  std::vector<std::vector<unsigned char> > pixels(batch);
+  std::vector<float> frameMs(batch);
+  std::vector<char> written(batch);
+  FrameStats stats((size_t)frames);
+  size_t frameBytes = (size_t)width * height * 3;
+  bool ok = true;
+  printf("Rendering %d frames of %dx%d, %zu of %zu points, %u thread%s\n",
+         frames, width, height, renderer.getPointCount(), totalPoints,
+         batch, batch > 1 ? "s" : "");
+
+  std::chrono::steady_clock::time_point total =
+      std::chrono::steady_clock::now();
+  for (int first = 0; ok && first < frames; first += batch) {
+    size_t count = std::min<size_t>(batch, (size_t)(frames - first));
+    parallelFor(
+        count,
+        [&](size_t k) {
+          std::chrono::steady_clock::time_point start =
+              std::chrono::steady_clock::now();
+          int index = first + (int)k;
+          Camera camera = renderer.getCamera();
+          path.evaluate(index / fps, camera);
+          float modelview[16], projection[16];
+          camera.computeMatrices(modelview, projection, width, height);
+#ifdef LIDAR_HEADLESS_EGL
+          if (useGL) {
+            glViewport(0, 0, width, height);
+            glClearColor(BACKGROUND[0], BACKGROUND[1], BACKGROUND[2], 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderer.render(modelview, projection);
+            context.readPixels(pixels[k]);
+          }
+#endif
+          if (!useGL) {
+            SoftwareRasterizer &raster = rasters[k];
+            raster.clear(BACKGROUND[0], BACKGROUND[1], BACKGROUND[2]);
+            raster.render(renderer, modelview, projection);
+          }
+          const unsigned char *rgb =
+              useGL ? pixels[k].data() : rasters[k].getPixels().data();
+          written[k] = outputPattern.empty() ||
+                       writeImage(outputPattern, index, width, height, rgb);
+          frameMs[k] = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        },
+        batch);
+
+    for (size_t k = 0; k < count && ok; ++k) {
+      stats.addFrame(frameMs[k]);
+      if (!written[k]) {
+        fprintf(stderr, "Cannot write frame %d\n", first + (int)k);
+        ok = false;
+      }
+      const unsigned char *rgb =
+          useGL ? pixels[k].data() : rasters[k].getPixels().data();
+      if (pipe && fwrite(rgb, 1, frameBytes, pipe) != frameBytes) {
+        fprintf(stderr, "Encoder stopped taking frames at %d\n",
+                first + (int)k);
+        ok = false;
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - total)
+                       .count();
+  if (pipe && pclose(pipe) != 0) {
+    fprintf(stderr, "Encoder failed\n");
+    ok = false;
+  }
+
+  FrameSummary summary = stats.getSummary();
+  int rendered = stats.getHistoryCount();
+  printf("Frame time:  mean %.2f  p50 %.2f  p95 %.2f  max %.2f ms\n",
+         summary.mean, summary.p50, summary.p95, summary.max);
+  printf("Throughput:  %.2f frames/s, %.1f Mpoints/s over %.1f s\n",
+         rendered / seconds,
+         renderer.getPointCount() * (double)rendered / seconds / 1e6,
+         seconds);
+  return ok ? 0 : 1;
+}
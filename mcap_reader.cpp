@@ -0,0 +1,663 @@
+#include "mcap_reader.h"
+#include "file_utils.h"
+#include "point_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdio.h>
+
+namespace {
+
+const uint8_t MCAP_MAGIC[8] = {0x89, 'M', 'C', 'A', 'P', '0', '\r', '\n'};
+const size_t RECORD_HEADER = 9;  // Opcode and uint64 length
+const size_t FOOTER_RECORD = 29; // Header and 20 bytes of content
+
+enum {
+  OP_HEADER = 0x01,
+  OP_FOOTER = 0x02,
+  OP_SCHEMA = 0x03,
+  OP_CHANNEL = 0x04,
+  OP_MESSAGE = 0x05,
+  OP_CHUNK = 0x06,
+  OP_MESSAGE_INDEX = 0x07,
+  OP_CHUNK_INDEX = 0x08,
+  OP_DATA_END = 0x0f
+};
+
+// PointField datatypes
+enum {
+  FIELD_INT8 = 1,
+  FIELD_UINT8,
+  FIELD_INT16,
+  FIELD_UINT16,
+  FIELD_INT32,
+  FIELD_UINT32,
+  FIELD_FLOAT32,
+  FIELD_FLOAT64
+};
+
+const double ORIGIN[3] = {0.0, 0.0, 0.0};
+
+// Bounds-checked little-endian reads. CDR aligns primitives to their size
+// relative to the start of the payload; ROS 1 and MCAP records don't.
+struct Cursor {
+  const uint8_t *base, *p, *end;
+  bool aligned;
+  bool ok;
+
+  Cursor(const uint8_t *data, size_t size, bool aligned = false)
+      : base(data), p(data), end(data + size), aligned(aligned), ok(true) {}
+
+  bool skip(size_t n) {
+    if (!ok || (size_t)(end - p) < n)
+      return ok = false;
+    p += n;
+    return true;
+  }
+
+  void align(size_t n) {
+    if (aligned) {
+      size_t misalign = (size_t)(p - base) % n;
+      if (misalign)
+        skip(n - misalign);
+    }
+  }
+
+  template <class T> T get() {
+    T v = T();
+    align(sizeof(T));
+    const uint8_t *at = p;
+    if (skip(sizeof(T)))
+      memcpy(&v, at, sizeof(T));
+    return v;
+  }
+
+  // uint32 length, then the bytes
+  bool getBytes(const uint8_t *&data, uint32_t &size) {
+    size = get<uint32_t>();
+    data = p;
+    return skip(size);
+  }
+
+  std::string getString() {
+    const uint8_t *data = NULL;
+    uint32_t size = 0;
+    if (!getBytes(data, size))
+      return std::string();
+    std::string s((const char *)data, size);
+    // CDR strings include their terminator
+    if (!s.empty() && s[s.size() - 1] == '\0')
+      s.resize(s.size() - 1);
+    return s;
+  }
+};
+
+double readValue(const uint8_t *p, int datatype) {
+  switch (datatype) {
+  case FIELD_INT8:
+    return (int8_t)*p;
+  case FIELD_UINT8:
+    return *p;
+  case FIELD_INT16: {
+    int16_t v;
+    memcpy(&v, p, 2);
+    return v;
+  }
+  case FIELD_UINT16: {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+  }
+  case FIELD_INT32: {
+    int32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+  case FIELD_UINT32: {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+  case FIELD_FLOAT32: {
+    float v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+  case FIELD_FLOAT64: {
+    double v;
+    memcpy(&v, p, 8);
+    return v;
+  }
+  default:
+    return 0.0;
+  }
+}
+
+// Largest value of an integer field, which maps to full intensity; 0 for
+// float fields
+double getFieldRange(int datatype) {
+  static const double ranges[] = {0.0,     127.0,        255.0,
+                                  32767.0, 65535.0,      2147483647.0,
+                                  4294967295.0, 0.0, 0.0};
+  return datatype >= 1 && datatype <= 8 ? ranges[datatype] : 0.0;
+}
+
+int fieldSize(int datatype) {
+  static const int sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+  return datatype >= 1 && datatype <= 8 ? sizes[datatype] : 0;
+}
+
+struct Field {
+  uint32_t offset;
+  int datatype;
+};
+
+// What open() collects from schema, channel and index records
+struct Channel {
+  uint16_t schema;
+  std::string topic;
+  std::string encoding;
+};
+
+struct Schema {
+  std::string name;
+};
+
+struct IndexEntry {
+  uint64_t time;
+  uint64_t offset; // File offset of the message record
+};
+
+struct Index {
+  std::map<uint16_t, Schema> schemas;
+  std::map<uint16_t, Channel> channels;
+  std::map<uint16_t, std::vector<IndexEntry>> messages;
+  std::map<uint16_t, bool> compressed; // Channels seen in compressed chunks
+};
+
+bool isPointCloud2(const std::string &schema) {
+  return schema == "sensor_msgs/msg/PointCloud2" ||
+         schema == "sensor_msgs/PointCloud2";
+}
+
+// Schema, channel and message records; offset is the record's position in
+// the file
+void parseRecord(int opcode, const uint8_t *content, size_t size,
+                 uint64_t offset, Index &index) {
+  Cursor c(content, size);
+  if (opcode == OP_SCHEMA) {
+    uint16_t id = c.get<uint16_t>();
+    Schema schema;
+    schema.name = c.getString();
+    if (c.ok)
+      index.schemas[id] = schema;
+  } else if (opcode == OP_CHANNEL) {
+    Channel channel;
+    uint16_t id = c.get<uint16_t>();
+    channel.schema = c.get<uint16_t>();
+    channel.topic = c.getString();
+    channel.encoding = c.getString();
+    if (c.ok)
+      index.channels[id] = channel;
+  } else if (opcode == OP_MESSAGE) {
+    uint16_t channel = c.get<uint16_t>();
+    c.get<uint32_t>(); // Sequence
+    IndexEntry entry;
+    entry.time = c.get<uint64_t>();
+    entry.offset = offset;
+    if (c.ok)
+      index.messages[channel].push_back(entry);
+  }
+}
+
+// Records of an uncompressed chunk, which start at recordsOffset in the file
+void parseChunkRecords(const uint8_t *data, size_t size,
+                       uint64_t recordsOffset, Index &index) {
+  size_t pos = 0;
+  while (size - pos >= RECORD_HEADER) {
+    uint64_t length;
+    memcpy(&length, data + pos + 1, 8);
+    if (length > size - pos - RECORD_HEADER)
+      break;
+    parseRecord(data[pos], data + pos + RECORD_HEADER, (size_t)length,
+                recordsOffset + pos, index);
+    pos += RECORD_HEADER + (size_t)length;
+  }
+}
+
+// Chunk content up to the records: start and end time, uncompressed size
+// and CRC, compression, then the uint64 length of the records
+bool parseChunkHeader(const uint8_t *content, size_t size,
+                      std::string &compression, size_t &headerSize,
+                      uint64_t &recordsSize) {
+  Cursor c(content, size);
+  c.skip(8 + 8 + 8 + 4);
+  compression = c.getString();
+  recordsSize = c.get<uint64_t>();
+  headerSize = (size_t)(c.p - content);
+  return c.ok;
+}
+
+// Index from the summary section: chunk indexes point at each chunk's
+// message index records, which list message offsets within the chunk
+bool readSummary(const std::string &path, uint64_t fileSize, Index &index) {
+  uint8_t footer[FOOTER_RECORD];
+  if (fileSize < 16 + FOOTER_RECORD ||
+      !readFileRange(path, fileSize - 8 - FOOTER_RECORD, FOOTER_RECORD,
+                     footer) ||
+      footer[0] != OP_FOOTER)
+    return false;
+  uint64_t summaryStart, summaryOffsetStart;
+  memcpy(&summaryStart, footer + RECORD_HEADER, 8);
+  memcpy(&summaryOffsetStart, footer + RECORD_HEADER + 8, 8);
+  uint64_t summaryEnd =
+      summaryOffsetStart ? summaryOffsetStart : fileSize - 8 - FOOTER_RECORD;
+  if (summaryStart == 0 || summaryStart >= summaryEnd)
+    return false;
+
+  std::vector<uint8_t> summary((size_t)(summaryEnd - summaryStart));
+  if (!readFileRange(path, summaryStart, summary.size(), summary.data()))
+    return false;
+
+  struct ChunkIndex {
+    uint64_t start, length, indexLength;
+    std::string compression;
+  };
+  std::vector<ChunkIndex> chunks;
+  size_t pos = 0;
+  while (summary.size() - pos >= RECORD_HEADER) {
+    int opcode = summary[pos];
+    uint64_t length;
+    memcpy(&length, &summary[pos + 1], 8);
+    if (length > summary.size() - pos - RECORD_HEADER)
+      return false;
+    const uint8_t *content = &summary[pos + RECORD_HEADER];
+    if (opcode == OP_CHUNK_INDEX) {
+      Cursor c(content, (size_t)length);
+      ChunkIndex chunk;
+      c.skip(16); // Message start and end time
+      chunk.start = c.get<uint64_t>();
+      chunk.length = c.get<uint64_t>();
+      uint32_t mapSize = c.get<uint32_t>();
+      c.skip(mapSize); // Per-channel offsets; the index region is read whole
+      chunk.indexLength = c.get<uint64_t>();
+      chunk.compression = c.getString();
+      if (c.ok)
+        chunks.push_back(chunk);
+    } else {
+      parseRecord(opcode, content, (size_t)length, 0, index);
+    }
+    pos += RECORD_HEADER + (size_t)length;
+  }
+  if (chunks.empty())
+    return false;
+
+  std::vector<uint8_t> buffer;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const ChunkIndex &chunk = chunks[i];
+
+    // Message offsets are relative to the chunk's records
+    uint8_t header[RECORD_HEADER + 64];
+    size_t headerRead =
+        (size_t)std::min<uint64_t>(sizeof(header), chunk.length);
+    std::string compression;
+    size_t headerSize = 0;
+    uint64_t recordsSize = 0;
+    if (!readFileRange(path, chunk.start, headerRead, header) ||
+        !parseChunkHeader(header + RECORD_HEADER, headerRead - RECORD_HEADER,
+                          compression, headerSize, recordsSize))
+      return false;
+    uint64_t recordsOffset = chunk.start + RECORD_HEADER + headerSize;
+
+    if (chunk.indexLength == 0) {
+      // No message indexes: read the chunk itself when possible
+      if (!compression.empty())
+        continue;
+      buffer.resize((size_t)recordsSize);
+      if (!readFileRange(path, recordsOffset, buffer.size(), buffer.data()))
+        return false;
+      parseChunkRecords(buffer.data(), buffer.size(), recordsOffset, index);
+      continue;
+    }
+
+    buffer.resize((size_t)chunk.indexLength);
+    if (!readFileRange(path, chunk.start + chunk.length, buffer.size(),
+                       buffer.data()))
+      return false;
+    for (size_t at = 0; buffer.size() - at >= RECORD_HEADER;) {
+      uint64_t length;
+      memcpy(&length, &buffer[at + 1], 8);
+      if (length > buffer.size() - at - RECORD_HEADER)
+        break;
+      if (buffer[at] == OP_MESSAGE_INDEX) {
+        Cursor c(&buffer[at + RECORD_HEADER], (size_t)length);
+        uint16_t channel = c.get<uint16_t>();
+        uint32_t bytes = c.get<uint32_t>();
+        if (!compression.empty())
+          index.compressed[channel] = true;
+        std::vector<IndexEntry> &entries = index.messages[channel];
+        for (uint32_t k = 0; k + 16 <= bytes && c.ok; k += 16) {
+          IndexEntry entry;
+          entry.time = c.get<uint64_t>();
+          entry.offset = recordsOffset + c.get<uint64_t>();
+          if (c.ok)
+            entries.push_back(entry);
+        }
+      }
+      at += RECORD_HEADER + (size_t)length;
+    }
+  }
+  return true;
+}
+
+// Index by reading every record of the data section
+bool scanFile(const std::string &path, Index &index) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+
+  uint64_t pos = 8;
+  std::vector<uint8_t> content;
+  bool ok = true;
+  while (ok) {
+    uint8_t header[RECORD_HEADER];
+    if (seekFile(f, pos) != 0 || fread(header, 1, RECORD_HEADER, f) !=
+                                     RECORD_HEADER)
+      break;
+    int opcode = header[0];
+    uint64_t length;
+    memcpy(&length, header + 1, 8);
+    if (opcode == OP_FOOTER || opcode == OP_DATA_END)
+      break;
+
+    // Only the start of a message is needed to index it
+    size_t want = opcode == OP_MESSAGE ? std::min<uint64_t>(length, 22)
+                                       : (size_t)length;
+    if (opcode == OP_SCHEMA || opcode == OP_CHANNEL || opcode == OP_MESSAGE ||
+        opcode == OP_CHUNK) {
+      content.resize(want);
+      ok = fread(content.data(), 1, want, f) == want;
+    }
+    if (ok && opcode == OP_CHUNK) {
+      std::string compression;
+      size_t headerSize = 0;
+      uint64_t recordsSize = 0;
+      ok = parseChunkHeader(content.data(), content.size(), compression,
+                            headerSize, recordsSize) &&
+           recordsSize <= content.size() - headerSize;
+      if (ok && compression.empty()) {
+        parseChunkRecords(content.data() + headerSize, (size_t)recordsSize,
+                          pos + RECORD_HEADER + headerSize, index);
+      } else if (ok) {
+        // Channels of compressed chunks can't be read; note them
+        std::map<uint16_t, Channel>::const_iterator it;
+        for (it = index.channels.begin(); it != index.channels.end(); ++it)
+          index.compressed[it->first] = true;
+      }
+    } else if (ok && (opcode == OP_SCHEMA || opcode == OP_CHANNEL ||
+                      opcode == OP_MESSAGE)) {
+      parseRecord(opcode, content.data(), content.size(), pos, index);
+    }
+    pos += RECORD_HEADER + length;
+  }
+  fclose(f);
+  return ok;
+}
+
+} // namespace
+
+bool decodePointCloud2(const uint8_t *data, size_t size, bool cdr,
+                       std::vector<Point3D> &out, bool *hasColor) {
+  if (cdr) {
+    // Encapsulation header; only little-endian CDR is handled
+    if (size < 4 || !(data[1] & 1))
+      return false;
+    data += 4;
+    size -= 4;
+  }
+  Cursor c(data, size, cdr);
+
+  // std_msgs/Header
+  if (!cdr)
+    c.get<uint32_t>(); // ROS 1 sequence number
+  c.get<uint32_t>();   // Stamp seconds
+  c.get<uint32_t>();   // Stamp nanoseconds
+  c.getString();       // Frame id
+
+  uint32_t height = c.get<uint32_t>();
+  uint32_t width = c.get<uint32_t>();
+  uint32_t fieldCount = c.get<uint32_t>();
+  Field x = {0, 0}, y = {0, 0}, z = {0, 0}, intensity = {0, 0},
+        rgb = {0, 0};
+  for (uint32_t i = 0; i < fieldCount && c.ok; ++i) {
+    std::string name = c.getString();
+    Field field;
+    field.offset = c.get<uint32_t>();
+    field.datatype = c.get<uint8_t>();
+    c.get<uint32_t>(); // Count
+    if (name == "x")
+      x = field;
+    else if (name == "y")
+      y = field;
+    else if (name == "z")
+      z = field;
+    else if (name == "intensity" || name == "reflectivity" ||
+             name == "reflectance")
+      intensity = intensity.datatype ? intensity : field;
+    else if (name == "rgb" || name == "rgba")
+      rgb = field;
+  }
+  bool bigEndian = c.get<uint8_t>() != 0;
+  uint32_t pointStep = c.get<uint32_t>();
+  uint32_t rowStep = c.get<uint32_t>();
+  const uint8_t *points = NULL;
+  uint32_t bytes = 0;
+  c.getBytes(points, bytes);
+  if (!c.ok || bigEndian || !x.datatype || !y.datatype || !z.datatype)
+    return false;
+
+  // Every field must lie inside the point and every row inside the data
+  Field *fields[] = {&x, &y, &z, &intensity, &rgb};
+  for (int i = 0; i < 5; ++i) {
+    if (fields[i]->datatype &&
+        (fieldSize(fields[i]->datatype) == 0 ||
+         fields[i]->offset + fieldSize(fields[i]->datatype) > pointStep))
+      return false;
+  }
+  if (height > 0 && width > 0 &&
+      ((uint64_t)rowStep * (height - 1) + (uint64_t)pointStep * width > bytes ||
+       pointStep == 0))
+    return false;
+  if (hasColor)
+    *hasColor = rgb.datatype == FIELD_FLOAT32 || rgb.datatype == FIELD_UINT32;
+
+  // One scale for the whole message keeps brightness in intensity order:
+  // integer fields by their type's range, float fields by the brightest
+  // point (kept as they are when already within 0..1)
+  double intensityScale = 1.0;
+  if (getFieldRange(intensity.datatype) > 0.0) {
+    intensityScale = 1.0 / getFieldRange(intensity.datatype);
+  } else if (intensity.datatype) {
+    double brightest = 1.0;
+    for (uint32_t row = 0; row < height; ++row) {
+      const uint8_t *p = points + (size_t)row * rowStep + intensity.offset;
+      for (uint32_t col = 0; col < width; ++col, p += pointStep) {
+        double i = readValue(p, intensity.datatype);
+        if (std::isfinite(i))
+          brightest = std::max(brightest, i);
+      }
+    }
+    intensityScale = 1.0 / brightest;
+  }
+
+  bool packed = x.datatype == FIELD_FLOAT32 && y.datatype == FIELD_FLOAT32 &&
+                z.datatype == FIELD_FLOAT32;
+  out.reserve(out.size() + (size_t)width * height);
+  for (uint32_t row = 0; row < height; ++row) {
+    const uint8_t *p = points + (size_t)row * rowStep;
+    for (uint32_t col = 0; col < width; ++col, p += pointStep) {
+      double v[3];
+      if (packed) {
+        // The common layout: read the floats without dispatching on type
+        float f[3];
+        memcpy(&f[0], p + x.offset, 4);
+        memcpy(&f[1], p + y.offset, 4);
+        memcpy(&f[2], p + z.offset, 4);
+        v[0] = f[0];
+        v[1] = f[1];
+        v[2] = f[2];
+      } else {
+        v[0] = readValue(p + x.offset, x.datatype);
+        v[1] = readValue(p + y.offset, y.datatype);
+        v[2] = readValue(p + z.offset, z.datatype);
+      }
+      // Organized clouds mark missing returns with NaN
+      if (!std::isfinite(v[0]) || !std::isfinite(v[1]) ||
+          !std::isfinite(v[2]))
+        continue;
+
+      Point3D point;
+      float pos[3];
+      fileToViewer(v[0], v[1], v[2], ORIGIN, pos);
+      point.x = pos[0];
+      point.y = pos[1];
+      point.z = pos[2];
+
+      if (intensity.datatype) {
+        double i = readValue(p + intensity.offset, intensity.datatype);
+        point.intensity =
+            (float)std::min(std::max(i * intensityScale, 0.0), 1.0);
+      }
+      if (rgb.datatype == FIELD_FLOAT32 || rgb.datatype == FIELD_UINT32) {
+        // Packed 0x00RRGGBB, stored as a float's bits in the rgb field
+        uint32_t packedColor;
+        memcpy(&packedColor, p + rgb.offset, 4);
+        point.r = ((packedColor >> 16) & 0xff) / 255.0f;
+        point.g = ((packedColor >> 8) & 0xff) / 255.0f;
+        point.b = (packedColor & 0xff) / 255.0f;
+      } else {
+        point.r = point.g = point.b = point.intensity;
+      }
+      out.push_back(point);
+    }
+  }
+  return true;
+}
+
+McapSequence::McapSequence() : indexed(false), color(false) {}
+
+bool McapSequence::open(const std::string &path, const std::string &topic) {
+  this->path = path;
+  this->topic.clear();
+  times.clear();
+  offsets.clear();
+  timestamped = true;
+  indexed = false;
+  color = false;
+  error.clear();
+
+  uint64_t fileSize = getFileSize(path);
+  uint8_t magic[8];
+  if (fileSize < 16 || !readFileRange(path, 0, 8, magic) ||
+      memcmp(magic, MCAP_MAGIC, 8) != 0) {
+    error = "not an MCAP file: " + path;
+    return false;
+  }
+
+  Index index;
+  indexed = readSummary(path, fileSize, index);
+  if (!indexed) {
+    index = Index();
+    if (!scanFile(path, index)) {
+      error = "cannot read " + path;
+      return false;
+    }
+  }
+
+  // The requested PointCloud2 channel, or the busiest one
+  int best = -1;
+  size_t bestCount = 0;
+  std::map<uint16_t, Channel>::const_iterator it;
+  for (it = index.channels.begin(); it != index.channels.end(); ++it) {
+    std::map<uint16_t, Schema>::const_iterator schema =
+        index.schemas.find(it->second.schema);
+    if (schema == index.schemas.end() || !isPointCloud2(schema->second.name))
+      continue;
+    if (it->second.encoding != "cdr" && it->second.encoding != "ros1")
+      continue;
+    if (!topic.empty() && it->second.topic != topic)
+      continue;
+    size_t count = index.messages[it->first].size();
+    if (best < 0 || count > bestCount) {
+      best = it->first;
+      bestCount = count;
+    }
+  }
+  if (best < 0) {
+    error = topic.empty() ? "no PointCloud2 channel in " + path
+                          : "no PointCloud2 channel " + topic + " in " + path;
+    return false;
+  }
+  if (index.compressed.count((uint16_t)best)) {
+    error = "compressed (lz4/zstd) chunks are not supported: " + path;
+    return false;
+  }
+
+  this->topic = index.channels[(uint16_t)best].topic;
+  encoding = index.channels[(uint16_t)best].encoding;
+  std::vector<IndexEntry> &entries = index.messages[(uint16_t)best];
+  if (entries.empty()) {
+    error = "no messages on " + this->topic;
+    return false;
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const IndexEntry &a, const IndexEntry &b) {
+                     return a.time < b.time;
+                   });
+  for (size_t i = 0; i < entries.size(); ++i) {
+    times.push_back((entries[i].time - entries[0].time) * 1e-9);
+    offsets.push_back(entries[i].offset);
+  }
+
+  // Decoder threads call loadFrame and hasColor later, so color is only
+  // ever set here
+  std::vector<Point3D> first;
+  if (!decodeFrame(0, first, &color)) {
+    error = "cannot decode the first PointCloud2 message on " + this->topic;
+    times.clear();
+    offsets.clear();
+    return false;
+  }
+  return true;
+}
+
+bool McapSequence::loadFrame(size_t frame, std::vector<Point3D> &out) const {
+  return decodeFrame(frame, out, NULL);
+}
+
+bool McapSequence::decodeFrame(size_t frame, std::vector<Point3D> &out,
+                               bool *hasColor) const {
+  if (frame >= offsets.size())
+    return false;
+
+  uint8_t header[RECORD_HEADER];
+  if (!readFileRange(path, offsets[frame], RECORD_HEADER, header) ||
+      header[0] != OP_MESSAGE)
+    return false;
+  uint64_t length;
+  memcpy(&length, header + 1, 8);
+  const size_t MESSAGE_FIELDS = 2 + 4 + 8 + 8; // Channel to publish time
+  if (length < MESSAGE_FIELDS || length > ((uint64_t)1 << 32))
+    return false;
+
+  static thread_local std::vector<uint8_t> content;
+  content.resize((size_t)length);
+  if (!readFileRange(path, offsets[frame] + RECORD_HEADER, content.size(),
+                     content.data()))
+    return false;
+
+  return decodePointCloud2(content.data() + MESSAGE_FIELDS,
+                           content.size() - MESSAGE_FIELDS, encoding == "cdr",
+                           out, hasColor);
+}
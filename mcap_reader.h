@@ -0,0 +1,52 @@
+#pragma once
+
+#include "frame_sequence.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// sensor_msgs/PointCloud2 messages of one MCAP channel as a sweep
+// sequence. open() builds a time-sorted index of the messages' file
+// offsets from the summary section (chunk indexes, then each chunk's
+// message indexes), so opening reads only a few kilobytes and seeking is a
+// binary search. Files without a summary are indexed by scanning the data
+// section once. Messages are read directly from their offsets and decoded
+// field by field; ROS 2 (CDR) and ROS 1 serializations are supported.
+//
+// Chunks must be uncompressed: lz4 and zstd chunks are reported as
+// unsupported when open() finds them on the selected channel.
+class McapSequence : public FrameSequence {
+public:
+  McapSequence();
+
+  // topic selects the PointCloud2 channel; empty picks the one with the
+  // most messages
+  bool open(const std::string &path, const std::string &topic = "");
+
+  const std::string &getTopic() const { return topic; }
+  bool isIndexed() const { return indexed; } // Summary section was used
+
+  bool loadFrame(size_t frame, std::vector<Point3D> &out) const override;
+  bool hasColor() const override { return color; }
+
+private:
+  bool decodeFrame(size_t frame, std::vector<Point3D> &out,
+                   bool *hasColor) const;
+
+  std::string path;
+  std::string topic;
+  std::string encoding; // "cdr" or "ros1"
+  bool indexed;
+  bool color; // First message has rgb or rgba
+
+  // File offset of each message record, in log time order
+  std::vector<uint64_t> offsets;
+};
+
+// Decode a serialized sensor_msgs/PointCloud2 into viewer coordinates
+// (sensor frame, Z up in the message); cdr selects ROS 2 serialization.
+// Intensity is scaled to 0..1 by the field type's range, or for float
+// fields by the message's brightest point when that exceeds 1.
+// Returns false on a malformed message or one without x, y, z fields.
+bool decodePointCloud2(const uint8_t *data, size_t size, bool cdr,
+                       std::vector<Point3D> &out, bool *hasColor = NULL);
@@ -0,0 +1,139 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "memory_stats.h"
+#include <atomic>
+
+static std::atomic<size_t> g_Bytes[MEM_CATEGORY_COUNT];
+static std::atomic<size_t> g_PeakBytes[MEM_CATEGORY_COUNT];
+static std::atomic<size_t> g_Allocations[MEM_CATEGORY_COUNT];
+
+void MemoryStats::add(MemoryCategory category, size_t bytes) {
+  size_t now = g_Bytes[category].fetch_add(bytes) + bytes;
+  g_Allocations[category].fetch_add(1);
+
+  // Raise the high-water mark if another thread hasn't already
+  size_t peak = g_PeakBytes[category].load();
+  while (now > peak && !g_PeakBytes[category].compare_exchange_weak(peak, now))
+    ;
+}
+
+void MemoryStats::remove(MemoryCategory category, size_t bytes) {
+  g_Bytes[category].fetch_sub(bytes);
+  g_Allocations[category].fetch_sub(1);
+}
+
+size_t MemoryStats::getBytes(MemoryCategory category) {
+  return g_Bytes[category].load();
+}
+
+size_t MemoryStats::getPeakBytes(MemoryCategory category) {
+  return g_PeakBytes[category].load();
+}
+
+size_t MemoryStats::getAllocationCount(MemoryCategory category) {
+  return g_Allocations[category].load();
+}
+
+bool MemoryStats::isGPU(MemoryCategory category) {
+  return category == MEM_GPU_BUFFERS || category == MEM_TEXTURES ||
+         category == MEM_FRAMEBUFFERS;
+}
+
+const char *MemoryStats::getCategoryName(MemoryCategory category) {
+  switch (category) {
+  case MEM_POINT_STORAGE:
+    return "Point Storage";
+  case MEM_INDICES:
+    return "Indices";
+  case MEM_CACHES:
+    return "Caches";
+  case MEM_GPU_BUFFERS:
+    return "GPU Buffers";
+  case MEM_TEXTURES:
+    return "Textures";
+  case MEM_FRAMEBUFFERS:
+    return "Framebuffers";
+  default:
+    return "Unknown";
+  }
+}
+
+size_t MemoryStats::getTotalBytes(bool gpu) {
+  size_t total = 0;
+  for (int i = 0; i < MEM_CATEGORY_COUNT; ++i) {
+    if (isGPU((MemoryCategory)i) == gpu)
+      total += getBytes((MemoryCategory)i);
+  }
+  return total;
+}
+
+size_t MemoryStats::getProcessResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.WorkingSetSize;
+  return 0;
+#elif defined(__linux__)
+  // Second field of statm is the resident set in pages
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  unsigned long size = 0, resident = 0;
+  int fields = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  if (fields != 2)
+    return 0;
+  return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+size_t MemoryStats::getProcessPeakResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss; // Bytes on macOS
+#else
+  return (size_t)usage.ru_maxrss * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
+
+void MemoryStats::dump(FILE *out) {
+  const double MB = 1024.0 * 1024.0;
+
+  fprintf(out, "%-16s %12s %12s %10s\n", "Category", "Current MB", "Peak MB",
+          "Blocks");
+  for (int i = 0; i < MEM_CATEGORY_COUNT; ++i) {
+    MemoryCategory c = (MemoryCategory)i;
+    fprintf(out, "%-16s %12.2f %12.2f %10zu\n", getCategoryName(c),
+            getBytes(c) / MB, getPeakBytes(c) / MB, getAllocationCount(c));
+  }
+  fprintf(out, "Tracked CPU: %.2f MB\n", getTotalBytes(false) / MB);
+  fprintf(out, "Tracked GPU: %.2f MB\n", getTotalBytes(true) / MB);
+  fprintf(out, "Process RSS: %.2f MB (peak %.2f MB)\n",
+          getProcessResidentBytes() / MB, getProcessPeakResidentBytes() / MB);
+}
+
+bool MemoryStats::dumpToFile(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return false;
+  dump(f);
+  fclose(f);
+  return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <new>
+
+// Subsystems whose memory use is accounted separately
+enum MemoryCategory {
+  MEM_POINT_STORAGE = 0,
+  MEM_INDICES,
+  MEM_CACHES,
+  MEM_GPU_BUFFERS,
+  MEM_TEXTURES,
+  MEM_FRAMEBUFFERS, // Offscreen targets: capture FBOs, headless pbuffers
+  MEM_CATEGORY_COUNT
+};
+
+// Process-wide memory counters, safe to update from any thread.
+// CPU categories are fed by TrackedAllocator, GPU categories are reported
+// explicitly by the code that creates buffers, textures and framebuffers.
+class MemoryStats {
+public:
+  static void add(MemoryCategory category, size_t bytes);
+  static void remove(MemoryCategory category, size_t bytes);
+
+  static size_t getBytes(MemoryCategory category);
+  static size_t getPeakBytes(MemoryCategory category);
+  static size_t getAllocationCount(MemoryCategory category);
+
+  static bool isGPU(MemoryCategory category);
+  static const char *getCategoryName(MemoryCategory category);
+
+  // Sum over all CPU (gpu = false) or GPU (gpu = true) categories
+  static size_t getTotalBytes(bool gpu);
+
+  // Operating system view of the whole process (0 if unavailable)
+  static size_t getProcessResidentBytes();
+  static size_t getProcessPeakResidentBytes();
+
+  // Write a human readable report of all counters
+  static void dump(FILE *out);
+  static bool dumpToFile(const char *path);
+};
+
+// STL allocator that reports its allocations to MemoryStats
+template <class T, MemoryCategory Category> struct TrackedAllocator {
+  typedef T value_type;
+
+  template <class U> struct rebind {
+    typedef TrackedAllocator<U, Category> other;
+  };
+
+  TrackedAllocator() {}
+  template <class U>
+  TrackedAllocator(const TrackedAllocator<U, Category> &) {}
+
+  T *allocate(size_t n) {
+    T *p = static_cast<T *>(::operator new(n * sizeof(T)));
+    MemoryStats::add(Category, n * sizeof(T));
+    return p;
+  }
+
+  void deallocate(T *p, size_t n) {
+    MemoryStats::remove(Category, n * sizeof(T));
+    ::operator delete(p);
+  }
+};
+
+template <class T, class U, MemoryCategory C>
+bool operator==(const TrackedAllocator<T, C> &, const TrackedAllocator<U, C> &) {
+  return true;
+}
+
+template <class T, class U, MemoryCategory C>
+bool operator!=(const TrackedAllocator<T, C> &, const TrackedAllocator<U, C> &) {
+  return false;
+}
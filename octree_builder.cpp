@@ -0,0 +1,537 @@
+#include "octree_builder.h"
+#include "file_utils.h"
+#include "memory_stats.h"
+#include "octree_dataset.h"
+#include "parallel.h"
+#include "point_codec.h"
+#include "point_io.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <unordered_set>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t READ_BATCH = 65536;
+const int MAX_GRID_LEVEL = 7; // 8^7 counting cells (16 MB of counters)
+const int MAX_DEPTH = 24;     // Stop splitting duplicates eventually
+
+struct Chunk {
+  std::string name; // Octree node name of the chunk's root
+  uint64_t count;
+  std::string tempPath;
+};
+
+struct NodeRecord {
+  std::string name;
+  int file;
+  uint64_t offset;
+  uint32_t count;
+  uint64_t size; // Bytes in the data file
+};
+
+// Appends node points to one data file and remembers where they went.
+// With codec options set, nodes are stored as encoded blocks.
+struct NodeWriter {
+  FILE *file;
+  int fileIndex;
+  uint64_t offset;
+  const CodecOptions *codec;
+  std::vector<NodeRecord> records;
+  std::vector<uint8_t> block;
+
+  bool write(const std::string &name, const std::vector<Point3D> &points) {
+    // Nodes with more than 4G points only happen for pathological input
+    size_t count = std::min<size_t>(points.size(), 0xffffffffu);
+    if (count == 0)
+      return true;
+    size_t size = count * sizeof(Point3D);
+    const void *data = points.data();
+    if (codec) {
+      encodePoints(points.data(), count, *codec, block);
+      size = block.size();
+      data = block.data();
+    }
+    if (fwrite(data, 1, size, file) != size)
+      return false;
+    NodeRecord record = {name, fileIndex, offset, (uint32_t)count, size};
+    records.push_back(record);
+    offset += size;
+    return true;
+  }
+};
+
+double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int gridCell(float v, float min, float size, int cells) {
+  int c = (int)((v - min) / size * cells);
+  return std::min(std::max(c, 0), cells - 1);
+}
+
+// Keep the first point in every cell of a res^3 grid over the cube; the
+// others go to rest when it is given
+void subsample(const std::vector<Point3D> &in, const float min[3], float size,
+               int res, std::vector<Point3D> &kept,
+               std::vector<Point3D> *rest) {
+  std::unordered_set<uint32_t> occupied;
+  occupied.reserve(std::min<size_t>(in.size(), (size_t)res * res * 4));
+  for (size_t i = 0; i < in.size(); ++i) {
+    const Point3D &p = in[i];
+    uint32_t key = ((uint32_t)gridCell(p.x, min[0], size, res) * res +
+                    gridCell(p.y, min[1], size, res)) *
+                       res +
+                   gridCell(p.z, min[2], size, res);
+    if (occupied.insert(key).second)
+      kept.push_back(p);
+    else if (rest)
+      rest->push_back(p);
+  }
+}
+
+// Write a node and recurse into its children; points is consumed
+bool buildNode(const std::string &name, const float min[3], float size,
+               std::vector<Point3D> &points, const OctreeBuildOptions &opt,
+               NodeWriter &writer) {
+  int level = (int)name.size() - 1;
+  if (points.size() <= opt.nodeCapacity || level >= MAX_DEPTH) {
+    bool ok = writer.write(name, points);
+    std::vector<Point3D>().swap(points);
+    return ok;
+  }
+
+  std::vector<Point3D> kept, rest;
+  subsample(points, min, size, opt.gridResolution, kept, &rest);
+  std::vector<Point3D>().swap(points);
+  if (!writer.write(name, kept))
+    return false;
+  std::vector<Point3D>().swap(kept);
+
+  float half = size * 0.5f;
+  float mid[3] = {min[0] + half, min[1] + half, min[2] + half};
+  std::vector<Point3D> children[8];
+  for (size_t i = 0; i < rest.size(); ++i) {
+    const Point3D &p = rest[i];
+    int child = (p.x >= mid[0] ? 4 : 0) | (p.y >= mid[1] ? 2 : 0) |
+                (p.z >= mid[2] ? 1 : 0);
+    children[child].push_back(p);
+  }
+  std::vector<Point3D>().swap(rest);
+
+  for (int c = 0; c < 8; ++c) {
+    if (children[c].empty())
+      continue;
+    float childMin[3] = {(c & 4) ? mid[0] : min[0], (c & 2) ? mid[1] : min[1],
+                         (c & 1) ? mid[2] : min[2]};
+    if (!buildNode(name + (char)('0' + c), childMin, half, children[c], opt,
+                   writer))
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool buildOctree(const OctreeBuildOptions &opt, OctreeBuildReport &report,
+                 std::string &error) {
+  report = OctreeBuildReport();
+  Clock::time_point start = Clock::now();
+  unsigned threads = opt.threads ? opt.threads : getWorkerCount();
+  CodecOptions codecOptions;
+  codecOptions.precision = opt.precision;
+  const CodecOptions *codec = opt.compress ? &codecOptions : NULL;
+
+  std::mutex errorMutex;
+  auto setError = [&](const std::string &message) {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (error.empty())
+      error = message;
+  };
+
+  if (opt.inputs.empty()) {
+    error = "no input files";
+    return false;
+  }
+  if (!makeDirectory(opt.outputDir) && !isDirectory(opt.outputDir)) {
+    error = "cannot create " + opt.outputDir;
+    return false;
+  }
+
+  // Bounds from the headers; files without them (PLY, XYZ) are scanned
+  std::vector<PointFileInfo> infos(opt.inputs.size());
+  parallelFor(
+      opt.inputs.size(),
+      [&](size_t i) {
+        std::unique_ptr<PointReader> reader = createPointReader(opt.inputs[i]);
+        if (!reader) {
+          setError("unsupported file type: " + opt.inputs[i]);
+          return;
+        }
+        if (!reader->open(opt.inputs[i])) {
+          setError(reader->getError());
+          return;
+        }
+        infos[i] = reader->getInfo();
+        if (infos[i].hasBounds)
+          return;
+
+        // Scan relative to the first batch's minimum to keep float precision
+        std::vector<Point3D> batch;
+        double origin[3] = {0, 0, 0}, pos[3];
+        uint64_t count = 0;
+        bool first = true;
+        while (reader->read(batch, READ_BATCH) > 0) {
+          for (size_t p = 0; p < batch.size(); ++p) {
+            float v[3] = {batch[p].x, batch[p].y, batch[p].z};
+            viewerToFile(v, origin, pos);
+            if (first) {
+              std::copy(pos, pos + 3, infos[i].min);
+              std::copy(pos, pos + 3, infos[i].max);
+              first = false;
+            }
+            for (int a = 0; a < 3; ++a) {
+              infos[i].min[a] = std::min(infos[i].min[a], pos[a]);
+              infos[i].max[a] = std::max(infos[i].max[a], pos[a]);
+            }
+          }
+          if (count == 0 && !batch.empty())
+            reader->setOrigin(infos[i].min[0], infos[i].min[1],
+                              infos[i].min[2]);
+          count += batch.size();
+          batch.clear();
+          std::copy(reader->getOrigin(), reader->getOrigin() + 3, origin);
+        }
+        infos[i].pointCount = count;
+        infos[i].hasBounds = count > 0;
+      },
+      threads);
+  if (!error.empty())
+    return false;
+
+  double fileMin[3] = {1e300, 1e300, 1e300}, fileMax[3] = {-1e300, -1e300,
+                                                           -1e300};
+  uint64_t expected = 0;
+  for (size_t i = 0; i < infos.size(); ++i) {
+    if (!infos[i].hasBounds)
+      continue;
+    expected += infos[i].pointCount;
+    for (int a = 0; a < 3; ++a) {
+      fileMin[a] = std::min(fileMin[a], infos[i].min[a]);
+      fileMax[a] = std::max(fileMax[a], infos[i].max[a]);
+    }
+  }
+  if (expected == 0) {
+    error = "input contains no points";
+    return false;
+  }
+
+  // Center the origin so viewer coordinates are small in every direction
+  double origin[3];
+  for (int a = 0; a < 3; ++a)
+    origin[a] = (fileMin[a] + fileMax[a]) * 0.5;
+  float lo[3], hi[3];
+  fileToViewer(fileMin[0], fileMax[1], fileMin[2], origin, lo);
+  fileToViewer(fileMax[0], fileMin[1], fileMax[2], origin, hi);
+
+  // Pad the cube so rounding can't put points outside of it
+  float size = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+  size = size * 1.001f + 0.01f;
+  float cubeMin[3];
+  for (int a = 0; a < 3; ++a)
+    cubeMin[a] = (lo[a] + hi[a]) * 0.5f - size * 0.5f;
+
+  // Pass 1: counting grid, fine enough that cells are well below a chunk
+  int gridLevel = 1;
+  while (gridLevel < MAX_GRID_LEVEL &&
+         ((uint64_t)1 << (3 * gridLevel)) * (opt.maxChunkPoints / 16 + 1) <
+             expected)
+    ++gridLevel;
+  const int cells = 1 << gridLevel;
+  auto cellIndex = [&](const Point3D &p) {
+    return ((size_t)gridCell(p.x, cubeMin[0], size, cells) * cells +
+            gridCell(p.y, cubeMin[1], size, cells)) *
+               cells +
+           gridCell(p.z, cubeMin[2], size, cells);
+  };
+
+  std::vector<uint64_t> counts((size_t)cells * cells * cells, 0);
+  std::mutex countMutex;
+  parallelFor(
+      opt.inputs.size(),
+      [&](size_t i) {
+        std::unique_ptr<PointReader> reader = createPointReader(opt.inputs[i]);
+        if (!reader->open(opt.inputs[i])) {
+          setError(reader->getError());
+          return;
+        }
+        reader->setOrigin(origin[0], origin[1], origin[2]);
+
+        std::vector<uint64_t> local(counts.size(), 0);
+        std::vector<Point3D> batch;
+        while (reader->read(batch, READ_BATCH) > 0) {
+          for (size_t p = 0; p < batch.size(); ++p)
+            ++local[cellIndex(batch[p])];
+          batch.clear();
+        }
+
+        std::lock_guard<std::mutex> lock(countMutex);
+        for (size_t c = 0; c < counts.size(); ++c)
+          counts[c] += local[c];
+      },
+      threads);
+  if (!error.empty())
+    return false;
+  for (size_t c = 0; c < counts.size(); ++c)
+    report.points += counts[c];
+  report.countSeconds = secondsSince(start);
+
+  // Sum the grid into a pyramid and cut it into chunks top-down
+  std::vector<std::vector<uint64_t>> pyramid(gridLevel + 1);
+  pyramid[gridLevel].swap(counts);
+  for (int l = gridLevel - 1; l >= 0; --l) {
+    int n = 1 << l;
+    pyramid[l].assign((size_t)n * n * n, 0);
+    for (int x = 0; x < 2 * n; ++x)
+      for (int y = 0; y < 2 * n; ++y)
+        for (int z = 0; z < 2 * n; ++z)
+          pyramid[l][((size_t)(x / 2) * n + y / 2) * n + z / 2] +=
+              pyramid[l + 1][((size_t)x * 2 * n + y) * 2 * n + z];
+  }
+
+  std::string tempDir = joinPath(opt.outputDir, "partition_tmp");
+  makeDirectory(tempDir);
+
+  std::vector<Chunk> chunks;
+  std::vector<int> cellChunk((size_t)cells * cells * cells, -1);
+  std::function<void(int, int, int, int, const std::string &)> selectChunks =
+      [&](int l, int x, int y, int z, const std::string &name) {
+        int n = 1 << l;
+        uint64_t count = pyramid[l][((size_t)x * n + y) * n + z];
+        if (count == 0)
+          return;
+        if (count > opt.maxChunkPoints && l < gridLevel) {
+          for (int c = 0; c < 8; ++c)
+            selectChunks(l + 1, 2 * x + (c >> 2), 2 * y + ((c >> 1) & 1),
+                   2 * z + (c & 1), name + (char)('0' + c));
+          return;
+        }
+
+        Chunk chunk;
+        chunk.name = name;
+        chunk.count = count;
+        chunk.tempPath = joinPath(tempDir, name + ".bin");
+        int span = 1 << (gridLevel - l);
+        for (int cx = x * span; cx < (x + 1) * span; ++cx)
+          for (int cy = y * span; cy < (y + 1) * span; ++cy)
+            for (int cz = z * span; cz < (z + 1) * span; ++cz)
+              cellChunk[((size_t)cx * cells + cy) * cells + cz] =
+                  (int)chunks.size();
+        chunks.push_back(chunk);
+      };
+  selectChunks(0, 0, 0, 0, "r");
+  std::vector<std::vector<uint64_t>>().swap(pyramid);
+  report.chunks = chunks.size();
+
+  // Pass 2: append every point to its chunk's temporary file
+  Clock::time_point partitionStart = Clock::now();
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    FILE *f = fopen(chunks[c].tempPath.c_str(), "wb");
+    if (!f) {
+      error = "cannot create " + chunks[c].tempPath;
+      return false;
+    }
+    fclose(f);
+  }
+
+  std::vector<std::mutex> chunkLocks(chunks.size());
+  size_t bufferBudget = std::max<size_t>(opt.bufferPoints / threads, 1);
+  parallelFor(
+      opt.inputs.size(),
+      [&](size_t i) {
+        std::unique_ptr<PointReader> reader = createPointReader(opt.inputs[i]);
+        if (!reader->open(opt.inputs[i])) {
+          setError(reader->getError());
+          return;
+        }
+        reader->setOrigin(origin[0], origin[1], origin[2]);
+
+        std::vector<std::vector<Point3D>> buffers(chunks.size());
+        size_t buffered = 0;
+        auto flush = [&]() {
+          for (size_t c = 0; c < buffers.size(); ++c) {
+            if (buffers[c].empty())
+              continue;
+            std::lock_guard<std::mutex> lock(chunkLocks[c]);
+            FILE *f = fopen(chunks[c].tempPath.c_str(), "ab");
+            if (!f || fwrite(buffers[c].data(), sizeof(Point3D),
+                             buffers[c].size(), f) != buffers[c].size())
+              setError("cannot write " + chunks[c].tempPath);
+            if (f)
+              fclose(f);
+            std::vector<Point3D>().swap(buffers[c]);
+          }
+          buffered = 0;
+        };
+
+        std::vector<Point3D> batch;
+        while (reader->read(batch, READ_BATCH) > 0) {
+          for (size_t p = 0; p < batch.size(); ++p)
+            buffers[cellChunk[cellIndex(batch[p])]].push_back(batch[p]);
+          buffered += batch.size();
+          batch.clear();
+          if (buffered >= bufferBudget)
+            flush();
+        }
+        flush();
+      },
+      threads);
+  if (!error.empty())
+    return false;
+  report.partitionSeconds = secondsSince(partitionStart);
+
+  // Pass 3: one subtree per chunk, largest first for better balance
+  Clock::time_point indexStart = Clock::now();
+  std::vector<size_t> order(chunks.size());
+  for (size_t c = 0; c < order.size(); ++c)
+    order[c] = c;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return chunks[a].count > chunks[b].count;
+  });
+
+  std::vector<std::vector<NodeRecord>> chunkRecords(chunks.size());
+  std::vector<std::vector<Point3D>> chunkSamples(chunks.size());
+  parallelFor(
+      order.size(),
+      [&](size_t o) {
+        size_t c = order[o];
+        const Chunk &chunk = chunks[c];
+        std::vector<Point3D> points((size_t)chunk.count);
+        bool ok = readFileRange(chunk.tempPath, 0,
+                                points.size() * sizeof(Point3D),
+                                points.data());
+        remove(chunk.tempPath.c_str());
+        if (!ok) {
+          setError("cannot read " + chunk.tempPath);
+          return;
+        }
+
+        char fileName[32];
+        snprintf(fileName, sizeof(fileName), "data_%zu.bin", c);
+        std::string path = joinPath(opt.outputDir, fileName);
+        NodeWriter writer = {fopen(path.c_str(), "wb"), (int)c + 1, 0,
+                             codec, std::vector<NodeRecord>(),
+                             std::vector<uint8_t>()};
+        if (!writer.file) {
+          setError("cannot create " + path);
+          return;
+        }
+
+        float min[3], max[3];
+        getOctreeNodeBounds(chunk.name, cubeMin, size, min, max);
+        float chunkSize = max[0] - min[0];
+
+        // The levels above are built from this chunk at half resolution
+        subsample(points, min, chunkSize, opt.gridResolution / 2,
+                  chunkSamples[c], NULL);
+
+        if (!buildNode(chunk.name, min, chunkSize, points, opt, writer))
+          setError("cannot write " + path);
+        fclose(writer.file);
+        chunkRecords[c].swap(writer.records);
+      },
+      threads);
+  removeDirectory(tempDir);
+  if (!error.empty())
+    return false;
+
+  // Levels above the chunks: every node subsamples its children's samples.
+  // These points duplicate points stored in the chunks.
+  std::string topPath = joinPath(opt.outputDir, "data_top.bin");
+  NodeWriter top = {fopen(topPath.c_str(), "wb"), 0, 0, codec,
+                    std::vector<NodeRecord>(), std::vector<uint8_t>()};
+  if (!top.file) {
+    error = "cannot create " + topPath;
+    return false;
+  }
+
+  std::map<std::string, std::vector<Point3D>> samples;
+  for (size_t c = 0; c < chunks.size(); ++c)
+    samples[chunks[c].name].swap(chunkSamples[c]);
+  for (int level = MAX_GRID_LEVEL; level > 0; --level) {
+    std::map<std::string, std::vector<Point3D>> parents;
+    for (auto it = samples.begin(); it != samples.end();) {
+      if ((int)it->first.size() - 1 != level) {
+        ++it;
+        continue;
+      }
+      std::vector<Point3D> &parent =
+          parents[it->first.substr(0, it->first.size() - 1)];
+      parent.insert(parent.end(), it->second.begin(), it->second.end());
+      it = samples.erase(it);
+    }
+
+    for (auto it = parents.begin(); it != parents.end(); ++it) {
+      float min[3], max[3];
+      getOctreeNodeBounds(it->first, cubeMin, size, min, max);
+      std::vector<Point3D> kept;
+      subsample(it->second, min, max[0] - min[0], opt.gridResolution, kept,
+                NULL);
+      if (!top.write(it->first, kept)) {
+        error = "cannot write " + topPath;
+        fclose(top.file);
+        return false;
+      }
+      subsample(kept, min, max[0] - min[0], opt.gridResolution / 2,
+                samples[it->first], NULL);
+    }
+  }
+  fclose(top.file);
+
+  // Hierarchy: header, data files, then one line per node
+  std::string hierarchyPath =
+      joinPath(opt.outputDir, OctreeDataset::getHierarchyFileName());
+  FILE *f = fopen(hierarchyPath.c_str(), "w");
+  if (!f) {
+    error = "cannot create " + hierarchyPath;
+    return false;
+  }
+  fprintf(f, "lidar_octree 1\n");
+  fprintf(f, "origin %.6f %.6f %.6f\n", origin[0], origin[1], origin[2]);
+  fprintf(f, "cube %.6f %.6f %.6f %.6f\n", cubeMin[0], cubeMin[1], cubeMin[2],
+          size);
+  fprintf(f, "points %llu\n", (unsigned long long)report.points);
+  if (codec)
+    fprintf(f, "encoding lpc\n");
+  fprintf(f, "file data_top.bin\n");
+  for (size_t c = 0; c < chunks.size(); ++c)
+    fprintf(f, "file data_%zu.bin\n", c);
+
+  chunkRecords.push_back(top.records);
+  for (size_t c = 0; c < chunkRecords.size(); ++c) {
+    for (size_t n = 0; n < chunkRecords[c].size(); ++n) {
+      const NodeRecord &r = chunkRecords[c][n];
+      fprintf(f, "node %s %d %llu %u", r.name.c_str(), r.file,
+              (unsigned long long)r.offset, r.count);
+      // Raw node sizes follow from the count
+      if (codec)
+        fprintf(f, " %llu", (unsigned long long)r.size);
+      fprintf(f, "\n");
+      report.storedBytes += r.size;
+      report.depth = std::max(report.depth, (int)r.name.size() - 1);
+      ++report.nodes;
+    }
+  }
+  bool ok = fclose(f) == 0;
+  if (!ok)
+    error = "cannot write " + hierarchyPath;
+
+  report.indexSeconds = secondsSince(indexStart);
+  report.peakResidentBytes = MemoryStats::getProcessPeakResidentBytes();
+  return ok;
+}
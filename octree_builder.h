@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct OctreeBuildOptions {
+  std::vector<std::string> inputs;
+  std::string outputDir;
+  size_t maxChunkPoints;  // Points per independently processed subtree
+  size_t nodeCapacity;    // Nodes with fewer points become leaves
+  int gridResolution;     // Subsampling cells along each node axis
+  size_t bufferPoints;    // Points held in partition buffers before flushing
+  unsigned threads;       // 0 = all cores
+  bool compress;          // Store nodes as point codec blocks
+  float precision;        // Position step of compressed nodes
+
+  OctreeBuildOptions()
+      : maxChunkPoints(5000000), nodeCapacity(20000), gridResolution(128),
+        bufferPoints(4000000), threads(0), compress(false),
+        precision(0.001f) {}
+};
+
+struct OctreeBuildReport {
+  uint64_t points;
+  size_t chunks;
+  size_t nodes;
+  int depth;
+  double countSeconds;     // Header scan and counting grid
+  double partitionSeconds; // Distributing points to chunk files
+  double indexSeconds;     // Per-chunk subsampling and upper levels
+  size_t peakResidentBytes;
+  uint64_t storedBytes; // Node data written to the data files
+};
+
+// Converts point files into the tiled octree read by OctreeDataset.
+// Memory use is bounded by the partition buffers and the largest chunk,
+// so input size is limited by disk space only.
+//
+//  1. Count points into a regular grid over the cube bounding all inputs
+//  2. Merge grid cells into octree chunks of at most maxChunkPoints and
+//     append every point to its chunk's temporary file
+//  3. Build each chunk's subtree in parallel: nodes keep one point per
+//     subsampling cell and pass the rest on to their children
+//  4. Build the levels above the chunks from subsamples of the chunk roots
+bool buildOctree(const OctreeBuildOptions &options, OctreeBuildReport &report,
+                 std::string &error);
@@ -0,0 +1,233 @@
+#include "octree_dataset.h"
+#include "file_utils.h"
+#include "parallel.h"
+#include "point_codec.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <stdio.h>
+
+void getOctreeNodeBounds(const std::string &name, const float rootMin[3],
+                         float rootSize, float min[3], float max[3]) {
+  float size = rootSize;
+  for (int i = 0; i < 3; ++i)
+    min[i] = rootMin[i];
+
+  // Child digit bits: 4 = upper x half, 2 = upper y half, 1 = upper z half
+  for (size_t i = 1; i < name.size(); ++i) {
+    int child = name[i] - '0';
+    size *= 0.5f;
+    if (child & 4)
+      min[0] += size;
+    if (child & 2)
+      min[1] += size;
+    if (child & 1)
+      min[2] += size;
+  }
+  for (int i = 0; i < 3; ++i)
+    max[i] = min[i] + size;
+}
+
+OctreeDataset::OctreeDataset() : totalPoints(0), compressed(false) {
+  origin[0] = origin[1] = origin[2] = 0.0;
+}
+
+bool OctreeDataset::open(const std::string &dir) {
+  directory = dir;
+  dataFiles.clear();
+  nodes.clear();
+  totalPoints = 0;
+  compressed = false;
+
+  std::string path = joinPath(dir, getHierarchyFileName());
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  char key[64];
+  int version = 0;
+  float cubeMin[3] = {0, 0, 0}, cubeSize = 0;
+  bool ok = fscanf(f, "%63s %d", key, &version) == 2 &&
+            !strcmp(key, "lidar_octree") && version == 1;
+
+  while (ok && fscanf(f, "%63s", key) == 1) {
+    if (!strcmp(key, "origin")) {
+      ok = fscanf(f, "%lf %lf %lf", &origin[0], &origin[1], &origin[2]) == 3;
+    } else if (!strcmp(key, "cube")) {
+      ok = fscanf(f, "%f %f %f %f", &cubeMin[0], &cubeMin[1], &cubeMin[2],
+                  &cubeSize) == 4;
+    } else if (!strcmp(key, "points")) {
+      unsigned long long points = 0;
+      ok = fscanf(f, "%llu", &points) == 1;
+      totalPoints = points;
+    } else if (!strcmp(key, "encoding")) {
+      char encoding[32];
+      ok = fscanf(f, "%31s", encoding) == 1 &&
+           (!strcmp(encoding, "raw") || !strcmp(encoding, "lpc"));
+      compressed = ok && !strcmp(encoding, "lpc");
+    } else if (!strcmp(key, "file")) {
+      char name[256];
+      ok = fscanf(f, "%255s", name) == 1;
+      dataFiles.push_back(name);
+    } else if (!strcmp(key, "node")) {
+      char name[64];
+      unsigned long long offset = 0;
+      OctreeNode node;
+      ok = fscanf(f, "%63s %d %llu %u", name, &node.file, &offset,
+                  &node.count) == 4 &&
+           node.file >= 0 && node.file < (int)dataFiles.size();
+      // Encoded nodes carry their stored size as a fifth field
+      unsigned long long size = node.count * sizeof(Point3D);
+      if (ok && compressed)
+        ok = fscanf(f, "%llu", &size) == 1;
+      node.name = name;
+      node.level = (int)node.name.size() - 1;
+      node.offset = offset;
+      node.size = size;
+      node.parent = -1;
+      getOctreeNodeBounds(node.name, cubeMin, cubeSize, node.min, node.max);
+      nodes.push_back(node);
+    } else {
+      // Unknown keys from newer writers: skip the rest of the line
+      int c;
+      while ((c = fgetc(f)) != EOF && c != '\n') {
+      }
+    }
+  }
+  fclose(f);
+
+  if (!ok || nodes.empty()) {
+    error = "invalid hierarchy in " + path;
+    nodes.clear();
+    return false;
+  }
+
+  std::sort(nodes.begin(), nodes.end(),
+            [](const OctreeNode &a, const OctreeNode &b) {
+              return a.level != b.level ? a.level < b.level : a.name < b.name;
+            });
+
+  std::map<std::string, int> byName;
+  for (size_t i = 0; i < nodes.size(); ++i)
+    byName[nodes[i].name] = (int)i;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].level > 0) {
+      std::map<std::string, int>::const_iterator it =
+          byName.find(nodes[i].name.substr(0, nodes[i].name.size() - 1));
+      if (it != byName.end())
+        nodes[i].parent = it->second;
+    }
+  }
+  return true;
+}
+
+bool OctreeDataset::loadNode(size_t index, std::vector<Point3D> &out) const {
+  if (index >= nodes.size())
+    return false;
+
+  const OctreeNode &node = nodes[index];
+  if (node.count == 0)
+    return true;
+
+  std::string path = joinPath(directory, dataFiles[node.file]);
+  if (compressed) {
+    std::vector<uint8_t> block((size_t)node.size);
+    return readFileRange(path, node.offset, node.size, block.data()) &&
+           decodePoints(block.data(), block.size(), out);
+  }
+
+  size_t first = out.size();
+  out.resize(first + node.count);
+  if (!readFileRange(path, node.offset, node.size, &out[first])) {
+    out.resize(first);
+    return false;
+  }
+  return true;
+}
+
+bool OctreeDataset::loadNodes(const std::vector<size_t> &indices,
+                              std::vector<std::vector<Point3D>> &out,
+                              AsyncFileReader &reader) const {
+  out.assign(indices.size(), std::vector<Point3D>());
+
+  std::vector<int> handles(dataFiles.size(), -1);
+  bool ok = true;
+  for (size_t i = 0; i < indices.size() && ok; ++i) {
+    if (indices[i] >= nodes.size()) {
+      ok = false;
+      break;
+    }
+    const OctreeNode &node = nodes[indices[i]];
+    if (node.count == 0)
+      continue;
+    int &handle = handles[node.file];
+    if (handle < 0)
+      handle = reader.openFile(joinPath(directory, dataFiles[node.file]));
+    if (handle < 0) {
+      ok = false;
+      break;
+    }
+    reader.read(handle, node.offset, node.size, i);
+  }
+  reader.submit();
+
+  // Decode each batch of completions in parallel while later reads are
+  // still in flight
+  std::atomic<bool> failed(!ok);
+  std::vector<ReadCompletion> batch;
+  while (reader.getOutstanding() > 0) {
+    batch.clear();
+    reader.poll(batch, true);
+    parallelFor(batch.size(), [&](size_t b) {
+      const ReadCompletion &read = batch[b];
+      if (read.error != 0) {
+        failed = true;
+        return;
+      }
+      std::vector<Point3D> &points = out[read.tag];
+      if (compressed) {
+        if (!decodePoints((const uint8_t *)read.data(), read.size, points))
+          failed = true;
+        return;
+      }
+      points.resize(read.size / sizeof(Point3D));
+      memcpy(points.data(), read.data(), points.size() * sizeof(Point3D));
+    });
+  }
+
+  for (size_t i = 0; i < handles.size(); ++i)
+    reader.closeFile(handles[i]);
+  return !failed;
+}
+
+size_t OctreeDataset::loadOverview(size_t pointBudget,
+                                   std::vector<Point3D> &out) const {
+  size_t loaded = 0, points = 0;
+  while (loaded < nodes.size()) {
+    // Take the next level only if all of it fits
+    size_t end = loaded;
+    size_t levelPoints = 0;
+    while (end < nodes.size() && nodes[end].level == nodes[loaded].level)
+      levelPoints += nodes[end++].count;
+    if (loaded > 0 && points + levelPoints > pointBudget)
+      break;
+    points += levelPoints;
+    loaded = end;
+  }
+
+  std::vector<size_t> indices(loaded);
+  for (size_t i = 0; i < loaded; ++i)
+    indices[i] = i;
+  AsyncFileReader reader;
+  reader.init();
+  std::vector<std::vector<Point3D>> nodePoints;
+  loadNodes(indices, nodePoints, reader);
+
+  out.reserve(out.size() + points);
+  for (size_t i = 0; i < nodePoints.size(); ++i)
+    out.insert(out.end(), nodePoints[i].begin(), nodePoints[i].end());
+  return loaded;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "async_reader.h"
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One node of a converted octree. Nodes are additive: a node holds a
+// subsample of its region and its children hold the remaining points.
+struct OctreeNode {
+  std::string name;     // "r" for the root, then one child digit per level
+  int level;
+  float min[3], max[3]; // Node cube in viewer coordinates
+  int file;             // Index into the dataset's data files
+  uint64_t offset;      // Byte offset of the node's points in that file
+  uint64_t size;        // Stored bytes, smaller than the points if encoded
+  uint32_t count;
+  int parent;           // Index of the parent node, -1 for the root
+};
+
+// Reader for the tiled octree datasets written by lidar_convert.
+// Only the hierarchy is read on open(); node points are loaded on demand.
+class OctreeDataset {
+public:
+  OctreeDataset();
+
+  bool open(const std::string &dir);
+  bool isOpen() const { return !nodes.empty(); }
+  const std::string &getError() const { return error; }
+
+  // Nodes in breadth-first order (by level, then name)
+  const std::vector<OctreeNode> &getNodes() const { return nodes; }
+  uint64_t getTotalPoints() const { return totalPoints; }
+
+  // Nodes are point codec blocks rather than raw Point3D arrays
+  bool isCompressed() const { return compressed; }
+
+  // File coordinates of the viewer origin (see fileToViewer)
+  const double *getOrigin() const { return origin; }
+
+  // Append a node's points to out
+  bool loadNode(size_t index, std::vector<Point3D> &out) const;
+
+  // Load many nodes through batched asynchronous reads, decoding each on a
+  // worker thread as its read completes; out[i] receives indices[i]
+  bool loadNodes(const std::vector<size_t> &indices,
+                 std::vector<std::vector<Point3D>> &out,
+                 AsyncFileReader &reader) const;
+
+  // Load whole levels from the root down while they fit in the budget;
+  // returns the number of nodes loaded
+  size_t loadOverview(size_t pointBudget, std::vector<Point3D> &out) const;
+
+  static const char *getHierarchyFileName() { return "hierarchy.txt"; }
+
+private:
+  std::string directory;
+  std::vector<std::string> dataFiles;
+  std::vector<OctreeNode> nodes;
+  uint64_t totalPoints;
+  bool compressed;
+  double origin[3];
+  std::string error;
+};
+
+// Cube of a node given the root cube and the node's name
+void getOctreeNodeBounds(const std::string &name, const float rootMin[3],
+                         float rootSize, float min[3], float max[3]);
@@ -0,0 +1,193 @@
+#include "octree_streamer.h"
+#include "frustum.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t MAX_BATCH_NODES = 64;
+const uint64_t MAX_BATCH_POINTS = 4000000;
+
+// Bounding sphere of a box seen from the eye, in pixels; capped once the
+// eye is inside it
+float getScreenSize(const OctreeNode &node, const float eye[3],
+                    float pixelsPerUnit) {
+  float radius = 0.0f, center = 0.0f;
+  for (int a = 0; a < 3; ++a) {
+    float half = (node.max[a] - node.min[a]) * 0.5f;
+    float offset = node.min[a] + half - eye[a];
+    radius += half * half;
+    center += offset * offset;
+  }
+  radius = std::sqrt(radius);
+  return 2.0f * radius * pixelsPerUnit / std::max(std::sqrt(center), radius);
+}
+
+} // namespace
+
+OctreeStreamer::OctreeStreamer(const OctreeDataset &dataset,
+                               size_t overviewNodes)
+    : dataset(dataset), overviewNodes(overviewNodes),
+      children(dataset.getNodes().size()), pointBudget(20000000),
+      minNodePixels(100.0f), loadedPoints(0), deepestLevel(0),
+      stopping(false) {
+  const std::vector<OctreeNode> &nodes = dataset.getNodes();
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].parent >= 0)
+      children[nodes[i].parent].push_back(i);
+    if (i < overviewNodes)
+      deepestLevel = std::max(deepestLevel, nodes[i].level);
+  }
+  reader.init();
+  worker = std::thread(&OctreeStreamer::workerLoop, this);
+}
+
+OctreeStreamer::~OctreeStreamer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  worker.join();
+}
+
+size_t OctreeStreamer::getPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return batch.size();
+}
+
+void OctreeStreamer::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this]() { return stopping || !batch.empty(); });
+    if (stopping)
+      return;
+
+    std::vector<size_t> indices = batch;
+    lock.unlock();
+    std::vector<std::vector<Point3D>> points;
+    bool ok = dataset.loadNodes(indices, points, reader);
+    lock.lock();
+
+    // A failed batch still delivers the nodes that did load
+    for (size_t i = 0; i < indices.size(); ++i) {
+      if (ok || !points[i].empty() ||
+          dataset.getNodes()[indices[i]].count == 0)
+        done.push_back(LoadedNode(indices[i], std::move(points[i])));
+      else
+        doneFailed.push_back(indices[i]);
+    }
+    batch.clear();
+  }
+}
+
+void OctreeStreamer::update(PointCloudRenderer &renderer, int width,
+                            int height) {
+  const std::vector<OctreeNode> &nodes = dataset.getNodes();
+  if (nodes.empty())
+    return;
+
+  // Apply the batch that finished since the last frame. Only an idle
+  // worker gets a new batch, so nothing is requested twice.
+  std::vector<LoadedNode> finished;
+  std::vector<size_t> newlyFailed;
+  bool idle;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.swap(done);
+    newlyFailed.swap(doneFailed);
+    idle = batch.empty();
+  }
+  failed.insert(newlyFailed.begin(), newlyFailed.end());
+  for (size_t i = 0; i < finished.size(); ++i) {
+    size_t id = finished[i].first;
+    if (!wanted.count(id) || loaded.count(id))
+      continue;
+    renderer.addChunk((int)id, finished[i].second);
+    loaded.insert(id);
+    loadedPoints += nodes[id].count;
+    deepestLevel = std::max(deepestLevel, nodes[id].level);
+  }
+
+  // Walk the hierarchy, largest on screen first
+  const Camera &camera = renderer.getCamera();
+  Frustum frustum;
+  frustum.setFromCamera(camera, width, height);
+  float eye[3];
+  camera.getEyePosition(eye[0], eye[1], eye[2]);
+  float pixelsPerUnit =
+      height * 0.5f / std::tan(camera.fov * 3.14159265f / 360.0f);
+
+  wanted.clear();
+  missing.clear();
+  heap.clear();
+  uint64_t wantedPoints = 0;
+  if (frustum.intersectsBox(nodes[0].min, nodes[0].max))
+    heap.push_back(std::make_pair(getScreenSize(nodes[0], eye, pixelsPerUnit),
+                                  (size_t)0));
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end());
+    size_t index = heap.back().second;
+    heap.pop_back();
+    const OctreeNode &node = nodes[index];
+    if (index >= overviewNodes) {
+      if (failed.count(index))
+        continue; // Nor its children, which would float without it
+      if (wantedPoints + node.count > pointBudget)
+        break;
+      wanted.insert(index);
+      wantedPoints += node.count;
+      if (!loaded.count(index))
+        missing.push_back(index);
+    }
+    for (size_t c = 0; c < children[index].size(); ++c) {
+      const OctreeNode &child = nodes[children[index][c]];
+      if (!frustum.intersectsBox(child.min, child.max))
+        continue;
+      float size = getScreenSize(child, eye, pixelsPerUnit);
+      if (size < minNodePixels)
+        continue;
+      heap.push_back(std::make_pair(size, children[index][c]));
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+
+  // The next batch: the most important missing nodes
+  uint64_t incoming = 0;
+  if (idle && !missing.empty()) {
+    std::vector<size_t> next;
+    for (size_t i = 0; i < missing.size() && next.size() < MAX_BATCH_NODES;
+         ++i) {
+      uint64_t count = nodes[missing[i]].count;
+      if (!next.empty() && incoming + count > MAX_BATCH_POINTS)
+        break;
+      next.push_back(missing[i]);
+      incoming += count;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      batch.swap(next);
+    }
+    wake.notify_one();
+  }
+
+  // Nodes out of view stay resident until the budget needs their room,
+  // farthest first
+  std::vector<std::pair<float, size_t>> unwanted;
+  for (std::set<size_t>::const_iterator it = loaded.begin();
+       it != loaded.end(); ++it) {
+    if (!wanted.count(*it)) {
+      const OctreeNode &node = nodes[*it];
+      unwanted.push_back(
+          std::make_pair(distanceToBox(eye, node.min, node.max), *it));
+    }
+  }
+  std::sort(unwanted.rbegin(), unwanted.rend());
+  for (size_t i = 0;
+       i < unwanted.size() && loadedPoints + incoming > pointBudget; ++i) {
+    size_t id = unwanted[i].second;
+    renderer.removeChunk((int)id);
+    loaded.erase(id);
+    loadedPoints -= nodes[id].count;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "async_reader.h"
+#include "octree_dataset.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Refines an octree dataset around the camera. Each frame the hierarchy is
+// walked from the root, largest nodes on screen first: visible nodes are
+// wanted until the point budget is spent, and children are only visited
+// while they cover at least minNodePixels. Wanted nodes that are missing
+// are loaded in batches through OctreeDataset::loadNodes on a background
+// thread, so one batch issues all its reads at once; results are added to
+// the renderer as chunks keyed by node index.
+//
+// The first nodes (the overview already in the renderer's point cloud)
+// count as always shown. Nodes that fail to load are not retried until the
+// streamer is recreated.
+class OctreeStreamer {
+public:
+  OctreeStreamer(const OctreeDataset &dataset, size_t overviewNodes);
+  ~OctreeStreamer();
+
+  void setPointBudget(uint64_t points) { pointBudget = points; }
+  uint64_t getPointBudget() const { return pointBudget; }
+  void setMinNodePixels(float pixels) { minNodePixels = pixels; }
+  float getMinNodePixels() const { return minNodePixels; }
+
+  // Call once per frame before rendering
+  void update(PointCloudRenderer &renderer, int width, int height);
+
+  size_t getWantedCount() const { return wanted.size(); }
+  size_t getLoadedCount() const { return loaded.size(); }
+  size_t getPendingCount() const;
+  uint64_t getLoadedPoints() const { return loadedPoints; }
+  size_t getFailedCount() const { return failed.size(); }
+  int getDeepestLevel() const { return deepestLevel; }
+
+private:
+  typedef std::pair<size_t, std::vector<Point3D>> LoadedNode;
+
+  void workerLoop();
+
+  const OctreeDataset &dataset;
+  size_t overviewNodes;
+  std::vector<std::vector<size_t>> children;
+  uint64_t pointBudget;
+  float minNodePixels;
+
+  std::set<size_t> wanted;
+  std::set<size_t> loaded;
+  std::set<size_t> failed;
+  uint64_t loadedPoints;
+  int deepestLevel; // Deepest level shown so far
+
+  // Scratch for update
+  std::vector<std::pair<float, size_t>> heap;
+  std::vector<size_t> missing;
+
+  // Background loading: one batch at a time
+  std::thread worker;
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+  std::vector<size_t> batch;      // Handed to the worker, not yet loaded
+  std::vector<LoadedNode> done;   // Loaded, not yet applied
+  std::vector<size_t> doneFailed; // Failed, not yet applied
+  AsyncFileReader reader;         // Used by the worker only
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use by default (at least 1)
+inline unsigned getWorkerCount() {
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Run fn(i) for every i in [0, count) on up to `threads` threads (0 = all
+// cores). Indices are handed out one at a time, so uneven work balances.
+template <class Fn>
+void parallelFor(size_t count, Fn fn, unsigned threads = 0) {
+  if (threads == 0)
+    threads = getWorkerCount();
+  threads = (unsigned)std::min<size_t>(threads, count);
+
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; ++i)
+      fn(i);
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&]() {
+      for (size_t i = next++; i < count; i = next++)
+        fn(i);
+    }));
+  }
+  for (size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+}
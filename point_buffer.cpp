@@ -0,0 +1,283 @@
+#include "point_buffer.h"
+#include "gl_ext.h"
+#include "gl_stats.h"
+#include "voxel_map.h"
+
+StreamingPointBuffer::StreamingPointBuffer() : front(0), uploads(0) {
+  buffers[0] = buffers[1] = 0;
+  capacity[0] = capacity[1] = 0;
+  counts[0] = counts[1] = 0;
+}
+
+void StreamingPointBuffer::upload(const std::vector<Point3D> &points) {
+  size_t bytes = points.size() * sizeof(Point3D);
+  ++uploads;
+  GLStats::countUpload(bytes);
+
+  if (!hasGLBufferFunctions()) {
+    clientPoints.assign(points.begin(), points.end());
+    counts[front] = points.size();
+    return;
+  }
+
+  const GLBufferFunctions &gl = getGLBufferFunctions();
+  if (buffers[0] == 0)
+    gl.genBuffers(2, buffers);
+
+  int back = 1 - front;
+  gl.bindBuffer(GL_ARRAY_BUFFER, buffers[back]);
+  if (bytes > capacity[back]) {
+    // Grow with headroom so sweeps of varying size reuse the allocation
+    size_t grown = bytes + bytes / 4;
+    gl.bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)grown, NULL, GL_STREAM_DRAW);
+    if (capacity[back] > 0)
+      MemoryStats::remove(MEM_GPU_BUFFERS, capacity[back]);
+    MemoryStats::add(MEM_GPU_BUFFERS, grown);
+    capacity[back] = grown;
+  }
+  if (bytes > 0)
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, (ptrdiff_t)bytes, points.data());
+  gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  counts[back] = points.size();
+  front = back;
+}
+
+namespace {
+
+// Point3D is x, y, z, r, g, b, intensity: interleaved position and color.
+// base is NULL for the bound buffer.
+void drawInterleaved(const Point3D *base, size_t first, size_t count) {
+  const char *bytes = (const char *)base;
+  glVertexPointer(3, GL_FLOAT, sizeof(Point3D), bytes);
+  glColorPointer(3, GL_FLOAT, sizeof(Point3D), bytes + 3 * sizeof(float));
+  gliDrawArrays(GL_POINTS, (GLint)first, (GLsizei)count);
+}
+
+void beginPoints(float pointSize) {
+  gliEnable(GL_DEPTH_TEST);
+  gliEnable(GL_POINT_SMOOTH);
+  gliPointSize(pointSize);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+}
+
+void endPoints() {
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  gliDisable(GL_POINT_SMOOTH);
+}
+
+} // namespace
+
+void StreamingPointBuffer::draw(float pointSize) const {
+  size_t count = counts[front];
+  if (count == 0)
+    return;
+
+  beginPoints(pointSize);
+  if (buffers[0] != 0) {
+    getGLBufferFunctions().bindBuffer(GL_ARRAY_BUFFER, buffers[front]);
+    drawInterleaved(NULL, 0, count);
+    getGLBufferFunctions().bindBuffer(GL_ARRAY_BUFFER, 0);
+  } else {
+    drawInterleaved(clientPoints.data(), 0, count);
+  }
+  endPoints();
+}
+
+void StreamingPointBuffer::release() {
+  if (buffers[0] != 0 && hasGLBufferFunctions())
+    getGLBufferFunctions().deleteBuffers(2, buffers);
+  for (int i = 0; i < 2; ++i) {
+    if (capacity[i] > 0)
+      MemoryStats::remove(MEM_GPU_BUFFERS, capacity[i]);
+    buffers[i] = 0;
+    capacity[i] = counts[i] = 0;
+  }
+  clientPoints.clear();
+  clientPoints.shrink_to_fit();
+}
+
+VoxelMapBuffer::VoxelMapBuffer() : points(0), lastUploads(0) {}
+
+void VoxelMapBuffer::update(VoxelMap &map) {
+  map.takeDirtyBlocks(dirty);
+  lastUploads = dirty.size();
+  if (dirty.empty())
+    return;
+
+  bool useBuffers = hasGLBufferFunctions();
+  for (size_t i = 0; i < dirty.size(); ++i) {
+    if (!map.getBlockPoints(dirty[i], scratch))
+      continue;
+    Block &block = blocks[dirty[i]];
+    points += scratch.size() - block.count;
+    block.count = scratch.size();
+
+    size_t bytes = scratch.size() * sizeof(Point3D);
+    GLStats::countUpload(bytes);
+    if (!useBuffers) {
+      block.clientPoints.swap(scratch);
+      continue;
+    }
+
+    const GLBufferFunctions &gl = getGLBufferFunctions();
+    if (block.buffer == 0)
+      gl.genBuffers(1, &block.buffer);
+    gl.bindBuffer(GL_ARRAY_BUFFER, block.buffer);
+    if (bytes > block.capacity) {
+      // Blocks only gain points; headroom spares a reallocation per sweep
+      size_t grown = bytes + bytes / 2;
+      gl.bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)grown, NULL, GL_STATIC_DRAW);
+      if (block.capacity > 0)
+        MemoryStats::remove(MEM_GPU_BUFFERS, block.capacity);
+      MemoryStats::add(MEM_GPU_BUFFERS, grown);
+      block.capacity = grown;
+    }
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, (ptrdiff_t)bytes, scratch.data());
+  }
+  if (useBuffers)
+    getGLBufferFunctions().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VoxelMapBuffer::draw(float pointSize) const {
+  if (points == 0)
+    return;
+
+  beginPoints(pointSize);
+  std::unordered_map<uint64_t, Block>::const_iterator it;
+  for (it = blocks.begin(); it != blocks.end(); ++it) {
+    const Block &block = it->second;
+    if (block.buffer != 0) {
+      getGLBufferFunctions().bindBuffer(GL_ARRAY_BUFFER, block.buffer);
+      drawInterleaved(NULL, 0, block.count);
+    } else {
+      drawInterleaved(block.clientPoints.data(), 0, block.count);
+    }
+  }
+  if (hasGLBufferFunctions())
+    getGLBufferFunctions().bindBuffer(GL_ARRAY_BUFFER, 0);
+  endPoints();
+}
+
+void VoxelMapBuffer::release() {
+  std::unordered_map<uint64_t, Block>::iterator it;
+  for (it = blocks.begin(); it != blocks.end(); ++it) {
+    if (it->second.buffer != 0 && hasGLBufferFunctions())
+      getGLBufferFunctions().deleteBuffers(1, &it->second.buffer);
+    if (it->second.capacity > 0)
+      MemoryStats::remove(MEM_GPU_BUFFERS, it->second.capacity);
+  }
+  blocks.clear();
+  points = 0;
+}
+
+TimedPointBuffer::TimedPointBuffer() : drawn(0) {}
+
+bool TimedPointBuffer::canFade() const {
+  return getGLBufferFunctions().fogCoordPointer != NULL;
+}
+
+void TimedPointBuffer::upload(const TimeIndex &index,
+                              const std::vector<Point3D> &points) {
+  const std::vector<TimeIndex::Chunk> &indexChunks = index.getChunks();
+  const std::vector<float> &times = index.getTimes();
+  GLStats::countUpload(points.size() * (sizeof(Point3D) + sizeof(float)));
+  if (!hasGLBufferFunctions()) {
+    clientPoints.assign(points.begin(), points.end());
+    return;
+  }
+
+  const GLBufferFunctions &gl = getGLBufferFunctions();
+  if (chunks.size() != indexChunks.size()) {
+    release();
+    chunks.resize(indexChunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      chunks[i].buffer = 0;
+      chunks[i].capacity = 0;
+    }
+  }
+  for (size_t i = 0; i < indexChunks.size(); ++i) {
+    const TimeIndex::Chunk &c = indexChunks[i];
+    size_t pointBytes = c.count * sizeof(Point3D);
+    size_t bytes = pointBytes + c.count * sizeof(float);
+    if (chunks[i].buffer == 0)
+      gl.genBuffers(1, &chunks[i].buffer);
+    gl.bindBuffer(GL_ARRAY_BUFFER, chunks[i].buffer);
+    if (bytes != chunks[i].capacity) {
+      gl.bufferData(GL_ARRAY_BUFFER, (ptrdiff_t)bytes, NULL, GL_STATIC_DRAW);
+      if (chunks[i].capacity > 0)
+        MemoryStats::remove(MEM_GPU_BUFFERS, chunks[i].capacity);
+      MemoryStats::add(MEM_GPU_BUFFERS, bytes);
+      chunks[i].capacity = bytes;
+    }
+    gl.bufferSubData(GL_ARRAY_BUFFER, 0, (ptrdiff_t)pointBytes,
+                     &points[c.first]);
+    gl.bufferSubData(GL_ARRAY_BUFFER, (ptrdiff_t)pointBytes,
+                     (ptrdiff_t)(c.count * sizeof(float)), &times[c.first]);
+  }
+  gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TimedPointBuffer::draw(const TimeIndex &index, float start, float end,
+                            float fadeSeconds, const float fadeColor[3],
+                            float pointSize) const {
+  drawn = index.selectWindow(start, end, ranges);
+  bool useBuffers = !chunks.empty();
+  if (drawn == 0 || (!useBuffers && clientPoints.empty()))
+    return;
+
+  const GLBufferFunctions &gl = getGLBufferFunctions();
+  bool fade = fadeSeconds > 0.0f && gl.fogCoordPointer;
+  if (fade) {
+    // Linear fog runs from 1 at the newest time to 0 at end - fadeSeconds
+    GLfloat color[4] = {fadeColor[0], fadeColor[1], fadeColor[2], 1.0f};
+    gliEnable(GL_FOG);
+    glFogi(GL_FOG_MODE, GL_LINEAR);
+    glFogi(GL_FOG_COORDINATE_SOURCE, GL_FOG_COORDINATE);
+    glFogf(GL_FOG_START, end);
+    glFogf(GL_FOG_END, end - fadeSeconds);
+    glFogfv(GL_FOG_COLOR, color);
+    glEnableClientState(GL_FOG_COORDINATE_ARRAY);
+  }
+
+  beginPoints(pointSize);
+  const std::vector<TimeIndex::Chunk> &indexChunks = index.getChunks();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const TimeIndex::Range &r = ranges[i];
+    const TimeIndex::Chunk &c = indexChunks[r.chunk];
+    const Point3D *base = NULL;
+    const float *times = NULL;
+    if (useBuffers) {
+      gl.bindBuffer(GL_ARRAY_BUFFER, chunks[r.chunk].buffer);
+      times = (const float *)(c.count * sizeof(Point3D));
+    } else {
+      base = &clientPoints[c.first];
+      times = &index.getTimes()[c.first];
+    }
+    if (fade)
+      gl.fogCoordPointer(GL_FLOAT, 0, times);
+    drawInterleaved(base, r.first, r.count);
+  }
+  if (useBuffers)
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+  endPoints();
+
+  if (fade) {
+    glDisableClientState(GL_FOG_COORDINATE_ARRAY);
+    glFogi(GL_FOG_COORDINATE_SOURCE, GL_FRAGMENT_DEPTH);
+    gliDisable(GL_FOG);
+  }
+}
+
+void TimedPointBuffer::release() {
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (chunks[i].buffer != 0 && hasGLBufferFunctions())
+      getGLBufferFunctions().deleteBuffers(1, &chunks[i].buffer);
+    if (chunks[i].capacity > 0)
+      MemoryStats::remove(MEM_GPU_BUFFERS, chunks[i].capacity);
+  }
+  chunks.clear();
+  clientPoints.clear();
+  clientPoints.shrink_to_fit();
+}
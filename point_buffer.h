@@ -0,0 +1,120 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include "time_index.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Points that change every frame (sequence playback), drawn from GPU
+// buffers. Two buffers are used in turn: each upload goes into the one
+// not drawn last, so it never waits for the GPU to finish with the frame
+// still in flight. Points are drawn with their own r, g, b.
+//
+// Falls back to client-side vertex arrays when the context has no buffer
+// objects (call loadGLBufferFunctions first). Needs a current GL context;
+// call release() before the context goes away.
+class StreamingPointBuffer {
+public:
+  StreamingPointBuffer();
+
+  // Make points the drawn frame
+  void upload(const std::vector<Point3D> &points);
+
+  // Draw with the modelview and projection currently set (e.g. after
+  // PointCloudRenderer::render)
+  void draw(float pointSize) const;
+
+  void release();
+
+  size_t getPointCount() const { return counts[front]; }
+  bool isUsingBuffers() const { return buffers[0] != 0; }
+  size_t getUploadCount() const { return uploads; }
+
+private:
+  unsigned buffers[2];
+  size_t capacity[2]; // Allocated bytes of each buffer
+  size_t counts[2];   // Points in each buffer
+  int front;          // Buffer drawn now
+  size_t uploads;
+  std::vector<Point3D> clientPoints; // Without buffer objects
+};
+
+class VoxelMap;
+
+// GPU copy of a VoxelMap, one buffer per block. update() re-uploads only
+// the blocks the map reports as changed, so a growing map costs one
+// sweep's worth of uploads per frame instead of the whole map.
+//
+// Same fallback and context rules as StreamingPointBuffer.
+class VoxelMapBuffer {
+public:
+  VoxelMapBuffer();
+
+  // Upload the blocks changed since the last update
+  void update(VoxelMap &map);
+
+  void draw(float pointSize) const;
+
+  // Drop every block (after clearing the map, or before the context goes)
+  void release();
+
+  size_t getPointCount() const { return points; }
+  size_t getBlockCount() const { return blocks.size(); }
+  size_t getLastUploadCount() const { return lastUploads; } // Blocks
+
+private:
+  struct Block {
+    unsigned buffer;
+    size_t capacity; // Bytes
+    size_t count;
+    std::vector<Point3D> clientPoints; // Without buffer objects
+
+    Block() : buffer(0), capacity(0), count(0) {}
+  };
+
+  std::unordered_map<uint64_t, Block> blocks;
+  std::vector<uint64_t> dirty;
+  std::vector<Point3D> scratch;
+  size_t points;
+  size_t lastUploads;
+};
+
+// A TimeIndex on the GPU: each chunk's points followed by their times in
+// one buffer. draw() takes the points of a time window from the index's
+// ranges and fades older ones toward a color by feeding the times in as
+// fog coordinates, so moving the window changes only draw ranges and fog
+// parameters, never vertex data.
+//
+// Fading needs glFogCoordPointer; without it points are drawn unfaded.
+// Same fallback and context rules as StreamingPointBuffer.
+class TimedPointBuffer {
+public:
+  TimedPointBuffer();
+
+  // points are the index's points in the same order, colored as they
+  // should be drawn; call again after recoloring
+  void upload(const TimeIndex &index, const std::vector<Point3D> &points);
+
+  // Points with start <= time <= end. Those older than end - fadeSeconds
+  // take fadeColor (usually the background); fadeSeconds <= 0 disables it.
+  void draw(const TimeIndex &index, float start, float end,
+            float fadeSeconds, const float fadeColor[3],
+            float pointSize) const;
+
+  void release();
+
+  size_t getDrawnCount() const { return drawn; } // By the last draw
+  bool canFade() const;
+
+private:
+  struct Chunk {
+    unsigned buffer;
+    size_t capacity; // Bytes
+  };
+
+  std::vector<Chunk> chunks;
+  std::vector<Point3D> clientPoints; // Without buffer objects
+  mutable std::vector<TimeIndex::Range> ranges; // Scratch for draw
+  mutable size_t drawn;
+};
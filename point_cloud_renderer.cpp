@@ -3,6 +3,7 @@
 #include <windows.h>
 #endif
 #include "point_cloud_renderer.h"
+#include "gl_stats.h"
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <algorithm>
@@ -55,36 +56,81 @@ void Camera::zoom(float delta) {
   distance *= (1.0f - delta * 0.1f);
   if (distance < 0.1f)
     distance = 0.1f;
-  if (distance > 1000.0f)
-    distance = 1000.0f;
+  if (distance > 1000000.0f) // Tiled surveys span many kilometres
+    distance = 1000000.0f;
 }
 
 void Camera::applyTransform(int width, int height) {
-  // Set up projection matrix
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
+  // Load the CPU-computed matrices so GL and software rendering agree
+  float modelview[16], projection[16];
+  computeMatrices(modelview, projection, width, height);
 
-  float aspect = (float)width / (float)height;
-  float fH = tan(fov * M_PI / 360.0f) * 0.1f;
-  float fW = fH * aspect;
-  glFrustum(-fW, fW, -fH, fH, 0.1f, 10000.0f);
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(projection);
 
-  // Set up view matrix
   glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+  glLoadMatrixf(modelview);
+}
 
+void Camera::getEyePosition(float &x, float &y, float &z) const {
   // Calculate camera position from spherical coordinates
   float yawRad = yaw * M_PI / 180.0f;
   float pitchRad = pitch * M_PI / 180.0f;
 
-  float camX = targetX + distance * cos(pitchRad) * sin(yawRad);
-  float camY = targetY + distance * sin(pitchRad);
-  float camZ = targetZ + distance * cos(pitchRad) * cos(yawRad);
+  x = targetX + distance * cos(pitchRad) * sin(yawRad);
+  y = targetY + distance * sin(pitchRad);
+  z = targetZ + distance * cos(pitchRad) * cos(yawRad);
+}
 
-  // Look at the target
-  gluLookAt(camX, camY, camZ,          // Camera position
-            targetX, targetY, targetZ, // Look at point
-            0.0f, 1.0f, 0.0f);         // Up vector
+void Camera::computeMatrices(float modelview[16], float projection[16],
+                             int width, int height) const {
+  // Projection, as glFrustum(-fW, fW, -fH, fH, near, far). The far plane
+  // grows with the orbit distance so large tiled scenes stay in view.
+  const float zFar = std::max(10000.0f, distance * 4.0f);
+  const float zNear = zFar * 1e-5f;
+  float aspect = (float)width / (float)height;
+  float fH = tan(fov * M_PI / 360.0f) * zNear;
+  float fW = fH * aspect;
+
+  for (int i = 0; i < 16; ++i)
+    projection[i] = 0.0f;
+  projection[0] = zNear / fW;
+  projection[5] = zNear / fH;
+  projection[10] = -(zFar + zNear) / (zFar - zNear);
+  projection[11] = -1.0f;
+  projection[14] = -2.0f * zFar * zNear / (zFar - zNear);
+
+  // View, as gluLookAt(eye, target, up = +Y)
+  float eye[3];
+  getEyePosition(eye[0], eye[1], eye[2]);
+
+  float f[3] = {targetX - eye[0], targetY - eye[1], targetZ - eye[2]};
+  float len = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+  for (int i = 0; i < 3; ++i)
+    f[i] /= len;
+
+  // side = f x up, up' = side x f
+  float s[3] = {-f[2], 0.0f, f[0]};
+  len = sqrt(s[0] * s[0] + s[2] * s[2]);
+  s[0] /= len;
+  s[2] /= len;
+  float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2],
+                s[0] * f[1] - s[1] * f[0]};
+
+  modelview[0] = s[0];
+  modelview[4] = s[1];
+  modelview[8] = s[2];
+  modelview[1] = u[0];
+  modelview[5] = u[1];
+  modelview[9] = u[2];
+  modelview[2] = -f[0];
+  modelview[6] = -f[1];
+  modelview[10] = -f[2];
+  modelview[3] = modelview[7] = modelview[11] = 0.0f;
+  modelview[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+  modelview[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+  modelview[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+  modelview[15] = 1.0f;
 }
 
 // CAD-style view presets
@@ -110,32 +156,7 @@ void Camera::setIsometricView() {
 
 void Camera::getProjectionMatrices(float modelview[16], float projection[16],
                                    int viewport[4], int width, int height) {
-  // Apply the same transformations as in applyTransform
-  glMatrixMode(GL_PROJECTION);
-  glPushMatrix();
-  glLoadIdentity();
-
-  float aspect = (float)width / (float)height;
-  float fH = tan(fov * M_PI / 360.0f) * 0.1f;
-  float fW = fH * aspect;
-  glFrustum(-fW, fW, -fH, fH, 0.1f, 10000.0f);
-  glGetFloatv(GL_PROJECTION_MATRIX, projection);
-  glPopMatrix();
-
-  glMatrixMode(GL_MODELVIEW);
-  glPushMatrix();
-  glLoadIdentity();
-
-  float yawRad = yaw * M_PI / 180.0f;
-  float pitchRad = pitch * M_PI / 180.0f;
-
-  float camX = targetX + distance * cos(pitchRad) * sin(yawRad);
-  float camY = targetY + distance * sin(pitchRad);
-  float camZ = targetZ + distance * cos(pitchRad) * cos(yawRad);
-
-  gluLookAt(camX, camY, camZ, targetX, targetY, targetZ, 0.0f, 1.0f, 0.0f);
-  glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
-  glPopMatrix();
+  computeMatrices(modelview, projection, width, height);
 
   viewport[0] = 0;
   viewport[1] = 0;
@@ -146,10 +167,11 @@ void Camera::getProjectionMatrices(float modelview[16], float projection[16],
 // ========== PointCloudRenderer Implementation ==========
 
 PointCloudRenderer::PointCloudRenderer()
-    : pointCount(0), pointSize(2.0f), colorMode(COLOR_RGB), showGrid(true),
-      gridSpacing(1.0f), gridSize(10), showAxisLabels(true) {
+    : pointCount(0), pointSize(2.0f), colorMode(COLOR_RGB), showPoints(true),
+      showGrid(true), gridSpacing(1.0f), gridSize(10), showAxisLabels(true) {
   minX = minY = minZ = 0;
   maxX = maxY = maxZ = 0;
+  std::fill(gridKey, gridKey + 7, std::numeric_limits<float>::quiet_NaN());
   setupOpenGL();
 }
 
@@ -183,10 +205,16 @@ void PointCloudRenderer::calculateBounds() {
 }
 
 void PointCloudRenderer::setPointCloud(const std::vector<Point3D> &newPoints) {
-  points = newPoints;
+  // Fresh storage, so no capacity from a larger previous cloud lingers
+  PointStorage(newPoints.begin(), newPoints.end()).swap(points);
   pointCount = points.size();
   calculateBounds();
+  for (const auto &chunk : chunks)
+    pointCount += chunk.second.size();
+  centerCamera();
+}
 
+void PointCloudRenderer::centerCamera() {
   // Auto-center camera on point cloud
   camera.targetX = (minX + maxX) * 0.5f;
   camera.targetY = (minY + maxY) * 0.5f;
@@ -201,13 +229,63 @@ void PointCloudRenderer::setPointCloud(const std::vector<Point3D> &newPoints) {
 }
 
 void PointCloudRenderer::clearPointCloud() {
-  points.clear();
+  // Swap with an empty vector so the storage is actually released
+  PointStorage().swap(points);
   pointCount = 0;
+  for (const auto &chunk : chunks)
+    pointCount += chunk.second.size();
 }
 
-void PointCloudRenderer::renderGrid() {
-  if (!showGrid)
+size_t PointCloudRenderer::getResidentBytes() const {
+  size_t bytes = points.capacity() * sizeof(Point3D);
+  for (const auto &chunk : chunks)
+    bytes += chunk.second.capacity() * sizeof(Point3D);
+  return bytes;
+}
+
+void PointCloudRenderer::addChunk(int id,
+                                  const std::vector<Point3D> &chunkPoints) {
+  removeChunk(id);
+  PointStorage(chunkPoints.begin(), chunkPoints.end()).swap(chunks[id]);
+  pointCount += chunkPoints.size();
+}
+
+void PointCloudRenderer::removeChunk(int id) {
+  std::map<int, PointStorage>::iterator it = chunks.find(id);
+  if (it == chunks.end())
     return;
+  pointCount -= it->second.size();
+  chunks.erase(it);
+}
+
+void PointCloudRenderer::clearChunks() {
+  for (const auto &chunk : chunks)
+    pointCount -= chunk.second.size();
+  chunks.clear();
+}
+
+void PointCloudRenderer::setSceneBounds(const float min[3],
+                                        const float max[3]) {
+  minX = min[0];
+  minY = min[1];
+  minZ = min[2];
+  maxX = max[0];
+  maxY = max[1];
+  maxZ = max[2];
+  centerCamera();
+}
+
+float PointCloudRenderer::getEffectiveGridSpacing() const {
+  float spacing = gridSpacing > 0.0f ? gridSpacing : 1.0f;
+  float size = std::max({maxX - minX, maxY - minY, maxZ - minZ});
+  float least = std::max(camera.distance, size) / 200.0f;
+  while (spacing < least)
+    spacing *= 10.0f;
+  return spacing;
+}
+
+void PointCloudRenderer::getGridLines(std::vector<GridLine> &lines) const {
+  lines.clear();
 
   // Use actual point cloud bounds for the grid planes
   float sizeX = maxX - minX;
@@ -218,211 +296,200 @@ void PointCloudRenderer::renderGrid() {
     return; // No valid bounds
 
   // Calculate number of grid lines based on spacing
-  int numLinesX = (int)(sizeX / gridSpacing) + 1;
-  int numLinesY = (int)(sizeY / gridSpacing) + 1;
-  int numLinesZ = (int)(sizeZ / gridSpacing) + 1;
-
-  glDisable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glLineWidth(1.0f);
-
-  glBegin(GL_LINES);
+  float spacing = getEffectiveGridSpacing();
+  int numLinesX = (int)(sizeX / spacing) + 1;
+  int numLinesY = (int)(sizeY / spacing) + 1;
+  int numLinesZ = (int)(sizeZ / spacing) + 1;
+
+  GridLine line;
+  auto setStyle = [&](float r, float g, float b, float a, float width) {
+    line.r = r;
+    line.g = g;
+    line.b = b;
+    line.a = a;
+    line.width = width;
+  };
+  auto add = [&](float x0, float y0, float z0, float x1, float y1, float z1) {
+    line.x0 = x0;
+    line.y0 = y0;
+    line.z0 = z0;
+    line.x1 = x1;
+    line.y1 = y1;
+    line.z1 = z1;
+    lines.push_back(line);
+  };
+  auto gridX = [&](int i) { return std::min(minX + i * spacing, maxX); };
+  auto gridY = [&](int i) { return std::min(minY + i * spacing, maxY); };
+  auto gridZ = [&](int i) { return std::min(minZ + i * spacing, maxZ); };
 
   // ===== BOTTOM PLANE (X-Z at minY) =====
-  glColor4f(0.6f, 0.6f, 0.6f, 0.7f);
+  setStyle(0.6f, 0.6f, 0.6f, 0.7f, 1.0f);
 
   // Lines parallel to X axis
-  for (int i = 0; i <= numLinesZ; ++i) {
-    float z = minZ + i * gridSpacing;
-    if (z > maxZ)
-      z = maxZ;
-
-    glVertex3f(minX, minY, z);
-    glVertex3f(maxX, minY, z);
-  }
+  for (int i = 0; i <= numLinesZ; ++i)
+    add(minX, minY, gridZ(i), maxX, minY, gridZ(i));
 
   // Lines parallel to Z axis
-  for (int i = 0; i <= numLinesX; ++i) {
-    float x = minX + i * gridSpacing;
-    if (x > maxX)
-      x = maxX;
-
-    glVertex3f(x, minY, minZ);
-    glVertex3f(x, minY, maxZ);
-  }
+  for (int i = 0; i <= numLinesX; ++i)
+    add(gridX(i), minY, minZ, gridX(i), minY, maxZ);
 
   // ===== BACK PLANE (X-Y at minZ) =====
-  glColor4f(0.5f, 0.5f, 0.6f, 0.5f);
+  setStyle(0.5f, 0.5f, 0.6f, 0.5f, 1.0f);
 
   // Lines parallel to X axis (horizontal)
-  for (int i = 0; i <= numLinesY; ++i) {
-    float y = minY + i * gridSpacing;
-    if (y > maxY)
-      y = maxY;
-
-    glVertex3f(minX, y, minZ);
-    glVertex3f(maxX, y, minZ);
-  }
+  for (int i = 0; i <= numLinesY; ++i)
+    add(minX, gridY(i), minZ, maxX, gridY(i), minZ);
 
   // Lines parallel to Y axis (vertical)
-  for (int i = 0; i <= numLinesX; ++i) {
-    float x = minX + i * gridSpacing;
-    if (x > maxX)
-      x = maxX;
-
-    glVertex3f(x, minY, minZ);
-    glVertex3f(x, maxY, minZ);
-  }
+  for (int i = 0; i <= numLinesX; ++i)
+    add(gridX(i), minY, minZ, gridX(i), maxY, minZ);
 
   // ===== LEFT PLANE (Y-Z at minX) =====
-  glColor4f(0.6f, 0.5f, 0.5f, 0.5f);
+  setStyle(0.6f, 0.5f, 0.5f, 0.5f, 1.0f);
 
   // Lines parallel to Z axis (horizontal)
-  for (int i = 0; i <= numLinesY; ++i) {
-    float y = minY + i * gridSpacing;
-    if (y > maxY)
-      y = maxY;
-
-    glVertex3f(minX, y, minZ);
-    glVertex3f(minX, y, maxZ);
-  }
+  for (int i = 0; i <= numLinesY; ++i)
+    add(minX, gridY(i), minZ, minX, gridY(i), maxZ);
 
   // Lines parallel to Y axis (vertical)
-  for (int i = 0; i <= numLinesZ; ++i) {
-    float z = minZ + i * gridSpacing;
-    if (z > maxZ)
-      z = maxZ;
+  for (int i = 0; i <= numLinesZ; ++i)
+    add(minX, minY, gridZ(i), minX, maxY, gridZ(i));
 
-    glVertex3f(minX, minY, z);
-    glVertex3f(minX, maxY, z);
-  }
-
-  glEnd();
-
-  // Draw bounding box edges (thicker lines)
-  glLineWidth(2.0f);
-  glBegin(GL_LINES);
-  glColor4f(0.3f, 0.3f, 0.3f, 0.9f);
+  // Bounding box edges (thicker lines)
+  setStyle(0.3f, 0.3f, 0.3f, 0.9f, 2.0f);
 
   // Bottom rectangle
-  glVertex3f(minX, minY, minZ);
-  glVertex3f(maxX, minY, minZ);
-  glVertex3f(maxX, minY, minZ);
-  glVertex3f(maxX, minY, maxZ);
-  glVertex3f(maxX, minY, maxZ);
-  glVertex3f(minX, minY, maxZ);
-  glVertex3f(minX, minY, maxZ);
-  glVertex3f(minX, minY, minZ);
+  add(minX, minY, minZ, maxX, minY, minZ);
+  add(maxX, minY, minZ, maxX, minY, maxZ);
+  add(maxX, minY, maxZ, minX, minY, maxZ);
+  add(minX, minY, maxZ, minX, minY, minZ);
 
   // Vertical edges at corners
-  glVertex3f(minX, minY, minZ);
-  glVertex3f(minX, maxY, minZ);
-  glVertex3f(maxX, minY, minZ);
-  glVertex3f(maxX, maxY, minZ);
-  glVertex3f(minX, minY, maxZ);
-  glVertex3f(minX, maxY, maxZ);
+  add(minX, minY, minZ, minX, maxY, minZ);
+  add(maxX, minY, minZ, maxX, maxY, minZ);
+  add(minX, minY, maxZ, minX, maxY, maxZ);
 
   // Top edges (partial box)
-  glVertex3f(minX, maxY, minZ);
-  glVertex3f(maxX, maxY, minZ);
-  glVertex3f(minX, maxY, minZ);
-  glVertex3f(minX, maxY, maxZ);
-
-  glEnd();
+  add(minX, maxY, minZ, maxX, maxY, minZ);
+  add(minX, maxY, minZ, minX, maxY, maxZ);
 
-  // Draw colored coordinate axes at origin corner
-  glLineWidth(3.0f);
-  glEnd();
-
-  // Draw 3D tick marks at grid intervals
-  glBegin(GL_LINES);
-  float tickSize = gridSpacing * 0.2f;
+  // 3D tick marks at grid intervals (thickest lines)
+  float tickSize = spacing * 0.2f;
 
   // X-axis ticks
-  glColor4f(1.0f, 0.5f, 0.5f, 0.8f);
-  for (int i = 0; i <= numLinesX; ++i) {
-    float x = minX + i * gridSpacing;
-    if (x > maxX)
-      x = maxX;
-    glVertex3f(x, minY, minZ);
-    glVertex3f(x, minY - tickSize, minZ);
-  }
+  setStyle(1.0f, 0.5f, 0.5f, 0.8f, 3.0f);
+  for (int i = 0; i <= numLinesX; ++i)
+    add(gridX(i), minY, minZ, gridX(i), minY - tickSize, minZ);
 
   // Y-axis ticks
-  glColor4f(0.5f, 1.0f, 0.5f, 0.8f);
-  for (int i = 0; i <= numLinesY; ++i) {
-    float y = minY + i * gridSpacing;
-    if (y > maxY)
-      y = maxY;
-    glVertex3f(minX, y, minZ);
-    glVertex3f(minX - tickSize, y, minZ);
-  }
+  setStyle(0.5f, 1.0f, 0.5f, 0.8f, 3.0f);
+  for (int i = 0; i <= numLinesY; ++i)
+    add(minX, gridY(i), minZ, minX - tickSize, gridY(i), minZ);
 
   // Z-axis ticks
-  glColor4f(0.5f, 0.5f, 1.0f, 0.8f);
-  for (int i = 0; i <= numLinesZ; ++i) {
-    float z = minZ + i * gridSpacing;
-    if (z > maxZ)
-      z = maxZ;
-    glVertex3f(minX, minY, z);
-    glVertex3f(minX - tickSize, minY, z);
+  setStyle(0.5f, 0.5f, 1.0f, 0.8f, 3.0f);
+  for (int i = 0; i <= numLinesZ; ++i)
+    add(minX, minY, gridZ(i), minX - tickSize, minY, gridZ(i));
+}
+
+void PointCloudRenderer::renderGrid() {
+  if (!showGrid)
+    return;
+
+  // The lines only change with the bounds and spacing
+  float spacing = getEffectiveGridSpacing();
+  float key[7] = {minX, minY, minZ, maxX, maxY, maxZ, spacing};
+  if (!std::equal(key, key + 7, gridKey)) {
+    std::copy(key, key + 7, gridKey);
+    std::vector<GridLine> lines;
+    getGridLines(lines);
+    gridVertices.clear();
+    gridColors.clear();
+    gridBatches.clear();
+    for (size_t i = 0; i < lines.size(); ++i) {
+      const GridLine &l = lines[i];
+      // One batch per run of lines sharing a width
+      if (gridBatches.empty() || gridBatches.back().first != l.width)
+        gridBatches.push_back(std::make_pair(l.width, 0));
+      gridBatches.back().second += 2;
+      const float vertices[6] = {l.x0, l.y0, l.z0, l.x1, l.y1, l.z1};
+      gridVertices.insert(gridVertices.end(), vertices, vertices + 6);
+      const float colors[8] = {l.r, l.g, l.b, l.a, l.r, l.g, l.b, l.a};
+      gridColors.insert(gridColors.end(), colors, colors + 8);
+    }
   }
+  if (gridVertices.empty())
+    return;
 
-  glEnd();
+  gliDisable(GL_DEPTH_TEST);
+  gliEnable(GL_BLEND);
+  gliBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, gridVertices.data());
+  glColorPointer(4, GL_FLOAT, 0, gridColors.data());
+
+  GLint first = 0;
+  for (size_t i = 0; i < gridBatches.size(); ++i) {
+    gliLineWidth(gridBatches[i].first);
+    gliDrawArrays(GL_LINES, first, gridBatches[i].second);
+    first += gridBatches[i].second;
+  }
 
-  glDisable(GL_BLEND);
-  glEnable(GL_DEPTH_TEST);
-  glLineWidth(1.0f);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  gliDisable(GL_BLEND);
+  gliEnable(GL_DEPTH_TEST);
+  gliLineWidth(1.0f);
 }
 
 void PointCloudRenderer::render(int width, int height) {
-  // Apply camera transformation first
-  camera.applyTransform(width, height);
+  float modelview[16], projection[16];
+  camera.computeMatrices(modelview, projection, width, height);
+  render(modelview, projection);
+}
+
+void PointCloudRenderer::render(const float modelview[16],
+                                const float projection[16]) {
+  glMatrixMode(GL_PROJECTION);
+  glLoadMatrixf(projection);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadMatrixf(modelview);
 
   // Render grid first (underneath points)
   renderGrid();
 
   // Then render points
-  if (pointCount == 0)
+  if (pointCount == 0 || !showPoints)
     return;
 
   // Enable point rendering
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_POINT_SMOOTH);
-  glPointSize(pointSize);
+  gliEnable(GL_DEPTH_TEST);
+  gliEnable(GL_POINT_SMOOTH);
+  gliPointSize(pointSize);
 
-  // Render points using immediate mode (compatible with all OpenGL versions)
-  glBegin(GL_POINTS);
+  drawPoints(points);
+  for (const auto &chunk : chunks)
+    drawPoints(chunk.second);
 
-  for (const auto &p : points) {
-    // Set color based on mode
-    switch (colorMode) {
-    case COLOR_RGB:
-      glColor3f(p.r, p.g, p.b);
-      break;
-    case COLOR_HEIGHT: {
-      // Color by height (Y axis)
-      float t = (p.y - minY) / (maxY - minY);
-      // Gradient: blue (low) -> green -> red (high)
-      glColor3f(t, 1.0f - fabs(t - 0.5f) * 2.0f, 1.0f - t);
-      break;
-    }
-    case COLOR_INTENSITY:
-      glColor3f(p.intensity, p.intensity, p.intensity);
-      break;
-    case COLOR_UNIFORM:
-      glColor3f(1.0f, 1.0f, 1.0f);
-      break;
-    }
+  gliDisable(GL_POINT_SMOOTH);
+}
 
-    // Set vertex position
-    glVertex3f(p.x, p.y, p.z);
-  }
+void PointCloudRenderer::drawPoints(const PointStorage &storage) {
+  if (storage.empty())
+    return;
 
-  glEnd();
+  // Render points using immediate mode (compatible with all OpenGL versions)
+  gliBegin(GL_POINTS);
+
+  float rgb[3];
+  for (const auto &p : storage) {
+    getPointColor(p, rgb);
+    glColor3f(rgb[0], rgb[1], rgb[2]);
+    gliVertex3f(p.x, p.y, p.z);
+  }
 
-  glDisable(GL_POINT_SMOOTH);
+  gliEnd();
 }
 
 // Axis label rendering implementation (using ImGui overlays)
@@ -468,12 +535,13 @@ void PointCloudRenderer::renderAxisLabels(int screenWidth, int screenHeight) {
   char label[32];
 
   // Calculate grid parameters
+  float spacing = getEffectiveGridSpacing();
   float sizeX = maxX - minX;
   float sizeY = maxY - minY;
   float sizeZ = maxZ - minZ;
-  int numLinesX = (int)(sizeX / gridSpacing) + 1;
-  int numLinesY = (int)(sizeY / gridSpacing) + 1;
-  int numLinesZ = (int)(sizeZ / gridSpacing) + 1;
+  int numLinesX = (int)(sizeX / spacing) + 1;
+  int numLinesY = (int)(sizeY / spacing) + 1;
+  int numLinesZ = (int)(sizeZ / spacing) + 1;
 
   // Adaptive skip
   int skipX = (numLinesX > 10) ? 2 : 1;
@@ -507,31 +575,31 @@ void PointCloudRenderer::renderAxisLabels(int screenWidth, int screenHeight) {
 
   // X-axis labels along bottom edge
   for (int i = 0; i <= numLinesX; i += skipX) {
-    float x = minX + i * gridSpacing;
+    float x = minX + i * spacing;
     if (x > maxX)
       x = maxX;
     snprintf(label, sizeof(label), "%.1f", x);
     drawAt(x, minY, minZ, label, IM_COL32(255, 150, 150, 255), ImVec2(0, 15));
   }
-  drawAt(maxX + gridSpacing * 0.5f, minY, minZ, "X", IM_COL32(255, 0, 0, 255));
+  drawAt(maxX + spacing * 0.5f, minY, minZ, "X", IM_COL32(255, 0, 0, 255));
 
   // Y-axis labels along left edge
   for (int i = 0; i <= numLinesY; i += skipY) {
-    float y = minY + i * gridSpacing;
+    float y = minY + i * spacing;
     if (y > maxY)
       y = maxY;
     snprintf(label, sizeof(label), "%.1f", y);
     drawAt(minX, y, minZ, label, IM_COL32(150, 255, 150, 255), ImVec2(-25, 0));
   }
-  drawAt(minX, maxY + gridSpacing * 0.5f, minZ, "Y", IM_COL32(0, 255, 0, 255));
+  drawAt(minX, maxY + spacing * 0.5f, minZ, "Y", IM_COL32(0, 255, 0, 255));
 
   // Z-axis labels along back edge
   for (int i = 0; i <= numLinesZ; i += skipZ) {
-    float z = minZ + i * gridSpacing;
+    float z = minZ + i * spacing;
     if (z > maxZ)
       z = maxZ;
     snprintf(label, sizeof(label), "%.1f", z);
     drawAt(minX, minY, z, label, IM_COL32(150, 150, 255, 255), ImVec2(-25, 15));
   }
-  drawAt(minX, minY, maxZ + gridSpacing * 0.5f, "Z", IM_COL32(0, 0, 255, 255));
+  drawAt(minX, minY, maxZ + spacing * 0.5f, "Z", IM_COL32(0, 0, 255, 255));
 }
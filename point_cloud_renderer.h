@@ -1,5 +1,8 @@
 #pragma once
 
+#include "memory_stats.h"
+#include <cmath>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -39,6 +42,18 @@ public:
   // Get current projection info for 3D->2D transforms
   void getProjectionMatrices(float modelview[16], float projection[16],
                              int viewport[4], int width, int height);
+
+  // Column-major matrices used by applyTransform, computed without GL
+  void computeMatrices(float modelview[16], float projection[16], int width,
+                       int height) const;
+  void getEyePosition(float &x, float &y, float &z) const;
+};
+
+// A grid or bounding box line segment, shared by the GL and software paths
+struct GridLine {
+  float x0, y0, z0, x1, y1, z1;
+  float r, g, b, a;
+  float width;
 };
 
 // High-performance point cloud renderer using OpenGL VBOs
@@ -53,26 +68,41 @@ public:
 
   // Rendering
   void render(int width, int height);
+  // Same, with caller-supplied column-major matrices instead of the camera's
+  void render(const float modelview[16], const float projection[16]);
 
   // Configuration
   void setPointSize(float size) { pointSize = size; }
   float getPointSize() const { return pointSize; }
 
+  // Points can be left out while a layer stands in for them (the grid is
+  // still drawn)
+  void setShowPoints(bool show) { showPoints = show; }
+  bool getShowPoints() const { return showPoints; }
+
   void setColorMode(int mode) { colorMode = mode; }
   int getColorMode() const { return colorMode; }
 
   // Camera access
   Camera &getCamera() { return camera; }
+  const Camera &getCamera() const { return camera; }
 
   // Statistics
   size_t getPointCount() const { return pointCount; }
 
+  // Memory actually held for point storage vs. what the points need
+  size_t getResidentBytes() const;
+  size_t getLogicalBytes() const { return pointCount * sizeof(Point3D); }
+
   // Grid settings
   void setShowGrid(bool show) { showGrid = show; }
   bool getShowGrid() const { return showGrid; }
 
   void setGridSpacing(float spacing) { gridSpacing = spacing; }
   float getGridSpacing() const { return gridSpacing; }
+  // The spacing the grid is drawn at: the set spacing times a power of ten,
+  // so lines are at least 1/200 of the view distance or of the bounds apart
+  float getEffectiveGridSpacing() const;
 
   void setGridSize(int size) { gridSize = size; }
   int getGridSize() const { return gridSize; }
@@ -83,6 +113,9 @@ public:
   void renderGrid();
   void renderAxisLabels(int screenWidth, int screenHeight);
 
+  // Geometry drawn by renderGrid (empty when bounds are degenerate)
+  void getGridLines(std::vector<GridLine> &lines) const;
+
   // Color modes
   enum ColorMode {
     COLOR_RGB = 0,
@@ -91,13 +124,64 @@ public:
     COLOR_UNIFORM = 3
   };
 
+  // Color of a point under the current color mode
+  void getPointColor(const Point3D &p, float rgb[3]) const {
+    switch (colorMode) {
+    case COLOR_RGB:
+      rgb[0] = p.r;
+      rgb[1] = p.g;
+      rgb[2] = p.b;
+      break;
+    case COLOR_HEIGHT: {
+      // Color by height (Y axis)
+      float t = maxY > minY ? (p.y - minY) / (maxY - minY) : 0.0f;
+      // Gradient: blue (low) -> green -> red (high)
+      rgb[0] = t;
+      rgb[1] = 1.0f - std::fabs(t - 0.5f) * 2.0f;
+      rgb[2] = 1.0f - t;
+      break;
+    }
+    case COLOR_INTENSITY:
+      rgb[0] = rgb[1] = rgb[2] = p.intensity;
+      break;
+    default:
+      rgb[0] = rgb[1] = rgb[2] = 1.0f;
+      break;
+    }
+  }
+
+  // Raw data access for alternative backends and tools
+  typedef std::vector<Point3D, TrackedAllocator<Point3D, MEM_POINT_STORAGE>>
+      PointStorage;
+  const PointStorage &getPoints() const { return points; }
+  void getBounds(float min[3], float max[3]) const {
+    min[0] = minX;
+    min[1] = minY;
+    min[2] = minZ;
+    max[0] = maxX;
+    max[1] = maxY;
+    max[2] = maxZ;
+  }
+
+  // Streamed chunks are drawn with the point cloud but leave the bounds and
+  // camera alone; setSceneBounds sets both for the whole dataset instead
+  void addChunk(int id, const std::vector<Point3D> &chunkPoints);
+  void removeChunk(int id);
+  void clearChunks();
+  bool hasChunk(int id) const { return chunks.count(id) != 0; }
+  const std::map<int, PointStorage> &getChunks() const { return chunks; }
+  void setSceneBounds(const float min[3], const float max[3]);
+
 private:
   void setupOpenGL();
   void cleanupOpenGL();
+  void drawPoints(const PointStorage &storage);
+  void centerCamera();
 
   size_t pointCount;
   float pointSize;
   int colorMode;
+  bool showPoints;
 
   // Grid settings
   bool showGrid;
@@ -107,7 +191,13 @@ private:
 
   Camera camera;
 
-  std::vector<Point3D> points;
+  PointStorage points;
+  std::map<int, PointStorage> chunks;
+  // Grid vertex arrays, kept until the bounds or spacing change
+  std::vector<float> gridVertices;                // xyz
+  std::vector<float> gridColors;                  // rgba
+  std::vector<std::pair<float, int>> gridBatches; // Line width, vertices
+  float gridKey[7]; // Bounds and spacing the arrays were built for
 
   // Bounding box for auto-scaling
   float minX, maxX, minY, maxY, minZ, maxZ;
@@ -0,0 +1,432 @@
+#include "point_codec.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint32_t BLOCK_MAGIC = 0x3143504c; // "LPC1"
+const int MORTON_BITS = 21;              // Per axis, 63 bits in total
+
+// rANS with 12-bit probabilities and byte-wise renormalization
+const int PROB_BITS = 12;
+const uint32_t PROB_SCALE = 1u << PROB_BITS;
+const uint32_t RANS_L = 1u << 23;
+const int RANS_WAYS = 4; // Interleaved states
+
+enum {
+  STREAM_POSITION,
+  STREAM_RED,
+  STREAM_GREEN,
+  STREAM_BLUE,
+  STREAM_INTENSITY,
+  STREAM_COUNT
+};
+
+struct BlockHeader {
+  uint32_t magic;
+  uint32_t count;
+  float precision;
+  float min[3];
+};
+
+void putVarint(std::vector<uint8_t> &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t)v);
+}
+
+bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && p < end; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+uint64_t spreadBits(uint32_t a) {
+  uint64_t x = a & 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+uint32_t compactBits(uint64_t x) {
+  x &= 0x1249249249249249ULL;
+  x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+  x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+  x = (x ^ (x >> 8)) & 0x1f0000ff0000ffULL;
+  x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+  x = (x ^ (x >> 32)) & 0x1fffffULL;
+  return (uint32_t)x;
+}
+
+uint8_t quantizeUnit(float v) {
+  return (uint8_t)std::min(std::max(v * 255.0f + 0.5f, 0.0f), 255.0f);
+}
+
+// Scale symbol counts to PROB_SCALE, keeping every present symbol >= 1
+void normalizeFrequencies(const uint32_t counts[256], size_t total,
+                          uint32_t freq[256]) {
+  uint32_t sum = 0;
+  for (int s = 0; s < 256; ++s) {
+    freq[s] = counts[s] == 0
+                  ? 0
+                  : std::max<uint32_t>(
+                        1, (uint32_t)((uint64_t)counts[s] * PROB_SCALE /
+                                      total));
+    sum += freq[s];
+  }
+
+  // Rounding leaves the sum off by at most one per symbol; settle the
+  // difference on the most frequent symbols, where it costs least
+  while (sum != PROB_SCALE) {
+    int largest = (int)(std::max_element(freq, freq + 256) - freq);
+    if (sum < PROB_SCALE) {
+      freq[largest] += PROB_SCALE - sum;
+      sum = PROB_SCALE;
+    } else {
+      uint32_t take = std::min(sum - PROB_SCALE, freq[largest] - 1);
+      if (take == 0)
+        take = 1; // Every symbol is at 1; can't happen with 256 symbols
+      freq[largest] -= take;
+      sum -= take;
+    }
+  }
+}
+
+// Stream layout: symbol count and mode, then for rANS streams a presence
+// bitmap and the frequencies of present symbols followed by the payload
+// (the initial states first). Streams rANS can't shrink are stored raw,
+// and streams of a single repeated symbol as just that symbol.
+enum { MODE_RAW, MODE_CONSTANT, MODE_RANS };
+
+void encodeStream(const std::vector<uint8_t> &symbols,
+                  std::vector<uint8_t> &out) {
+  putVarint(out, symbols.size());
+  if (symbols.empty())
+    return;
+
+  uint32_t counts[256] = {0}, freq[256], start[256];
+  for (size_t i = 0; i < symbols.size(); ++i)
+    ++counts[symbols[i]];
+  if (counts[symbols[0]] == symbols.size()) {
+    out.push_back(MODE_CONSTANT);
+    out.push_back(symbols[0]);
+    return;
+  }
+  normalizeFrequencies(counts, symbols.size(), freq);
+
+  size_t streamStart = out.size();
+  out.push_back(MODE_RANS);
+
+  uint8_t present[32] = {0};
+  for (int s = 0; s < 256; ++s) {
+    if (freq[s])
+      present[s >> 3] |= (uint8_t)(1 << (s & 7));
+  }
+  out.insert(out.end(), present, present + 32);
+  uint32_t cumulative = 0;
+  for (int s = 0; s < 256; ++s) {
+    start[s] = cumulative;
+    cumulative += freq[s];
+    if (freq[s])
+      putVarint(out, freq[s] - 1);
+  }
+
+  // rANS is LIFO: encode backwards so the decoder runs forwards. Each
+  // symbol emits at most PROB_BITS bits.
+  std::vector<uint8_t> buffer(symbols.size() * 2 + 16);
+  uint8_t *end = buffer.data() + buffer.size();
+  uint8_t *ptr = end;
+  uint32_t state[RANS_WAYS];
+  for (int k = 0; k < RANS_WAYS; ++k)
+    state[k] = RANS_L;
+  for (size_t i = symbols.size(); i-- > 0;) {
+    uint32_t &x = state[i % RANS_WAYS];
+    uint32_t f = freq[symbols[i]];
+    uint32_t xmax = ((RANS_L >> PROB_BITS) << 8) * f;
+    while (x >= xmax) {
+      *--ptr = (uint8_t)x;
+      x >>= 8;
+    }
+    x = ((x / f) << PROB_BITS) + (x % f) + start[symbols[i]];
+  }
+  for (int k = RANS_WAYS - 1; k >= 0; --k) {
+    ptr -= 4;
+    for (int b = 0; b < 4; ++b)
+      ptr[b] = (uint8_t)(state[k] >> (8 * b));
+  }
+
+  putVarint(out, (uint64_t)(end - ptr));
+  out.insert(out.end(), ptr, end);
+
+  // Raw bytes decode for free, so entropy coding has to earn its keep
+  if (out.size() - streamStart > symbols.size() * 9 / 10) {
+    out.resize(streamStart);
+    out.push_back(MODE_RAW);
+    out.insert(out.end(), symbols.begin(), symbols.end());
+  }
+}
+
+// Decode table entry per probability slot: frequency - 1 in bits 0-11,
+// cumulative start in bits 12-23, symbol in bits 24-31
+typedef uint32_t DecodeSlot;
+
+bool decodeStream(const uint8_t *&p, const uint8_t *end,
+                  std::vector<uint8_t> &symbols) {
+  uint64_t count = 0;
+  if (!getVarint(p, end, count) || count > (1ull << 32))
+    return false;
+  symbols.resize((size_t)count);
+  if (count == 0)
+    return true;
+
+  if (p >= end)
+    return false;
+  int mode = *p++;
+  if (mode == MODE_CONSTANT) {
+    if (p >= end)
+      return false;
+    memset(symbols.data(), *p++, (size_t)count);
+    return true;
+  }
+  if (mode == MODE_RAW) {
+    if ((uint64_t)(end - p) < count)
+      return false;
+    memcpy(symbols.data(), p, (size_t)count);
+    p += count;
+    return true;
+  }
+
+  if (mode != MODE_RANS || end - p < 32)
+    return false;
+  const uint8_t *present = p;
+  p += 32;
+
+  static thread_local DecodeSlot slots[PROB_SCALE];
+  uint32_t cumulative = 0;
+  for (int s = 0; s < 256; ++s) {
+    if (!(present[s >> 3] & (1 << (s & 7))))
+      continue;
+    uint64_t f = 0;
+    if (!getVarint(p, end, f) || cumulative + f + 1 > PROB_SCALE)
+      return false;
+    DecodeSlot slot = (uint32_t)f | cumulative << 12 | (uint32_t)s << 24;
+    for (uint32_t k = 0; k <= f; ++k)
+      slots[cumulative + k] = slot;
+    cumulative += (uint32_t)f + 1;
+  }
+  uint64_t length = 0;
+  if (cumulative != PROB_SCALE || !getVarint(p, end, length) ||
+      length < 4 * RANS_WAYS || length > (uint64_t)(end - p))
+    return false;
+
+  const uint8_t *q = p, *qend = p + length;
+  p += length;
+  uint32_t x[RANS_WAYS];
+  for (int k = 0; k < RANS_WAYS; ++k, q += 4)
+    x[k] = q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32_t)q[3] << 24);
+  uint32_t x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+
+  // The states are independent, so their lookups overlap in the CPU
+  uint8_t *out = symbols.data();
+  const DecodeSlot *table = slots;
+  size_t i = 0;
+#define RANS_DECODE(x, dst)                                                    \
+  do {                                                                         \
+    DecodeSlot slot = table[x & (PROB_SCALE - 1)];                             \
+    dst = (uint8_t)(slot >> 24);                                               \
+    x = ((slot & 0xfff) + 1) * (x >> PROB_BITS) + (x & (PROB_SCALE - 1)) -     \
+        ((slot >> 12) & 0xfff);                                                \
+    while (x < RANS_L && q < qend)                                             \
+      x = (x << 8) | *q++;                                                     \
+  } while (0)
+  for (; i + 3 < count; i += 4) {
+    RANS_DECODE(x0, out[i]);
+    RANS_DECODE(x1, out[i + 1]);
+    RANS_DECODE(x2, out[i + 2]);
+    RANS_DECODE(x3, out[i + 3]);
+  }
+  if (i < count)
+    RANS_DECODE(x0, out[i++]);
+  if (i < count)
+    RANS_DECODE(x1, out[i++]);
+  if (i < count)
+    RANS_DECODE(x2, out[i++]);
+#undef RANS_DECODE
+  return true;
+}
+
+} // namespace
+
+void encodePoints(const Point3D *points, size_t count,
+                  const CodecOptions &options, std::vector<uint8_t> &out,
+                  std::vector<uint32_t> *decodedOrder) {
+  out.clear();
+
+  BlockHeader header;
+  header.magic = BLOCK_MAGIC;
+  header.count = (uint32_t)count;
+  float max[3];
+  for (int a = 0; a < 3; ++a)
+    header.min[a] = max[a] = count ? (&points[0].x)[a] : 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    for (int a = 0; a < 3; ++a) {
+      float v = (&points[i].x)[a];
+      header.min[a] = std::min(header.min[a], v);
+      max[a] = std::max(max[a], v);
+    }
+  }
+
+  // Coarsen the step until the extent fits the Morton code
+  float extent = 0.0f;
+  for (int a = 0; a < 3; ++a)
+    extent = std::max(extent, max[a] - header.min[a]);
+  header.precision = std::max(options.precision, 1e-9f);
+  while (extent / header.precision >= (float)((1 << MORTON_BITS) - 1))
+    header.precision *= 2.0f;
+
+  std::vector<std::pair<uint64_t, uint32_t>> order(count);
+  const float scale = 1.0f / header.precision;
+  const uint32_t maxCell = (1u << MORTON_BITS) - 1;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t code = 0;
+    for (int a = 0; a < 3; ++a) {
+      float q = ((&points[i].x)[a] - header.min[a]) * scale + 0.5f;
+      code |= spreadBits(std::min((uint32_t)std::max(q, 0.0f), maxCell)) << a;
+    }
+    order[i] = std::make_pair(code, (uint32_t)i);
+  }
+  std::sort(order.begin(), order.end());
+  if (decodedOrder) {
+    decodedOrder->resize(count);
+    for (size_t i = 0; i < count; ++i)
+      (*decodedOrder)[i] = order[i].second;
+  }
+
+  std::vector<uint8_t> streams[STREAM_COUNT];
+  for (int s = STREAM_RED; s < STREAM_COUNT; ++s)
+    streams[s].resize(count);
+  streams[STREAM_POSITION].reserve(count * 2);
+
+  uint64_t lastCode = 0;
+  uint8_t last[4] = {0, 0, 0, 0};
+  for (size_t i = 0; i < count; ++i) {
+    const Point3D &p = points[order[i].second];
+    putVarint(streams[STREAM_POSITION], order[i].first - lastCode);
+    lastCode = order[i].first;
+
+    // Channels tend to change together, so green and blue are predicted
+    // from red's change (all mod 256)
+    uint8_t c[4] = {quantizeUnit(p.r), quantizeUnit(p.g), quantizeUnit(p.b),
+                    quantizeUnit(p.intensity)};
+    uint8_t dr = (uint8_t)(c[0] - last[0]);
+    streams[STREAM_RED][i] = dr;
+    streams[STREAM_GREEN][i] = (uint8_t)(c[1] - last[1] - dr);
+    streams[STREAM_BLUE][i] = (uint8_t)(c[2] - last[2] - dr);
+    streams[STREAM_INTENSITY][i] = (uint8_t)(c[3] - last[3]);
+    memcpy(last, c, 4);
+  }
+
+  // Fields are stored in host byte order (little endian on all targets)
+  out.resize(sizeof(header));
+  memcpy(out.data(), &header, sizeof(header));
+  for (int s = 0; s < STREAM_COUNT; ++s)
+    encodeStream(streams[s], out);
+}
+
+size_t getEncodedPointCount(const uint8_t *data, size_t size) {
+  BlockHeader header;
+  if (size < sizeof(header))
+    return 0;
+  memcpy(&header, data, sizeof(header));
+  return header.magic == BLOCK_MAGIC ? header.count : 0;
+}
+
+bool decodePoints(const uint8_t *data, size_t size,
+                  std::vector<Point3D> &out) {
+  BlockHeader header;
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != BLOCK_MAGIC)
+    return false;
+
+  static thread_local std::vector<uint8_t> streams[STREAM_COUNT];
+  const uint8_t *p = data + sizeof(header), *end = data + size;
+  for (int s = 0; s < STREAM_COUNT; ++s) {
+    if (!decodeStream(p, end, streams[s]))
+      return false;
+    if (s != STREAM_POSITION && streams[s].size() != header.count)
+      return false;
+  }
+
+  size_t first = out.size();
+  out.resize(first + header.count);
+  Point3D *dst = out.data() + first;
+
+  const uint8_t *pos = streams[STREAM_POSITION].data();
+  const uint8_t *posEnd = pos + streams[STREAM_POSITION].size();
+  const uint8_t *red = streams[STREAM_RED].data();
+  const uint8_t *green = streams[STREAM_GREEN].data();
+  const uint8_t *blue = streams[STREAM_BLUE].data();
+  const uint8_t *intensity = streams[STREAM_INTENSITY].data();
+  const float unit = 1.0f / 255.0f;
+
+  uint64_t code = 0;
+  uint8_t r = 0, g = 0, b = 0, i = 0;
+  for (size_t k = 0; k < header.count; ++k) {
+    uint64_t delta = 0;
+    if (!getVarint(pos, posEnd, delta)) {
+      out.resize(first);
+      return false;
+    }
+    code += delta;
+
+    uint8_t dr = red[k];
+    r = (uint8_t)(r + dr);
+    g = (uint8_t)(g + green[k] + dr);
+    b = (uint8_t)(b + blue[k] + dr);
+    i = (uint8_t)(i + intensity[k]);
+
+    Point3D &pt = dst[k];
+    pt.x = header.min[0] + compactBits(code) * header.precision;
+    pt.y = header.min[1] + compactBits(code >> 1) * header.precision;
+    pt.z = header.min[2] + compactBits(code >> 2) * header.precision;
+    pt.r = r * unit;
+    pt.g = g * unit;
+    pt.b = b * unit;
+    pt.intensity = i * unit;
+  }
+  return true;
+}
+
+bool decodeBlocks(const std::vector<const uint8_t *> &blocks,
+                  const std::vector<size_t> &sizes,
+                  std::vector<std::vector<Point3D>> &out, unsigned threads) {
+  // Keep the capacity of existing outputs so repeated decodes don't fault in
+  // fresh pages
+  out.resize(blocks.size());
+  for (size_t i = 0; i < out.size(); ++i)
+    out[i].clear();
+  std::atomic<bool> ok(true);
+  parallelFor(
+      blocks.size(),
+      [&](size_t i) {
+        if (!decodePoints(blocks[i], sizes[i], out[i]))
+          ok = false;
+      },
+      threads);
+  return ok;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossy compression of point blocks for storage and transfer.
+//
+// Positions are quantized to a grid (precision in viewer units), sorted in
+// Morton order and stored as varint deltas of the Morton codes. Colors are
+// stored as 8-bit residuals from the previous point, with green and blue
+// predicted from red's change; intensity likewise. Each byte stream is
+// entropy coded with a four-way interleaved rANS coder, or stored raw when
+// that doesn't pay. Blocks are self-contained, so chunks decode
+// independently and in parallel.
+//
+// Point order is not preserved.
+struct CodecOptions {
+  float precision; // Quantization step; coarsened if the extent needs it
+
+  CodecOptions() : precision(0.001f) {}
+};
+
+// decodedOrder, if given, receives the input index of each point in the
+// order the block decodes them
+void encodePoints(const Point3D *points, size_t count,
+                  const CodecOptions &options, std::vector<uint8_t> &out,
+                  std::vector<uint32_t> *decodedOrder = NULL);
+
+// Appends the decoded points to out; false on a malformed block
+bool decodePoints(const uint8_t *data, size_t size, std::vector<Point3D> &out);
+
+// Point count from a block header, 0 if it isn't a block
+size_t getEncodedPointCount(const uint8_t *data, size_t size);
+
+// Decode many blocks on worker threads; out[i] receives block i
+bool decodeBlocks(const std::vector<const uint8_t *> &blocks,
+                  const std::vector<size_t> &sizes,
+                  std::vector<std::vector<Point3D>> &out,
+                  unsigned threads = 0);
@@ -0,0 +1,318 @@
+#include "point_export.h"
+#include "file_utils.h"
+#include "parallel.h"
+#include "point_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdio.h>
+#include <thread>
+
+namespace {
+
+const int LAS_HEADER_SIZE = 227; // LAS 1.2, no variable length records
+
+// Points [first, first + count) of a span
+struct Block {
+  size_t span, first, count;
+};
+
+// Passing points of a block and their bounds, in file coordinates
+struct BlockBounds {
+  size_t count;
+  double min[3], max[3];
+};
+
+template <class T> void putValue(unsigned char *p, T v) {
+  memcpy(p, &v, sizeof(T));
+}
+
+uint16_t toShort(float v) {
+  return (uint16_t)(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+unsigned char toByte(float v) {
+  return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+bool isInside(const Point3D &p, const PointExportOptions &options) {
+  return !options.clip ||
+         (p.x >= options.clipMin[0] && p.x <= options.clipMax[0] &&
+          p.y >= options.clipMin[1] && p.y <= options.clipMax[1] &&
+          p.z >= options.clipMin[2] && p.z <= options.clipMax[2]);
+}
+
+class RecordEncoder {
+public:
+  RecordEncoder(bool las, const PointExportOptions &options)
+      : las(las), withTime(options.hasTime),
+        withScalar(!las && !options.scalarName.empty()),
+        scalarName(options.scalarName), origin(options.origin) {
+    if (las)
+      recordSize = withTime ? 34 : 26; // Point formats 3 and 2
+    else
+      recordSize = 31 + (withTime ? 8 : 0) + (withScalar ? 4 : 0);
+    for (int a = 0; a < 3; ++a) {
+      scale[a] = 0.001;
+      offset[a] = 0.0;
+    }
+  }
+
+  // LAS integer positions around the rounded origin, as fine as int32
+  // allows up to a millimetre
+  void setBounds(const double min[3], const double max[3]) {
+    for (int a = 0; a < 3; ++a) {
+      offset[a] = std::floor(origin[a] + 0.5);
+      double reach = std::max(std::fabs(max[a] - offset[a]),
+                              std::fabs(min[a] - offset[a]));
+      while (reach / scale[a] > 2e9)
+        scale[a] *= 10.0;
+    }
+  }
+
+  int getRecordSize() const { return recordSize; }
+
+  void encode(const Point3D &p, double seconds, float scalar,
+              unsigned char *out) const {
+    const float v[3] = {p.x, p.y, p.z};
+    double f[3];
+    viewerToFile(v, origin, f);
+    if (las) {
+      for (int a = 0; a < 3; ++a) {
+        double q = std::floor((f[a] - offset[a]) / scale[a] + 0.5);
+        putValue<int32_t>(out + a * 4,
+                          (int32_t)std::min(std::max(q, -2147483648.0),
+                                            2147483647.0));
+      }
+      putValue<uint16_t>(out + 12, toShort(p.intensity));
+      out[14] = 0x09; // Return 1 of 1
+      out[15] = 1;    // Unclassified
+      out[16] = out[17] = 0;
+      putValue<uint16_t>(out + 18, 0);
+      unsigned char *rgb = out + 20;
+      if (withTime) {
+        putValue<double>(out + 20, seconds);
+        rgb = out + 28;
+      }
+      putValue<uint16_t>(rgb, toShort(p.r));
+      putValue<uint16_t>(rgb + 2, toShort(p.g));
+      putValue<uint16_t>(rgb + 4, toShort(p.b));
+    } else {
+      for (int a = 0; a < 3; ++a)
+        putValue<double>(out + a * 8, f[a]);
+      out[24] = toByte(p.r);
+      out[25] = toByte(p.g);
+      out[26] = toByte(p.b);
+      putValue<float>(out + 27, p.intensity);
+      if (withTime)
+        putValue<double>(out + 31, seconds);
+      if (withScalar)
+        putValue<float>(out + recordSize - 4, scalar);
+    }
+  }
+
+  void writeHeader(std::vector<unsigned char> &header, uint64_t count,
+                   const double min[3], const double max[3]) const {
+    if (!las) {
+      char text[512];
+      snprintf(text, sizeof(text),
+               "ply\nformat binary_little_endian 1.0\n"
+               "element vertex %llu\n"
+               "property double x\nproperty double y\nproperty double z\n"
+               "property uchar red\nproperty uchar green\n"
+               "property uchar blue\nproperty float intensity\n%s%s%s%s"
+               "end_header\n",
+               (unsigned long long)count,
+               withTime ? "property double gps_time\n" : "",
+               withScalar ? "property float " : "",
+               withScalar ? scalarName.c_str() : "", withScalar ? "\n" : "");
+      header.assign(text, text + strlen(text));
+      return;
+    }
+
+    header.assign(LAS_HEADER_SIZE, 0);
+    unsigned char *h = header.data();
+    memcpy(h, "LASF", 4);
+    h[24] = 1; // Version 1.2
+    h[25] = 2;
+    const char software[] = "lidar_viewer export";
+    memcpy(h + 26, "OTHER", 5);
+    memcpy(h + 58, software, sizeof(software) - 1);
+    time_t now = time(NULL);
+    struct tm *date = gmtime(&now);
+    if (date) {
+      putValue<uint16_t>(h + 90, (uint16_t)(date->tm_yday + 1));
+      putValue<uint16_t>(h + 92, (uint16_t)(date->tm_year + 1900));
+    }
+    putValue<uint16_t>(h + 94, LAS_HEADER_SIZE);
+    putValue<uint32_t>(h + 96, LAS_HEADER_SIZE);
+    putValue<uint32_t>(h + 100, 0);
+    h[104] = withTime ? 3 : 2;
+    putValue<uint16_t>(h + 105, (uint16_t)recordSize);
+    putValue<uint32_t>(h + 107, (uint32_t)count);
+    putValue<uint32_t>(h + 111, (uint32_t)count); // All first returns
+    for (int a = 0; a < 3; ++a) {
+      putValue<double>(h + 131 + a * 8, scale[a]);
+      putValue<double>(h + 155 + a * 8, offset[a]);
+      putValue<double>(h + 179 + a * 16, count ? max[a] : 0.0);
+      putValue<double>(h + 187 + a * 16, count ? min[a] : 0.0);
+    }
+  }
+
+private:
+  bool las, withTime, withScalar;
+  std::string scalarName;
+  const double *origin;
+  int recordSize;
+  double scale[3], offset[3];
+};
+
+} // namespace
+
+bool exportPoints(const std::vector<PointSpan> &spans,
+                  const PointExportOptions &options, const std::string &path,
+                  PointExportReport &report, std::string &error) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  report.points = report.bytes = 0;
+  report.seconds = 0.0;
+  std::string extension = getExtension(path);
+  if (extension != "las" && extension != "ply") {
+    error = "unknown point file extension (las, ply)";
+    return false;
+  }
+  RecordEncoder encoder(extension == "las", options);
+  unsigned threads = options.threads ? options.threads : getWorkerCount();
+  size_t blockPoints = std::max<size_t>(options.blockPoints, 1);
+
+  std::vector<Block> blocks;
+  for (size_t s = 0; s < spans.size(); ++s) {
+    for (size_t first = 0; first < spans[s].count; first += blockPoints) {
+      Block block = {s, first, std::min(blockPoints, spans[s].count - first)};
+      blocks.push_back(block);
+    }
+  }
+
+  // Pass 1: what passes, for the header and the batch layout
+  std::vector<BlockBounds> bounds(blocks.size());
+  parallelFor(
+      blocks.size(),
+      [&](size_t b) {
+        const Block &block = blocks[b];
+        const Point3D *points = spans[block.span].points + block.first;
+        BlockBounds &out = bounds[b];
+        out.count = 0;
+        for (int a = 0; a < 3; ++a) {
+          out.min[a] = HUGE_VAL;
+          out.max[a] = -HUGE_VAL;
+        }
+        for (size_t i = 0; i < block.count; ++i) {
+          if (!isInside(points[i], options))
+            continue;
+          const float v[3] = {points[i].x, points[i].y, points[i].z};
+          double f[3];
+          viewerToFile(v, options.origin, f);
+          for (int a = 0; a < 3; ++a) {
+            out.min[a] = std::min(out.min[a], f[a]);
+            out.max[a] = std::max(out.max[a], f[a]);
+          }
+          ++out.count;
+        }
+      },
+      threads);
+
+  uint64_t total = 0;
+  double min[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+  double max[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  for (size_t b = 0; b < bounds.size(); ++b) {
+    total += bounds[b].count;
+    for (int a = 0; a < 3; ++a) {
+      min[a] = std::min(min[a], bounds[b].min[a]);
+      max[a] = std::max(max[a], bounds[b].max[a]);
+    }
+  }
+  if (extension == "las" && total > 0xffffffffu) {
+    error = "LAS 1.2 holds at most 4294967295 points";
+    return false;
+  }
+  if (total > 0)
+    encoder.setBounds(min, max);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    error = "cannot create " + path;
+    return false;
+  }
+  std::vector<unsigned char> header;
+  encoder.writeHeader(header, total, min, max);
+  bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+  // Pass 2: batches of blocks are encoded into one buffer while the
+  // writer thread drains the other
+  size_t recordSize = encoder.getRecordSize();
+  size_t batchBlocks = std::max<size_t>(
+      threads, options.bufferBytes / (blockPoints * recordSize));
+  std::vector<unsigned char> buffers[2];
+  std::vector<size_t> offsets;
+  std::thread writer;
+  bool writeOk = true;
+  int current = 0;
+  for (size_t first = 0; ok && first < blocks.size(); first += batchBlocks) {
+    size_t count = std::min(batchBlocks, blocks.size() - first);
+    offsets.assign(1, 0);
+    for (size_t k = 0; k < count; ++k)
+      offsets.push_back(offsets.back() + bounds[first + k].count * recordSize);
+    std::vector<unsigned char> &buffer = buffers[current];
+    buffer.resize(offsets.back());
+
+    parallelFor(
+        count,
+        [&](size_t k) {
+          const Block &block = blocks[first + k];
+          const PointSpan &span = spans[block.span];
+          unsigned char *out = buffer.data() + offsets[k];
+          for (size_t i = block.first; i < block.first + block.count; ++i) {
+            if (!isInside(span.points[i], options))
+              continue;
+            double seconds = options.timeBase;
+            if (span.times)
+              seconds += span.times[i];
+            float scalar = span.scalars
+                               ? span.scalars[i]
+                               : std::numeric_limits<float>::quiet_NaN();
+            encoder.encode(span.points[i], seconds, scalar, out);
+            out += recordSize;
+          }
+        },
+        threads);
+
+    if (writer.joinable())
+      writer.join();
+    ok = writeOk;
+    if (!ok)
+      break;
+    writer = std::thread([&buffer, file, &writeOk]() {
+      writeOk = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    });
+    current ^= 1;
+  }
+  if (writer.joinable())
+    writer.join();
+  ok = ok && writeOk;
+  if (fclose(file) != 0)
+    ok = false;
+  if (!ok) {
+    error = "cannot write " + path;
+    return false;
+  }
+
+  report.points = total;
+  report.bytes = header.size() + total * recordSize;
+  report.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A run of points to export, in viewer coordinates. times (seconds after
+// the export's timeBase) and scalars (the export's scalar field) have one
+// value per point and may be null.
+struct PointSpan {
+  const Point3D *points;
+  const float *times;
+  const float *scalars;
+  size_t count;
+
+  PointSpan(const Point3D *p = NULL, size_t n = 0, const float *t = NULL,
+            const float *s = NULL)
+      : points(p), times(t), scalars(s), count(n) {}
+};
+
+struct PointExportOptions {
+  double origin[3]; // File coordinates of the viewer origin
+  bool clip;        // Keep only the points inside the clip box
+  float clipMin[3], clipMax[3];
+  bool hasTime;    // Write GPS time; spans without times get timeBase
+  double timeBase; // Seconds added to span times
+  std::string scalarName; // PLY float property from span scalars (NaN
+                          // without them); LAS has no place for it
+  unsigned threads; // 0 = all cores
+  size_t blockPoints;  // Points encoded by one task
+  size_t bufferBytes;  // Encoded bytes held per batch of blocks
+
+  PointExportOptions()
+      : clip(false), hasTime(false), timeBase(0.0), threads(0),
+        blockPoints(65536), bufferBytes(32 << 20) {
+    for (int a = 0; a < 3; ++a) {
+      origin[a] = 0.0;
+      clipMin[a] = clipMax[a] = 0.0f;
+    }
+  }
+};
+
+struct PointExportReport {
+  uint64_t points; // Points written
+  uint64_t bytes;
+  double seconds;
+};
+
+// Writes the points of the spans that pass the clip box to a LAS 1.2
+// (point format 2, or 3 with time) or binary little-endian PLY file, chosen
+// by extension, in span order.
+//
+// The spans are cut into blocks and exported in two parallel passes: the
+// first counts each block's passing points and their bounds for the
+// header, the second encodes batches of blocks on worker threads while the
+// previous batch is written out on its own thread. Memory is two batches
+// of encoded records however many points pass, and the file is written
+// front to back, so it can also be a pipe.
+//
+// LAS positions are stored to the millimetre (coarser when the extent
+// needs it) around the origin; PLY positions are doubles.
+bool exportPoints(const std::vector<PointSpan> &spans,
+                  const PointExportOptions &options, const std::string &path,
+                  PointExportReport &report, std::string &error);
@@ -0,0 +1,618 @@
+#include "point_io.h"
+#include "file_utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// All binary formats handled here are little-endian, like every host we
+// build for; PLY big-endian files are byte-swapped explicitly.
+template <class T> static T readValue(const unsigned char *p) {
+  T v;
+  memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+PointReader::PointReader() : timeOutput(NULL) {
+  memset(&info, 0, sizeof(info));
+  origin[0] = origin[1] = origin[2] = 0.0;
+}
+
+void PointReader::setOrigin(double x, double y, double z) {
+  origin[0] = x;
+  origin[1] = y;
+  origin[2] = z;
+}
+
+Point3D PointReader::makePoint(double x, double y, double z, float r, float g,
+                               float b, float intensity) const {
+  float v[3];
+  fileToViewer(x, y, z, origin, v);
+  return Point3D(v[0], v[1], v[2], r, g, b, intensity);
+}
+
+bool PointReader::fail(const std::string &message) {
+  error = message;
+  return false;
+}
+
+// ========== LAS ==========
+
+class LasReader : public PointReader {
+public:
+  LasReader() : file(NULL) {}
+  ~LasReader() { close(); }
+
+  bool open(const std::string &path) override;
+  size_t read(std::vector<Point3D> &out, size_t maxPoints) override;
+
+private:
+  void close() {
+    if (file)
+      fclose(file);
+    file = NULL;
+  }
+
+  FILE *file;
+  double scale[3], offset[3];
+  int recordLength;
+  int colorOffset; // -1 when the point format has no RGB
+  int timeOffset;  // -1 when the point format has no GPS time
+  uint64_t pointsRead;
+
+  // Many files store 8-bit values in the 16-bit fields; decided on the first
+  // batch and then kept for the whole file
+  bool scalesKnown;
+  float colorScale, intensityScale;
+
+  std::vector<unsigned char> buffer;
+};
+
+bool LasReader::open(const std::string &path) {
+  close();
+  file = fopen(path.c_str(), "rb");
+  if (!file)
+    return fail("cannot open " + path);
+
+  unsigned char h[375];
+  memset(h, 0, sizeof(h));
+  size_t got = fread(h, 1, sizeof(h), file);
+  if (got < 227 || memcmp(h, "LASF", 4) != 0)
+    return fail(path + " is not a LAS file");
+
+  int versionMinor = h[25];
+  int headerSize = readValue<uint16_t>(h + 94);
+  uint32_t pointOffset = readValue<uint32_t>(h + 96);
+  int format = h[104];
+  recordLength = readValue<uint16_t>(h + 105);
+
+  // LASzip sets the top bits of the format id
+  if ((format & 0xC0) != 0 || getExtension(path) == "laz")
+    return fail(path + " is LAZ-compressed; decompress it to LAS first "
+                       "(e.g. laszip -i in.laz -o out.las)");
+
+  for (int i = 0; i < 3; ++i) {
+    scale[i] = readValue<double>(h + 131 + i * 8);
+    offset[i] = readValue<double>(h + 155 + i * 8);
+    info.max[i] = readValue<double>(h + 179 + i * 16);
+    info.min[i] = readValue<double>(h + 187 + i * 16);
+  }
+  info.hasBounds = true;
+
+  info.pointCount = readValue<uint32_t>(h + 107);
+  if (versionMinor >= 4 && headerSize >= 375 && got >= 375) {
+    uint64_t count = readValue<uint64_t>(h + 247);
+    if (count > 0)
+      info.pointCount = count;
+  }
+
+  switch (format) {
+  case 2:
+    colorOffset = 20;
+    break;
+  case 3:
+  case 5:
+    colorOffset = 28;
+    break;
+  case 7:
+  case 8:
+  case 10:
+    colorOffset = 30;
+    break;
+  default:
+    colorOffset = -1;
+  }
+  info.hasColor = colorOffset >= 0;
+  info.hasIntensity = true;
+
+  // Formats 1 and 3-5 add GPS time after the legacy fields, 6 and up
+  // after their wider ones
+  timeOffset = format >= 6 ? 22 : (format == 0 || format == 2) ? -1 : 20;
+  info.hasTime = timeOffset >= 0;
+
+  if (recordLength < 20 ||
+      (colorOffset >= 0 && recordLength < colorOffset + 6) ||
+      (timeOffset >= 0 && recordLength < timeOffset + 8))
+    return fail(path + " has an invalid point record length");
+
+  pointsRead = 0;
+  scalesKnown = false;
+  colorScale = intensityScale = 1.0f / 65535.0f;
+  if (seekFile(file, pointOffset) != 0)
+    return fail("cannot seek to point data in " + path);
+  return true;
+}
+
+size_t LasReader::read(std::vector<Point3D> &out, size_t maxPoints) {
+  if (!file)
+    return 0;
+
+  size_t count = (size_t)std::min<uint64_t>(maxPoints,
+                                            info.pointCount - pointsRead);
+  buffer.resize(count * recordLength);
+  size_t records = fread(buffer.data(), recordLength, count, file);
+  pointsRead += records;
+
+  if (!scalesKnown && records > 0) {
+    int maxColor = 0, maxIntensity = 0;
+    for (size_t i = 0; i < records; ++i) {
+      const unsigned char *p = &buffer[i * recordLength];
+      maxIntensity = std::max<int>(maxIntensity, readValue<uint16_t>(p + 12));
+      for (int c = 0; colorOffset >= 0 && c < 3; ++c)
+        maxColor = std::max<int>(maxColor,
+                                 readValue<uint16_t>(p + colorOffset + c * 2));
+    }
+    if (maxColor <= 255)
+      colorScale = 1.0f / 255.0f;
+    if (maxIntensity <= 255)
+      intensityScale = 1.0f / 255.0f;
+    scalesKnown = true;
+  }
+
+  out.reserve(out.size() + records);
+  for (size_t i = 0; i < records; ++i) {
+    const unsigned char *p = &buffer[i * recordLength];
+    double x = readValue<int32_t>(p) * scale[0] + offset[0];
+    double y = readValue<int32_t>(p + 4) * scale[1] + offset[1];
+    double z = readValue<int32_t>(p + 8) * scale[2] + offset[2];
+    float intensity =
+        std::min(readValue<uint16_t>(p + 12) * intensityScale, 1.0f);
+
+    float c[3] = {intensity, intensity, intensity};
+    for (int k = 0; colorOffset >= 0 && k < 3; ++k) {
+      uint16_t value = readValue<uint16_t>(p + colorOffset + k * 2);
+      c[k] = std::min(value * colorScale, 1.0f);
+    }
+    out.push_back(makePoint(x, y, z, c[0], c[1], c[2], intensity));
+    if (timeOutput && timeOffset >= 0)
+      timeOutput->push_back(readValue<double>(p + timeOffset));
+  }
+  return records;
+}
+
+// ========== PLY ==========
+
+class PlyReader : public PointReader {
+public:
+  PlyReader() : file(NULL) {}
+  ~PlyReader() { close(); }
+
+  bool open(const std::string &path) override;
+  size_t read(std::vector<Point3D> &out, size_t maxPoints) override;
+
+private:
+  struct Property {
+    std::string name;
+    int size; // Bytes in binary files
+    char kind; // 'i' signed, 'u' unsigned, 'f' floating point
+    int offset;
+  };
+
+  void close() {
+    if (file)
+      fclose(file);
+    file = NULL;
+  }
+  static bool parseType(const std::string &type, int &size, char &kind);
+  double getValue(const unsigned char *record, const Property &p) const;
+  int findProperty(const char *a, const char *b = NULL) const;
+
+  FILE *file;
+  enum { PLY_ASCII, PLY_LITTLE, PLY_BIG } format;
+  std::vector<Property> properties;
+  int recordSize;
+  int xyz[3], rgb[3], intensityIndex, timeIndex;
+  float colorScale;
+  uint64_t pointsRead;
+  std::vector<unsigned char> buffer;
+};
+
+bool PlyReader::open(const std::string &path) {
+  close();
+  file = fopen(path.c_str(), "rb");
+  if (!file)
+    return fail("cannot open " + path);
+
+  char line[1024];
+  if (!fgets(line, sizeof(line), file) || strncmp(line, "ply", 3) != 0)
+    return fail(path + " is not a PLY file");
+
+  properties.clear();
+  recordSize = 0;
+  bool inVertex = false, seenVertex = false;
+  format = PLY_ASCII;
+
+  while (fgets(line, sizeof(line), file)) {
+    char a[64] = "", b[64] = "", c[64] = "";
+    int fields = sscanf(line, "%63s %63s %63s", a, b, c);
+    if (fields <= 0 || !strcmp(a, "comment") || !strcmp(a, "obj_info"))
+      continue;
+
+    if (!strcmp(a, "end_header")) {
+      break;
+    } else if (!strcmp(a, "format")) {
+      if (!strcmp(b, "binary_little_endian"))
+        format = PLY_LITTLE;
+      else if (!strcmp(b, "binary_big_endian"))
+        format = PLY_BIG;
+    } else if (!strcmp(a, "element")) {
+      inVertex = !strcmp(b, "vertex");
+      if (inVertex) {
+        info.pointCount = strtoull(c, NULL, 10);
+        seenVertex = true;
+      } else if (!seenVertex) {
+        return fail(path + ": vertex must be the first PLY element");
+      }
+    } else if (!strcmp(a, "property") && inVertex) {
+      if (!strcmp(b, "list"))
+        return fail(path + ": list properties on vertices are not supported");
+
+      Property p;
+      p.name = c;
+      p.offset = recordSize;
+      if (!parseType(b, p.size, p.kind))
+        return fail(path + ": unknown PLY type " + b);
+      recordSize += p.size;
+      properties.push_back(p);
+    }
+  }
+
+  xyz[0] = findProperty("x");
+  xyz[1] = findProperty("y");
+  xyz[2] = findProperty("z");
+  if (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0)
+    return fail(path + ": vertices have no x/y/z");
+
+  rgb[0] = findProperty("red", "diffuse_red");
+  rgb[1] = findProperty("green", "diffuse_green");
+  rgb[2] = findProperty("blue", "diffuse_blue");
+  intensityIndex = findProperty("intensity", "scalar_intensity");
+  if (intensityIndex < 0)
+    intensityIndex = findProperty("scalar_Intensity");
+
+  timeIndex = findProperty("gps_time", "scalar_GpsTime");
+  if (timeIndex < 0)
+    timeIndex = findProperty("time", "timestamp");
+
+  info.hasColor = rgb[0] >= 0 && rgb[1] >= 0 && rgb[2] >= 0;
+  info.hasIntensity = intensityIndex >= 0;
+  info.hasTime = timeIndex >= 0;
+  info.hasBounds = false;
+  colorScale = 1.0f;
+  if (info.hasColor) {
+    const Property &p = properties[rgb[0]];
+    if (p.kind != 'f')
+      colorScale = p.size == 1 ? 1.0f / 255.0f : 1.0f / 65535.0f;
+  }
+
+  pointsRead = 0;
+  return true;
+}
+
+bool PlyReader::parseType(const std::string &type, int &size, char &kind) {
+  static const struct {
+    const char *name, *alias;
+    int size;
+    char kind;
+  } types[] = {{"char", "int8", 1, 'i'},     {"uchar", "uint8", 1, 'u'},
+               {"short", "int16", 2, 'i'},   {"ushort", "uint16", 2, 'u'},
+               {"int", "int32", 4, 'i'},     {"uint", "uint32", 4, 'u'},
+               {"float", "float32", 4, 'f'}, {"double", "float64", 8, 'f'}};
+
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+    if (type == types[i].name || type == types[i].alias) {
+      size = types[i].size;
+      kind = types[i].kind;
+      return true;
+    }
+  }
+  return false;
+}
+
+int PlyReader::findProperty(const char *a, const char *b) const {
+  for (size_t i = 0; i < properties.size(); ++i) {
+    if (properties[i].name == a || (b && properties[i].name == b))
+      return (int)i;
+  }
+  return -1;
+}
+
+double PlyReader::getValue(const unsigned char *record,
+                           const Property &p) const {
+  unsigned char bytes[8];
+  memcpy(bytes, record + p.offset, p.size);
+  if (format == PLY_BIG)
+    std::reverse(bytes, bytes + p.size);
+
+  switch (p.size) {
+  case 1:
+    return p.kind == 'i' ? (double)(int8_t)bytes[0] : (double)bytes[0];
+  case 2:
+    return p.kind == 'i' ? (double)readValue<int16_t>(bytes)
+                         : (double)readValue<uint16_t>(bytes);
+  case 4:
+    if (p.kind == 'f')
+      return readValue<float>(bytes);
+    return p.kind == 'i' ? (double)readValue<int32_t>(bytes)
+                         : (double)readValue<uint32_t>(bytes);
+  default:
+    return readValue<double>(bytes);
+  }
+}
+
+size_t PlyReader::read(std::vector<Point3D> &out, size_t maxPoints) {
+  if (!file)
+    return 0;
+
+  size_t count = (size_t)std::min<uint64_t>(maxPoints,
+                                            info.pointCount - pointsRead);
+  buffer.resize(count * recordSize);
+  size_t records = 0;
+
+  if (format == PLY_ASCII) {
+    // Convert each text line into a little-endian binary record
+    char line[4096];
+    while (records < count && fgets(line, sizeof(line), file)) {
+      unsigned char *record = &buffer[records * recordSize];
+      char *cursor = line;
+      size_t i = 0;
+      for (; i < properties.size(); ++i) {
+        char *end;
+        double v = strtod(cursor, &end);
+        if (end == cursor)
+          break;
+        cursor = end;
+
+        const Property &p = properties[i];
+        if (p.kind == 'f' && p.size == 8) {
+          memcpy(record + p.offset, &v, 8);
+        } else if (p.kind == 'f') {
+          float f = (float)v;
+          memcpy(record + p.offset, &f, 4);
+        } else if (p.size == 1) {
+          record[p.offset] = (unsigned char)(int)v;
+        } else if (p.size == 2) {
+          uint16_t s = (uint16_t)(int)v;
+          memcpy(record + p.offset, &s, 2);
+        } else {
+          uint32_t u = (uint32_t)(int64_t)v;
+          memcpy(record + p.offset, &u, 4);
+        }
+      }
+      if (i == properties.size())
+        ++records;
+    }
+  } else {
+    records = fread(buffer.data(), recordSize, count, file);
+  }
+  pointsRead += records;
+  if (records < count)
+    pointsRead = info.pointCount; // Truncated file, stop here
+
+  out.reserve(out.size() + records);
+  for (size_t i = 0; i < records; ++i) {
+    const unsigned char *record = &buffer[i * recordSize];
+    double x = getValue(record, properties[xyz[0]]);
+    double y = getValue(record, properties[xyz[1]]);
+    double z = getValue(record, properties[xyz[2]]);
+
+    float intensity = 1.0f;
+    if (intensityIndex >= 0) {
+      const Property &p = properties[intensityIndex];
+      intensity = (float)getValue(record, p);
+      if (p.kind != 'f')
+        intensity /= p.size == 1 ? 255.0f : 65535.0f;
+    }
+
+    float r = intensity, g = intensity, b = intensity;
+    if (info.hasColor) {
+      r = (float)getValue(record, properties[rgb[0]]) * colorScale;
+      g = (float)getValue(record, properties[rgb[1]]) * colorScale;
+      b = (float)getValue(record, properties[rgb[2]]) * colorScale;
+    }
+    out.push_back(makePoint(x, y, z, r, g, b, intensity));
+    if (timeOutput && timeIndex >= 0)
+      timeOutput->push_back(getValue(record, properties[timeIndex]));
+  }
+  return records;
+}
+
+// ========== XYZ / TXT / CSV ==========
+
+class XyzReader : public PointReader {
+public:
+  XyzReader() : file(NULL), columns(0) {}
+  ~XyzReader() { close(); }
+
+  bool open(const std::string &path) override;
+  size_t read(std::vector<Point3D> &out, size_t maxPoints) override;
+
+private:
+  void close() {
+    if (file)
+      fclose(file);
+    file = NULL;
+  }
+  // Parse up to 8 numbers separated by spaces, tabs or commas
+  static int parseLine(const char *line, double values[8]);
+
+  FILE *file;
+  int columns; // 3 xyz, 4 xyzi, 6 xyzrgb, 7 xyzrgbi
+};
+
+int XyzReader::parseLine(const char *line, double values[8]) {
+  int n = 0;
+  const char *cursor = line;
+  while (n < 8) {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == ',')
+      ++cursor;
+    char *end;
+    double v = strtod(cursor, &end);
+    if (end == cursor)
+      break;
+    values[n++] = v;
+    cursor = end;
+  }
+  return n;
+}
+
+bool XyzReader::open(const std::string &path) {
+  close();
+  file = fopen(path.c_str(), "r");
+  if (!file)
+    return fail("cannot open " + path);
+
+  // The first numeric line decides the column layout
+  char line[1024];
+  double values[8];
+  columns = 0;
+  while (columns == 0 && fgets(line, sizeof(line), file)) {
+    int n = parseLine(line, values);
+    if (n >= 3)
+      columns = n;
+  }
+  if (columns == 0)
+    return fail(path + " has no x y z lines");
+  rewind(file);
+
+  info.hasColor = columns >= 6;
+  info.hasIntensity = columns == 4 || columns >= 7;
+  info.hasBounds = false;
+  return true;
+}
+
+size_t XyzReader::read(std::vector<Point3D> &out, size_t maxPoints) {
+  if (!file)
+    return 0;
+
+  char line[1024];
+  double v[8];
+  size_t records = 0;
+  while (records < maxPoints && fgets(line, sizeof(line), file)) {
+    int n = parseLine(line, v);
+    if (n < 3)
+      continue; // Header or blank line
+
+    float intensity = 1.0f;
+    if (n == 4)
+      intensity = (float)v[3];
+    else if (n >= 7)
+      intensity = (float)v[6];
+    if (intensity > 1.0f)
+      intensity = std::min(intensity / 255.0f, 1.0f);
+
+    float r = intensity, g = intensity, b = intensity;
+    if (n >= 6) {
+      // 0-255 colors unless all three are already normalized
+      float s = (v[3] > 1.0 || v[4] > 1.0 || v[5] > 1.0) ? 1.0f / 255.0f : 1.0f;
+      r = (float)v[3] * s;
+      g = (float)v[4] * s;
+      b = (float)v[5] * s;
+    }
+    out.push_back(makePoint(v[0], v[1], v[2], r, g, b, intensity));
+    ++records;
+  }
+  return records;
+}
+
+// ========== Factory ==========
+
+std::unique_ptr<PointReader> createPointReader(const std::string &path) {
+  std::string ext = getExtension(path);
+  if (ext == "las" || ext == "laz")
+    return std::unique_ptr<PointReader>(new LasReader());
+  if (ext == "ply")
+    return std::unique_ptr<PointReader>(new PlyReader());
+  if (ext == "xyz" || ext == "txt" || ext == "csv" || ext == "pts")
+    return std::unique_ptr<PointReader>(new XyzReader());
+  return std::unique_ptr<PointReader>();
+}
+
+bool loadPointFile(const std::string &path, std::vector<Point3D> &points,
+                   double origin[3], std::string *error,
+                   std::vector<double> *times) {
+  std::unique_ptr<PointReader> reader = createPointReader(path);
+  if (!reader) {
+    if (error)
+      *error = "unsupported file type: " + path;
+    return false;
+  }
+  if (!reader->open(path)) {
+    if (error)
+      *error = reader->getError();
+    return false;
+  }
+
+  const PointFileInfo &info = reader->getInfo();
+  if (info.hasBounds) {
+    for (int i = 0; i < 3; ++i)
+      origin[i] = (info.min[i] + info.max[i]) * 0.5;
+  } else {
+    // Use the first point; its float rounding doesn't matter for an origin
+    std::vector<Point3D> first;
+    origin[0] = origin[1] = origin[2] = 0.0;
+    if (reader->read(first, 1) == 1) {
+      const double zero[3] = {0.0, 0.0, 0.0};
+      float v[3] = {first[0].x, first[0].y, first[0].z};
+      viewerToFile(v, zero, origin);
+    }
+    reader->open(path);
+  }
+  reader->setOrigin(origin[0], origin[1], origin[2]);
+
+  points.clear();
+  if (info.pointCount > 0)
+    points.reserve((size_t)info.pointCount);
+  if (times) {
+    times->clear();
+    if (info.hasTime) {
+      reader->setTimeOutput(times);
+      times->reserve((size_t)info.pointCount);
+    }
+  }
+  while (reader->read(points, 1 << 20) > 0) {
+  }
+  return true;
+}
+
+bool loadPointFileAt(const std::string &path, const double origin[3],
+                     std::vector<Point3D> &points, std::string *error) {
+  std::unique_ptr<PointReader> reader = createPointReader(path);
+  if (!reader || !reader->open(path)) {
+    if (error)
+      *error = reader ? reader->getError() : "unsupported file type: " + path;
+    return false;
+  }
+  reader->setOrigin(origin[0], origin[1], origin[2]);
+
+  points.clear();
+  if (reader->getInfo().pointCount > 0)
+    points.reserve((size_t)reader->getInfo().pointCount);
+  while (reader->read(points, 1 << 20) > 0) {
+  }
+  if (!reader->getError().empty()) {
+    if (error)
+      *error = reader->getError();
+    return false;
+  }
+  return true;
+}
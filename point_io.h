@@ -0,0 +1,83 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Header information of a point file, in file coordinates (Z up)
+struct PointFileInfo {
+  uint64_t pointCount; // 0 when the format doesn't record it (XYZ)
+  bool hasBounds;
+  double min[3], max[3];
+  bool hasColor;
+  bool hasIntensity;
+  bool hasTime; // GPS time (LAS) or a time property (PLY)
+};
+
+// Point files are Z up, the viewer is Y up. Positions are stored relative
+// to an origin so large projected coordinates keep float precision.
+inline void fileToViewer(double x, double y, double z, const double origin[3],
+                         float out[3]) {
+  out[0] = (float)(x - origin[0]);
+  out[1] = (float)(z - origin[2]);
+  out[2] = (float)(origin[1] - y);
+}
+
+inline void viewerToFile(const float in[3], const double origin[3],
+                         double out[3]) {
+  out[0] = in[0] + origin[0];
+  out[1] = origin[1] - in[2];
+  out[2] = in[1] + origin[2];
+}
+
+// Streaming reader for LAS, PLY and XYZ files. Only the header is parsed by
+// open(), so bounds and counts are available without touching the points.
+class PointReader {
+public:
+  PointReader();
+  virtual ~PointReader() {}
+
+  virtual bool open(const std::string &path) = 0;
+
+  // Append up to maxPoints points to out; returns the number read, 0 at end
+  virtual size_t read(std::vector<Point3D> &out, size_t maxPoints) = 0;
+
+  const PointFileInfo &getInfo() const { return info; }
+  const std::string &getError() const { return error; }
+
+  // File coordinates subtracted from every point (default 0, 0, 0)
+  void setOrigin(double x, double y, double z);
+  const double *getOrigin() const { return origin; }
+
+  // When the file has times (info.hasTime), read() appends one per point
+  // to times, in seconds as stored in the file
+  void setTimeOutput(std::vector<double> *times) { timeOutput = times; }
+
+protected:
+  Point3D makePoint(double x, double y, double z, float r, float g, float b,
+                    float intensity) const;
+  bool fail(const std::string &message);
+
+  PointFileInfo info;
+  double origin[3];
+  std::vector<double> *timeOutput;
+  std::string error;
+};
+
+// Reader chosen by extension (las, laz, ply, xyz, txt, csv), null if unknown
+std::unique_ptr<PointReader> createPointReader(const std::string &path);
+
+// Read a whole file into memory; origin is set to the header bounds center
+// when the file has bounds. times receives the point times when the file
+// has them and is left empty otherwise.
+bool loadPointFile(const std::string &path, std::vector<Point3D> &points,
+                   double origin[3], std::string *error = NULL,
+                   std::vector<double> *times = NULL);
+
+// Read a whole file around a given origin, e.g. the one loadPointFile chose
+// for another survey of the same site, so the two line up
+bool loadPointFileAt(const std::string &path, const double origin[3],
+                     std::vector<Point3D> &points, std::string *error = NULL);
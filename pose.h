@@ -0,0 +1,54 @@
+#pragma once
+
+// Rigid transform [R | t] as a row-major 3x4 matrix, the layout of KITTI
+// pose files. Maps points from a local frame (a sweep's sensor frame) into
+// the frame above it (the map).
+struct Pose {
+  float m[12];
+
+  Pose() {
+    for (int i = 0; i < 12; ++i)
+      m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+  }
+
+  void apply(const float in[3], float out[3]) const {
+    for (int r = 0; r < 3; ++r)
+      out[r] = m[r * 4] * in[0] + m[r * 4 + 1] * in[1] +
+               m[r * 4 + 2] * in[2] + m[r * 4 + 3];
+  }
+
+  // this after b: (a * b).apply(p) == a.apply(b.apply(p))
+  Pose operator*(const Pose &b) const {
+    Pose c;
+    for (int r = 0; r < 3; ++r) {
+      for (int col = 0; col < 4; ++col) {
+        float v = m[r * 4] * b.m[col] + m[r * 4 + 1] * b.m[4 + col] +
+                  m[r * 4 + 2] * b.m[8 + col];
+        c.m[r * 4 + col] = col == 3 ? v + m[r * 4 + 3] : v;
+      }
+    }
+    return c;
+  }
+
+  // Inverse of a rigid transform: [R^T | -R^T t]
+  Pose inverse() const {
+    Pose inv;
+    for (int r = 0; r < 3; ++r) {
+      for (int col = 0; col < 3; ++col)
+        inv.m[r * 4 + col] = m[col * 4 + r];
+      inv.m[r * 4 + 3] = -(m[r] * m[3] + m[4 + r] * m[7] + m[8 + r] * m[11]);
+    }
+    return inv;
+  }
+
+  float getTranslation(int axis) const { return m[axis * 4 + 3]; }
+
+  // Column-major 4x4, as glMultMatrixf takes it
+  void toMatrix(float out[16]) const {
+    for (int col = 0; col < 4; ++col) {
+      for (int r = 0; r < 3; ++r)
+        out[col * 4 + r] = m[r * 4 + col];
+      out[col * 4 + 3] = col == 3 ? 1.0f : 0.0f;
+    }
+  }
+};
@@ -0,0 +1,325 @@
+#include "range_image.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const float PI = 3.14159265358979f;
+const float DEG = PI / 180.0f;
+const float LOOKUP_STEP = 0.01f * DEG; // Elevation bin of the ring lookup
+
+// Both cells hold returns from one surface unless the nearer one hides the
+// farther one at a grazing angle (Bogoslavskyi and Stachniss, 2016)
+bool sameSurface(float a, float b, float cosAlpha, float sinAlpha,
+                 float tanThreshold) {
+  float d1 = std::max(a, b), d2 = std::min(a, b);
+  // beta = atan2(d2 sin(alpha), d1 - d2 cos(alpha)) > threshold
+  float along = d1 - d2 * cosAlpha;
+  return along <= 0.0f || d2 * sinAlpha > tanThreshold * along;
+}
+
+} // namespace
+
+RangeImageCalibration RangeImageCalibration::uniform(int rings,
+                                                     float topDegrees,
+                                                     float bottomDegrees,
+                                                     int columns) {
+  RangeImageCalibration c;
+  c.columns = columns;
+  for (int i = 0; i < rings; ++i) {
+    float t = rings > 1 ? (float)i / (rings - 1) : 0.0f;
+    c.elevations.push_back((topDegrees + (bottomDegrees - topDegrees) * t) *
+                           DEG);
+  }
+  return c;
+}
+
+RangeImageCalibration RangeImageCalibration::hdl64(int columns) {
+  // Upper block of 32 lasers at 1/3 degree spacing, lower block at 1/2
+  RangeImageCalibration c = uniform(32, 2.0f, -8.33f, columns);
+  RangeImageCalibration lower = uniform(32, -8.83f, -24.33f, columns);
+  c.elevations.insert(c.elevations.end(), lower.elevations.begin(),
+                      lower.elevations.end());
+  return c;
+}
+
+RangeImage::RangeImage()
+    : rows(0), columns(0), lookupMin(0.0f), lookupScale(0.0f) {}
+
+void RangeImage::setCalibration(const RangeImageCalibration &calibration) {
+  calib = calibration;
+  rows = (int)calib.elevations.size();
+  columns = std::max(calib.columns, 1);
+  ranges.assign((size_t)rows * columns, 0.0f);
+  intensities.assign(ranges.size(), 0.0f);
+
+  rowCos.resize(rows);
+  rowSin.resize(rows);
+  for (int r = 0; r < rows; ++r) {
+    rowCos[r] = std::cos(calib.elevations[r]);
+    rowSin[r] = std::sin(calib.elevations[r]);
+  }
+  columnCos.resize(columns);
+  columnSin.resize(columns);
+  for (int c = 0; c < columns; ++c) {
+    float azimuth = 2.0f * PI * c / columns;
+    columnCos[c] = std::cos(azimuth);
+    columnSin[c] = std::sin(azimuth);
+  }
+
+  // Nearest ring for every elevation bin, half a ring gap past the ends
+  ringLookup.clear();
+  if (rows == 0)
+    return;
+  float top = *std::max_element(calib.elevations.begin(),
+                                calib.elevations.end());
+  float bottom = *std::min_element(calib.elevations.begin(),
+                                   calib.elevations.end());
+  float margin = rows > 1 ? (top - bottom) / (rows - 1) * 0.5f : DEG;
+  lookupMin = bottom - margin;
+  lookupScale = 1.0f / LOOKUP_STEP;
+  size_t bins = (size_t)((top + margin - lookupMin) * lookupScale) + 1;
+  ringLookup.resize(bins);
+  for (size_t i = 0; i < bins; ++i) {
+    float elevation = lookupMin + (i + 0.5f) * LOOKUP_STEP;
+    int best = 0;
+    for (int r = 1; r < rows; ++r) {
+      if (std::fabs(calib.elevations[r] - elevation) <
+          std::fabs(calib.elevations[best] - elevation))
+        best = r;
+    }
+    ringLookup[i] = (int16_t)best;
+  }
+}
+
+size_t RangeImage::fromPoints(const std::vector<Point3D> &points) {
+  std::fill(ranges.begin(), ranges.end(), 0.0f);
+  std::fill(intensities.begin(), intensities.end(), 0.0f);
+  if (ringLookup.empty())
+    return 0;
+
+  size_t filled = 0;
+  float columnScale = columns / (2.0f * PI);
+  for (size_t i = 0; i < points.size(); ++i) {
+    // Back to the sensor's axes: x forward, y left, z up
+    const Point3D &p = points[i];
+    float x = p.x, y = -p.z, z = p.y;
+    float horizontal = std::sqrt(x * x + y * y);
+    float range = std::sqrt(horizontal * horizontal + z * z);
+    if (!(range > 1e-3f))
+      continue;
+
+    float bin = (std::atan2(z, horizontal) - lookupMin) * lookupScale;
+    if (!(bin >= 0.0f && bin < (float)ringLookup.size()))
+      continue;
+    int row = ringLookup[(size_t)bin];
+    float azimuth = std::atan2(y, x);
+    if (azimuth < 0.0f)
+      azimuth += 2.0f * PI;
+    int column = (int)(azimuth * columnScale + 0.5f) % columns;
+
+    size_t cell = (size_t)row * columns + column;
+    if (ranges[cell] == 0.0f)
+      ++filled;
+    else if (ranges[cell] <= range)
+      continue;
+    ranges[cell] = range;
+    intensities[cell] = p.intensity;
+  }
+  return filled;
+}
+
+void RangeImage::computePositions(std::vector<float> &xyz,
+                                  unsigned threads) const {
+  xyz.resize(ranges.size() * 3);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  parallelFor(
+      (size_t)rows,
+      [&](size_t r) {
+        // One ring: the elevation terms are constant along the row
+        float ce = rowCos[r], se = rowSin[r];
+        const float *range = &ranges[r * columns];
+        float *out = &xyz[r * columns * 3];
+        for (int c = 0; c < columns; ++c) {
+          float d = range[c];
+          float h = d * ce;
+          bool valid = d > 0.0f;
+          out[c * 3] = valid ? h * columnCos[c] : nan;
+          out[c * 3 + 1] = valid ? d * se : nan;
+          out[c * 3 + 2] = valid ? -h * columnSin[c] : nan;
+        }
+      },
+      threads);
+}
+
+void RangeImage::computeNormals(const std::vector<float> &xyz,
+                                std::vector<float> &normals,
+                                unsigned threads) const {
+  normals.assign(ranges.size() * 3, 0.0f);
+  parallelFor(
+      (size_t)rows,
+      [&](size_t row) {
+        int r = (int)row;
+        for (int c = 0; c < columns; ++c) {
+          size_t cell = (size_t)r * columns + c;
+          float d = ranges[cell];
+          if (d == 0.0f)
+            continue;
+
+          // Neighbors on the same surface: a range step under 10%
+          size_t around[4] = {
+              (size_t)r * columns + (c + columns - 1) % columns,
+              (size_t)r * columns + (c + 1) % columns,
+              r > 0 ? cell - columns : cell,
+              r + 1 < rows ? cell + columns : cell};
+          bool use[4];
+          for (int k = 0; k < 4; ++k)
+            use[k] = around[k] != cell && ranges[around[k]] > 0.0f &&
+                     std::fabs(ranges[around[k]] - d) < 0.1f * d;
+
+          // Central differences, one-sided at gaps
+          float du[3], dv[3];
+          size_t a = use[0] ? around[0] : cell, b = use[1] ? around[1] : cell;
+          size_t e = use[2] ? around[2] : cell, f = use[3] ? around[3] : cell;
+          if (a == b || e == f)
+            continue;
+          for (int k = 0; k < 3; ++k) {
+            du[k] = xyz[b * 3 + k] - xyz[a * 3 + k];
+            dv[k] = xyz[f * 3 + k] - xyz[e * 3 + k];
+          }
+          float n[3] = {du[1] * dv[2] - du[2] * dv[1],
+                        du[2] * dv[0] - du[0] * dv[2],
+                        du[0] * dv[1] - du[1] * dv[0]};
+          float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+          if (length < 1e-12f)
+            continue;
+          const float *p = &xyz[cell * 3];
+          if (n[0] * p[0] + n[1] * p[1] + n[2] * p[2] > 0.0f)
+            length = -length; // Face the sensor at the origin
+          for (int k = 0; k < 3; ++k)
+            normals[cell * 3 + k] = n[k] / length;
+        }
+      },
+      threads);
+}
+
+void RangeImage::segmentGround(const std::vector<float> &xyz,
+                               const RangeSegmentOptions &options,
+                               std::vector<uint8_t> &ground) const {
+  ground.assign(ranges.size(), 0);
+  float groundLevel = -options.sensorHeight + options.groundTolerance;
+  float maxSlope = std::tan(options.maxGroundSlope * DEG);
+  for (int c = 0; c < columns; ++c) {
+    bool previousGround = false, havePrevious = false;
+    float previousHeight = 0.0f, previousDistance = 0.0f;
+    for (int r = rows - 1; r >= 0; --r) {
+      size_t cell = (size_t)r * columns + c;
+      if (ranges[cell] == 0.0f)
+        continue;
+      const float *p = &xyz[cell * 3];
+      float height = p[1];
+      float distance = std::sqrt(p[0] * p[0] + p[2] * p[2]);
+
+      // Continue a ground run while the slope stays low; start one at
+      // ground level
+      bool isGround = height < groundLevel;
+      if (havePrevious && previousGround) {
+        float rise = std::fabs(height - previousHeight);
+        float run = std::max(std::fabs(distance - previousDistance), 1e-3f);
+        isGround = rise <= maxSlope * run;
+      }
+      ground[cell] = isGround ? 1 : 0;
+      previousGround = isGround;
+      previousHeight = height;
+      previousDistance = distance;
+      havePrevious = true;
+    }
+  }
+}
+
+int RangeImage::cluster(const std::vector<uint8_t> &ground,
+                        const RangeSegmentOptions &options,
+                        std::vector<int> &labels) const {
+  labels.assign(ranges.size(), 0);
+  float tanThreshold = std::tan(options.clusterAngle * DEG);
+  float step = 2.0f * PI / columns;
+  float cosStep = std::cos(step), sinStep = std::sin(step);
+  std::vector<float> gapCos(rows, 1.0f), gapSin(rows, 0.0f); // Ring r to r+1
+  for (int r = 0; r + 1 < rows; ++r) {
+    float alpha = std::fabs(calib.elevations[r + 1] - calib.elevations[r]);
+    gapCos[r] = std::cos(alpha);
+    gapSin[r] = std::sin(alpha);
+  }
+
+  // Breadth-first fill over the 4-neighborhood, wrapping around in azimuth
+  std::vector<size_t> queue;
+  std::vector<int> sizes(1, 0);
+  int next = 1;
+  for (size_t seed = 0; seed < ranges.size(); ++seed) {
+    if (labels[seed] != 0 || ranges[seed] == 0.0f || ground[seed])
+      continue;
+    int label = next++;
+    size_t size = 0;
+    queue.clear();
+    queue.push_back(seed);
+    labels[seed] = label;
+    for (size_t q = 0; q < queue.size(); ++q) {
+      size_t cell = queue[q];
+      ++size;
+      int r = (int)(cell / columns), c = (int)(cell % columns);
+      for (int k = 0; k < 4; ++k) {
+        int nr = r, nc = c;
+        if (k == 0)
+          nc = (c + columns - 1) % columns;
+        else if (k == 1)
+          nc = (c + 1) % columns;
+        else if (k == 2)
+          nr = r - 1;
+        else
+          nr = r + 1;
+        if (nr < 0 || nr >= rows)
+          continue;
+        size_t n = (size_t)nr * columns + nc;
+        if (labels[n] != 0 || ranges[n] == 0.0f || ground[n])
+          continue;
+
+        float cosAlpha = cosStep, sinAlpha = sinStep;
+        if (nr != r) {
+          cosAlpha = gapCos[std::min(r, nr)];
+          sinAlpha = gapSin[std::min(r, nr)];
+        }
+        if (sameSurface(ranges[cell], ranges[n], cosAlpha, sinAlpha,
+                        tanThreshold)) {
+          labels[n] = label;
+          queue.push_back(n);
+        }
+      }
+    }
+    sizes.push_back((int)size);
+  }
+
+  // Drop small clusters and number the rest from 1
+  std::vector<int> renumber(sizes.size(), 0);
+  int count = 0;
+  for (size_t i = 1; i < sizes.size(); ++i) {
+    if (sizes[i] >= options.minClusterSize)
+      renumber[i] = ++count;
+  }
+  for (size_t i = 0; i < labels.size(); ++i)
+    labels[i] = renumber[labels[i]];
+  return count;
+}
+
+void RangeImage::toPoints(std::vector<Point3D> &out) const {
+  std::vector<float> xyz;
+  computePositions(xyz, 1);
+  for (size_t cell = 0; cell < ranges.size(); ++cell) {
+    if (ranges[cell] == 0.0f)
+      continue;
+    float i = intensities[cell];
+    out.push_back(Point3D(xyz[cell * 3], xyz[cell * 3 + 1], xyz[cell * 3 + 2],
+                          i, i, i, i));
+  }
+}
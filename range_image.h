@@ -0,0 +1,100 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <vector>
+
+// Beam layout of a spinning sensor: the elevation of each ring and the
+// number of azimuth steps per revolution
+struct RangeImageCalibration {
+  std::vector<float> elevations; // Radians, one per ring, top ring first
+  int columns;
+
+  RangeImageCalibration() : columns(0) {}
+
+  // rings spread evenly between two elevations (degrees)
+  static RangeImageCalibration uniform(int rings, float topDegrees,
+                                       float bottomDegrees, int columns);
+  // Velodyne HDL-64E as mounted on the KITTI car
+  static RangeImageCalibration hdl64(int columns = 2048);
+};
+
+// Ground and cluster segmentation settings
+struct RangeSegmentOptions {
+  float sensorHeight;    // Above the ground, meters
+  float groundTolerance; // Lowest return counts as ground within this
+  float maxGroundSlope;  // Degrees between consecutive ground returns
+  float clusterAngle;    // Degrees; larger merges less
+  int minClusterSize;    // Smaller clusters are left unlabeled
+
+  RangeSegmentOptions()
+      : sensorHeight(1.73f), groundTolerance(0.4f), maxGroundSlope(10.0f),
+        clusterAngle(10.0f), minClusterSize(20) {}
+};
+
+// A sweep as the sensor sees it: rings x azimuth steps of range and
+// intensity, row 0 being the top ring and column 0 straight ahead. Every
+// cell's neighbors are one step away, so normals, ground and clusters come
+// from fixed-size neighborhoods instead of a spatial search.
+//
+// Positions are recomputed on demand from the ranges and per-ring and
+// per-column sine/cosine tables, in loops written to vectorize. Points are
+// in viewer coordinates (Y up) of the sensor frame, like the sweeps of
+// FrameSequence.
+class RangeImage {
+public:
+  RangeImage();
+
+  void setCalibration(const RangeImageCalibration &calibration);
+  const RangeImageCalibration &getCalibration() const { return calib; }
+
+  int getRows() const { return rows; }
+  int getColumns() const { return columns; }
+
+  // Bin an unorganized sweep into the grid, keeping the nearest return of
+  // each cell; returns the number of cells filled
+  size_t fromPoints(const std::vector<Point3D> &points);
+
+  // Range 0 marks an empty cell
+  float getRange(int row, int column) const {
+    return ranges[(size_t)row * columns + column];
+  }
+  float getIntensity(int row, int column) const {
+    return intensities[(size_t)row * columns + column];
+  }
+
+  // x, y, z of every cell, row-major (NaN for empty cells)
+  void computePositions(std::vector<float> &xyz, unsigned threads = 0) const;
+
+  // Unit normal per cell from the cells around it, facing the sensor
+  // (zero where the neighborhood is too sparse)
+  void computeNormals(const std::vector<float> &xyz,
+                      std::vector<float> &normals,
+                      unsigned threads = 0) const;
+
+  // 1 for ground cells, walking each column up from the lowest ring while
+  // the slope between returns stays small
+  void segmentGround(const std::vector<float> &xyz,
+                     const RangeSegmentOptions &options,
+                     std::vector<uint8_t> &ground) const;
+
+  // Connected non-ground cells whose depth step to a neighbor is not a
+  // jump; labels are 1-based, 0 for ground, empty and small clusters.
+  // Returns the number of clusters.
+  int cluster(const std::vector<uint8_t> &ground,
+              const RangeSegmentOptions &options,
+              std::vector<int> &labels) const;
+
+  // Filled cells as points (with the stored intensity)
+  void toPoints(std::vector<Point3D> &out) const;
+
+private:
+  RangeImageCalibration calib;
+  int rows, columns;
+  std::vector<float> ranges, intensities;
+
+  // Lookup tables
+  std::vector<float> rowCos, rowSin, columnCos, columnSin;
+  std::vector<int16_t> ringLookup; // Elevation bin -> nearest ring
+  float lookupMin, lookupScale;
+};
@@ -0,0 +1,280 @@
+// Headless image regression check for the point cloud renderer.
+// Renders deterministic scenes through the software rasterizer, compares
+// them against golden PPM files and enforces frame time and memory limits.
+// A missing golden is a failure; --update writes the current images as the
+// new goldens.
+#ifdef LIDAR_HEADLESS_EGL
+#include "headless_context.h"
+#include <GL/gl.h>
+#endif
+#include "image_io.h"
+#include "point_cloud_renderer.h"
+#include "sample_scenes.h"
+#include "software_rasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+struct Options {
+  std::string goldenDir;
+  std::string diffDir; // Where difference images go (the golden directory)
+  bool update;
+  int tolerance;         // Per-channel difference that counts as a mismatch
+  float maxDiffFraction; // Fraction of mismatched pixels allowed
+  float maxFrameMs;
+  float maxMemoryMB;
+  bool useGL; // Headless OpenGL instead of the software rasterizer
+};
+
+static void makeDirectory(const std::string &path) {
+#ifdef _WIN32
+  _mkdir(path.c_str());
+#else
+  mkdir(path.c_str(), 0755);
+#endif
+}
+
+static bool fileExists(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f)
+    fclose(f);
+  return f != NULL;
+}
+
+// Returns the fraction of pixels differing by more than the tolerance, and
+// writes a difference image next to the golden file
+static float compareImages(const std::vector<unsigned char> &actual,
+                           const std::vector<unsigned char> &golden, int width,
+                           int height, int tolerance,
+                           const std::string &diffPath) {
+  std::vector<unsigned char> diff(actual.size(), 0);
+  size_t mismatched = 0;
+  for (size_t i = 0; i < actual.size(); i += 3) {
+    int worst = 0;
+    for (int c = 0; c < 3; ++c)
+      worst = std::max(worst, std::abs((int)actual[i + c] - golden[i + c]));
+    if (worst > tolerance) {
+      ++mismatched;
+      diff[i] = 255;
+    }
+  }
+  if (mismatched > 0)
+    writePPM(diffPath.c_str(), width, height, diff.data());
+  return (float)mismatched / (width * height);
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  opt.goldenDir = "regress_golden";
+  opt.update = false;
+  opt.tolerance = 8;
+  opt.maxDiffFraction = 0.005f;
+  opt.maxFrameMs = 250.0f;
+  opt.maxMemoryMB = 1024.0f;
+  opt.useGL = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--update")) {
+      opt.update = true;
+    } else if (!strcmp(argv[i], "--golden") && i + 1 < argc) {
+      opt.goldenDir = argv[++i];
+    } else if (!strcmp(argv[i], "--diff-dir") && i + 1 < argc) {
+      opt.diffDir = argv[++i];
+    } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+      opt.tolerance = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-diff") && i + 1 < argc) {
+      opt.maxDiffFraction = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-frame-ms") && i + 1 < argc) {
+      opt.maxFrameMs = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-memory-mb") && i + 1 < argc) {
+      opt.maxMemoryMB = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--backend") && i + 1 < argc) {
+      opt.useGL = !strcmp(argv[++i], "gl");
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--golden DIR] [--update] [--diff-dir DIR]\n"
+              "          [--tolerance N]\n"
+              "          [--max-diff FRACTION] [--max-frame-ms MS]\n"
+              "          [--max-memory-mb MB] [--backend software|gl]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  struct Scene {
+    const char *name;
+    int count;
+  };
+  const Scene scenes[] = {
+      {"spiral", 50000}, {"terrain", 40000}, {"boxes", 45000}};
+
+  struct View {
+    const char *name;
+    int colorMode;
+    void (Camera::*preset)();
+  };
+  const View views[] = {
+      {"iso_rgb", PointCloudRenderer::COLOR_RGB, &Camera::setIsometricView},
+      {"iso_height", PointCloudRenderer::COLOR_HEIGHT,
+       &Camera::setIsometricView},
+      {"iso_intensity", PointCloudRenderer::COLOR_INTENSITY,
+       &Camera::setIsometricView},
+      {"iso_uniform", PointCloudRenderer::COLOR_UNIFORM,
+       &Camera::setIsometricView},
+      {"top_height", PointCloudRenderer::COLOR_HEIGHT, &Camera::setTopView},
+      {"front_rgb", PointCloudRenderer::COLOR_RGB, &Camera::setFrontView},
+      {"side_rgb", PointCloudRenderer::COLOR_RGB, &Camera::setSideView}};
+
+  const int width = 320, height = 240;
+  const int timedFrames = 5;
+  int failures = 0, created = 0, passed = 0;
+
+  if (opt.diffDir.empty())
+    opt.diffDir = opt.goldenDir;
+  if (opt.update)
+    makeDirectory(opt.goldenDir);
+  makeDirectory(opt.diffDir);
+
+#ifdef LIDAR_HEADLESS_EGL
+  HeadlessContext context;
+  if (opt.useGL && !context.create(width, height))
+    return 1;
+#else
+  if (opt.useGL) {
+    fprintf(stderr, "Built without headless GL support\n");
+    return 1;
+  }
+#endif
+
+  PointCloudRenderer renderer;
+  SoftwareRasterizer raster(width, height);
+  std::vector<unsigned char> glPixels;
+
+  // Render one frame with the selected backend, returning its pixels
+  auto renderFrame = [&]() -> const std::vector<unsigned char> & {
+#ifdef LIDAR_HEADLESS_EGL
+    if (opt.useGL) {
+      glViewport(0, 0, width, height);
+      glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      renderer.render(width, height);
+      context.readPixels(glPixels);
+      return glPixels;
+    }
+#endif
+    raster.clear(0.1f, 0.1f, 0.15f);
+    raster.render(renderer);
+    return raster.getPixels();
+  };
+
+  for (const Scene &scene : scenes) {
+    std::vector<Point3D> points;
+    makeScene(scene.name, scene.count, points);
+    renderer.getCamera().reset();
+    renderer.setPointCloud(points);
+    Camera base = renderer.getCamera();
+
+    // Point storage must hold exactly the loaded points
+    size_t expected = points.size() * sizeof(Point3D);
+    if (MemoryStats::getBytes(MEM_POINT_STORAGE) != expected) {
+      printf("FAIL %s: point storage %zu bytes, expected %zu\n", scene.name,
+             MemoryStats::getBytes(MEM_POINT_STORAGE), expected);
+      ++failures;
+    }
+
+    for (const View &view : views) {
+      std::string name = std::string(scene.name) + "_" + view.name;
+      // GL and software images differ in rasterization, keep separate goldens
+      if (opt.useGL)
+        name += "_gl";
+      renderer.getCamera() = base;
+      (renderer.getCamera().*view.preset)();
+      renderer.setColorMode(view.colorMode);
+
+      // Median of several frames to keep the timing check stable
+      std::vector<double> times;
+      const std::vector<unsigned char> *pixels = NULL;
+      for (int f = 0; f < timedFrames; ++f) {
+        auto start = std::chrono::steady_clock::now();
+        pixels = &renderFrame();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(
+            std::chrono::duration<double, std::milli>(end - start).count());
+      }
+      std::sort(times.begin(), times.end());
+      double frameMs = times[times.size() / 2];
+
+      bool ok = true, isNew = false;
+      if (frameMs > opt.maxFrameMs) {
+        printf("FAIL %s: frame time %.2f ms > %.2f ms\n", name.c_str(),
+               frameMs, opt.maxFrameMs);
+        ok = false;
+      }
+
+      std::string goldenPath = opt.goldenDir + "/" + name + ".ppm";
+      if (opt.update) {
+        if (!writePPM(goldenPath.c_str(), width, height, pixels->data())) {
+          printf("FAIL %s: cannot write %s\n", name.c_str(),
+                 goldenPath.c_str());
+          ok = false;
+        } else {
+          printf("NEW  %s (%.2f ms)\n", name.c_str(), frameMs);
+          isNew = true;
+        }
+      } else if (!fileExists(goldenPath)) {
+        printf("FAIL %s: no golden %s (run with --update to create it)\n",
+               name.c_str(), goldenPath.c_str());
+        ok = false;
+      } else {
+        int gw = 0, gh = 0;
+        std::vector<unsigned char> golden;
+        if (!readPPM(goldenPath.c_str(), gw, gh, golden) || gw != width ||
+            gh != height) {
+          printf("FAIL %s: unreadable golden %s\n", name.c_str(),
+                 goldenPath.c_str());
+          ok = false;
+        } else {
+          std::string diffPath = opt.diffDir + "/" + name + ".diff.ppm";
+          float fraction = compareImages(*pixels, golden, width, height,
+                                         opt.tolerance, diffPath);
+          if (fraction > opt.maxDiffFraction) {
+            printf("FAIL %s: %.3f%% pixels differ (see %s)\n", name.c_str(),
+                   fraction * 100.0f, diffPath.c_str());
+            ok = false;
+          } else {
+            printf("OK   %s (%.2f ms, %.3f%% differ)\n", name.c_str(),
+                   frameMs, fraction * 100.0f);
+          }
+        }
+      }
+
+      if (!ok)
+        ++failures;
+      else if (isNew)
+        ++created;
+      else
+        ++passed;
+    }
+  }
+
+  float peakMB =
+      MemoryStats::getProcessPeakResidentBytes() / (1024.0f * 1024.0f);
+  if (peakMB > opt.maxMemoryMB) {
+    printf("FAIL peak RSS %.1f MB > %.1f MB\n", peakMB, opt.maxMemoryMB);
+    ++failures;
+  }
+
+  printf("%d passed, %d created, %d failed (peak RSS %.1f MB)\n", passed,
+         created, failures, peakMB);
+  return failures > 0 ? 1 : 0;
+}
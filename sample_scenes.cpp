@@ -0,0 +1,87 @@
+#include "sample_scenes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Small LCG so scenes are identical on every platform and standard library
+struct SceneRandom {
+  unsigned int state;
+  explicit SceneRandom(unsigned int seed) : state(seed) {}
+  float next() {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f);
+  }
+};
+
+std::vector<Point3D> makeSpiralScene(int count) {
+  SceneRandom rnd(1);
+  std::vector<Point3D> points;
+  points.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    float angle = (float)i / count * 2.0f * (float)M_PI * 10.0f;
+    float radius = rnd.next() * 5.0f;
+    float x = cosf(angle) * radius;
+    float y = sinf(angle) * 2.0f + rnd.next() * 0.5f;
+    float z = sinf(angle) * radius;
+    points.push_back(Point3D(x, y, z, (x + 5.0f) / 10.0f, (y + 3.0f) / 6.0f,
+                             (z + 5.0f) / 10.0f, rnd.next()));
+  }
+  return points;
+}
+
+std::vector<Point3D> makeTerrainScene(int count) {
+  SceneRandom rnd(2);
+  std::vector<Point3D> points;
+  int side = std::max((int)std::sqrt((float)count), 1);
+  float step = 20.0f / side;
+  points.reserve((size_t)side * side);
+  for (int i = 0; i < side; ++i) {
+    for (int j = 0; j < side; ++j) {
+      float x = i * step - 10.0f;
+      float z = j * step - 10.0f;
+      float y = sinf(x * 0.5f) * cosf(z * 0.3f) * 2.0f + rnd.next() * 0.05f;
+      float shade = 0.5f + 0.25f * y;
+      points.push_back(Point3D(x, y, z, 0.3f, shade, 0.2f, rnd.next()));
+    }
+  }
+  return points;
+}
+
+std::vector<Point3D> makeBoxesScene(int count) {
+  SceneRandom rnd(3);
+  std::vector<Point3D> points;
+  points.reserve(count);
+  const float boxes[3][6] = {{-4, 0, -4, -1, 3, -1},
+                             {0, 0, 0, 3, 1, 4},
+                             {-2, 0, 2, -1, 5, 3}};
+  for (int b = 0; b < 3; ++b) {
+    const float *box = boxes[b];
+    for (int i = 0; i < count / 3; ++i) {
+      float p[3];
+      for (int k = 0; k < 3; ++k)
+        p[k] = box[k] + rnd.next() * (box[k + 3] - box[k]);
+      // Snap one coordinate to a face so points lie on the surface
+      int axis = i % 3;
+      p[axis] = rnd.next() < 0.5f ? box[axis] : box[axis + 3];
+      points.push_back(Point3D(p[0], p[1], p[2], b == 0, b == 1, b == 2,
+                               rnd.next()));
+    }
+  }
+  return points;
+}
+
+bool makeScene(const char *name, int count, std::vector<Point3D> &points) {
+  if (!strcmp(name, "spiral"))
+    points = makeSpiralScene(count);
+  else if (!strcmp(name, "terrain"))
+    points = makeTerrainScene(count);
+  else if (!strcmp(name, "boxes"))
+    points = makeBoxesScene(count);
+  else
+    return false;
+  return true;
+}
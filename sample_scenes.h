@@ -0,0 +1,14 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <vector>
+
+// Deterministic synthetic point clouds for benchmarks and regression runs.
+// They use their own random generator, so the same count yields identical
+// points on every platform and standard library.
+std::vector<Point3D> makeSpiralScene(int count);
+std::vector<Point3D> makeTerrainScene(int count);
+std::vector<Point3D> makeBoxesScene(int count);
+
+// Look up one of the scenes above by name ("spiral", "terrain", "boxes")
+bool makeScene(const char *name, int count, std::vector<Point3D> &points);
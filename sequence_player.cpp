@@ -0,0 +1,191 @@
+#include "sequence_player.h"
+#include <algorithm>
+#include <cmath>
+
+SequencePlayer::SequencePlayer(const FrameSequence &sequence, unsigned threads)
+    : sequence(sequence), colorMode(PointCloudRenderer::COLOR_HEIGHT),
+      heightMin(-2.5f), heightMax(2.5f),
+      loader(
+          [this](int id, std::vector<Point3D> &points) {
+            if (!this->sequence.loadFrame((size_t)id, points))
+              return false;
+            colorize(points);
+            return true;
+          },
+          threads),
+      playing(false), speed(1.0f), loop(true), queueDepth(8), clock(0.0),
+      shownFrame(0), hasShown(false), seekPending(false), waiting(false),
+      waitFrame(0), stalls(0), skipped(0) {
+  seek(0);
+}
+
+void SequencePlayer::setColorMode(int mode) {
+  if (mode == colorMode)
+    return;
+  colorMode = mode;
+  // Decoded frames carry the old colors; decode the shown one again
+  seek(shownFrame);
+}
+
+void SequencePlayer::setHeightRange(float minY, float maxY) {
+  heightMin = minY;
+  heightMax = maxY;
+  if (colorMode == PointCloudRenderer::COLOR_HEIGHT ||
+      colorMode == PointCloudRenderer::COLOR_RGB)
+    seek(shownFrame);
+}
+
+void SequencePlayer::seek(size_t frame) {
+  if (sequence.getFrameCount() == 0)
+    return;
+  // Drop everything decoded for the old position, including loads that
+  // finished since the last update
+  loader.cancelAll();
+  finished.clear();
+  loader.takeFinished(finished);
+  finished.clear();
+  ready.clear();
+  requested.clear();
+  shownFrame = std::min(frame, sequence.getFrameCount() - 1);
+  clock = sequence.getFrameTime(shownFrame);
+  seekPending = true;
+  waiting = false;
+  fillWindow();
+}
+
+void SequencePlayer::step(int frames) {
+  long long target = (long long)shownFrame + frames;
+  seek((size_t)std::max(target, 0LL));
+}
+
+void SequencePlayer::show(size_t frame) {
+  std::map<size_t, std::vector<Point3D>>::iterator it = ready.find(frame);
+  shownPoints.swap(it->second);
+  ready.erase(it);
+  shownFrame = frame;
+  hasShown = true;
+  waiting = false;
+}
+
+bool SequencePlayer::update(double elapsedSeconds) {
+  finished.clear();
+  loader.takeFinished(finished);
+  for (size_t i = 0; i < finished.size(); ++i) {
+    requested.erase((size_t)finished[i].id);
+    if (finished[i].ok)
+      ready[(size_t)finished[i].id].swap(finished[i].points);
+  }
+  finished.clear();
+
+  size_t count = sequence.getFrameCount();
+  bool changed = false;
+  if (count == 0) {
+    return false;
+  } else if (seekPending) {
+    if (ready.count(shownFrame)) {
+      show(shownFrame);
+      seekPending = false;
+      changed = true;
+    }
+  } else if (playing) {
+    // The last sweep lasts one average period before the clock wraps
+    double period = count > 1 ? sequence.getDuration() / (count - 1) : 0.1;
+    double end = sequence.getDuration() + period;
+    clock += elapsedSeconds * speed;
+    if (clock >= end) {
+      if (loop) {
+        clock = std::fmod(clock, end);
+      } else {
+        clock = sequence.getDuration();
+        playing = false;
+      }
+    }
+
+    size_t target = sequence.findFrame(clock);
+    if (target != shownFrame) {
+      if (ready.count(target)) {
+        if (target > shownFrame)
+          skipped += target - shownFrame - 1;
+        show(target);
+        changed = true;
+      } else {
+        // Hold the clock at the frame we are waiting for, and decode from
+        // it: after a long update it can be past the end of the window
+        ++stalls;
+        clock = sequence.getFrameTime(target);
+        waiting = true;
+        waitFrame = target;
+      }
+    }
+  }
+
+  fillWindow();
+  return changed;
+}
+
+void SequencePlayer::fillWindow() {
+  size_t count = sequence.getFrameCount();
+  if (count == 0)
+    return;
+
+  // The frames that will be shown next, in order; wraps when looping
+  std::vector<size_t> window;
+  size_t next = seekPending ? shownFrame : waiting ? waitFrame : shownFrame + 1;
+  for (size_t k = 0; k < queueDepth && window.size() < count; ++k) {
+    size_t frame = next + k;
+    if (frame >= count) {
+      if (!loop)
+        break;
+      frame %= count;
+    }
+    window.push_back(frame);
+  }
+
+  for (std::map<size_t, std::vector<Point3D>>::iterator it = ready.begin();
+       it != ready.end();) {
+    if (std::find(window.begin(), window.end(), it->first) == window.end())
+      it = ready.erase(it);
+    else
+      ++it;
+  }
+  for (std::set<size_t>::iterator it = requested.begin();
+       it != requested.end();) {
+    if (std::find(window.begin(), window.end(), *it) == window.end()) {
+      loader.cancel((int)*it);
+      it = requested.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Nearest frames first
+  for (size_t k = 0; k < window.size(); ++k) {
+    size_t frame = window[k];
+    if (!ready.count(frame) && !requested.count(frame)) {
+      loader.request((int)frame, -(float)k);
+      requested.insert(frame);
+    }
+  }
+}
+
+void SequencePlayer::colorize(std::vector<Point3D> &points) const {
+  int mode = colorMode;
+  if (mode == PointCloudRenderer::COLOR_RGB && sequence.hasColor())
+    return;
+  float minY = heightMin, maxY = heightMax;
+  float scale = maxY > minY ? 1.0f / (maxY - minY) : 0.0f;
+  for (size_t i = 0; i < points.size(); ++i) {
+    Point3D &p = points[i];
+    if (mode == PointCloudRenderer::COLOR_INTENSITY) {
+      p.r = p.g = p.b = p.intensity;
+    } else if (mode == PointCloudRenderer::COLOR_UNIFORM) {
+      p.r = p.g = p.b = 1.0f;
+    } else {
+      // Same blue -> green -> red ramp as the renderer's height mode
+      float t = std::min(std::max((p.y - minY) * scale, 0.0f), 1.0f);
+      p.r = t;
+      p.g = 1.0f - std::fabs(t - 0.5f) * 2.0f;
+      p.b = 1.0f - t;
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "chunk_loader.h"
+#include "frame_sequence.h"
+#include <atomic>
+#include <algorithm>
+#include <map>
+#include <set>
+
+// Plays a FrameSequence on its own clock. Frames ahead of the one shown
+// are decoded on background threads into a bounded window; the shown
+// frame only advances to frames that are ready, so a slow disk stalls the
+// clock instead of skipping sweeps. Seeking drops the window and decodes
+// the target first.
+class SequencePlayer {
+public:
+  explicit SequencePlayer(const FrameSequence &sequence, unsigned threads = 2);
+
+  void play() { playing = true; }
+  void pause() { playing = false; }
+  bool isPlaying() const { return playing; }
+  void setSpeed(float speed) { this->speed = speed; }
+  float getSpeed() const { return speed; }
+  void setLoop(bool loop) { this->loop = loop; }
+  bool getLoop() const { return loop; }
+
+  // Frames decoded or decoding ahead of the shown one
+  void setQueueDepth(size_t frames) { queueDepth = frames ? frames : 1; }
+  size_t getQueueDepth() const { return queueDepth; }
+
+  // Colors baked into decoded frames: COLOR_HEIGHT over the given range of
+  // viewer Y, COLOR_INTENSITY or COLOR_UNIFORM (PointCloudRenderer modes;
+  // COLOR_RGB keeps the sweep's colors, or falls back to height for
+  // sequences without them)
+  void setColorMode(int mode);
+  int getColorMode() const { return colorMode; }
+  void setHeightRange(float minY, float maxY);
+
+  // Show a frame as soon as it is decoded; step() seeks relative to the
+  // frame shown now
+  void seek(size_t frame);
+  void step(int frames);
+
+  // Advance the clock by the wall time since the last call and keep the
+  // decode window full. Returns true when a new frame is ready to show.
+  bool update(double elapsedSeconds);
+
+  // The frame shown now; its points stay valid until the next update
+  size_t getFrame() const { return shownFrame; }
+  const std::vector<Point3D> &getFramePoints() const { return shownPoints; }
+  bool hasFrame() const { return hasShown; }
+  double getTime() const { return clock; }
+
+  size_t getReadyCount() const { return ready.size(); }
+  size_t getPendingCount() const { return loader.getPendingCount(); }
+  size_t getStallCount() const { return stalls; }     // Updates spent waiting
+  size_t getSkippedCount() const { return skipped; }  // Frames never shown
+
+private:
+  void fillWindow();
+  void show(size_t frame);
+  void colorize(std::vector<Point3D> &points) const;
+
+  const FrameSequence &sequence;
+  std::atomic<int> colorMode; // Read by the decode threads
+  std::atomic<float> heightMin, heightMax;
+  ChunkLoader loader;
+  bool playing;
+  float speed;
+  bool loop;
+  size_t queueDepth;
+
+  double clock;        // Sequence time
+  size_t shownFrame;
+  bool hasShown;
+  bool seekPending;    // Show the shown frame again once decoded
+  bool waiting;        // The clock is held at waitFrame until it decodes
+  size_t waitFrame;
+  std::vector<Point3D> shownPoints;
+
+  std::map<size_t, std::vector<Point3D>> ready; // Decoded, not shown yet
+  std::set<size_t> requested;
+  std::vector<LoadedChunk> finished; // Scratch for update
+  size_t stalls, skipped;
+};
@@ -0,0 +1,97 @@
+// Playback check for SequencePlayer on a synthetic sequence: frames must
+// keep advancing at the clock's pace, including after an update that moves
+// the clock far past the decode window (a long hitch on the UI thread).
+#include "sequence_player.h"
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+namespace {
+
+// A fixed number of one-point sweeps at 10 Hz; each decode takes a little
+// time so the player really waits on its worker threads
+class SyntheticSequence : public FrameSequence {
+public:
+  explicit SyntheticSequence(size_t frames) {
+    for (size_t i = 0; i < frames; ++i)
+      times.push_back(i * 0.1);
+  }
+
+  bool loadFrame(size_t frame, std::vector<Point3D> &out) const override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    Point3D p = {};
+    p.x = (float)frame;
+    out.push_back(p);
+    return true;
+  }
+};
+
+// Update with small steps until the shown frame is one of first..last;
+// false if it isn't within the given wall time
+bool playUntil(SequencePlayer &player, size_t first, size_t last,
+               double seconds) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  while (std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+             .count() < seconds) {
+    player.update(0.02);
+    size_t frame = player.getFrame();
+    if (player.hasFrame() && frame >= first && frame <= last &&
+        player.getFramePoints().size() == 1 &&
+        player.getFramePoints()[0].x == (float)frame)
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+
+  // Normal playback from the start
+  {
+    SyntheticSequence sequence(40);
+    SequencePlayer player(sequence);
+    player.setLoop(false);
+    player.play();
+    bool ok = playUntil(player, 20, 39, 5.0);
+    printf("%-32s %s (frame %zu, stalls %zu)\n", "playback",
+           ok ? "PASS" : "FAIL", player.getFrame(), player.getStallCount());
+    failures += !ok;
+  }
+
+  // One update 15 frames long, well past the 8-frame window: the player
+  // has to decode the frame the clock jumped to and carry on from there
+  {
+    SyntheticSequence sequence(40);
+    SequencePlayer player(sequence);
+    player.setLoop(false);
+    bool ok = playUntil(player, 0, 0, 5.0);
+    player.play();
+    player.update(1.5);
+    ok = ok && playUntil(player, 30, 39, 5.0);
+    printf("%-32s %s (frame %zu, stalls %zu)\n", "large update",
+           ok ? "PASS" : "FAIL", player.getFrame(), player.getStallCount());
+    failures += !ok;
+  }
+
+  // The same across the end of a looping sequence
+  {
+    SyntheticSequence sequence(40);
+    SequencePlayer player(sequence);
+    player.seek(35);
+    bool ok = playUntil(player, 35, 35, 5.0);
+    player.play();
+    player.update(2.0);
+    ok = ok && playUntil(player, 20, 34, 5.0);
+    printf("%-32s %s (frame %zu, stalls %zu)\n", "large update, looping",
+           ok ? "PASS" : "FAIL", player.getFrame(), player.getStallCount());
+    failures += !ok;
+  }
+
+  printf("%d failure(s)\n", failures);
+  return failures ? 1 : 0;
+}
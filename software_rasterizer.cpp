@@ -0,0 +1,219 @@
+#include "software_rasterizer.h"
+#include "image_io.h"
+#include <algorithm>
+#include <cmath>
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height)
+    : width(0), height(0) {
+  resize(width, height);
+  for (int i = 0; i < 16; ++i)
+    mvp[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+}
+
+void SoftwareRasterizer::resize(int newWidth, int newHeight) {
+  width = std::max(newWidth, 0);
+  height = std::max(newHeight, 0);
+  color.assign((size_t)width * height * 3, 0);
+  depth.assign((size_t)width * height, 1.0f);
+}
+
+void SoftwareRasterizer::clear(float r, float g, float b) {
+  unsigned char c[3] = {(unsigned char)(r * 255.0f + 0.5f),
+                        (unsigned char)(g * 255.0f + 0.5f),
+                        (unsigned char)(b * 255.0f + 0.5f)};
+  for (size_t i = 0; i < color.size(); i += 3) {
+    color[i] = c[0];
+    color[i + 1] = c[1];
+    color[i + 2] = c[2];
+  }
+  std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+void SoftwareRasterizer::render(const PointCloudRenderer &renderer) {
+  float modelview[16], projection[16];
+  renderer.getCamera().computeMatrices(modelview, projection, width, height);
+  render(renderer, modelview, projection);
+}
+
+void SoftwareRasterizer::render(const PointCloudRenderer &renderer,
+                                const float modelview[16],
+                                const float projection[16]) {
+  if (width == 0 || height == 0)
+    return;
+  setMatrices(modelview, projection);
+
+  // Grid first, blended and without depth test, as in renderGrid()
+  if (renderer.getShowGrid()) {
+    std::vector<GridLine> lines;
+    renderer.getGridLines(lines);
+    for (size_t i = 0; i < lines.size(); ++i)
+      drawLine(lines[i]);
+  }
+
+  // Then depth-tested points, including streamed chunks
+  drawPoints(renderer, renderer.getPoints());
+  for (const auto &chunk : renderer.getChunks())
+    drawPoints(renderer, chunk.second);
+}
+
+void SoftwareRasterizer::drawPoints(
+    const PointCloudRenderer &renderer,
+    const PointCloudRenderer::PointStorage &points) {
+  float size = renderer.getPointSize();
+  float rgb[3];
+  for (size_t i = 0; i < points.size(); ++i) {
+    const Point3D &p = points[i];
+    renderer.getPointColor(p, rgb);
+    drawPoint(p.x, p.y, p.z, size, rgb);
+  }
+}
+
+bool SoftwareRasterizer::writePPM(const char *path) const {
+  return ::writePPM(path, width, height, color.data());
+}
+
+void SoftwareRasterizer::setMatrices(const float modelview[16],
+                                     const float projection[16]) {
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; ++k)
+        sum += projection[k * 4 + r] * modelview[c * 4 + k];
+      mvp[c * 4 + r] = sum;
+    }
+  }
+}
+
+void SoftwareRasterizer::drawPoint(float x, float y, float z, float size,
+                                   const float rgb[3]) {
+  const float *m = mvp;
+  float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+  if (cw <= 0.0f)
+    return;
+  float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+  float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+  float cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+
+  // Clip to the depth range, then map to window coordinates
+  float nz = cz / cw;
+  if (nz < -1.0f || nz > 1.0f)
+    return;
+  float wx = (cx / cw + 1.0f) * 0.5f * width;
+  float wy = (cy / cw + 1.0f) * 0.5f * height;
+  float d = (nz + 1.0f) * 0.5f;
+
+  unsigned char c[3] = {(unsigned char)(rgb[0] * 255.0f + 0.5f),
+                        (unsigned char)(rgb[1] * 255.0f + 0.5f),
+                        (unsigned char)(rgb[2] * 255.0f + 0.5f)};
+
+  // Round points like GL_POINT_SMOOTH: pixels whose centers are inside
+  float radius = std::max(size, 1.0f) * 0.5f;
+  int x0 = (int)std::floor(wx - radius), x1 = (int)std::floor(wx + radius);
+  int y0 = (int)std::floor(wy - radius), y1 = (int)std::floor(wy + radius);
+  if (x1 < 0 || y1 < 0 || x0 >= width || y0 >= height)
+    return;
+  bool single = size <= 1.5f;
+
+  for (int py = std::max(y0, 0); py <= std::min(y1, height - 1); ++py) {
+    for (int px = std::max(x0, 0); px <= std::min(x1, width - 1); ++px) {
+      if (single) {
+        if (px != (int)std::floor(wx) || py != (int)std::floor(wy))
+          continue;
+      } else {
+        float dx = px + 0.5f - wx, dy = py + 0.5f - wy;
+        if (dx * dx + dy * dy > radius * radius)
+          continue;
+      }
+
+      size_t index = (size_t)(height - 1 - py) * width + px;
+      if (d >= depth[index])
+        continue;
+      depth[index] = d;
+      color[index * 3] = c[0];
+      color[index * 3 + 1] = c[1];
+      color[index * 3 + 2] = c[2];
+    }
+  }
+}
+
+void SoftwareRasterizer::drawLine(const GridLine &line) {
+  const float *m = mvp;
+  float a[4], b[4];
+  const float pa[3] = {line.x0, line.y0, line.z0};
+  const float pb[3] = {line.x1, line.y1, line.z1};
+  for (int r = 0; r < 4; ++r) {
+    a[r] = m[r] * pa[0] + m[4 + r] * pa[1] + m[8 + r] * pa[2] + m[12 + r];
+    b[r] = m[r] * pb[0] + m[4 + r] * pb[1] + m[8 + r] * pb[2] + m[12 + r];
+  }
+
+  // Clip against the near plane (z >= -w)
+  float da = a[2] + a[3], db = b[2] + b[3];
+  if (da < 0.0f && db < 0.0f)
+    return;
+  if (da < 0.0f || db < 0.0f) {
+    float t = da / (da - db);
+    float *out = da < 0.0f ? a : b;
+    for (int r = 0; r < 4; ++r)
+      out[r] = a[r] + (b[r] - a[r]) * t;
+  }
+  if (a[3] <= 0.0f || b[3] <= 0.0f)
+    return;
+
+  float x0 = (a[0] / a[3] + 1.0f) * 0.5f * width;
+  float y0 = (a[1] / a[3] + 1.0f) * 0.5f * height;
+  float x1 = (b[0] / b[3] + 1.0f) * 0.5f * width;
+  float y1 = (b[1] / b[3] + 1.0f) * 0.5f * height;
+
+  // Liang-Barsky clip to the viewport so off-screen lines cost nothing
+  float t0 = 0.0f, t1 = 1.0f;
+  float dx = x1 - x0, dy = y1 - y0;
+  const float p[4] = {-dx, dx, -dy, dy};
+  const float q[4] = {x0, width - x0, y0, height - y0};
+  for (int i = 0; i < 4; ++i) {
+    if (p[i] == 0.0f) {
+      if (q[i] < 0.0f)
+        return;
+    } else {
+      float t = q[i] / p[i];
+      if (p[i] < 0.0f)
+        t0 = std::max(t0, t);
+      else
+        t1 = std::min(t1, t);
+    }
+  }
+  if (t0 > t1)
+    return;
+
+  float sx = x0 + dx * t0, sy = y0 + dy * t0;
+  float ex = x0 + dx * t1, ey = y0 + dy * t1;
+  int steps = (int)std::ceil(std::max(std::fabs(ex - sx), std::fabs(ey - sy)));
+  bool xMajor = std::fabs(ex - sx) >= std::fabs(ey - sy);
+  int thickness = std::max((int)(line.width + 0.5f), 1);
+  const float rgba[4] = {line.r, line.g, line.b, line.a};
+
+  for (int i = 0; i <= steps; ++i) {
+    float t = steps > 0 ? (float)i / steps : 0.0f;
+    int px = (int)std::floor(sx + (ex - sx) * t);
+    int py = (int)std::floor(sy + (ey - sy) * t);
+
+    // Widen along the minor axis
+    for (int k = 0; k < thickness; ++k) {
+      int offset = k - thickness / 2;
+      if (xMajor)
+        blendPixel(px, py + offset, rgba);
+      else
+        blendPixel(px + offset, py, rgba);
+    }
+  }
+}
+
+void SoftwareRasterizer::blendPixel(int x, int y, const float rgba[4]) {
+  if (x < 0 || y < 0 || x >= width || y >= height)
+    return;
+
+  unsigned char *c = &color[((size_t)(height - 1 - y) * width + x) * 3];
+  for (int i = 0; i < 3; ++i) {
+    float v = rgba[i] * 255.0f * rgba[3] + c[i] * (1.0f - rgba[3]);
+    c[i] = (unsigned char)std::min(v + 0.5f, 255.0f);
+  }
+}
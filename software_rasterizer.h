@@ -0,0 +1,44 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <vector>
+
+// CPU implementation of PointCloudRenderer::render() for machines without a
+// GPU. Uses the renderer's own grid geometry, color modes and camera
+// matrices, so images match the GL path up to rasterization details.
+class SoftwareRasterizer {
+public:
+  SoftwareRasterizer(int width = 0, int height = 0);
+
+  void resize(int width, int height);
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // Reset color to the background and depth to the far plane
+  void clear(float r, float g, float b);
+
+  // Draw grid and points from the renderer's camera, like render()
+  void render(const PointCloudRenderer &renderer);
+
+  // Same, with caller-supplied column-major matrices
+  void render(const PointCloudRenderer &renderer, const float modelview[16],
+              const float projection[16]);
+
+  // 8-bit RGB pixels, top row first
+  const std::vector<unsigned char> &getPixels() const { return color; }
+  bool writePPM(const char *path) const;
+
+private:
+  void setMatrices(const float modelview[16], const float projection[16]);
+  void drawPoint(float x, float y, float z, float size, const float rgb[3]);
+  void drawPoints(const PointCloudRenderer &renderer,
+                  const PointCloudRenderer::PointStorage &points);
+  void drawLine(const GridLine &line);
+  void blendPixel(int x, int y, const float rgba[4]);
+
+  int width, height;
+  float mvp[16]; // projection * modelview
+
+  std::vector<unsigned char> color;
+  std::vector<float> depth;
+};
@@ -0,0 +1,149 @@
+#include "tile_index.h"
+#include "file_utils.h"
+#include "frustum.h"
+#include "parallel.h"
+#include "point_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+TileIndex::TileIndex() : totalPoints(0), skipped(0), buildSeconds(0.0) {
+  origin[0] = origin[1] = origin[2] = 0.0;
+  boundsMin[0] = boundsMin[1] = boundsMin[2] = 0.0f;
+  boundsMax[0] = boundsMax[1] = boundsMax[2] = 0.0f;
+}
+
+bool TileIndex::build(const std::string &dir, unsigned threads) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  tiles.clear();
+  totalPoints = 0;
+  skipped = 0;
+
+  std::vector<std::string> names = listDirectory(dir);
+  std::vector<PointFileInfo> infos(names.size());
+  std::vector<char> valid(names.size(), 0);
+
+  // Header reads are independent and mostly wait on the disk
+  parallelFor(
+      names.size(),
+      [&](size_t i) {
+        std::unique_ptr<PointReader> reader =
+            createPointReader(joinPath(dir, names[i]));
+        if (reader && reader->open(joinPath(dir, names[i])) &&
+            reader->getInfo().hasBounds && reader->getInfo().pointCount > 0) {
+          infos[i] = reader->getInfo();
+          valid[i] = 1;
+        }
+      },
+      threads ? threads : getWorkerCount() * 2);
+
+  double fileMin[3] = {1e300, 1e300, 1e300};
+  double fileMax[3] = {-1e300, -1e300, -1e300};
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!valid[i]) {
+      if (createPointReader(names[i]))
+        ++skipped;
+      continue;
+    }
+    for (int a = 0; a < 3; ++a) {
+      fileMin[a] = std::min(fileMin[a], infos[i].min[a]);
+      fileMax[a] = std::max(fileMax[a], infos[i].max[a]);
+    }
+  }
+  if (fileMin[0] > fileMax[0]) {
+    error = "no point files with header bounds in " + dir;
+    return false;
+  }
+
+  for (int a = 0; a < 3; ++a)
+    origin[a] = (fileMin[a] + fileMax[a]) * 0.5;
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (!valid[i])
+      continue;
+    TileInfo tile;
+    tile.path = joinPath(dir, names[i]);
+    tile.pointCount = infos[i].pointCount;
+    // Z-up file bounds become Y-up viewer bounds (file Y flips to -Z)
+    fileToViewer(infos[i].min[0], infos[i].max[1], infos[i].min[2], origin,
+                 tile.min);
+    fileToViewer(infos[i].max[0], infos[i].min[1], infos[i].max[2], origin,
+                 tile.max);
+    totalPoints += tile.pointCount;
+    tiles.push_back(tile);
+  }
+
+  fileToViewer(fileMin[0], fileMax[1], fileMin[2], origin, boundsMin);
+  fileToViewer(fileMax[0], fileMin[1], fileMax[2], origin, boundsMax);
+
+  buildSeconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  return true;
+}
+
+void TileIndex::getBounds(float min[3], float max[3]) const {
+  for (int a = 0; a < 3; ++a) {
+    min[a] = boundsMin[a];
+    max[a] = boundsMax[a];
+  }
+}
+
+void TileIndex::queryVisible(const Camera &camera, int width, int height,
+                             float maxDistance,
+                             std::vector<TileCandidate> &out) const {
+  out.clear();
+  Frustum frustum;
+  frustum.setFromCamera(camera, width, height);
+  float eye[3];
+  camera.getEyePosition(eye[0], eye[1], eye[2]);
+  float pixelsPerUnit =
+      height * 0.5f / std::tan(camera.fov * 3.14159265f / 360.0f);
+
+  // Six plane tests per box; a linear pass handles thousands of tiles in
+  // well under a millisecond
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    const TileInfo &tile = tiles[i];
+    if (!frustum.intersectsBox(tile.min, tile.max))
+      continue;
+    TileCandidate candidate;
+    candidate.tile = (int)i;
+    candidate.distance = distanceToBox(eye, tile.min, tile.max);
+    if (maxDistance > 0.0f && candidate.distance > maxDistance)
+      continue;
+
+    // Bounding sphere seen from the eye; capped once the eye is inside it
+    float radius = 0.0f, center = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+      float half = (tile.max[a] - tile.min[a]) * 0.5f;
+      float offset = tile.min[a] + half - eye[a];
+      radius += half * half;
+      center += offset * offset;
+    }
+    radius = std::sqrt(radius);
+    candidate.screenSize = 2.0f * radius * pixelsPerUnit /
+                           std::max(std::sqrt(center), radius);
+    out.push_back(candidate);
+  }
+
+  std::sort(out.begin(), out.end(),
+            [](const TileCandidate &a, const TileCandidate &b) {
+              return a.distance < b.distance;
+            });
+}
+
+bool TileIndex::loadTile(size_t index, std::vector<Point3D> &points) const {
+  if (index >= tiles.size())
+    return false;
+
+  std::unique_ptr<PointReader> reader = createPointReader(tiles[index].path);
+  if (!reader || !reader->open(tiles[index].path))
+    return false;
+  reader->setOrigin(origin[0], origin[1], origin[2]);
+
+  points.reserve(points.size() + (size_t)tiles[index].pointCount);
+  while (reader->read(points, 1 << 20) > 0) {
+  }
+  return reader->getError().empty();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A point file of a tiled survey, described by its header only
+struct TileInfo {
+  std::string path;
+  uint64_t pointCount;
+  float min[3], max[3]; // Viewer coordinates relative to the index origin
+};
+
+// A tile selected for the current view
+struct TileCandidate {
+  int tile;
+  float distance;   // From the eye to the tile's box
+  float screenSize; // Approximate projected diameter in pixels
+};
+
+// Bounding-box index over a directory of point file tiles. Building it
+// reads only the file headers, so thousands of tiles open in seconds.
+class TileIndex {
+public:
+  TileIndex();
+
+  // Files without bounds in their header (PLY, XYZ) are skipped
+  bool build(const std::string &dir, unsigned threads = 0);
+
+  const std::vector<TileInfo> &getTiles() const { return tiles; }
+  const double *getOrigin() const { return origin; }
+  void getBounds(float min[3], float max[3]) const;
+  uint64_t getTotalPoints() const { return totalPoints; }
+  size_t getSkippedCount() const { return skipped; }
+  double getBuildSeconds() const { return buildSeconds; }
+  const std::string &getError() const { return error; }
+
+  // Tiles in the view frustum, nearest first; maxDistance 0 = unlimited
+  void queryVisible(const Camera &camera, int width, int height,
+                    float maxDistance, std::vector<TileCandidate> &out) const;
+
+  // Read a tile's points into viewer coordinates relative to the origin
+  bool loadTile(size_t index, std::vector<Point3D> &points) const;
+
+private:
+  std::vector<TileInfo> tiles;
+  double origin[3];
+  float boundsMin[3], boundsMax[3];
+  uint64_t totalPoints;
+  size_t skipped;
+  double buildSeconds;
+  std::string error;
+};
@@ -0,0 +1,160 @@
+#include "tile_streamer.h"
+#include "frustum.h"
+#include <algorithm>
+
+TileStreamer::TileStreamer(const TileIndex &index, unsigned threads)
+    : index(index),
+      loader(
+          [this](int id, std::vector<Point3D> &points) {
+            if (cache.get(id, points))
+              return true;
+            if (!this->index.loadTile((size_t)id, points))
+              return false;
+            cache.put(id, points);
+            return true;
+          },
+          threads),
+      pointBudget(20000000), maxDistance(0.0f), prefetchSeconds(0.3f),
+      startTime(std::chrono::steady_clock::now()), loadedPoints(0),
+      prefetchCount(0), cancelled(0), maxDecodeLoad(0.25f),
+      retainPoints(pointBudget / 4), retainedPoints(0) {}
+
+void TileStreamer::adaptRetainLimit() {
+  // Step sizes take about a second to grow to the budget and a few
+  // seconds to shrink back at 60 fps
+  float load = cache.getStats().decodeLoad;
+  retainPoints = std::min(retainPoints, pointBudget);
+  if (load > maxDecodeLoad)
+    retainPoints = std::min(pointBudget, retainPoints + pointBudget / 50);
+  else if (load < maxDecodeLoad * 0.5f)
+    retainPoints -= std::min(retainPoints, pointBudget / 200);
+}
+
+void TileStreamer::update(PointCloudRenderer &renderer, int width,
+                          int height) {
+  // Apply loads that finished since the last frame
+  finished.clear();
+  loader.takeFinished(finished);
+  for (size_t i = 0; i < finished.size(); ++i) {
+    int id = finished[i].id;
+    requested.erase(id);
+    if (!finished[i].ok) {
+      failed.insert(id);
+      continue;
+    }
+    if (!wanted.count(id) || loaded.count(id))
+      continue;
+    renderer.addChunk(id, finished[i].points);
+    loaded.insert(id);
+    loadedPoints += index.getTiles()[id].pointCount;
+  }
+  finished.clear();
+
+  // Tiles in view rank above all prefetch candidates, each group ordered
+  // by screen size
+  const float VISIBLE_BOOST = 1e6f;
+  const Camera &camera = renderer.getCamera();
+  index.queryVisible(camera, width, height, maxDistance, visible);
+  priorities.clear();
+  for (size_t i = 0; i < visible.size(); ++i)
+    priorities[visible[i].tile] = visible[i].screenSize + VISIBLE_BOOST;
+
+  double now = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - startTime)
+                   .count();
+  predictor.observe(camera, now);
+  if (prefetchSeconds > 0.0f && predictor.isMoving()) {
+    // Further predictions are less certain and count for less
+    const int steps = 3;
+    for (int step = 1; step <= steps; ++step) {
+      float ahead = prefetchSeconds * step / steps;
+      float weight = 1.0f - 0.5f * step / steps;
+      index.queryVisible(predictor.predict(ahead), width, height,
+                         maxDistance, predicted);
+      for (size_t i = 0; i < predicted.size(); ++i) {
+        float &priority = priorities[predicted[i].tile];
+        priority = std::max(priority, predicted[i].screenSize * weight);
+      }
+    }
+  }
+
+  ranked.clear();
+  for (std::map<int, float>::const_iterator it = priorities.begin();
+       it != priorities.end(); ++it)
+    ranked.push_back(std::make_pair(it->second, it->first));
+  std::sort(ranked.rbegin(), ranked.rend());
+
+  // Highest priorities up to the budget; the first one always fits
+  wanted.clear();
+  prefetchCount = 0;
+  uint64_t wantedPoints = 0;
+  for (size_t i = 0; i < ranked.size(); ++i) {
+    int tile = ranked[i].second;
+    if (failed.count(tile))
+      continue; // Reading it again would fail again, every frame
+    uint64_t count = index.getTiles()[tile].pointCount;
+    if (!wanted.empty() && wantedPoints + count > pointBudget)
+      break;
+    wanted.insert(tile);
+    wantedPoints += count;
+    if (ranked[i].first < VISIBLE_BOOST)
+      ++prefetchCount;
+
+    // Requesting again updates the priority of a queued load
+    if (!loaded.count(tile)) {
+      loader.request(tile, ranked[i].first);
+      requested.insert(tile);
+    }
+  }
+
+  // Requests the view has moved away from are stale
+  for (std::set<int>::iterator it = requested.begin();
+       it != requested.end();) {
+    if (wanted.count(*it)) {
+      ++it;
+    } else {
+      loader.cancel(*it);
+      it = requested.erase(it);
+      ++cancelled;
+    }
+  }
+
+  // Tiles outside the view stay resident so turning back doesn't reload
+  // them: up to the budget without a cache, up to the adaptive retain
+  // limit with one
+  uint64_t incoming = 0;
+  for (std::set<int>::const_iterator it = requested.begin();
+       it != requested.end(); ++it)
+    incoming += index.getTiles()[*it].pointCount;
+  uint64_t retainLimit = pointBudget;
+  if (cache.getByteBudget() > 0) {
+    adaptRetainLimit();
+    retainLimit = retainPoints;
+  }
+
+  float eye[3];
+  renderer.getCamera().getEyePosition(eye[0], eye[1], eye[2]);
+  std::vector<std::pair<float, int>> unwanted;
+  retainedPoints = 0;
+  for (std::set<int>::const_iterator it = loaded.begin(); it != loaded.end();
+       ++it) {
+    if (!wanted.count(*it)) {
+      const TileInfo &tile = index.getTiles()[*it];
+      unwanted.push_back(
+          std::make_pair(distanceToBox(eye, tile.min, tile.max), *it));
+      retainedPoints += tile.pointCount;
+    }
+  }
+  std::sort(unwanted.rbegin(), unwanted.rend()); // Farthest first
+  for (size_t i = 0; i < unwanted.size() &&
+                     (loadedPoints + incoming > pointBudget ||
+                      retainedPoints > retainLimit);
+       ++i) {
+    int id = unwanted[i].second;
+    uint64_t count = index.getTiles()[id].pointCount;
+    renderer.removeChunk(id);
+    loaded.erase(id);
+    loadedPoints -= count;
+    retainedPoints -= count;
+  }
+}
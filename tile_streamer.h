@@ -0,0 +1,86 @@
+#pragma once
+
+#include "camera_predictor.h"
+#include "chunk_cache.h"
+#include "chunk_loader.h"
+#include "tile_index.h"
+#include <chrono>
+#include <map>
+#include <set>
+
+// Keeps the tiles that appear largest on screen loaded in the renderer,
+// within a point budget. Loads run on background threads; tiles that leave
+// the view are cancelled while queued and evicted once over budget.
+// While the camera moves, tiles visible from its extrapolated position a
+// little ahead are loaded too, after everything currently in view.
+//
+// Loaded tiles are also kept compressed in a ChunkCache, so tiles that come
+// back into view are decoded from RAM instead of read from disk. Since that
+// makes evicting cheap, tiles out of view only stay resident up to a retain
+// limit that grows while decoding keeps the loaders busy and shrinks while
+// they are idle, trading decode time for raw memory.
+class TileStreamer {
+public:
+  explicit TileStreamer(const TileIndex &index, unsigned threads = 2);
+
+  void setPointBudget(uint64_t points) { pointBudget = points; }
+  uint64_t getPointBudget() const { return pointBudget; }
+  void setMaxDistance(float distance) { maxDistance = distance; }
+  float getMaxDistance() const { return maxDistance; }
+
+  // How far ahead to predict camera motion; 0 disables prefetching
+  void setPrefetchSeconds(float seconds) { prefetchSeconds = seconds; }
+  float getPrefetchSeconds() const { return prefetchSeconds; }
+
+  // Compressed copies of loaded tiles; a budget of 0 disables the cache
+  // and keeps tiles out of view resident up to the point budget
+  void setCacheBytes(size_t bytes) { cache.setByteBudget(bytes); }
+  size_t getCacheBytes() const { return cache.getByteBudget(); }
+  ChunkCacheStats getCacheStats() const { return cache.getStats(); }
+
+  // Decode time (in cores) above which more tiles out of view stay raw
+  void setMaxDecodeLoad(float cores) { maxDecodeLoad = cores; }
+  float getMaxDecodeLoad() const { return maxDecodeLoad; }
+
+  // Call once per frame before rendering
+  void update(PointCloudRenderer &renderer, int width, int height);
+
+  size_t getVisibleCount() const { return visible.size(); }
+  size_t getWantedCount() const { return wanted.size(); }
+  size_t getLoadedCount() const { return loaded.size(); }
+  size_t getPendingCount() const { return loader.getPendingCount(); }
+  uint64_t getLoadedPoints() const { return loadedPoints; }
+  size_t getFailedCount() const { return failed.size(); }
+  size_t getPrefetchCount() const { return prefetchCount; }
+  size_t getCancelledCount() const { return cancelled; }
+  uint64_t getRetainPoints() const { return retainPoints; }
+  uint64_t getRetainedPoints() const { return retainedPoints; }
+
+private:
+  void adaptRetainLimit();
+
+  const TileIndex &index;
+  ChunkCache cache; // Before the loader, whose workers use it
+  ChunkLoader loader;
+  uint64_t pointBudget;
+  float maxDistance;
+  float prefetchSeconds;
+  CameraPredictor predictor;
+  std::chrono::steady_clock::time_point startTime;
+
+  std::vector<TileCandidate> visible;
+  std::vector<TileCandidate> predicted;   // Scratch for predicted views
+  std::map<int, float> priorities;        // Scratch: tile -> priority
+  std::vector<std::pair<float, int>> ranked;
+  std::set<int> wanted;    // Tiles the current view should show
+  std::set<int> requested; // Handed to the loader, not yet applied
+  std::set<int> loaded;    // Added to the renderer
+  std::set<int> failed;    // Unreadable; not requested again
+  uint64_t loadedPoints;
+  size_t prefetchCount; // Wanted tiles that are not in view yet
+  size_t cancelled;     // Stale requests dropped since the start
+  float maxDecodeLoad;
+  uint64_t retainPoints;   // Limit for resident tiles out of view
+  uint64_t retainedPoints; // Resident tiles out of view after the update
+  std::vector<LoadedChunk> finished; // Scratch for update
+};
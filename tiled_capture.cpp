@@ -0,0 +1,404 @@
+#include "tiled_capture.h"
+#include "gl_ext.h"
+#include "image_io.h"
+#include "memory_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int MAX_GL_TILE = 4096;
+const int MAX_IMAGE_SIDE = 1 << 20;
+
+// Column-major glOrtho(left, right, bottom, top, near, far)
+void orthoMatrix(float left, float right, float bottom, float top,
+                 float zNear, float zFar, float m[16]) {
+  for (int i = 0; i < 16; ++i)
+    m[i] = 0.0f;
+  m[0] = 2.0f / (right - left);
+  m[5] = 2.0f / (top - bottom);
+  m[10] = -2.0f / (zFar - zNear);
+  m[12] = -(right + left) / (right - left);
+  m[13] = -(top + bottom) / (top - bottom);
+  m[14] = -(zFar + zNear) / (zFar - zNear);
+  m[15] = 1.0f;
+}
+
+// Copy the points with x and z inside the box into out
+void gatherPoints(const PointCloudRenderer::PointStorage &points, float minX,
+                  float minZ, float maxX, float maxZ,
+                  std::vector<Point3D> &out) {
+  for (size_t i = 0; i < points.size(); ++i) {
+    const Point3D &p = points[i];
+    if (p.z >= minZ && p.z <= maxZ && p.x >= minX && p.x <= maxX)
+      out.push_back(p);
+  }
+}
+
+// Copy the w x h pixels inside a tile's guard band of pad pixels into
+// image rows width wide, starting at column x0
+void copyTile(const std::vector<unsigned char> &tile, int pad, int w, int h,
+              std::vector<unsigned char> &rows, int width, int x0) {
+  size_t tileRow = (size_t)(w + 2 * pad) * 3;
+  for (int y = 0; y < h; ++y)
+    memcpy(&rows[((size_t)y * width + x0) * 3],
+           &tile[(y + pad) * tileRow + (size_t)pad * 3], (size_t)w * 3);
+}
+
+// GL drops a wide point whose center is outside the viewport, so tiles
+// are drawn with a guard band of half a point and cropped
+int getGuardBand(float pointSize) {
+  return (int)std::ceil(pointSize * 0.5f) + 1;
+}
+
+// The part of a projection covering NDC x in [left, right] and y in
+// [bottom, top], stretched over the whole viewport: clip x and y are
+// scaled and offset by w, which works for perspective and orthographic
+// projections alike
+void subProjection(const float projection[16], float left, float right,
+                   float bottom, float top, float out[16]) {
+  float sx = 2.0f / (right - left), tx = -(right + left) / (right - left);
+  float sy = 2.0f / (top - bottom), ty = -(top + bottom) / (top - bottom);
+  for (int column = 0; column < 4; ++column) {
+    const float *in = projection + column * 4;
+    out[column * 4] = sx * in[0] + tx * in[3];
+    out[column * 4 + 1] = sy * in[1] + ty * in[3];
+    out[column * 4 + 2] = in[2];
+    out[column * 4 + 3] = in[3];
+  }
+}
+
+// An image rendered in tiles
+struct TiledImage {
+  int width, height;
+  int pad; // Guard band around each tile, pixels
+  const float *background;
+  size_t stripBytes;
+};
+
+// Render the image tile by tile with sub-projections of projection, a
+// strip of tiles at a time, and stream the strips to path.
+// prepareStrip(y0, rows) gives the renderer to draw a strip with.
+template <class PrepareStrip>
+bool renderTiledImage(const TiledImage &image, const float modelview[16],
+                      const float projection[16], PrepareStrip prepareStrip,
+                      TileTarget &target, const TileOverlay *overlay,
+                      const std::string &path, CaptureStats &stats,
+                      std::string &error) {
+  Clock::time_point start = Clock::now();
+  stats.width = stats.height = stats.tiles = 0;
+  stats.seconds = 0.0;
+  int width = image.width, height = image.height, pad = image.pad;
+  int maxTileWidth, maxTileHeight;
+  target.getMaxTileSize(maxTileWidth, maxTileHeight);
+  int tileWidth = std::min(width, maxTileWidth - 2 * pad);
+  size_t stripRows = image.stripBytes / ((size_t)width * 3);
+  int tileHeight = (int)std::min<size_t>(
+      std::min(height, maxTileHeight - 2 * pad),
+      std::max<size_t>(stripRows, 1));
+  if (tileWidth <= 0 || tileHeight <= 0) {
+    error = "No tile target, or tiles too small for the point size";
+    return false;
+  }
+
+  ImageRowWriter writer;
+  if (!writer.open(path.c_str(), width, height)) {
+    error = "Cannot write " + path;
+    return false;
+  }
+  std::vector<unsigned char> rows((size_t)width * tileHeight * 3);
+  std::vector<unsigned char> tile;
+  for (int y0 = 0; y0 < height; y0 += tileHeight) {
+    int h = std::min(tileHeight, height - y0);
+    PointCloudRenderer &renderer = prepareStrip(y0, h);
+    for (int x0 = 0; x0 < width; x0 += tileWidth) {
+      int w = std::min(tileWidth, width - x0);
+      // NDC of the tile and its guard band; image row 0 is NDC y = 1
+      float tileProjection[16];
+      subProjection(projection, -1.0f + 2.0f * (x0 - pad) / width,
+                    -1.0f + 2.0f * (x0 + w + pad) / width,
+                    1.0f - 2.0f * (y0 + h + pad) / height,
+                    1.0f - 2.0f * (y0 - pad) / height, tileProjection);
+      TileRect rect = {x0 - pad, y0 - pad, w + 2 * pad, h + 2 * pad};
+      if (!target.renderTile(renderer, modelview, tileProjection, rect,
+                             image.background, overlay, tile)) {
+        error = "Tile rendering failed";
+        return false;
+      }
+      copyTile(tile, pad, w, h, rows, width, x0);
+      ++stats.tiles;
+    }
+    if (!writer.writeRows(rows.data(), h)) {
+      error = "Write failed: " + path;
+      return false;
+    }
+  }
+  if (!writer.close()) {
+    error = "Write failed: " + path;
+    return false;
+  }
+  stats.width = width;
+  stats.height = height;
+  stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return true;
+}
+
+} // namespace
+
+SoftwareTileTarget::SoftwareTileTarget(int maxTileSize)
+    : maxTileSize(maxTileSize) {}
+
+void SoftwareTileTarget::getMaxTileSize(int &width, int &height) const {
+  width = height = maxTileSize;
+}
+
+bool SoftwareTileTarget::renderTile(PointCloudRenderer &renderer,
+                                    const float modelview[16],
+                                    const float projection[16],
+                                    const TileRect &tile,
+                                    const float background[3],
+                                    const TileOverlay *,
+                                    std::vector<unsigned char> &rgb) {
+  int width = tile.width, height = tile.height;
+  if (width > maxTileSize || height > maxTileSize)
+    return false;
+  if (raster.getWidth() != width || raster.getHeight() != height)
+    raster.resize(width, height);
+  raster.clear(background[0], background[1], background[2]);
+  raster.render(renderer, modelview, projection);
+  rgb = raster.getPixels();
+  return true;
+}
+
+GLTileTarget::GLTileTarget()
+    : framebuffer(0), tileWidth(0), tileHeight(0), bufferBytes(0) {
+  renderbuffers[0] = renderbuffers[1] = 0;
+}
+
+bool GLTileTarget::create(int viewportWidth, int viewportHeight) {
+  release();
+  tileWidth = viewportWidth;
+  tileHeight = viewportHeight;
+  if (!hasGLFramebufferFunctions())
+    return tileWidth > 0 && tileHeight > 0;
+
+  GLint maxRenderbuffer = 0, maxViewport[2] = {0, 0};
+  glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+  glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+  int size = std::min(MAX_GL_TILE, (int)maxRenderbuffer);
+  size = std::min(size, (int)std::min(maxViewport[0], maxViewport[1]));
+  if (size <= 0)
+    return tileWidth > 0 && tileHeight > 0;
+
+  const GLFramebufferFunctions &gl = getGLFramebufferFunctions();
+  gl.genFramebuffers(1, &framebuffer);
+  gl.genRenderbuffers(2, renderbuffers);
+  gl.bindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+  gl.renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+  gl.bindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+  gl.renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+  gl.bindRenderbuffer(GL_RENDERBUFFER, 0);
+  gl.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  gl.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_RENDERBUFFER, renderbuffers[0]);
+  gl.framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                             GL_RENDERBUFFER, renderbuffers[1]);
+  bool complete =
+      gl.checkFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  gl.bindFramebuffer(GL_FRAMEBUFFER, 0);
+  bufferBytes = (size_t)size * size * 8;
+  MemoryStats::add(MEM_FRAMEBUFFERS, bufferBytes);
+  if (!complete) {
+    release(); // Fall back to the draw buffer
+    tileWidth = viewportWidth;
+    tileHeight = viewportHeight;
+    return tileWidth > 0 && tileHeight > 0;
+  }
+  tileWidth = tileHeight = size;
+  return true;
+}
+
+void GLTileTarget::release() {
+  if (framebuffer != 0) {
+    const GLFramebufferFunctions &gl = getGLFramebufferFunctions();
+    gl.deleteFramebuffers(1, &framebuffer);
+    gl.deleteRenderbuffers(2, renderbuffers);
+    MemoryStats::remove(MEM_FRAMEBUFFERS, bufferBytes);
+    framebuffer = 0;
+    renderbuffers[0] = renderbuffers[1] = 0;
+  }
+  bufferBytes = 0;
+  tileWidth = tileHeight = 0;
+}
+
+void GLTileTarget::getMaxTileSize(int &width, int &height) const {
+  width = tileWidth;
+  height = tileHeight;
+}
+
+bool GLTileTarget::renderTile(PointCloudRenderer &renderer,
+                              const float modelview[16],
+                              const float projection[16],
+                              const TileRect &tile,
+                              const float background[3],
+                              const TileOverlay *overlay,
+                              std::vector<unsigned char> &rgb) {
+  int width = tile.width, height = tile.height;
+  if (width > tileWidth || height > tileHeight)
+    return false;
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if (framebuffer != 0)
+    getGLFramebufferFunctions().bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+  // The buffer is usually larger than the tile; only clear the tile
+  glViewport(0, 0, width, height);
+  glScissor(0, 0, width, height);
+  glEnable(GL_SCISSOR_TEST);
+  glClearColor(background[0], background[1], background[2], 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glDisable(GL_SCISSOR_TEST);
+  renderer.render(modelview, projection);
+  if (overlay)
+    (*overlay)(tile);
+
+  // GL rows are bottom-up; flip while copying out
+  std::vector<unsigned char> flipped((size_t)width * height * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+               flipped.data());
+  rgb.resize(flipped.size());
+  size_t rowBytes = (size_t)width * 3;
+  for (int y = 0; y < height; ++y)
+    memcpy(&rgb[(size_t)y * rowBytes],
+           &flipped[(size_t)(height - 1 - y) * rowBytes], rowBytes);
+
+  if (framebuffer != 0)
+    getGLFramebufferFunctions().bindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  return glGetError() == GL_NO_ERROR;
+}
+
+OrthoExportOptions::OrthoExportOptions()
+    : pixelSize(0.1f), minX(0.0f), minZ(0.0f), maxX(0.0f), maxZ(0.0f),
+      stripBytes(64 << 20) {
+  background[0] = background[1] = background[2] = 0.0f;
+}
+
+void OrthoExportOptions::setArea(const PointCloudRenderer &renderer) {
+  float min[3], max[3];
+  renderer.getBounds(min, max);
+  minX = min[0];
+  minZ = min[2];
+  maxX = max[0];
+  maxZ = max[2];
+}
+
+bool getOrthoImageSize(const OrthoExportOptions &options, int &width,
+                       int &height) {
+  width = height = 0;
+  if (!(options.pixelSize > 0.0f))
+    return false;
+  double w = std::ceil((options.maxX - options.minX) / options.pixelSize);
+  double h = std::ceil((options.maxZ - options.minZ) / options.pixelSize);
+  if (!(w >= 1.0 && h >= 1.0 && w <= MAX_IMAGE_SIDE && h <= MAX_IMAGE_SIDE))
+    return false;
+  width = (int)w;
+  height = (int)h;
+  return true;
+}
+
+bool exportOrthophoto(const PointCloudRenderer &renderer, TileTarget &target,
+                      const OrthoExportOptions &options,
+                      const std::string &path, CaptureStats &stats,
+                      std::string &error) {
+  int width, height;
+  if (!getOrthoImageSize(options, width, height)) {
+    error = "Orthophoto area or pixel size out of range";
+    return false;
+  }
+
+  // Looking straight down: eye x is x, eye y is -z so minZ is the top row,
+  // and depth runs down from above the highest point
+  float min[3], max[3];
+  renderer.getBounds(min, max);
+  float above = max[1] + 1.0f;
+  float modelview[16] = {1.0f, 0.0f, 0.0f,  0.0f,    // x
+                         0.0f, 0.0f, 1.0f,  0.0f,    // y
+                         0.0f, -1.0f, 0.0f, 0.0f,    // z
+                         0.0f, 0.0f, -above, 1.0f}; // Translation
+  float px = options.pixelSize;
+  float projection[16];
+  orthoMatrix(options.minX, options.minX + width * px,
+              -(options.minZ + height * px), -options.minZ, 0.5f,
+              above - min[1] + 1.0f, projection);
+
+  // Strips draw a copy of just their points, with the renderer's colors,
+  // point size and height range
+  PointCloudRenderer strip;
+  strip.setPointSize(renderer.getPointSize());
+  strip.setColorMode(renderer.getColorMode());
+  strip.setShowGrid(false);
+  std::vector<Point3D> stripPoints;
+  int pad = getGuardBand(renderer.getPointSize());
+  float margin = pad * px;
+  auto prepareStrip = [&](int y0, int rows) -> PointCloudRenderer & {
+    float top = options.minZ + y0 * px;
+    stripPoints.clear();
+    gatherPoints(renderer.getPoints(), options.minX - margin, top - margin,
+                 options.maxX + margin, top + rows * px + margin,
+                 stripPoints);
+    for (const auto &chunk : renderer.getChunks())
+      gatherPoints(chunk.second, options.minX - margin, top - margin,
+                   options.maxX + margin, top + rows * px + margin,
+                   stripPoints);
+    strip.setPointCloud(stripPoints);
+    strip.setSceneBounds(min, max);
+    return strip;
+  };
+
+  TiledImage image = {width, height, pad, options.background,
+                      options.stripBytes};
+  return renderTiledImage(image, modelview, projection, prepareStrip, target,
+                          NULL, path, stats, error);
+}
+
+ScreenshotOptions::ScreenshotOptions()
+    : width(7680), height(4320), pointScale(1.0f), stripBytes(64 << 20) {
+  background[0] = background[1] = background[2] = 0.0f;
+}
+
+bool captureScreenshot(PointCloudRenderer &renderer, TileTarget &target,
+                       const ScreenshotOptions &options,
+                       const std::string &path, CaptureStats &stats,
+                       std::string &error) {
+  if (options.width <= 0 || options.height <= 0 ||
+      options.width > MAX_IMAGE_SIDE || options.height > MAX_IMAGE_SIDE) {
+    error = "Screenshot size out of range";
+    return false;
+  }
+
+  // The camera's view at the image's aspect; points keep their look at a
+  // higher resolution by growing with pointScale
+  float modelview[16], projection[16];
+  renderer.getCamera().computeMatrices(modelview, projection, options.width,
+                                       options.height);
+  float pointSize = renderer.getPointSize();
+  renderer.setPointSize(pointSize * options.pointScale);
+  auto prepareStrip = [&](int, int) -> PointCloudRenderer & {
+    return renderer;
+  };
+
+  TiledImage image = {options.width, options.height,
+                      getGuardBand(renderer.getPointSize()),
+                      options.background, options.stripBytes};
+  bool ok = renderTiledImage(image, modelview, projection, prepareStrip,
+                             target, options.overlay ? &options.overlay : NULL,
+                             path, stats, error);
+  renderer.setPointSize(pointSize);
+  return ok;
+}
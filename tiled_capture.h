@@ -0,0 +1,131 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include "software_rasterizer.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A tile's pixels within the whole image, top-left origin. Tiles reach
+// past their share of the image by a guard band, so possibly past its edges.
+struct TileRect {
+  int x, y, width, height;
+};
+
+// Drawn over each tile after the points, with the tile's matrices still
+// loaded; GL targets only
+typedef std::function<void(const TileRect &tile)> TileOverlay;
+
+// Where the tiles of a capture larger than any framebuffer are drawn: one
+// tile at a time with the given matrices, read back as 8-bit RGB, top row
+// first
+class TileTarget {
+public:
+  virtual ~TileTarget() {}
+
+  virtual void getMaxTileSize(int &width, int &height) const = 0;
+  virtual bool renderTile(PointCloudRenderer &renderer,
+                          const float modelview[16],
+                          const float projection[16], const TileRect &tile,
+                          const float background[3],
+                          const TileOverlay *overlay,
+                          std::vector<unsigned char> &rgb) = 0;
+};
+
+// Tiles through the software rasterizer, on any machine; overlays are
+// skipped
+class SoftwareTileTarget : public TileTarget {
+public:
+  explicit SoftwareTileTarget(int maxTileSize = 2048);
+
+  void getMaxTileSize(int &width, int &height) const override;
+  bool renderTile(PointCloudRenderer &renderer,
+                  const float modelview[16], const float projection[16],
+                  const TileRect &tile, const float background[3],
+                  const TileOverlay *overlay,
+                  std::vector<unsigned char> &rgb) override;
+
+private:
+  int maxTileSize;
+  SoftwareRasterizer raster;
+};
+
+// Tiles through GL into a framebuffer object of up to 4096 pixels a side
+// (less if the context can't), or without framebuffer objects (call
+// loadGLFramebufferFunctions first) into the current draw buffer, no larger
+// than the viewport. Needs the context current from create() to release().
+class GLTileTarget : public TileTarget {
+public:
+  GLTileTarget();
+
+  // viewportWidth, viewportHeight: the fallback tile size
+  bool create(int viewportWidth, int viewportHeight);
+  void release();
+  bool hasFramebuffer() const { return framebuffer != 0; }
+
+  void getMaxTileSize(int &width, int &height) const override;
+  bool renderTile(PointCloudRenderer &renderer,
+                  const float modelview[16], const float projection[16],
+                  const TileRect &tile, const float background[3],
+                  const TileOverlay *overlay,
+                  std::vector<unsigned char> &rgb) override;
+
+private:
+  unsigned framebuffer;
+  unsigned renderbuffers[2]; // Color, depth
+  int tileWidth, tileHeight;
+  size_t bufferBytes;
+};
+
+// Size and timing of a finished capture
+struct CaptureStats {
+  int width, height;
+  int tiles;
+  double seconds;
+};
+
+// A top-down orthographic image of the renderer's points (grid left out),
+// row 0 along minZ, which is north for points from Z-up files
+struct OrthoExportOptions {
+  float pixelSize;              // Ground units per pixel
+  float minX, minZ, maxX, maxZ; // Area covered, viewer coordinates
+  float background[3];
+  size_t stripBytes; // Memory for one row of tiles
+
+  OrthoExportOptions();
+  // Cover the renderer's bounds
+  void setArea(const PointCloudRenderer &renderer);
+};
+
+// Image size for the options; false if empty or over a million pixels a side
+bool getOrthoImageSize(const OrthoExportOptions &options, int &width,
+                       int &height);
+
+// Render the orthophoto strip by strip and stream it to a PPM (or PGM, by
+// extension). Each strip only draws the points under it (plus a point's
+// width), copied out of the renderer, so memory is bounded by the strip and
+// the densest band of points.
+bool exportOrthophoto(const PointCloudRenderer &renderer, TileTarget &target,
+                      const OrthoExportOptions &options,
+                      const std::string &path, CaptureStats &stats,
+                      std::string &error);
+
+// A capture of the camera's current view at any resolution. Each tile is
+// an off-axis part of the view's frustum, so the tiles stitch into exactly
+// the image one huge framebuffer would give.
+struct ScreenshotOptions {
+  int width, height;
+  float pointScale; // Point size multiplier, e.g. image over window width
+  float background[3];
+  size_t stripBytes; // Memory for one row of tiles
+  TileOverlay overlay; // Optional, e.g. other layers and labels
+
+  ScreenshotOptions();
+};
+
+// Render the view strip by strip and stream it to a PPM (or PGM)
+bool captureScreenshot(PointCloudRenderer &renderer, TileTarget &target,
+                       const ScreenshotOptions &options,
+                       const std::string &path, CaptureStats &stats,
+                       std::string &error);
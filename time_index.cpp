@@ -0,0 +1,96 @@
+#include "time_index.h"
+#include <algorithm>
+#include <cstdint>
+
+void TimeIndex::build(std::vector<Point3D> &input,
+                      const std::vector<double> &inputTimes,
+                      size_t chunkSize) {
+  clear();
+  size_t count = std::min(input.size(), inputTimes.size());
+  if (count == 0)
+    return;
+  chunkSize = std::max<size_t>(chunkSize, 1);
+
+  bool sorted = true;
+  for (size_t i = 1; i < count && sorted; ++i)
+    sorted = inputTimes[i] >= inputTimes[i - 1];
+
+  baseTime = sorted ? inputTimes[0]
+                    : *std::min_element(inputTimes.begin(),
+                                        inputTimes.begin() + count);
+  times.resize(count);
+  if (sorted) {
+    points.swap(input);
+    points.resize(count);
+    for (size_t i = 0; i < count; ++i)
+      times[i] = (float)(inputTimes[i] - baseTime);
+  } else {
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+      order[i] = (uint32_t)i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) {
+                       return inputTimes[a] < inputTimes[b];
+                     });
+    points.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      points[i] = input[order[i]];
+      times[i] = (float)(inputTimes[order[i]] - baseTime);
+    }
+    input.clear();
+  }
+
+  for (size_t first = 0; first < count; first += chunkSize) {
+    Chunk chunk;
+    chunk.first = first;
+    chunk.count = std::min(chunkSize, count - first);
+    chunk.start = times[first];
+    chunk.end = times[first + chunk.count - 1];
+    chunks.push_back(chunk);
+  }
+}
+
+void TimeIndex::clear() {
+  baseTime = 0.0;
+  points.clear();
+  times.clear();
+  chunks.clear();
+}
+
+size_t TimeIndex::selectWindow(float start, float end,
+                               std::vector<Range> &out) const {
+  out.clear();
+  if (chunks.empty() || end < start)
+    return 0;
+
+  // First chunk that ends at or after the window start
+  std::vector<Chunk>::const_iterator it = std::lower_bound(
+      chunks.begin(), chunks.end(), start,
+      [](const Chunk &c, float t) { return c.end < t; });
+
+  size_t total = 0;
+  for (; it != chunks.end() && it->start <= end; ++it) {
+    Range range;
+    range.chunk = (size_t)(it - chunks.begin());
+    range.first = 0;
+    range.count = it->count;
+
+    // Only the chunks at the window edges need a search inside
+    std::vector<float>::const_iterator begin = times.begin() + it->first;
+    std::vector<float>::const_iterator stop = begin + it->count;
+    if (it->start < start)
+      range.first =
+          (size_t)(std::lower_bound(begin, stop, start) - begin);
+    if (it->end > end)
+      range.count =
+          (size_t)(std::upper_bound(begin, stop, end) - begin) - range.first;
+    else
+      range.count -= range.first;
+
+    if (range.count > 0) {
+      out.push_back(range);
+      total += range.count;
+    }
+  }
+  return total;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "point_cloud_renderer.h"
+#include <vector>
+
+// Points ordered by capture time and cut into fixed-size chunks, each with
+// the time range it covers. A time window maps to a run of whole chunks
+// plus partial chunks at either end, found by binary search over the chunk
+// ranges and then the per-point times, so moving the window never scans or
+// rewrites the points.
+//
+// Times are kept as float seconds from the earliest point (getBaseTime()
+// holds the absolute value), which resolves well under a millisecond over
+// hours of acquisition where raw GPS seconds would not.
+class TimeIndex {
+public:
+  struct Chunk {
+    size_t first, count; // Points of the chunk
+    float start, end;    // Earliest and latest time in it
+  };
+
+  // Points of one chunk inside a window
+  struct Range {
+    size_t chunk;
+    size_t first, count; // Relative to the chunk's first point
+  };
+
+  TimeIndex() : baseTime(0.0) {}
+
+  // Take points and their times (one per point), ordering both by time.
+  // Files recorded in acquisition order are detected and not sorted.
+  void build(std::vector<Point3D> &points, const std::vector<double> &times,
+             size_t chunkSize = 65536);
+  void clear();
+
+  bool isEmpty() const { return chunks.empty(); }
+  double getBaseTime() const { return baseTime; }
+  float getDuration() const { return times.empty() ? 0.0f : times.back(); }
+
+  const std::vector<Point3D> &getPoints() const { return points; }
+  const std::vector<float> &getTimes() const { return times; } // Ascending
+  const std::vector<Chunk> &getChunks() const { return chunks; }
+
+  // Ranges of the points with start <= time <= end; returns their count
+  size_t selectWindow(float start, float end, std::vector<Range> &out) const;
+
+private:
+  double baseTime;
+  std::vector<Point3D> points;
+  std::vector<float> times;
+  std::vector<Chunk> chunks;
+};
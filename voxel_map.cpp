@@ -0,0 +1,230 @@
+#include "voxel_map.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int BLOCK_BITS = 5; // 32 voxels per block edge
+const int BLOCK_MASK = (1 << BLOCK_BITS) - 1;
+const int KEY_BITS = 21;  // Per axis in a block key
+const int64_t VOXEL_LIMIT = (int64_t)1 << (KEY_BITS + BLOCK_BITS - 1);
+const size_t BATCH = 16384; // Points transformed per task
+
+uint64_t packBlock(int64_t x, int64_t y, int64_t z) {
+  const uint64_t mask = ((uint64_t)1 << KEY_BITS) - 1;
+  return (((uint64_t)x & mask) << (2 * KEY_BITS)) |
+         (((uint64_t)y & mask) << KEY_BITS) | ((uint64_t)z & mask);
+}
+
+// A point's place in the map: its block and the voxel within it
+struct Binned {
+  uint64_t block;
+  uint32_t voxel;
+  uint32_t point; // Index into the transformed sweep
+};
+
+uint32_t hashVoxel(uint32_t voxel) { return (voxel * 2654435761u) >> 8; }
+
+} // namespace
+
+void VoxelMap::Block::add(uint32_t voxel, const Point3D &point) {
+  // Keep the table at most half full
+  if ((points.size() + 1) * 2 > table.size()) {
+    std::vector<uint32_t, TrackedAllocator<uint32_t, MEM_INDICES>> grown(
+        std::max<size_t>(table.size() * 2, 16), 0);
+    uint32_t mask = (uint32_t)grown.size() - 1;
+    for (size_t i = 0; i < table.size(); ++i) {
+      if (table[i] == 0)
+        continue;
+      uint32_t slot = hashVoxel((table[i] >> 16) - 1) & mask;
+      while (grown[slot] != 0)
+        slot = (slot + 1) & mask;
+      grown[slot] = table[i];
+    }
+    table.swap(grown);
+  }
+
+  uint32_t mask = (uint32_t)table.size() - 1;
+  uint32_t slot = hashVoxel(voxel) & mask;
+  while (table[slot] != 0 && (table[slot] >> 16) != voxel + 1)
+    slot = (slot + 1) & mask;
+
+  if (table[slot] == 0) {
+    table[slot] = ((voxel + 1) << 16) | (uint32_t)points.size();
+    points.push_back(point);
+    counts.push_back(1);
+    return;
+  }
+
+  // Running mean; once the count saturates the voxel stays put
+  uint32_t index = table[slot] & 0xffff;
+  if (counts[index] == 0xffff)
+    return;
+  float w = 1.0f / ++counts[index];
+  Point3D &p = points[index];
+  p.x += (point.x - p.x) * w;
+  p.y += (point.y - p.y) * w;
+  p.z += (point.z - p.z) * w;
+  p.r += (point.r - p.r) * w;
+  p.g += (point.g - p.g) * w;
+  p.b += (point.b - p.b) * w;
+  p.intensity += (point.intensity - p.intensity) * w;
+}
+
+size_t VoxelMap::Block::getBytes() const {
+  return sizeof(Block) + sizeof(uint64_t) +
+         points.capacity() * sizeof(Point3D) +
+         counts.capacity() * sizeof(uint16_t) +
+         table.capacity() * sizeof(uint32_t);
+}
+
+VoxelMap::VoxelMap(float voxelSize) : voxelSize(voxelSize), sweeps(0) {}
+
+void VoxelMap::setVoxelSize(float size) {
+  if (size == voxelSize)
+    return;
+  voxelSize = size;
+  clear();
+}
+
+int VoxelMap::getShard(uint64_t key) const {
+  return (int)((key * 0x9E3779B97F4A7C15ull) >> 58); // 64 shards
+}
+
+void VoxelMap::integrate(const std::vector<Point3D> &sweep, const Pose &pose,
+                         unsigned threads) {
+  ++sweeps;
+  size_t count = sweep.size();
+  if (count == 0)
+    return;
+
+  // Place every point: transform, then find its block and voxel
+  std::vector<Point3D> placed(count);
+  std::vector<Binned> binned(count);
+  std::vector<char> valid(count);
+  float scale = 1.0f / voxelSize;
+  parallelFor(
+      (count + BATCH - 1) / BATCH,
+      [&](size_t batch) {
+        size_t end = std::min(count, (batch + 1) * BATCH);
+        for (size_t i = batch * BATCH; i < end; ++i) {
+          Point3D p = sweep[i];
+          float in[3] = {p.x, p.y, p.z}, out[3];
+          pose.apply(in, out);
+          p.x = out[0];
+          p.y = out[1];
+          p.z = out[2];
+          placed[i] = p;
+
+          int64_t v[3];
+          valid[i] = 1;
+          for (int a = 0; a < 3; ++a) {
+            float f = std::floor(out[a] * scale);
+            if (!(f > -VOXEL_LIMIT && f < VOXEL_LIMIT)) {
+              valid[i] = 0; // Out of range or not finite
+              break;
+            }
+            v[a] = (int64_t)f;
+          }
+          if (!valid[i])
+            continue;
+          binned[i].block = packBlock(v[0] >> BLOCK_BITS, v[1] >> BLOCK_BITS,
+                                      v[2] >> BLOCK_BITS);
+          binned[i].voxel = (uint32_t)((v[0] & BLOCK_MASK) |
+                                       (v[1] & BLOCK_MASK) << BLOCK_BITS |
+                                       (v[2] & BLOCK_MASK) << (2 * BLOCK_BITS));
+          binned[i].point = (uint32_t)i;
+        }
+      },
+      threads);
+
+  // Counting sort by shard so each shard's points are contiguous, in
+  // sweep order
+  size_t starts[SHARD_COUNT + 1] = {0};
+  for (size_t i = 0; i < count; ++i) {
+    if (valid[i])
+      ++starts[getShard(binned[i].block) + 1];
+  }
+  for (int s = 0; s < SHARD_COUNT; ++s)
+    starts[s + 1] += starts[s];
+  std::vector<Binned> sorted(starts[SHARD_COUNT]);
+  size_t fill[SHARD_COUNT];
+  std::copy(starts, starts + SHARD_COUNT, fill);
+  for (size_t i = 0; i < count; ++i) {
+    if (valid[i])
+      sorted[fill[getShard(binned[i].block)]++] = binned[i];
+  }
+
+  // Merge each shard on its own thread; blocks never span shards. A sweep
+  // comes in scan order, so runs of points share a block and the lookup is
+  // done once per run.
+  parallelFor(
+      SHARD_COUNT,
+      [&](size_t s) {
+        Shard &shard = shards[s];
+        for (size_t i = starts[s]; i < starts[s + 1];) {
+          uint64_t key = sorted[i].block;
+          Block &block = shard.blocks[key];
+          size_t points = block.points.size();
+          size_t bytes = points == 0 ? 0 : block.getBytes();
+          for (; i < starts[s + 1] && sorted[i].block == key; ++i)
+            block.add(sorted[i].voxel, placed[sorted[i].point]);
+          shard.points += block.points.size() - points;
+          shard.bytes += block.getBytes() - bytes;
+          if (!block.dirty) {
+            block.dirty = true;
+            shard.dirty.push_back(key);
+          }
+        }
+      },
+      threads);
+}
+
+void VoxelMap::clear() {
+  for (int s = 0; s < SHARD_COUNT; ++s)
+    shards[s] = Shard();
+  sweeps = 0;
+}
+
+size_t VoxelMap::getPointCount() const {
+  size_t total = 0;
+  for (int s = 0; s < SHARD_COUNT; ++s)
+    total += shards[s].points;
+  return total;
+}
+
+size_t VoxelMap::getBlockCount() const {
+  size_t total = 0;
+  for (int s = 0; s < SHARD_COUNT; ++s)
+    total += shards[s].blocks.size();
+  return total;
+}
+
+size_t VoxelMap::getMemoryBytes() const {
+  size_t total = 0;
+  for (int s = 0; s < SHARD_COUNT; ++s)
+    total += shards[s].bytes;
+  return total;
+}
+
+void VoxelMap::takeDirtyBlocks(std::vector<uint64_t> &keys) {
+  keys.clear();
+  for (int s = 0; s < SHARD_COUNT; ++s) {
+    Shard &shard = shards[s];
+    for (size_t i = 0; i < shard.dirty.size(); ++i)
+      shard.blocks[shard.dirty[i]].dirty = false;
+    keys.insert(keys.end(), shard.dirty.begin(), shard.dirty.end());
+    shard.dirty.clear();
+  }
+}
+
+bool VoxelMap::getBlockPoints(uint64_t key, std::vector<Point3D> &out) const {
+  const Shard &shard = shards[getShard(key)];
+  std::unordered_map<uint64_t, Block>::const_iterator it =
+      shard.blocks.find(key);
+  if (it == shard.blocks.end())
+    return false;
+  out.assign(it->second.points.begin(), it->second.points.end());
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "memory_stats.h"
+#include "point_cloud_renderer.h"
+#include "pose.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Sweeps accumulated into one map, keeping a single point per occupied
+// voxel (the running mean of the points that fell into it), so memory
+// grows with the explored volume rather than with the number of sweeps.
+//
+// Voxels are grouped into blocks of 32^3. Blocks are spread over shards by
+// hash and each shard is merged on its own thread, so integrating a sweep
+// needs no locking. Blocks that changed are reported through
+// takeDirtyBlocks() so a GPU copy only re-uploads those.
+//
+// Not thread-safe: integrate() and the accessors are called from one
+// thread; integrate() uses worker threads internally.
+class VoxelMap {
+public:
+  explicit VoxelMap(float voxelSize = 0.1f);
+
+  // Changing the voxel size clears the map
+  void setVoxelSize(float size);
+  float getVoxelSize() const { return voxelSize; }
+
+  // Merge a sweep (viewer coordinates, sensor frame) placed by pose
+  void integrate(const std::vector<Point3D> &sweep, const Pose &pose,
+                 unsigned threads = 0);
+  void clear();
+
+  size_t getPointCount() const;
+  size_t getBlockCount() const;
+  size_t getMemoryBytes() const;
+  size_t getSweepCount() const { return sweeps; }
+
+  // Keys of the blocks changed since the last call (all blocks after
+  // clear() are gone; callers drop their copies when the map is cleared)
+  void takeDirtyBlocks(std::vector<uint64_t> &keys);
+
+  // Replace out with a block's points; false if the block doesn't exist
+  bool getBlockPoints(uint64_t key, std::vector<Point3D> &out) const;
+
+private:
+  typedef std::vector<Point3D, TrackedAllocator<Point3D, MEM_POINT_STORAGE>>
+      PointArray;
+
+  struct Block {
+    PointArray points; // Mean of each occupied voxel
+    std::vector<uint16_t, TrackedAllocator<uint16_t, MEM_INDICES>> counts;
+    // Open addressing from voxel to point: (voxel + 1) << 16 | point, with
+    // 0 for an empty slot
+    std::vector<uint32_t, TrackedAllocator<uint32_t, MEM_INDICES>> table;
+    bool dirty;
+
+    Block() : dirty(false) {}
+    void add(uint32_t voxel, const Point3D &point);
+    size_t getBytes() const;
+  };
+
+  struct Shard {
+    std::unordered_map<uint64_t, Block> blocks;
+    std::vector<uint64_t> dirty;
+    size_t points;
+    size_t bytes;
+
+    Shard() : points(0), bytes(0) {}
+  };
+
+  static const int SHARD_COUNT = 64;
+
+  int getShard(uint64_t key) const;
+
+  float voxelSize;
+  size_t sweeps;
+  Shard shards[SHARD_COUNT];
+};